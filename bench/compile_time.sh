@@ -0,0 +1,78 @@
+#!/bin/sh
+# Compile-time benchmark: generates a translation unit with PIPELINES
+# independent pipelines (each with its own lambdas, like real code) and
+# compiles it, reporting the wall time, the time GCC spends instantiating
+# templates, the amount of functions emitted (mostly template instantiations)
+# and the size of the object file.
+#
+# usage: compile_time.sh [pipelines]
+# environment:
+#   CC          the compiler (g++ by default)
+#   CXXARGS     the compiler arguments (-std=c++20 -O0 by default)
+#   INCL_PATH   the directory with the headers (../inc by default)
+#   BENCH_OUT   append the result to this file, as a JSON line
+set -e
+
+PIPELINES=${1:-${PIPELINES:-200}}
+CC=${CC:-g++}
+CXXARGS=${CXXARGS:--std=c++20 -O0}
+INCL_PATH=${INCL_PATH:-$(cd "$(dirname "$0")/../inc" && pwd)}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+SRC="$WORK/pipelines.cpp"
+
+{
+  # only the headers the pipelines use, so parsing unrelated subsystems
+  # doesn't drown out the cost of instantiating them
+  echo '#include "aggregators.hpp"'
+  echo '#include "generator.hpp"'
+  echo '#include "manipulators.hpp"'
+  echo '#include "sources.hpp"'
+  echo '#include <vector>'
+  i=0
+  while [ "$i" -lt "$PIPELINES" ]; do
+    cat <<EOF
+
+size_t pipeline_$i(const std::vector<int> &v, std::vector<long> &out) {
+  auto mapped = fpgen::map(fpgen::from(v), [](int x) { return x + $i; });
+  auto kept = fpgen::filter(std::move(mapped),
+                            [](int x) { return x % ($i + 2) != 0; });
+  auto rest = fpgen::drop_while(std::move(kept), [](int x) { return x < $i; });
+  auto longs = fpgen::map(std::move(rest), [](int x) { return long{x}; });
+  fpgen::aggregate_to(std::move(longs), out);
+  fpgen::foreach (fpgen::from(out), [](long x) { (void)x; });
+  return fpgen::fold<size_t>(fpgen::from(v),
+                             [](size_t acc, int x) { return acc + x + $i; });
+}
+EOF
+    i=$((i + 1))
+  done
+} >"$SRC"
+
+START=$(date +%s%N)
+$CC $CXXARGS -I"$INCL_PATH" -ftime-report -c "$SRC" -o "$WORK/pipelines.o" \
+  2>"$WORK/report.txt"
+END=$(date +%s%N)
+
+SECONDS_TOTAL=$(awk "BEGIN { printf \"%.3f\", ($END - $START) / 1e9 }")
+# GCC's "template instantiation" timer (usr, sys, wall, memory; we want the
+# wall time in seconds); 0 for other compilers
+INSTANTIATION=$(awk -F: '/^ *template instantiation/ {
+  gsub(/\([^)]*\)/, "", $2); split($2, t, " "); print t[3]; exit }' \
+  "$WORK/report.txt")
+INSTANTIATION=${INSTANTIATION:-0}
+FUNCTIONS=$(nm --defined-only "$WORK/pipelines.o" | awk '$2 ~ /^[tTwW]$/' |
+  wc -l)
+OBJECT=$(wc -c <"$WORK/pipelines.o")
+
+printf '%-24s %8.2f s %8.2f s instantiating %7d functions %10d bytes\n' \
+  "compile/$PIPELINES" "$SECONDS_TOTAL" "$INSTANTIATION" "$FUNCTIONS" \
+  "$OBJECT"
+
+if [ -n "$BENCH_OUT" ]; then
+  printf '{"suite":"compile_time","name":"compile/%s","seconds":%s,' \
+    "$PIPELINES" "$SECONDS_TOTAL" >>"$BENCH_OUT"
+  printf '"instantiation_seconds":%s,"functions":%s,"object_bytes":%s}\n' \
+    "$INSTANTIATION" "$FUNCTIONS" "$OBJECT" >>"$BENCH_OUT"
+fi
@@ -0,0 +1,134 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        bench.hpp
+// Purpose:     minimal benchmarking helpers for the fpgen benchmarks.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_BENCH
+#define _FPGEN_BENCH
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+/**
+ *  \brief Benchmarking helpers.
+ *
+ *  Benchmarks are configured through the environment:
+ *   - `BENCH_FILTER`: only run benchmarks whose name contains this string;
+ *   - `BENCH_OUT`: append one JSON object per benchmark (a line each) to this
+ * file, for tracking results across versions;
+ *   - `BENCH_SUITE`: the suite name recorded in that file (`make bench` sets
+ * it to the name of the benchmark binary).
+ */
+namespace bench {
+/**
+ *  \brief Prevents the compiler from optimizing a value away.
+ *  \param[in] value The value to keep.
+ */
+template <typename T> inline void keep(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+namespace detail {
+/**
+ *  \brief Reads an environment variable.
+ *  \param[in] name The name of the variable.
+ *  \returns Its value, or an empty string if it isn't set.
+ */
+inline std::string env(const char *name) {
+  const char *value = std::getenv(name);
+  return value == nullptr ? std::string() : std::string(value);
+}
+
+/**
+ *  \brief Escapes a string for use in a JSON string literal.
+ *  \param[in] text The string.
+ *  \returns The escaped string.
+ */
+inline std::string json_escape(const std::string &text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\')
+      out += '\\';
+    out += c;
+  }
+  return out;
+}
+
+/**
+ *  \brief Appends a result to the file named by `BENCH_OUT` (if set).
+ *  \param[in] name The name of the benchmark.
+ *  \param[in] iterations The amount of timed runs.
+ *  \param[in] items The amount of items processed per run.
+ *  \param[in] ns The average time per run, in nanoseconds.
+ */
+inline void record(const std::string &name, size_t iterations, size_t items,
+                   double ns) {
+  static std::FILE *out = []() -> std::FILE * {
+    std::string path = env("BENCH_OUT");
+    return path.empty() ? nullptr : std::fopen(path.c_str(), "a");
+  }();
+  if (out == nullptr)
+    return;
+  std::fprintf(out,
+               "{\"suite\":\"%s\",\"name\":\"%s\",\"iterations\":%zu,"
+               "\"items\":%zu,\"ns_per_op\":%.3f,\"ns_per_item\":%.5f}\n",
+               json_escape(env("BENCH_SUITE")).c_str(),
+               json_escape(name).c_str(), iterations, items, ns,
+               ns / static_cast<double>(items));
+  std::fflush(out);
+}
+} // namespace detail
+
+/**
+ *  \brief Checks whether a benchmark is selected by `BENCH_FILTER`.
+ *  \param[in] name The name of the benchmark.
+ *  \returns True if the benchmark should run.
+ */
+inline bool selected(const std::string &name) {
+  static const std::string filter = detail::env("BENCH_FILTER");
+  return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+/**
+ *  \brief Runs a function repeatedly and reports the time per run.
+ *
+ *  The function is run once untimed, then `iterations` times. The result is
+ * printed as `name: <ns> ns/op` (followed by the time per item, if a run
+ * processes more than one), and recorded in `BENCH_OUT`. Benchmarks not
+ * selected by `BENCH_FILTER` are skipped.
+ *
+ *  \param[in] name The name of the benchmark.
+ *  \param[in] iterations The amount of timed runs.
+ *  \param[in] func The function to run.
+ *  \param[in] items The amount of items each run processes.
+ *  \returns The average time per run, in nanoseconds (or 0 if skipped).
+ */
+template <typename Fun>
+double run(const std::string &name, size_t iterations, Fun func,
+           size_t items = 1) {
+  if (!selected(name))
+    return 0;
+  func();
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    func();
+  }
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() /
+              static_cast<double>(iterations);
+  if (items > 1) {
+    std::printf("%-48s %12.2f ns/op %10.3f ns/item\n", name.c_str(), ns,
+                ns / static_cast<double>(items));
+  } else {
+    std::printf("%-48s %12.2f ns/op\n", name.c_str(), ns);
+  }
+  detail::record(name, iterations, items, ns);
+  return ns;
+}
+} // namespace bench
+
+#endif
@@ -0,0 +1,70 @@
+#include "aggregators.hpp"
+#include "allocator.hpp"
+#include "bench.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// counts every call to the global heap
+static size_t heap_calls = 0;
+
+void *operator new(size_t size) {
+  heap_calls++;
+  if (void *ptr = std::malloc(size == 0 ? 1 : size))
+    return ptr;
+  throw std::bad_alloc();
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { std::free(ptr); }
+
+static const std::vector<int> input = {1, 2, 3, 4, 5, 6, 7, 8};
+
+// a short pipeline like the ones built per request: 4 frames
+static int pipeline() {
+  return fpgen::sum(fpgen::take(
+      fpgen::filter(fpgen::map(fpgen::from(input), [](int v) { return v * 3; }),
+                    [](int v) { return v % 2 == 0; }),
+      3));
+}
+
+template <typename Fun> static void report(const char *name, Fun func) {
+  constexpr size_t iterations = 200000;
+  if (!bench::selected(name))
+    return;
+  func();
+  size_t before = heap_calls;
+  bench::run(name, iterations, func);
+  double calls = static_cast<double>(heap_calls - before) / (iterations + 1);
+  std::printf("%-48s %12.2f heap allocs/op\n", "", calls);
+}
+
+int main() {
+  report("pipeline: global heap (no pool)", []() {
+    fpgen::alloc::heap_resource heap;
+    fpgen::alloc::scoped_resource scope(heap);
+    bench::keep(pipeline());
+  });
+
+  report("pipeline: thread-local frame pool", []() {
+    bench::keep(pipeline());
+  });
+
+  report("pipeline: arena per pipeline", []() {
+    fpgen::alloc::arena arena;
+    fpgen::alloc::scoped_resource scope(arena);
+    bench::keep(pipeline());
+  });
+
+  static fpgen::alloc::arena shared(1 << 16);
+  report("pipeline: reused arena (reset per pipeline)", []() {
+    {
+      fpgen::alloc::scoped_resource scope(shared);
+      bench::keep(pipeline());
+    }
+    shared.reset();
+  });
+}
@@ -0,0 +1,44 @@
+#include "aggregators.hpp"
+#include "batch.hpp"
+#include "bench.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <vector>
+
+static std::vector<int> make_input() {
+  std::vector<int> in(1 << 16);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = static_cast<int>(i & 0xff);
+  }
+  return in;
+}
+
+static const std::vector<int> input = make_input();
+
+int main() {
+  constexpr size_t iterations = 200;
+  auto times3 = [](int v) { return v * 3; };
+
+  bench::run("sum: per element", iterations,
+             []() { bench::keep(fpgen::sum(fpgen::from(input))); });
+
+  bench::run("sum: chunked per element source (1024)", iterations, []() {
+    bench::keep(fpgen::batch::sum(fpgen::chunk(fpgen::from(input), 1024)));
+  });
+
+  bench::run("sum: batches over the container (1024)", iterations, []() {
+    bench::keep(fpgen::batch::sum(fpgen::batch::from(input, 1024)));
+  });
+
+  bench::run("map + sum: per element", iterations, [&]() {
+    bench::keep(fpgen::sum(fpgen::map(fpgen::from(input), times3)));
+  });
+
+  bench::run("map + sum: batches (1024)", iterations, [&]() {
+    bench::keep(fpgen::batch::sum(
+        fpgen::batch::map(fpgen::batch::from(input, 1024), times3)));
+  });
+
+  return 0;
+}
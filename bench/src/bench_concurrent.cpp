@@ -0,0 +1,60 @@
+#include "aggregators.hpp"
+#include "bench.hpp"
+#include "concurrent.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <cstdint>
+
+// some CPU work standing in for parsing or hashing
+static uint64_t spin(uint64_t v, int rounds) {
+  for (int i = 0; i < rounds; i++) {
+    v = v * 6364136223846793005ull + 1442695040888963407ull;
+  }
+  return v;
+}
+
+static fpgen::generator<uint64_t> slow_source(size_t count) {
+  for (uint64_t i = 0; i < count; i++) {
+    co_yield spin(i, 200);
+  }
+  co_return;
+}
+
+int main() {
+  constexpr size_t count = 20000;
+  auto expensive = [](uint64_t v) { return spin(v, 200); };
+
+  bench::run("slow source + map, one thread", 10, [&]() {
+    bench::keep(fpgen::sum(fpgen::map(slow_source(count), expensive)));
+  });
+  bench::run("slow source + map, buffered(1024)", 10, [&]() {
+    bench::keep(fpgen::sum(
+        fpgen::map(fpgen::buffered(slow_source(count), 1024), expensive)));
+  });
+
+  // the overhead per value of passing it through the queue
+  bench::run("1M values, direct", 5, []() {
+    bench::keep(
+        fpgen::sum(fpgen::take(fpgen::inc((uint64_t)0), 1000000)));
+  });
+  bench::run("1M values, buffered(4096)", 5, []() {
+    bench::keep(fpgen::sum(fpgen::buffered(
+        fpgen::take(fpgen::inc((uint64_t)0), 1000000), 4096)));
+  });
+
+  // expensive map: scales with the threads (given more than one core)
+  bench::run("map(expensive), one thread", 10, [&]() {
+    bench::keep(fpgen::sum(
+        fpgen::map(fpgen::take(fpgen::inc((uint64_t)0), count), expensive)));
+  });
+  bench::run("par_map(expensive), window 64", 10, [&]() {
+    bench::keep(fpgen::sum(fpgen::par_map(
+        fpgen::take(fpgen::inc((uint64_t)0), count), expensive, 0, 64)));
+  });
+  bench::run("par_map_unordered(expensive), window 64", 10, [&]() {
+    bench::keep(fpgen::sum(fpgen::par_map_unordered(
+        fpgen::take(fpgen::inc((uint64_t)0), count), expensive, 0, 64)));
+  });
+  return 0;
+}
@@ -0,0 +1,525 @@
+#include "aggregators.hpp"
+#include "bench.hpp"
+#include "generator.hpp"
+#include "manipulators.hpp"
+#include "range.hpp"
+#include "sources.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <numeric>
+#include <ranges>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+// Per-element cost of every source, manipulator and aggregator, next to the
+// equivalent hand-written loop and (where one exists) std::ranges view. Names
+// are `<type>/<size>/<operation>/<variant>`, so BENCH_FILTER can select e.g.
+// all `/map/` cases, or everything over `string/1000/`.
+
+// values are increasing for every type, so they can be compared to a threshold
+template <typename T> static T make_value(size_t i) {
+  if constexpr (std::is_same_v<T, std::string>) {
+    return std::to_string(1000000000 + i);
+  } else {
+    return static_cast<T>(i);
+  }
+}
+
+// a cheap number derived from a value
+template <typename T> static size_t key(const T &value) {
+  if constexpr (std::is_same_v<T, std::string>) {
+    return static_cast<size_t>(value.back());
+  } else {
+    return static_cast<size_t>(value);
+  }
+}
+
+template <typename T> static fpgen::generator<T> repeat_twice(T value) {
+  co_yield value;
+  co_yield value;
+  co_return;
+}
+
+template <typename T> static const char *type_name() {
+  if constexpr (std::is_same_v<T, int>) {
+    return "int";
+  } else if constexpr (std::is_same_v<T, double>) {
+    return "double";
+  } else {
+    return "string";
+  }
+}
+
+template <typename T> static void suite(size_t size) {
+  std::vector<T> input;
+  for (size_t i = 0; i < size; i++) {
+    input.push_back(make_value<T>(i));
+  }
+  const T threshold = make_value<T>(size / 2);
+  const std::string prefix =
+      std::string(type_name<T>()) + "/" + std::to_string(size) + "/";
+  // ~10M elements per benchmark
+  const size_t iterations = std::max<size_t>(3, 10000000 / size);
+  auto measure = [&](const std::string &name, auto func) {
+    bench::run(prefix + name, iterations, func, size);
+  };
+
+  auto mapper = [](const T &v) { return key(v) + 1; };
+  auto pred = [](const T &v) { return key(v) % 3 != 0; };
+  auto below = [threshold](const T &v) { return v < threshold; };
+  auto add_key = [](size_t acc, T v) { return acc + key(v); };
+  auto all = [](const T &) { return true; };
+
+  // generator protocol and sources
+  measure("protocol/bool-call", [&]() {
+    size_t total = 0;
+    auto gen = fpgen::from(input);
+    while (gen) {
+      total += key(gen());
+    }
+    bench::keep(total);
+  });
+  measure("protocol/next", [&]() {
+    size_t total = 0;
+    auto gen = fpgen::from(input);
+    while (auto v = gen.next()) {
+      total += key(*v);
+    }
+    bench::keep(total);
+  });
+  measure("protocol/range-for", [&]() {
+    size_t total = 0;
+    for (const T &v : fpgen::from(input)) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  measure("from/raw", [&]() {
+    size_t total = 0;
+    for (const T &v : input) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  measure("from/ranges", [&]() {
+    size_t total = 0;
+    for (const T &v : std::views::all(input)) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  measure("from_ref/fpgen", [&]() {
+    size_t total = 0;
+    for (const T &v : fpgen::from_ref(input)) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  measure("enumerate/fpgen", [&]() {
+    size_t total = 0;
+    for (const auto &[i, v] : fpgen::enumerate(input)) {
+      total += i + key(v);
+    }
+    bench::keep(total);
+  });
+  measure("enumerate/raw", [&]() {
+    size_t total = 0;
+    for (size_t i = 0; i < input.size(); i++) {
+      total += i + key(input[i]);
+    }
+    bench::keep(total);
+  });
+  if constexpr (std::is_arithmetic_v<T>) {
+    measure("inc/fpgen", [&]() {
+      bench::keep(fpgen::sum(fpgen::take(fpgen::inc(T{}), size)));
+    });
+    measure("inc/raw", [&]() {
+      T total{};
+      for (size_t i = 0; i < size; i++) {
+        total += static_cast<T>(i);
+      }
+      bench::keep(total);
+    });
+    measure("inc/ranges", [&]() {
+      T total{};
+      for (size_t i : std::views::iota(size_t{0}, size)) {
+        total += static_cast<T>(i);
+      }
+      bench::keep(total);
+    });
+    measure("inc/iota_n", [&]() {
+      bench::keep(fpgen::sum(fpgen::iota_n(T{}, size)));
+    });
+    // a mapped range: coroutine frames against a counted loop
+    auto cube = [](T v) { return v * v * v; };
+    measure("range_map/generator", [&]() {
+      bench::keep(fpgen::sum(fpgen::map(
+          fpgen::take(fpgen::inc(T{}), size), cube)));
+    });
+    measure("range_map/fpgen", [&]() {
+      bench::keep(fpgen::sum(fpgen::map(
+          fpgen::range(T{}, static_cast<T>(size)), cube)));
+    });
+    measure("range_map/raw", [&]() {
+      T total{};
+      for (size_t i = 0; i < size; i++) {
+        total += cube(static_cast<T>(i));
+      }
+      bench::keep(total);
+    });
+  }
+
+  // manipulators
+  measure("map/fpgen", [&]() {
+    bench::keep(fpgen::sum(fpgen::map(fpgen::from(input), mapper)));
+  });
+  measure("map/raw", [&]() {
+    size_t total = 0;
+    for (const T &v : input) {
+      total += mapper(v);
+    }
+    bench::keep(total);
+  });
+  measure("map/ranges", [&]() {
+    size_t total = 0;
+    for (size_t v : input | std::views::transform(mapper)) {
+      total += v;
+    }
+    bench::keep(total);
+  });
+  // fpgen stages against the standard views, and both combined
+  auto odd = [](size_t v) { return v % 2 != 0; };
+  measure("transform_filter/fpgen", [&]() {
+    bench::keep(fpgen::sum(
+        fpgen::filter(fpgen::map(fpgen::from_ref(input), mapper), odd)));
+  });
+  // the same stages with noexcept functions: every frame uses nothrow_policy
+  auto nothrow_mapper = [](const T &v) noexcept { return key(v) + 1; };
+  auto nothrow_odd = [](size_t v) noexcept { return v % 2 != 0; };
+  measure("transform_filter/fpgen_nothrow", [&]() {
+    bench::keep(fpgen::sum(fpgen::filter(
+        fpgen::map(fpgen::from_ref(input), nothrow_mapper), nothrow_odd)));
+  });
+  measure("transform_filter/views_over_fpgen", [&]() {
+    size_t total = 0;
+    for (size_t v : fpgen::from_ref(input) | std::views::transform(mapper) |
+                        std::views::filter(odd)) {
+      total += v;
+    }
+    bench::keep(total);
+  });
+  measure("transform_filter/from_range", [&]() {
+    bench::keep(fpgen::sum(fpgen::from_range(
+        input | std::views::transform(mapper) | std::views::filter(odd))));
+  });
+  measure("transform_filter/ranges", [&]() {
+    size_t total = 0;
+    for (size_t v :
+         input | std::views::transform(mapper) | std::views::filter(odd)) {
+      total += v;
+    }
+    bench::keep(total);
+  });
+  measure("filter/fpgen", [&]() {
+    bench::keep(fpgen::count(fpgen::filter(fpgen::from(input), pred)));
+  });
+  measure("filter/raw", [&]() {
+    bench::keep(std::count_if(input.begin(), input.end(), pred));
+  });
+  measure("filter/ranges", [&]() {
+    bench::keep(std::ranges::distance(input | std::views::filter(pred)));
+  });
+  measure("drop/fpgen", [&]() {
+    bench::keep(fpgen::fold<size_t>(
+        fpgen::drop(fpgen::from(input), size / 2), add_key));
+  });
+  measure("drop/ranges", [&]() {
+    size_t total = 0;
+    for (const T &v : input | std::views::drop(size / 2)) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  measure("take/fpgen", [&]() {
+    bench::keep(fpgen::fold<size_t>(
+        fpgen::take(fpgen::from(input), size / 2), add_key));
+  });
+  measure("take/ranges", [&]() {
+    size_t total = 0;
+    for (const T &v : input | std::views::take(size / 2)) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  // the last page of 10 values
+  measure("slice/fpgen", [&]() {
+    bench::keep(fpgen::fold<size_t>(
+        fpgen::slice(fpgen::from(input), size - 10, 10), add_key));
+  });
+  measure("slice/fpgen_sequential", [&]() {
+    bench::keep(fpgen::fold<size_t>(
+        fpgen::slice(fpgen::filter(fpgen::from(input), all), size - 10, 10),
+        add_key));
+  });
+  measure("slice/ranges", [&]() {
+    size_t total = 0;
+    for (const T &v : input | std::views::drop(size - 10) |
+                          std::views::take(10)) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  measure("drop_while/fpgen", [&]() {
+    bench::keep(fpgen::count(fpgen::drop_while(fpgen::from(input), below)));
+  });
+  measure("drop_while/ranges", [&]() {
+    size_t total = 0;
+    for (const T &v : input | std::views::drop_while(below)) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  measure("take_while/fpgen", [&]() {
+    bench::keep(fpgen::count(fpgen::take_while(fpgen::from(input), below)));
+  });
+  measure("take_while/ranges", [&]() {
+    size_t total = 0;
+    for (const T &v : input | std::views::take_while(below)) {
+      total += key(v);
+    }
+    bench::keep(total);
+  });
+  measure("zip/fpgen", [&]() {
+    size_t total = 0;
+    for (const auto &[a, b] :
+         fpgen::zip(fpgen::from(input), fpgen::from(input))) {
+      total += key(a) + key(b);
+    }
+    bench::keep(total);
+  });
+  measure("zip/raw", [&]() {
+    size_t total = 0;
+    for (size_t i = 0; i < input.size(); i++) {
+      total += key(input[i]) + key(input[i]);
+    }
+    bench::keep(total);
+  });
+  // each value expands into two
+  auto twice = [](const T &v) { return repeat_twice(v); };
+  measure("flat_map/fpgen", [&]() {
+    bench::keep(fpgen::count(fpgen::flat_map(fpgen::from(input), twice)));
+  });
+  measure("flat_map/raw", [&]() {
+    size_t total = 0;
+    for (const T &v : input) {
+      for (int i = 0; i < 2; i++) {
+        T inner = v;
+        total += key(inner);
+      }
+    }
+    bench::keep(total);
+  });
+  measure("stacked/fpgen", [&]() {
+    bench::keep(fpgen::sum(fpgen::map(
+        fpgen::take(fpgen::filter(fpgen::from(input), pred), size / 2),
+        mapper)));
+  });
+  measure("stacked/raw", [&]() {
+    size_t total = 0, taken = 0;
+    for (const T &v : input) {
+      if (taken == size / 2)
+        break;
+      if (pred(v)) {
+        total += mapper(v);
+        taken++;
+      }
+    }
+    bench::keep(total);
+  });
+  measure("stacked/ranges", [&]() {
+    size_t total = 0;
+    for (size_t v : input | std::views::filter(pred) |
+                        std::views::take(size / 2) |
+                        std::views::transform(mapper)) {
+      total += v;
+    }
+    bench::keep(total);
+  });
+
+  // aggregators
+  measure("aggregate_to/fpgen", [&]() {
+    std::vector<T> out;
+    bench::keep(fpgen::aggregate_to(fpgen::from(input), out).size());
+  });
+  measure("aggregate_to/raw", [&]() {
+    std::vector<T> out;
+    for (const T &v : input) {
+      out.push_back(v);
+    }
+    bench::keep(out.size());
+  });
+  measure("aggregate_to/raw_reserved", [&]() {
+    std::vector<T> out;
+    out.reserve(input.size());
+    for (const T &v : input) {
+      out.push_back(v);
+    }
+    bench::keep(out.size());
+  });
+  measure("aggregate_to/ranges", [&]() {
+    std::vector<T> out;
+    std::ranges::copy(input, std::back_inserter(out));
+    bench::keep(out.size());
+  });
+  // the size of fpgen::from is known, so only the unsized one is traversed
+  measure("count/fpgen",
+          [&]() { bench::keep(fpgen::count(fpgen::from(input))); });
+  measure("count/fpgen_unsized", [&]() {
+    bench::keep(fpgen::count(fpgen::filter(fpgen::from(input), all)));
+  });
+  measure("fold/fpgen", [&]() {
+    bench::keep(fpgen::fold<size_t>(fpgen::from(input), add_key));
+  });
+  measure("fold/raw", [&]() {
+    bench::keep(std::accumulate(input.begin(), input.end(), size_t{0},
+                                add_key));
+  });
+  measure("fold_init/fpgen", [&]() {
+    bench::keep(fpgen::fold(fpgen::from(input), add_key, size_t{1}));
+  });
+  measure("fold_ref/fpgen", [&]() {
+    size_t total = 0;
+    bench::keep(fpgen::fold_ref(fpgen::from(input), add_key, total));
+  });
+  measure("foreach/fpgen", [&]() {
+    size_t total = 0;
+    fpgen::foreach (fpgen::from(input),
+                    [&total](const T &v) { total += key(v); });
+    bench::keep(total);
+  });
+  measure("foreach/ranges", [&]() {
+    size_t total = 0;
+    std::ranges::for_each(input, [&total](const T &v) { total += key(v); });
+    bench::keep(total);
+  });
+  if constexpr (std::is_arithmetic_v<T>) {
+    measure("sum/fpgen",
+            [&]() { bench::keep(fpgen::sum(fpgen::from(input))); });
+    measure("sum/raw", [&]() {
+      bench::keep(std::accumulate(input.begin(), input.end(), T{}));
+    });
+  }
+}
+
+// the associative and stream-based sources and aggregators
+static void text_suite(size_t size) {
+  std::map<int, int> pairs;
+  std::ostringstream numbers;
+  for (size_t i = 0; i < size; i++) {
+    pairs[static_cast<int>(i)] = static_cast<int>(i * 2);
+    numbers << i << '\n';
+  }
+  const std::string text = numbers.str();
+  const std::string prefix = "int/" + std::to_string(size) + "/";
+  const size_t iterations = std::max<size_t>(3, 2000000 / size);
+  auto measure = [&](const std::string &name, auto func) {
+    bench::run(prefix + name, iterations, func, size);
+  };
+
+  measure("from_tup/fpgen", [&]() {
+    size_t total = 0;
+    for (const auto &[k, v] : fpgen::from_tup(pairs)) {
+      total += static_cast<size_t>(k + v);
+    }
+    bench::keep(total);
+  });
+  measure("from_tup/raw", [&]() {
+    size_t total = 0;
+    for (const auto &[k, v] : pairs) {
+      total += static_cast<size_t>(k + v);
+    }
+    bench::keep(total);
+  });
+  measure("tup_aggregate_to/fpgen", [&]() {
+    std::map<int, int> out;
+    bench::keep(fpgen::tup_aggregate_to(fpgen::from_tup(pairs), out).size());
+  });
+  measure("tup_aggregate_to/raw", [&]() {
+    std::map<int, int> out;
+    for (const auto &[k, v] : pairs) {
+      out[k] = v;
+    }
+    bench::keep(out.size());
+  });
+  measure("from_stream/fpgen", [&]() {
+    std::istringstream in(text);
+    auto read = [](std::istream &in) {
+      int v = 0;
+      in >> v;
+      return v;
+    };
+    bench::keep(fpgen::sum(fpgen::from_stream(in, read)));
+  });
+  measure("from_stream/raw", [&]() {
+    std::istringstream in(text);
+    int total = 0, v = 0;
+    while (in >> v) {
+      total += v;
+    }
+    bench::keep(total);
+  });
+  measure("from_stream/ranges", [&]() {
+    std::istringstream in(text);
+    int total = 0;
+    for (int v : std::views::istream<int>(in)) {
+      total += v;
+    }
+    bench::keep(total);
+  });
+  measure("from_lines/fpgen", [&]() {
+    std::istringstream in(text);
+    bench::keep(fpgen::count(fpgen::from_lines(in)));
+  });
+  measure("from_lines/raw", [&]() {
+    std::istringstream in(text);
+    std::string line;
+    size_t lines = 0;
+    while (std::getline(in, line)) {
+      lines++;
+    }
+    bench::keep(lines);
+  });
+  measure("to_stream/fpgen", [&]() {
+    std::ostringstream out;
+    fpgen::to_stream(fpgen::take(fpgen::inc(0), size), out, ' ');
+    bench::keep(out.view().size());
+  });
+  measure("to_lines/fpgen", [&]() {
+    std::ostringstream out;
+    fpgen::to_lines(fpgen::take(fpgen::inc(0), size), out);
+    bench::keep(out.view().size());
+  });
+  measure("to_lines/raw", [&]() {
+    std::ostringstream out;
+    for (size_t i = 0; i < size; i++) {
+      out << static_cast<int>(i) << '\n';
+    }
+    bench::keep(out.view().size());
+  });
+}
+
+int main() {
+  for (size_t size : {1000, 1000000}) {
+    suite<int>(size);
+    suite<double>(size);
+    suite<std::string>(size);
+    text_suite(size);
+  }
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include "aggregators.hpp"
+#include "bench.hpp"
+#include "instrument.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Built twice by the bench Makefile: as is, and as bench_instrument_off with
+// FPGEN_NO_INSTRUMENTATION, where the instrumented pipeline should cost
+// exactly as much as the plain one.
+#ifdef FPGEN_NO_INSTRUMENTATION
+static const std::string mode = " [instrumentation off]";
+#else
+static const std::string mode = " [instrumentation on]";
+#endif
+
+static std::vector<int> make_input() {
+  std::vector<int> in(1 << 16);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = static_cast<int>(i);
+  }
+  return in;
+}
+
+static const std::vector<int> input = make_input();
+
+static auto times3 = [](int v) { return v * 3; };
+static auto even = [](int v) { return v % 2 == 0; };
+
+int main() {
+  constexpr size_t iterations = 200;
+
+  bench::run(
+      "plain pipeline (3 stages)" + mode, iterations,
+      []() {
+        bench::keep(
+            fpgen::sum(fpgen::filter(fpgen::map(fpgen::from(input), times3),
+                                     even)));
+      },
+      input.size());
+
+  bench::run(
+      "instrumented pipeline (3 stages)" + mode, iterations,
+      []() {
+        auto source = fpgen::instrumented(fpgen::from(input), "source");
+        auto mapped = fpgen::instrumented(
+            fpgen::map(std::move(source), times3), "map");
+        bench::keep(fpgen::sum(fpgen::instrumented(
+            fpgen::filter(std::move(mapped), even), "filter")));
+      },
+      input.size());
+
+#ifdef FPGEN_NO_INSTRUMENTATION
+  // no wrapper at all: the very same coroutine comes back
+  auto gen = fpgen::from(input);
+  fpgen::generator<int>::handle_type before = gen;
+  auto same = fpgen::instrumented(std::move(gen), "source");
+  fpgen::generator<int>::handle_type after = same;
+  std::printf("%-48s %12s\n", "", before == after ? "no wrapper" : "WRAPPED");
+  return before == after ? 0 : 1;
+#else
+  // what the registry makes of the instrumented runs
+  for (const auto &s : fpgen::instrument::registry::global().snapshot()) {
+    std::printf("  %-8s in %9llu  out %9llu  self %7.2f ms  p50 %5.0f ns  "
+                "p99 %5.0f ns\n",
+                s.name.c_str(), static_cast<unsigned long long>(s.elements_in),
+                static_cast<unsigned long long>(s.elements_out),
+                static_cast<double>(s.self_ns) / 1e6, s.p50_ns, s.p99_ns);
+  }
+
+  bench::run(
+      "instrumented source, traced" + mode, iterations,
+      []() {
+        fpgen::instrument::registry::global().reset();
+        fpgen::instrument::registry::global().trace(true);
+        bench::keep(fpgen::sum(
+            fpgen::instrumented(fpgen::from(input), "traced source")));
+        fpgen::instrument::registry::global().trace(false);
+      },
+      input.size());
+  return 0;
+#endif
+}
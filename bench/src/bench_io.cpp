@@ -0,0 +1,119 @@
+#include "bench.hpp"
+#include "generator.hpp"
+#include "io.hpp"
+#include "sources.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+int main() {
+  // ~64 MiB of log-like lines of varying length
+  std::string path =
+      (std::filesystem::temp_directory_path() / "fpgen_bench_lines.txt")
+          .string();
+  size_t bytes = 0;
+  {
+    std::ofstream out(path, std::ios::binary);
+    std::string line;
+    for (size_t i = 0; bytes < (64u << 20); i++) {
+      line = "2022-01-01 12:00:00 [info] request " + std::to_string(i) + " " +
+             std::string(i % 97, 'x') + "\n";
+      out << line;
+      bytes += line.size();
+    }
+  }
+  auto throughput = [bytes](const std::string &name, auto func) {
+    double ns = bench::run(name, 5, func);
+    if (ns > 0)
+      std::printf("%-48s %12.2f GB/s\n", "", static_cast<double>(bytes) / ns);
+  };
+
+  throughput("from_lines (istream + getline)", [&]() {
+    std::ifstream in(path, std::ios::binary);
+    size_t total = 0;
+    for (const auto &line : fpgen::from_lines(in)) {
+      total += line.size();
+    }
+    bench::keep(total);
+  });
+  throughput("from_mmap_lines", [&]() {
+    size_t total = 0;
+    for (auto line : fpgen::from_mmap_lines(path)) {
+      total += line.size();
+    }
+    bench::keep(total);
+  });
+  throughput("from_mmap_lines, populate", [&]() {
+    fpgen::mmap_options options;
+    options.populate = true;
+    size_t total = 0;
+    for (auto line : fpgen::from_mmap_lines(path, options)) {
+      total += line.size();
+    }
+    bench::keep(total);
+  });
+  throughput("from_istream_lines (64 KiB blocks)", [&]() {
+    std::ifstream in(path, std::ios::binary);
+    size_t total = 0;
+    for (auto line : fpgen::from_istream_lines(in)) {
+      total += line.size();
+    }
+    bench::keep(total);
+  });
+  throughput("from_fd_lines (64 KiB blocks)", [&]() {
+    int fd = open(path.c_str(), O_RDONLY);
+    size_t total = 0;
+    for (auto line : fpgen::from_fd_lines(fd)) {
+      total += line.size();
+    }
+    close(fd);
+    bench::keep(total);
+  });
+
+  // 64 MiB of fixed-size records, through each binary mode
+  struct record {
+    uint64_t key;
+    double value;
+  };
+  auto records = []() -> fpgen::generator<record> {
+    for (uint64_t i = 0; i < (4u << 20); i++) {
+      co_yield record{i, 0.5 * static_cast<double>(i)};
+    }
+  };
+  std::string bin_path =
+      (std::filesystem::temp_directory_path() / "fpgen_bench_records.bin")
+          .string();
+  size_t bin_bytes = (4u << 20) * sizeof(record);
+  const char *mode_names[] = {"buffered", "mmap", "direct"};
+  for (auto mode : {fpgen::io_mode::buffered, fpgen::io_mode::mmap,
+                    fpgen::io_mode::direct}) {
+    std::string name = mode_names[static_cast<int>(mode)];
+    double ns = bench::run("to_binary, " + name, 3, [&]() {
+      bench::keep(fpgen::to_binary(records(), bin_path, mode));
+    });
+    if (ns > 0)
+      std::printf("%-48s %12.2f GB/s\n", "",
+                  static_cast<double>(bin_bytes) / ns);
+    ns = bench::run("from_binary, " + name, 3, [&]() {
+      uint64_t total = 0;
+      for (const record &r : fpgen::from_binary<record>(bin_path, mode)) {
+        total += r.key;
+      }
+      bench::keep(total);
+    });
+    if (ns > 0)
+      std::printf("%-48s %12.2f GB/s\n", "",
+                  static_cast<double>(bin_bytes) / ns);
+  }
+  std::filesystem::remove(bin_path);
+
+  std::filesystem::remove(path);
+  return 0;
+}
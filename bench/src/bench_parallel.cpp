@@ -0,0 +1,54 @@
+#include "aggregators.hpp"
+#include "bench.hpp"
+#include "parallel.hpp"
+#include "sources.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+static std::vector<double> make_input() {
+  std::vector<double> in(1 << 22);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = static_cast<double>(i % 1000) * 0.5;
+  }
+  return in;
+}
+
+static const std::vector<double> input = make_input();
+
+int main() {
+  constexpr size_t iterations = 5;
+  auto heavy = [](double acc, double v) { return acc + std::sqrt(v); };
+  auto add = [](double lhs, double rhs) { return lhs + rhs; };
+
+  double base = bench::run("sequential fpgen::sum", iterations, []() {
+    bench::keep(fpgen::sum(fpgen::from(input)));
+  });
+  double base_fold = bench::run("sequential fpgen::fold (sqrt)", iterations,
+                                [&]() {
+                                  bench::keep(fpgen::fold<double>(
+                                      fpgen::from(input), heavy));
+                                });
+
+  size_t max = std::thread::hardware_concurrency();
+  for (size_t threads = 1; threads <= max; threads *= 2) {
+    fpgen::thread_pool pool(threads);
+    std::string suffix = " [" + std::to_string(threads) + " threads]";
+    double ns = bench::run("parallel_sum" + suffix, iterations, [&]() {
+      bench::keep(fpgen::parallel_sum(fpgen::split_from(input), pool));
+    });
+    if (ns > 0 && base > 0)
+      std::printf("%-48s %12.2fx\n", "", base / ns);
+    ns = bench::run("parallel_fold (sqrt)" + suffix, iterations, [&]() {
+      bench::keep(fpgen::parallel_fold<double>(fpgen::split_from(input), heavy,
+                                               add, 0.0, pool));
+    });
+    if (ns > 0 && base_fold > 0)
+      std::printf("%-48s %12.2fx\n", "", base_fold / ns);
+  }
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include "aggregators.hpp"
+#include "bench.hpp"
+#include "manipulators.hpp"
+#include "pipeline.hpp"
+#include "sources.hpp"
+
+#include <vector>
+
+static std::vector<int> make_input() {
+  std::vector<int> in(1 << 16);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = static_cast<int>(i);
+  }
+  return in;
+}
+
+static const std::vector<int> input = make_input();
+static const size_t limit = 20000;
+
+static auto times3 = [](int v) { return v * 3; };
+static auto even = [](int v) { return v % 2 == 0; };
+
+int main() {
+  constexpr size_t iterations = 200;
+
+  bench::run("hand-written loop", iterations, []() {
+    int total = 0;
+    size_t taken = 0;
+    for (int v : input) {
+      if (taken == limit)
+        break;
+      int m = times3(v);
+      if (even(m)) {
+        total += m;
+        taken++;
+      }
+    }
+    bench::keep(total);
+  });
+
+  bench::run("nested manipulators (4 frames)", iterations, []() {
+    bench::keep(fpgen::sum(fpgen::take(
+        fpgen::filter(fpgen::map(fpgen::from(input), times3), even), limit)));
+  });
+
+  bench::run("pipeline from generator", iterations, []() {
+    bench::keep(fpgen::sum(fpgen::from(input) | fpgen::map(times3) |
+                           fpgen::filter(even) | fpgen::take(limit)));
+  });
+
+  bench::run("pipeline from container", iterations, []() {
+    bench::keep(fpgen::sum(input | fpgen::map(times3) | fpgen::filter(even) |
+                           fpgen::take(limit)));
+  });
+
+  bench::run("pipeline from container, as generator", iterations, []() {
+    fpgen::generator<int> gen = input | fpgen::map(times3) |
+                                fpgen::filter(even) | fpgen::take(limit);
+    bench::keep(fpgen::sum(std::move(gen)));
+  });
+
+  return 0;
+}
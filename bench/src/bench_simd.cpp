@@ -0,0 +1,62 @@
+#include "aggregators.hpp"
+#include "batch.hpp"
+#include "bench.hpp"
+#include "simd.hpp"
+#include "sources.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const char *names[] = {"scalar", "sse4", "avx2"};
+
+template <typename T> static std::vector<T> make_input() {
+  std::vector<T> in(1 << 20);
+  for (size_t i = 0; i < in.size(); i++) {
+    in[i] = static_cast<T>(i % 1000);
+  }
+  return in;
+}
+
+// runs the benchmark and reports its throughput over `bytes` bytes of input
+template <typename Fun>
+static void throughput(const std::string &name, size_t bytes, Fun func) {
+  double ns = bench::run(name, 20, func);
+  if (ns > 0)
+    std::printf("%-48s %12.2f GB/s\n", "", static_cast<double>(bytes) / ns);
+}
+
+template <typename T> static void suite(const char *type) {
+  static const std::vector<T> in = make_input<T>();
+  size_t bytes = in.size() * sizeof(T);
+  std::string prefix = std::string(type) + " ";
+
+  throughput(prefix + "fpgen::sum(from(v))", bytes,
+             []() { bench::keep(fpgen::sum(fpgen::from(in))); });
+  throughput(prefix + "fpgen::batch::sum(batch::from(v, 4096))", bytes, []() {
+    bench::keep(fpgen::batch::sum(fpgen::batch::from(in, 4096)));
+  });
+
+  for (auto lvl : {fpgen::simd::level::scalar, fpgen::simd::level::sse4,
+                   fpgen::simd::level::avx2}) {
+    if (lvl > fpgen::simd::supported())
+      continue;
+    fpgen::simd::limit(lvl);
+    std::string suffix = std::string(" [") + names[(int)lvl] + "]";
+    throughput(prefix + "simd::sum" + suffix, bytes,
+               []() { bench::keep(fpgen::simd::sum(in)); });
+    throughput(prefix + "simd::max" + suffix, bytes,
+               []() { bench::keep(fpgen::simd::max(in)); });
+    throughput(prefix + "simd::count" + suffix, bytes,
+               []() { bench::keep(fpgen::simd::count(in, T(7))); });
+    throughput(prefix + "simd::dot" + suffix, 2 * bytes,
+               []() { bench::keep(fpgen::simd::dot(in, in)); });
+  }
+  fpgen::simd::limit(fpgen::simd::level::avx2);
+}
+
+int main() {
+  suite<float>("float");
+  suite<int>("int");
+  return 0;
+}
@@ -0,0 +1,75 @@
+#include "aggregators.hpp"
+#include "bench.hpp"
+#include "generator.hpp"
+#include "sink.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+// 10M numbers per run; enough for flushing to dominate the old to_lines
+constexpr uint64_t count = 10'000'000;
+
+fpgen::generator<uint64_t> numbers() {
+  for (uint64_t i = 0; i < count; i++) {
+    co_yield i * 2654435761u % 1000000007u;
+  }
+  co_return;
+}
+
+fpgen::generator<double> reals() {
+  for (uint64_t i = 0; i < count; i++) {
+    co_yield static_cast<double>(i) / 7.0;
+  }
+  co_return;
+}
+
+int main() {
+  std::string path =
+      (std::filesystem::temp_directory_path() / "fpgen_bench_sink.txt")
+          .string();
+  auto per_value = [](const std::string &name, auto func) {
+    bench::run(name, 3, func, count);
+  };
+
+  per_value("integers, std::endl per line", [&]() {
+    std::ofstream out(path);
+    auto gen = numbers();
+    while (gen) {
+      out << gen() << std::endl;
+    }
+  });
+  per_value("integers, to_lines (ofstream)", [&]() {
+    std::ofstream out(path);
+    fpgen::to_lines(numbers(), out);
+  });
+  per_value("integers, to_sink_lines", [&]() {
+    fpgen::fd_sink sink(path);
+    fpgen::to_sink_lines(numbers(), sink).flush();
+  });
+  per_value("integers, to_sink_lines, background", [&]() {
+    fpgen::sink_options options;
+    options.background = true;
+    fpgen::fd_sink sink(path, options);
+    fpgen::to_sink_lines(numbers(), sink).flush();
+  });
+  per_value("integers, to_sink_lines, 1 MiB buffer", [&]() {
+    fpgen::sink_options options;
+    options.capacity = 1 << 20;
+    fpgen::fd_sink sink(path, options);
+    fpgen::to_sink_lines(numbers(), sink).flush();
+  });
+
+  per_value("doubles, to_lines (ofstream)", [&]() {
+    std::ofstream out(path);
+    fpgen::to_lines(reals(), out);
+  });
+  per_value("doubles, to_sink_lines", [&]() {
+    fpgen::fd_sink sink(path);
+    fpgen::to_sink_lines(reals(), sink).flush();
+  });
+
+  std::filesystem::remove(path);
+  return 0;
+}
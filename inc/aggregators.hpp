@@ -20,6 +20,24 @@
  *  \brief The namespace containing all of fpgen's code.
  */
 namespace fpgen {
+namespace detail {
+/**
+ *  \brief Type trait checking whether a container supports `reserve(size)`.
+ *  \tparam Container The container type.
+ */
+template <typename Container, typename = void>
+struct has_reserve : std::false_type {};
+/**
+ *  \brief Type trait checking whether a container supports `reserve(size)`.
+ *  \tparam Container The container type.
+ */
+template <typename Container>
+struct has_reserve<Container,
+                   std::void_t<decltype(std::declval<Container &>().reserve(
+                       std::declval<Container &>().size()))>>
+    : std::true_type {};
+} // namespace detail
+
 /**
  *  \brief Aggregates all data in the generator to a dataset.
  *
@@ -27,21 +45,34 @@ namespace fpgen {
  * containers). Each element is extracted from the generator and inserted into
  * the container. The container is not cleared before inserting. Elements
  * already extracted (due to previous calls to the generator, ...) cannot be
- * reconstructed.
+ * reconstructed. Elements are moved into the container, so move-only types
+ * are supported. If the generator's size is known exactly (see
+ * fpgen::size_hint) and the container supports `reserve`, space for all
+ * elements is reserved up front.
  *
- *  \tparam T The type contained in the container and generator.
+ *  \tparam TGen The type contained in the generator; either `T` or a reference
+ * to `T`.
+ *  \tparam P The exception policy of the generator.
+ *  \tparam T The type contained in the container.
  *  \tparam Args Other parameters to be passed to the container.
  *  \tparam Container The container type to output to.
  *  \param[in, out] gen The generator to extract from.
  *  \param[out] out The container to output to.
  *  \returns A reference to the modified container.
  */
-template <typename T, typename... Args,
-          template <typename...> typename Container>
-Container<T, Args...> &aggregate_to(generator<T> gen,
+template <typename TGen, typename P, typename T, typename... Args,
+          template <typename...> typename Container,
+          typename _ = std::enable_if_t<
+              std::is_same<std::remove_cvref_t<TGen>, T>::value>>
+Container<T, Args...> &aggregate_to(generator<TGen, P> gen,
                                     Container<T, Args...> &out) {
-  while (gen) {
-    out.push_back(gen());
+  if constexpr (detail::has_reserve<Container<T, Args...>>::value) {
+    size_hint hint = gen.hint();
+    if (hint.is_exact())
+      out.reserve(out.size() + hint.size);
+  }
+  for (auto &&value : gen) {
+    out.push_back(std::forward<decltype(value)>(value));
   }
   return out;
 }
@@ -56,20 +87,20 @@ Container<T, Args...> &aggregate_to(generator<T> gen,
  *
  *  \tparam TKey The key type for the container.
  *  \tparam TValue The value type for the container.
+ *  \tparam P The exception policy of the generator.
  *  \tparam Args Other parameters to be passed to the container.
  *  \tparam Container The container to be used.
  *  \param[in, out] gen The generator to extract from.
  *  \param[out] out The container to insert to.
  *  \returns A reference to the modified container.
  */
-template <typename TKey, typename TVal, typename... Args,
+template <typename TKey, typename TVal, typename P, typename... Args,
           template <typename...> typename Container>
 Container<TKey, TVal, Args...> &
-tup_aggregate_to(generator<std::tuple<TKey, TVal>> gen,
+tup_aggregate_to(generator<std::tuple<TKey, TVal>, P> gen,
                  Container<TKey, TVal, Args...> &out) {
-  while (gen) {
-    std::tuple<TKey, TVal> tup = gen();
-    out[std::get<0>(tup)] = std::get<1>(tup);
+  for (auto &&tup : gen) {
+    out[std::move(std::get<0>(tup))] = std::move(std::get<1>(tup));
   }
   return out;
 }
@@ -79,16 +110,21 @@ tup_aggregate_to(generator<std::tuple<TKey, TVal>> gen,
  *
  *  Each element is extracted from the generator. These values are not
  * recoverable. Only values left in the generator are counted. Afterwards, the
- * generator will be empty.
+ * generator will be empty. If the generator's size is known exactly (see
+ * fpgen::size_hint), it is returned without running the generator at all (so
+ * side effects of generating the values don't happen).
  *
  *  \tparam T The type of values contained in the generator.
+ *  \tparam P The exception policy of the generator.
  *  \param[in,out] gen The generator to iterate over.
  *  \returns The amount of elements in the generator.
  */
-template <typename T> size_t count(generator<T> gen) {
+template <typename T, typename P> size_t count(generator<T, P> gen) {
+  size_hint hint = gen.hint();
+  if (hint.is_exact())
+    return hint.size;
   size_t cnt = 0;
-  while (gen) {
-    gen();
+  for (auto it = gen.begin(); it != gen.end(); ++it) {
     cnt++;
   }
   return cnt;
@@ -105,18 +141,19 @@ template <typename T> size_t count(generator<T> gen) {
  *
  *  \tparam TOut The output type (accumulator type).
  *  \tparam TIn The input type (type contained in the generator).
+ *  \tparam P The exception policy of the generator.
  *  \tparam Fun The function type (should have the signature (TOut, TIn) ->
  * TOut).
  *  \param[in,out] gen The generator to fold.
  *  \param[in] folder The folding function.
  *  \returns The final accumulator value.
  */
-template <typename TOut, typename TIn, typename Fun,
-          typename _ = type::is_function_to<Fun, TOut, TOut, TIn>>
-TOut fold(generator<TIn> gen, Fun folder) {
+template <typename TOut, typename TIn, typename P, typename Fun>
+  requires type::function_to<Fun, TOut, TOut, TIn>
+TOut fold(generator<TIn, P> gen, Fun folder) {
   TOut value = {};
-  while (gen) {
-    value = folder(value, gen());
+  for (auto &&v : gen) {
+    value = folder(std::move(value), std::forward<decltype(v)>(v));
   }
   return value;
 }
@@ -128,23 +165,24 @@ TOut fold(generator<TIn> gen, Fun folder) {
  * (TOut, TIn) -> TOut) as signature is called. The result is stored in the
  * accumulator, which is passed down to the next value in the generator. Once
  * all values are extracted, the resulting accumulator is returned. The
- * accumulator is initialized using `TOut value(initial);`.
+ * accumulator is initialized using `TOut value(std::move(initial));`.
  *
  *  \tparam TOut The output type (accumulator type).
  *  \tparam TIn The input type (type contained in the generator).
+ *  \tparam P The exception policy of the generator.
  *  \tparam Fun The function type (should have the signature (TOut, TIn) ->
  * TOut).
  *  \param[in,out] gen The generator to fold.
  *  \param[in] folder The folding function.
- *  \param[in] initial The initial value for the accumulator (is copied).
+ *  \param[in] initial The initial value for the accumulator.
  *  \returns The final accumulator value.
  */
-template <typename TOut, typename TIn, typename Fun,
-          typename _ = type::is_function_to<Fun, TOut, TOut, TIn>>
-TOut fold(generator<TIn> gen, Fun folder, TOut initial) {
-  TOut value(initial);
-  while (gen) {
-    value = folder(value, gen());
+template <typename TOut, typename TIn, typename P, typename Fun>
+  requires type::function_to<Fun, TOut, TOut, TIn>
+TOut fold(generator<TIn, P> gen, Fun folder, TOut initial) {
+  TOut value(std::move(initial));
+  for (auto &&v : gen) {
+    value = folder(std::move(value), std::forward<decltype(v)>(v));
   }
   return value;
 }
@@ -160,6 +198,7 @@ TOut fold(generator<TIn> gen, Fun folder, TOut initial) {
  *
  *  \tparam TOut The output type (accumulator type).
  *  \tparam TIn The input type (type contained in the generator).
+ *  \tparam P The exception policy of the generator.
  *  \tparam Fun The function type (should have the signature (TOut, TIn) ->
  * TOut or (TOut &, TIn) -> TOut).
  *  \param[in,out] gen The generator to fold.
@@ -168,11 +207,11 @@ TOut fold(generator<TIn> gen, Fun folder, TOut initial) {
  *  \returns A reference to the value which was passed as initial value and is
  * now the output value.
  */
-template <typename TOut, typename TIn, typename Fun,
-          typename _ = type::is_function_to<Fun, TOut, TOut, TIn>>
-TOut &fold_ref(generator<TIn> gen, Fun folder, TOut &initial) {
-  while (gen) {
-    initial = folder(initial, gen());
+template <typename TOut, typename TIn, typename P, typename Fun>
+  requires type::function_to<Fun, TOut, TOut, TIn>
+TOut &fold_ref(generator<TIn, P> gen, Fun folder, TOut &initial) {
+  for (auto &&v : gen) {
+    initial = folder(initial, std::forward<decltype(v)>(v));
   }
   return initial;
 }
@@ -185,13 +224,16 @@ TOut &fold_ref(generator<TIn> gen, Fun folder, TOut &initial) {
  * the accumulator, which is returned afterwards.
  *
  *  \tparam T The type contained in the generator, should support `operator+`.
+ * For reference generators, the referenced type should.
+ *  \tparam P The exception policy of the generator.
  *  \param[in,out] gen The generator to sum over.
  *  \returns The sum of all elements.
  */
-template <typename T> T sum(generator<T> gen) {
-  T accum = {};
-  while (gen) {
-    accum = accum + gen();
+template <typename T, typename P>
+std::remove_cvref_t<T> sum(generator<T, P> gen) {
+  std::remove_cvref_t<T> accum = {};
+  for (auto &&v : gen) {
+    accum = std::move(accum) + std::forward<decltype(v)>(v);
   }
   return accum;
 }
@@ -204,15 +246,16 @@ template <typename T> T sum(generator<T> gen) {
  * function and a lambda function. Afterwards, the generator will be empty.
  *
  *  \tparam T The type of values contained in the generator.
+ *  \tparam P The exception policy of the generator.
  *  \tparam Fun The function type of the callback.
  *  \param[in,out] gen The generator to iterate over.
  *  \param[in] func The function to use.
  */
-template <typename T, typename Fun,
-          typename _ = type::is_function_to<Fun, void, T>>
-void foreach (generator<T> gen, Fun func) {
-  while (gen) {
-    func(gen());
+template <typename T, typename P, typename Fun>
+  requires type::function_to<Fun, void, T>
+void foreach (generator<T, P> gen, Fun func) {
+  for (auto &&v : gen) {
+    func(std::forward<decltype(v)>(v));
   }
 }
 
@@ -223,14 +266,15 @@ void foreach (generator<T> gen, Fun func) {
  * resulting (modified) stream.
  *
  *  \tparam T The type of values in the stream.
+ *  \tparam P The exception policy of the generator.
  *  \param[in,out] gen The generator supplying the values.
  *  \param[in,out] stream The stream to output to.
  *  \returns The resulting stream.
  */
-template <typename T>
-std::ostream &to_stream(generator<T> gen, std::ostream &stream) {
-  while (gen) {
-    stream << gen();
+template <typename T, typename P>
+std::ostream &to_stream(generator<T, P> gen, std::ostream &stream) {
+  for (auto &&v : gen) {
+    stream << v;
   }
   return stream;
 }
@@ -244,19 +288,22 @@ std::ostream &to_stream(generator<T> gen, std::ostream &stream) {
  * the separator is added.
  *
  *  \tparam T The type of values in the stream.
+ *  \tparam P The exception policy of the generator.
  *  \tparam T2 The type of the separator.
  *  \param[in,out] gen The generator supplying the values.
  *  \param[in,out] stream The stream to output to.
  *  \param[in] separator The separator to use.
  *  \returns The resulting stream.
  */
-template <typename T, typename T2>
-std::ostream &to_stream(generator<T> gen, std::ostream &stream, T2 separator) {
-  if (gen) {
-    stream << gen();
-  }
-  while (gen) {
-    stream << separator << gen();
+template <typename T, typename P, typename T2>
+std::ostream &to_stream(generator<T, P> gen, std::ostream &stream,
+                        T2 separator) {
+  bool first = true;
+  for (auto &&v : gen) {
+    if (!first)
+      stream << separator;
+    stream << v;
+    first = false;
   }
   return stream;
 }
@@ -264,19 +311,21 @@ std::ostream &to_stream(generator<T> gen, std::ostream &stream, T2 separator) {
 /**
  *  \brief Sends each value to the stream on a separate line.
  *
- *  Calls `stream << value << std::endl` for each value in the generator, then
- * returns the resulting (modified) stream. To avoid a trailing newline, see
- * `fpgen::to_lines_no_trail`
+ *  Calls `stream << value << '\n'` for each value in the generator, then
+ * returns the resulting (modified) stream. The stream is not flushed after
+ * each line; use `std::flush` (or `fpgen::fd_sink`) when that matters. To avoid
+ * a trailing newline, see `fpgen::to_lines_no_trail`
  *
  *  \tparam T The type of values in the stream.
+ *  \tparam P The exception policy of the generator.
  *  \param[in,out] gen The generator supplying the values.
  *  \param[in,out] stream The stream to output to.
  *  \returns The resulting stream.
  */
-template <typename T>
-std::ostream &to_lines(generator<T> gen, std::ostream &stream) {
-  while (gen) {
-    stream << gen() << std::endl;
+template <typename T, typename P>
+std::ostream &to_lines(generator<T, P> gen, std::ostream &stream) {
+  for (auto &&v : gen) {
+    stream << v << '\n';
   }
   return stream;
 }
@@ -285,21 +334,24 @@ std::ostream &to_lines(generator<T> gen, std::ostream &stream) {
  *  \brief Sends each value to the stream on a separate line, without trailing
  * newline.
  *
- *  Calls `stream << std::endl << value` for each value in the generator (except
- * the first), then returns the resulting (modified) stream.
+ *  Calls `stream << '\n' << value` for each value in the generator (except the
+ * first), then returns the resulting (modified) stream. The stream is not
+ * flushed.
  *
  *  \tparam T The type of values in the stream.
+ *  \tparam P The exception policy of the generator.
  *  \param[in,out] gen The generator supplying the values.
  *  \param[in,out] stream The stream to output to.
  *  \returns The resulting stream.
  */
-template <typename T>
-std::ostream &to_lines_no_trail(generator<T> gen, std::ostream &stream) {
-  if (gen) {
-    stream << gen();
-  }
-  while (gen) {
-    stream << std::endl << gen();
+template <typename T, typename P>
+std::ostream &to_lines_no_trail(generator<T, P> gen, std::ostream &stream) {
+  bool first = true;
+  for (auto &&v : gen) {
+    if (!first)
+      stream << '\n';
+    stream << v;
+    first = false;
   }
   return stream;
 }
@@ -0,0 +1,516 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        allocator.hpp
+// Purpose:     allocation of fpgen coroutine frames.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_ALLOCATOR
+#define _FPGEN_ALLOCATOR
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ *  \brief The namespace containing the coroutine frame allocation helpers.
+ *
+ *  Every generator frame is allocated through fpgen::alloc::allocate_frame.
+ * Where the memory comes from depends on how the coroutine is called:
+ *  - if the coroutine takes `std::allocator_arg_t, const Alloc &` as its first
+ * parameters, the frame is allocated using that allocator;
+ *  - otherwise, if a fpgen::alloc::scoped_resource is active on the current
+ * thread, the frame is allocated from that resource;
+ *  - otherwise, the frame comes from the thread-local fpgen::alloc::frame_pool.
+ *
+ *  The way a frame was allocated is recorded behind the frame itself, so frames
+ * can be destroyed on any thread and after the scope they were created in.
+ */
+namespace fpgen::alloc {
+/**
+ *  \brief Function type used to release a frame.
+ *
+ *  The first argument is the frame, the second the frame size requested by the
+ * compiler.
+ */
+using release_fn = void (*)(void *, size_t);
+
+/**
+ *  \brief Helpers to lay out frames; not part of the public interface.
+ */
+namespace detail {
+/**
+ *  \brief Block type in which allocator-allocated frames are expressed.
+ */
+struct alignas(std::max_align_t) frame_block {
+  /**
+   *  \brief Padding to make the block as large as its alignment.
+   */
+  unsigned char data[alignof(std::max_align_t)];
+};
+
+/**
+ *  \brief Rounds a size up to a multiple of the given alignment.
+ *  \param[in] size The size to round up.
+ *  \param[in] align The alignment (a power of two).
+ *  \returns The rounded size.
+ */
+constexpr size_t align_up(size_t size, size_t align) {
+  return (size + align - 1) & ~(align - 1);
+}
+
+/**
+ *  \brief Gets the offset of the release function behind a frame.
+ *  \param[in] size The frame size requested by the compiler.
+ *  \returns The offset of the release function.
+ */
+constexpr size_t release_offset(size_t size) {
+  return align_up(size, alignof(release_fn));
+}
+
+/**
+ *  \brief Gets the offset of the stored allocator behind a frame.
+ *  \tparam Alloc The allocator type.
+ *  \param[in] size The frame size requested by the compiler.
+ *  \returns The offset of the stored allocator.
+ */
+template <typename Alloc> constexpr size_t allocator_offset(size_t size) {
+  return align_up(release_offset(size) + sizeof(release_fn), alignof(Alloc));
+}
+
+/**
+ *  \brief Gets the total amount of bytes needed for a frame and its trailer.
+ *  \tparam Alloc The allocator type stored behind the frame.
+ *  \param[in] size The frame size requested by the compiler.
+ *  \returns The size to allocate.
+ */
+template <typename Alloc> constexpr size_t total_size(size_t size) {
+  return allocator_offset<Alloc>(size) + sizeof(Alloc);
+}
+
+/**
+ *  \brief Gets the location of a value at some offset in a frame.
+ *  \tparam T The value type.
+ *  \param[in] frame The frame.
+ *  \param[in] offset The offset of the value.
+ *  \returns A pointer to the value.
+ */
+template <typename T> T *at(void *frame, size_t offset) {
+  return reinterpret_cast<T *>(static_cast<unsigned char *>(frame) + offset);
+}
+
+/**
+ *  \brief Releases a frame which was allocated using an allocator.
+ *  \tparam Alloc The (rebound) allocator type stored behind the frame.
+ *  \param[in] frame The frame.
+ *  \param[in] size The frame size requested by the compiler.
+ */
+template <typename Alloc> void release_with(void *frame, size_t size) {
+  Alloc *stored = at<Alloc>(frame, allocator_offset<Alloc>(size));
+  Alloc alloc(std::move(*stored));
+  stored->~Alloc();
+  size_t blocks = align_up(total_size<Alloc>(size), sizeof(frame_block)) /
+                  sizeof(frame_block);
+  std::allocator_traits<Alloc>::deallocate(
+      alloc, static_cast<frame_block *>(frame), blocks);
+}
+} // namespace detail
+
+/**
+ *  \brief A thread-local free list for coroutine frames.
+ *
+ *  Frames are grouped in size classes of `granularity` bytes. Freed frames are
+ * kept (up to `max_cached` per class) in a list owned by the freeing thread,
+ * and handed out again to the next frame in the same class. Building and
+ * tearing down short pipelines therefore doesn't go through the global heap
+ * after the first time. Frames larger than `classes * granularity` bytes
+ * bypass the pool. All memory is obtained from the global `operator new`, so
+ * it doesn't matter which thread frees a frame.
+ */
+class frame_pool {
+public:
+  /**
+   *  \brief The size (in bytes) of each size class.
+   */
+  static constexpr size_t granularity = 64;
+  /**
+   *  \brief The amount of size classes.
+   */
+  static constexpr size_t classes = 32;
+  /**
+   *  \brief The maximal amount of cached blocks per class and thread.
+   */
+  static constexpr size_t max_cached = 64;
+
+  /**
+   *  \brief Allocates a block of (at least) the given size.
+   *  \param[in] size The requested size.
+   *  \returns A pointer to the block.
+   *  \throws std::bad_alloc If no memory could be allocated.
+   */
+  static void *allocate(size_t size) {
+    size_t cls = class_of(size);
+    if (cls >= classes)
+      return ::operator new(size);
+
+    lists &l = local();
+    if (node *head = l.head[cls]) {
+      l.head[cls] = head->next;
+      l.count[cls]--;
+      return head;
+    }
+    return ::operator new((cls + 1) * granularity);
+  }
+
+  /**
+   *  \brief Returns a block to the pool of the calling thread.
+   *  \param[in] ptr The block, obtained from
+   * fpgen::alloc::frame_pool::allocate.
+   *  \param[in] size The size passed to fpgen::alloc::frame_pool::allocate.
+   */
+  static void deallocate(void *ptr, size_t size) noexcept {
+    size_t cls = class_of(size);
+    if (cls >= classes) {
+      ::operator delete(ptr, size);
+      return;
+    }
+
+    lists &l = local();
+    if (l.closed || l.count[cls] >= max_cached) {
+      ::operator delete(ptr, (cls + 1) * granularity);
+      return;
+    }
+    if (!l.registered) {
+      l.registered = true;
+      register_cleanup();
+    }
+    l.head[cls] = ::new (ptr) node{l.head[cls]};
+    l.count[cls]++;
+  }
+
+  /**
+   *  \brief Frees all blocks cached by the calling thread.
+   */
+  static void trim() noexcept {
+    lists &l = local();
+    for (size_t cls = 0; cls < classes; cls++) {
+      while (node *head = l.head[cls]) {
+        l.head[cls] = head->next;
+        ::operator delete(head, (cls + 1) * granularity);
+      }
+      l.count[cls] = 0;
+    }
+  }
+
+  /**
+   *  \brief Gets the amount of blocks cached by the calling thread.
+   *  \returns The amount of cached blocks, over all size classes.
+   */
+  static size_t cached() noexcept {
+    lists &l = local();
+    size_t total = 0;
+    for (size_t cls = 0; cls < classes; cls++)
+      total += l.count[cls];
+    return total;
+  }
+
+private:
+  struct node {
+    node *next;
+  };
+
+  struct lists {
+    node *head[classes];
+    size_t count[classes];
+    bool registered;
+    bool closed;
+  };
+
+  struct cleanup {
+    ~cleanup() {
+      trim();
+      local().closed = true;
+    }
+  };
+
+  static size_t class_of(size_t size) noexcept {
+    return size == 0 ? 0 : (size - 1) / granularity;
+  }
+
+  static lists &local() noexcept {
+    // trivially destructible, so it outlives any thread_local holding frames
+    thread_local lists l{};
+    return l;
+  }
+
+  static void register_cleanup() noexcept { thread_local cleanup c; }
+};
+
+/**
+ *  \brief Interface for memory resources frames can be allocated from.
+ *
+ *  Install a resource for the current thread using
+ * fpgen::alloc::scoped_resource. Resources should outlive all frames allocated
+ * from them.
+ */
+class frame_resource {
+public:
+  /**
+   *  \brief Cleans up the resource.
+   */
+  virtual ~frame_resource() = default;
+  /**
+   *  \brief Allocates a block suitably aligned for any coroutine frame.
+   *  \param[in] size The size of the block.
+   *  \returns A pointer to the block.
+   */
+  virtual void *allocate(size_t size) = 0;
+  /**
+   *  \brief Returns a block to the resource.
+   *  \param[in] ptr The block.
+   *  \param[in] size The size passed to `allocate`.
+   */
+  virtual void deallocate(void *ptr, size_t size) noexcept = 0;
+};
+
+/**
+ *  \brief A frame resource using the global `operator new` and `operator
+ * delete`, bypassing the frame pool.
+ */
+class heap_resource : public frame_resource {
+public:
+  /**
+   *  \brief Allocates a block using the global `operator new`.
+   *  \param[in] size The size of the block.
+   *  \returns A pointer to the block.
+   */
+  void *allocate(size_t size) override { return ::operator new(size); }
+  /**
+   *  \brief Frees a block using the global `operator delete`.
+   *  \param[in] ptr The block.
+   *  \param[in] size The size of the block.
+   */
+  void deallocate(void *ptr, size_t size) noexcept override {
+    ::operator delete(ptr, size);
+  }
+};
+
+/**
+ *  \brief A monotonic frame resource.
+ *
+ *  Memory is handed out from large blocks by bumping a pointer; freeing is a
+ * no-op, and all memory is returned when the arena is destroyed (or
+ * fpgen::alloc::arena::release is called). This makes it a cheap resource for
+ * pipelines which are built, run and destroyed within a single scope;
+ * fpgen::alloc::arena::reset makes the memory available to the next pipeline
+ * without returning it to the heap.
+ */
+class arena : public frame_resource {
+public:
+  /**
+   *  \brief Constructs a new, empty arena.
+   *  \param[in] block_size The size of the first block to allocate. Subsequent
+   * blocks double in size.
+   */
+  explicit arena(size_t block_size = 4096)
+      : _block_size{block_size}, _next_size{block_size} {}
+
+  arena(const arena &) = delete;
+  arena &operator=(const arena &) = delete;
+
+  /**
+   *  \brief Frees all memory held by this arena.
+   */
+  ~arena() override { release(); }
+
+  /**
+   *  \brief Allocates a block from the arena.
+   *  \param[in] size The size of the block.
+   *  \returns A pointer to the block.
+   */
+  void *allocate(size_t size) override {
+    size = detail::align_up(size, alignof(std::max_align_t));
+    if (static_cast<size_t>(_end - _cur) < size)
+      grow(size);
+    void *res = _cur;
+    _cur += size;
+    return res;
+  }
+
+  /**
+   *  \brief Does nothing; memory is only returned when releasing the arena.
+   */
+  void deallocate(void *, size_t) noexcept override {}
+
+  /**
+   *  \brief Frees all memory held by this arena.
+   *
+   *  All frames allocated from this arena should be destroyed beforehand.
+   */
+  void release() noexcept {
+    while (_blocks != nullptr) {
+      block *prev = _blocks->prev;
+      ::operator delete(_blocks, _blocks->size);
+      _blocks = prev;
+    }
+    _cur = _end = nullptr;
+    _next_size = _block_size;
+  }
+
+  /**
+   *  \brief Makes all memory held by this arena available again.
+   *
+   *  Only the largest block is kept; the others are freed. All frames
+   * allocated from this arena should be destroyed beforehand.
+   */
+  void reset() noexcept {
+    if (_blocks == nullptr)
+      return;
+    block *last = _blocks;
+    _blocks = last->prev;
+    release();
+    _blocks = ::new (last) block{nullptr, last->size};
+    _cur = reinterpret_cast<unsigned char *>(_blocks + 1);
+    _end = reinterpret_cast<unsigned char *>(_blocks) + _blocks->size;
+    _next_size = 2 * _blocks->size;
+  }
+
+private:
+  struct alignas(std::max_align_t) block {
+    block *prev;
+    size_t size;
+  };
+
+  void grow(size_t size) {
+    size_t needed = sizeof(block) + size;
+    while (_next_size < needed)
+      _next_size *= 2;
+    void *mem = ::operator new(_next_size);
+    _blocks = ::new (mem) block{_blocks, _next_size};
+    _cur = reinterpret_cast<unsigned char *>(_blocks + 1);
+    _end = static_cast<unsigned char *>(mem) + _next_size;
+    _next_size *= 2;
+  }
+
+  block *_blocks = nullptr;
+  unsigned char *_cur = nullptr;
+  unsigned char *_end = nullptr;
+  size_t _block_size;
+  size_t _next_size;
+};
+
+/**
+ *  \brief Gets the frame resource installed on the calling thread.
+ *  \returns A reference to the installed resource (`nullptr` if none).
+ */
+inline frame_resource *&current_resource() noexcept {
+  thread_local frame_resource *current = nullptr;
+  return current;
+}
+
+/**
+ *  \brief Installs a frame resource for the calling thread in the current
+ * scope.
+ *
+ *  While the object lives, all generator frames created on this thread (which
+ * don't receive an allocator explicitly) are allocated from the given resource.
+ * The previously installed resource is restored afterwards. Frames allocated
+ * from the resource are returned to it, even when destroyed later.
+ */
+class scoped_resource {
+public:
+  /**
+   *  \brief Installs the resource.
+   *  \param[in] res The resource to allocate frames from.
+   */
+  explicit scoped_resource(frame_resource &res)
+      : _prev{std::exchange(current_resource(), &res)} {}
+
+  scoped_resource(const scoped_resource &) = delete;
+  scoped_resource &operator=(const scoped_resource &) = delete;
+
+  /**
+   *  \brief Restores the previously installed resource.
+   */
+  ~scoped_resource() { current_resource() = _prev; }
+
+private:
+  frame_resource *_prev;
+};
+
+/**
+ *  \brief Allocates a frame using the given allocator.
+ *
+ *  The allocator is copied behind the frame, so fpgen::alloc::deallocate_frame
+ * can use it to free the frame again.
+ *
+ *  \tparam Alloc The allocator type (any element type).
+ *  \param[in] size The frame size requested by the compiler.
+ *  \param[in] alloc The allocator.
+ *  \returns A pointer to the frame.
+ */
+template <typename Alloc>
+void *allocate_frame(size_t size, const Alloc &alloc) {
+  using block_alloc = typename std::allocator_traits<
+      Alloc>::template rebind_alloc<detail::frame_block>;
+  static_assert(alignof(block_alloc) <= alignof(std::max_align_t),
+                "over-aligned allocators are not supported");
+
+  block_alloc rebound(alloc);
+  size_t blocks =
+      detail::align_up(detail::total_size<block_alloc>(size),
+                       sizeof(detail::frame_block)) /
+      sizeof(detail::frame_block);
+  void *frame = std::allocator_traits<block_alloc>::allocate(rebound, blocks);
+  *detail::at<release_fn>(frame, detail::release_offset(size)) =
+      &detail::release_with<block_alloc>;
+  ::new (detail::at<block_alloc>(
+      frame, detail::allocator_offset<block_alloc>(size)))
+      block_alloc(std::move(rebound));
+  return frame;
+}
+
+/**
+ *  \brief Allocates a frame from the installed resource or the frame pool.
+ *  \param[in] size The frame size requested by the compiler.
+ *  \returns A pointer to the frame.
+ */
+inline void *allocate_frame(size_t size) {
+  size_t total = detail::release_offset(size) + sizeof(release_fn);
+  if (frame_resource *res = current_resource()) {
+    total += sizeof(frame_resource *);
+    void *frame = res->allocate(total);
+    *detail::at<release_fn>(frame, detail::release_offset(size)) =
+        [](void *frame, size_t size) {
+          size_t total = detail::release_offset(size) + sizeof(release_fn);
+          frame_resource *res = *detail::at<frame_resource *>(frame, total);
+          res->deallocate(frame, total + sizeof(frame_resource *));
+        };
+    *detail::at<frame_resource *>(frame, total - sizeof(frame_resource *)) =
+        res;
+    return frame;
+  }
+
+  void *frame = frame_pool::allocate(total);
+  *detail::at<release_fn>(frame, detail::release_offset(size)) =
+      [](void *frame, size_t size) {
+        frame_pool::deallocate(frame, detail::release_offset(size) +
+                                          sizeof(release_fn));
+      };
+  return frame;
+}
+
+/**
+ *  \brief Frees a frame allocated by any of the fpgen::alloc::allocate_frame
+ * overloads.
+ *  \param[in] frame The frame.
+ *  \param[in] size The frame size requested by the compiler.
+ */
+inline void deallocate_frame(void *frame, size_t size) noexcept {
+  (*detail::at<release_fn>(frame, detail::release_offset(size)))(frame, size);
+}
+} // namespace fpgen::alloc
+
+#endif
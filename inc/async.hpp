@@ -0,0 +1,1037 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        async.hpp
+// Purpose:     asynchronous generators, tasks and an executor for fpgen.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_ASYNC
+#define _FPGEN_ASYNC
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include "allocator.hpp"
+#include "generator.hpp"
+#include "thread_pool.hpp"
+#include "type_traits.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <system_error>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include "io.hpp"
+#endif
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+namespace detail {
+/**
+ *  \brief The part of a task's promise not depending on the result type.
+ */
+struct task_promise_base {
+  /**
+   *  \brief The coroutine awaiting the task (or none).
+   */
+  coroutine_handle<> continuation;
+  /**
+   *  \brief The exception thrown from the task (if any).
+   */
+  std::exception_ptr ex;
+
+  /**
+   *  \brief Final awaiter, transferring control to the awaiting coroutine.
+   */
+  struct final_awaiter {
+    /**
+     *  \brief Always suspends.
+     *  \returns False.
+     */
+    bool await_ready() const noexcept { return false; }
+    /**
+     *  \brief Transfers control to the awaiting coroutine (if any).
+     *  \tparam P The promise type.
+     *  \param[in] h The finishing task.
+     *  \returns The coroutine to resume next.
+     */
+    template <typename P>
+    coroutine_handle<> await_suspend(coroutine_handle<P> h) noexcept {
+      coroutine_handle<> next = h.promise().continuation;
+      if (next)
+        return next;
+      return noop_coroutine();
+    }
+    /**
+     *  \brief Does nothing (never called).
+     */
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   *  \brief Tasks are lazy: they only start once awaited.
+   *  \returns A `suspend_always` object.
+   */
+  suspend_always initial_suspend() noexcept { return {}; }
+  /**
+   *  \brief Resumes the awaiting coroutine once the task finished.
+   *  \returns The final awaiter.
+   */
+  final_awaiter final_suspend() noexcept { return {}; }
+  /**
+   *  \brief Stores the exception thrown from the task.
+   */
+  void unhandled_exception() { ex = std::current_exception(); }
+
+  /**
+   *  \brief Allocates the coroutine frame (see fpgen::alloc::allocate_frame).
+   *  \param[in] size The size of the frame.
+   *  \returns A pointer to the frame.
+   */
+  static void *operator new(size_t size) {
+    return alloc::allocate_frame(size);
+  }
+  /**
+   *  \brief Frees the coroutine frame.
+   *  \param[in] ptr The frame.
+   *  \param[in] size The size of the frame.
+   */
+  static void operator delete(void *ptr, size_t size) noexcept {
+    alloc::deallocate_frame(ptr, size);
+  }
+};
+
+/**
+ *  \brief The result-dependent part of a task's promise.
+ *  \tparam T The result type.
+ */
+template <typename T> struct task_promise : task_promise_base {
+  /**
+   *  \brief The result (once the task finished).
+   */
+  std::optional<T> value;
+
+  /**
+   *  \brief Stores the result.
+   *  \tparam U The type of the returned value.
+   *  \param[in] v The returned value.
+   */
+  template <typename U = T> void return_value(U &&v) {
+    value.emplace(std::forward<U>(v));
+  }
+  /**
+   *  \brief Gets the result, or rethrows the exception from the task.
+   *  \returns The result.
+   */
+  T result() {
+    if (ex)
+      std::rethrow_exception(ex);
+    return std::move(*value);
+  }
+};
+
+/**
+ *  \brief The promise part of a task without result.
+ */
+template <> struct task_promise<void> : task_promise_base {
+  /**
+   *  \brief Does nothing.
+   */
+  void return_void() noexcept {}
+  /**
+   *  \brief Rethrows the exception from the task (if any).
+   */
+  void result() {
+    if (ex)
+      std::rethrow_exception(ex);
+  }
+};
+} // namespace detail
+
+/**
+ *  \brief A lazy, awaitable coroutine producing a single value.
+ *
+ *  The task starts running when it's first awaited (`co_await t`), and resumes
+ * the awaiting coroutine once it's finished (on whichever thread it finished
+ * on). Exceptions thrown from the task are rethrown from `co_await`. Outside
+ * of coroutines, use fpgen::sync_wait to run a task to completion.
+ *
+ *  \tparam T The result type (or `void`).
+ */
+template <typename T = void> class [[nodiscard]] task {
+public:
+  /**
+   *  \brief The promise type, required by the C++20 spec.
+   */
+  struct promise_type : detail::task_promise<T> {
+    /**
+     *  \brief Creates the task object for the coroutine.
+     *  \returns The new task.
+     */
+    task get_return_object() {
+      return task{detail::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+  };
+
+  /**
+   *  \brief Type alias for the coroutine handle of the task.
+   */
+  using handle_type = detail::coroutine_handle<promise_type>;
+
+  /**
+   *  \brief Awaiter starting the task and getting its result.
+   */
+  struct awaiter {
+    /**
+     *  \brief The task.
+     */
+    handle_type h;
+
+    /**
+     *  \brief Skips suspending if the task already finished.
+     *  \returns True if the task finished.
+     */
+    bool await_ready() const noexcept { return h.done(); }
+    /**
+     *  \brief Starts (or continues) the task.
+     *  \param[in] cont The awaiting coroutine.
+     *  \returns The task, to resume next.
+     */
+    detail::coroutine_handle<>
+    await_suspend(detail::coroutine_handle<> cont) noexcept {
+      h.promise().continuation = cont;
+      return h;
+    }
+    /**
+     *  \brief Gets the result of the task.
+     *  \returns The result; rethrows the exception from the task if any.
+     */
+    T await_resume() { return h.promise().result(); }
+  };
+
+  /**
+   *  \brief Awaiter starting the task without getting its result.
+   */
+  struct ready_awaiter : awaiter {
+    /**
+     *  \brief Does nothing; the result (or exception) stays in the task.
+     */
+    void await_resume() const noexcept {}
+  };
+
+  task(const task &other) = delete;
+  task &operator=(const task &other) = delete;
+
+  /**
+   *  \brief Takes ownership of another task.
+   *  \param[in,out] other The task to take over.
+   */
+  task(task &&other) noexcept : _h{std::exchange(other._h, nullptr)} {}
+
+  /**
+   *  \brief Takes ownership of another task, destroying the current one.
+   *  \param[in,out] other The task to take over.
+   *  \returns A reference to this task.
+   */
+  task &operator=(task &&other) noexcept {
+    if (this != &other) {
+      if (_h)
+        _h.destroy();
+      _h = std::exchange(other._h, nullptr);
+    }
+    return *this;
+  }
+
+  /**
+   *  \brief Destroys the task.
+   */
+  ~task() {
+    if (_h)
+      _h.destroy();
+  }
+
+  /**
+   *  \brief Starts the task and waits for its result.
+   *  \returns The awaiter.
+   */
+  awaiter operator co_await() const noexcept { return awaiter{_h}; }
+
+  /**
+   *  \brief Starts the task and waits until it's finished, without getting its
+   * result (or rethrowing its exception).
+   *  \returns The awaiter.
+   */
+  ready_awaiter when_ready() const noexcept { return ready_awaiter{{_h}}; }
+
+private:
+  explicit task(handle_type h) : _h{h} {}
+
+  handle_type _h;
+};
+
+/**
+ *  \brief A generator which can `co_await` in between values.
+ *
+ *  Unlike fpgen::generator, an asynchronous generator may suspend on other
+ * awaitables (fpgen::task, fpgen::executor::schedule,
+ * fpgen::executor::readable, ...) while producing its next value. It's
+ * consumed from a coroutine, using `co_await gen.next()`, which gives a
+ * pointer to the next value (or `nullptr` once the generator is done); see
+ * also the async overloads of fpgen::map, fpgen::filter, fpgen::take and
+ * fpgen::foreach. Control passes between the consumer and the generator
+ * directly (symmetric transfer), without going through a scheduler.
+ *
+ *  \tparam T The type of the values.
+ */
+template <typename T> class async_generator {
+public:
+  /**
+   *  \brief The type of the values.
+   */
+  using value_type = T;
+  /**
+   *  \brief The pointer type returned from `next()`.
+   */
+  using pointer = std::remove_reference_t<T> *;
+
+  /**
+   *  \brief The promise type, required by the C++20 spec.
+   */
+  class promise_type {
+  public:
+    /**
+     *  \brief The current value.
+     */
+    pointer value = nullptr;
+    /**
+     *  \brief The exception thrown from the generator (if any).
+     */
+    std::exception_ptr ex;
+    /**
+     *  \brief The coroutine waiting for the next value.
+     */
+    detail::coroutine_handle<> consumer;
+
+    /**
+     *  \brief Awaiter handing the current value to the consumer.
+     */
+    struct yield_awaiter {
+      /**
+       *  \brief Always suspends.
+       *  \returns False.
+       */
+      bool await_ready() const noexcept { return false; }
+      /**
+       *  \brief Transfers control to the consumer.
+       *  \param[in] h The generator.
+       *  \returns The consumer, to resume next.
+       */
+      detail::coroutine_handle<>
+      await_suspend(detail::coroutine_handle<promise_type> h) noexcept {
+        return h.promise().consumer;
+      }
+      /**
+       *  \brief Does nothing.
+       */
+      void await_resume() const noexcept {}
+    };
+
+    /**
+     *  \brief Awaiter holding a copy of a yielded lvalue while the consumer
+     * uses it.
+     */
+    struct copy_awaiter {
+      /**
+       *  \brief The copy.
+       */
+      std::remove_cvref_t<T> copy;
+
+      /**
+       *  \brief Always suspends.
+       *  \returns False.
+       */
+      bool await_ready() const noexcept { return false; }
+      /**
+       *  \brief Hands the copy to the consumer, and transfers control to it.
+       *  \param[in] h The generator.
+       *  \returns The consumer, to resume next.
+       */
+      detail::coroutine_handle<>
+      await_suspend(detail::coroutine_handle<promise_type> h) noexcept {
+        h.promise().value = std::addressof(copy);
+        return h.promise().consumer;
+      }
+      /**
+       *  \brief Does nothing.
+       */
+      void await_resume() const noexcept {}
+    };
+
+    /**
+     *  \brief Creates the generator object for the coroutine.
+     *  \returns The new generator.
+     */
+    async_generator get_return_object() {
+      return async_generator{
+          detail::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    /**
+     *  \brief The generator only starts once the first value is requested.
+     *  \returns A `suspend_always` object.
+     */
+    detail::suspend_always initial_suspend() noexcept { return {}; }
+    /**
+     *  \brief Transfers control to the consumer once the generator is done.
+     *  \returns The awaiter.
+     */
+    yield_awaiter final_suspend() noexcept { return {}; }
+
+    /**
+     *  \brief Yields an rvalue; it lives until the generator is resumed.
+     *  \param[in] v The value.
+     *  \returns The awaiter.
+     */
+    yield_awaiter yield_value(std::remove_reference_t<T> &&v) noexcept {
+      value = std::addressof(v);
+      return {};
+    }
+    /**
+     *  \brief Yields an lvalue; copied for value generators, referenced for
+     * reference generators.
+     *  \param[in] v The value.
+     *  \returns The awaiter.
+     */
+    auto yield_value(std::conditional_t<std::is_reference_v<T>,
+                                        std::remove_reference_t<T> &,
+                                        const std::remove_reference_t<T> &>
+                         v) {
+      if constexpr (std::is_reference_v<T>) {
+        value = std::addressof(v);
+        return yield_awaiter{};
+      } else {
+        return copy_awaiter{v};
+      }
+    }
+
+    /**
+     *  \brief Does nothing.
+     */
+    void return_void() noexcept {}
+    /**
+     *  \brief Stores the exception thrown from the generator.
+     */
+    void unhandled_exception() { ex = std::current_exception(); }
+
+    /**
+     *  \brief Allocates the coroutine frame (see
+     * fpgen::alloc::allocate_frame).
+     *  \param[in] size The size of the frame.
+     *  \returns A pointer to the frame.
+     */
+    static void *operator new(size_t size) {
+      return alloc::allocate_frame(size);
+    }
+    /**
+     *  \brief Frees the coroutine frame.
+     *  \param[in] ptr The frame.
+     *  \param[in] size The size of the frame.
+     */
+    static void operator delete(void *ptr, size_t size) noexcept {
+      alloc::deallocate_frame(ptr, size);
+    }
+  };
+
+  /**
+   *  \brief Type alias for the coroutine handle of the generator.
+   */
+  using handle_type = detail::coroutine_handle<promise_type>;
+
+  /**
+   *  \brief Awaiter resuming the generator for its next value.
+   */
+  struct next_awaiter {
+    /**
+     *  \brief The generator.
+     */
+    handle_type h;
+
+    /**
+     *  \brief Skips suspending if the generator is done.
+     *  \returns True if the generator is done.
+     */
+    bool await_ready() const noexcept { return h.done(); }
+    /**
+     *  \brief Resumes the generator.
+     *  \param[in] cont The consumer.
+     *  \returns The generator, to resume next.
+     */
+    detail::coroutine_handle<>
+    await_suspend(detail::coroutine_handle<> cont) noexcept {
+      h.promise().consumer = cont;
+      h.promise().value = nullptr;
+      return h;
+    }
+    /**
+     *  \brief Gets the next value.
+     *
+     *  If the generator threw, the exception is rethrown (once).
+     *
+     *  \returns A pointer to the value, valid until the generator is resumed
+     * again, or `nullptr` if the generator is done.
+     */
+    pointer await_resume() {
+      if (h.promise().ex)
+        std::rethrow_exception(std::exchange(h.promise().ex, nullptr));
+      return h.done() ? nullptr : h.promise().value;
+    }
+  };
+
+  async_generator(const async_generator &other) = delete;
+  async_generator &operator=(const async_generator &other) = delete;
+
+  /**
+   *  \brief Takes ownership of another generator.
+   *  \param[in,out] other The generator to take over.
+   */
+  async_generator(async_generator &&other) noexcept
+      : _h{std::exchange(other._h, nullptr)} {}
+
+  /**
+   *  \brief Takes ownership of another generator, destroying the current one.
+   *  \param[in,out] other The generator to take over.
+   *  \returns A reference to this generator.
+   */
+  async_generator &operator=(async_generator &&other) noexcept {
+    if (this != &other) {
+      if (_h)
+        _h.destroy();
+      _h = std::exchange(other._h, nullptr);
+    }
+    return *this;
+  }
+
+  /**
+   *  \brief Destroys the generator.
+   */
+  ~async_generator() {
+    if (_h)
+      _h.destroy();
+  }
+
+  /**
+   *  \brief Requests the next value.
+   *
+   *  The generator shouldn't be resumed again (by another consumer) before
+   * this awaiter completes.
+   *
+   *  \returns An awaiter giving a pointer to the next value, or `nullptr`
+   * once the generator is done.
+   */
+  next_awaiter next() { return next_awaiter{_h}; }
+
+private:
+  explicit async_generator(handle_type h) : _h{h} {}
+
+  handle_type _h;
+};
+
+namespace detail {
+/**
+ *  \brief A fire-and-forget coroutine, destroying itself when finished.
+ *
+ *  Exceptions escaping the coroutine terminate the program.
+ */
+struct detached {
+  /**
+   *  \brief The promise type, required by the C++20 spec.
+   */
+  struct promise_type {
+    /**
+     *  \brief Creates the (empty) return object.
+     *  \returns The return object.
+     */
+    detached get_return_object() noexcept { return {}; }
+    /**
+     *  \brief Starts right away.
+     *  \returns A `suspend_never` object.
+     */
+    suspend_never initial_suspend() noexcept { return {}; }
+    /**
+     *  \brief Destroys the coroutine once it's finished.
+     *  \returns A `suspend_never` object.
+     */
+    suspend_never final_suspend() noexcept { return {}; }
+    /**
+     *  \brief Does nothing.
+     */
+    void return_void() noexcept {}
+    /**
+     *  \brief Terminates the program.
+     */
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+
+/**
+ *  \brief The state fpgen::sync_wait waits on.
+ */
+struct sync_state {
+  /**
+   *  \brief Protects `done`.
+   */
+  std::mutex lock;
+  /**
+   *  \brief Notified once `done` is set.
+   */
+  std::condition_variable changed;
+  /**
+   *  \brief Whether the awaited task finished.
+   */
+  bool done = false;
+};
+
+/**
+ *  \brief Awaits an awaitable, then marks the state as done.
+ *  \tparam Awaitable The awaitable type.
+ *  \param[in] awaitable The awaitable.
+ *  \param[in,out] state The state to mark.
+ *  \returns A detached coroutine.
+ */
+template <typename Awaitable>
+detached sync_run(Awaitable awaitable, sync_state &state) {
+  co_await awaitable;
+  // notify while locked: the state is gone as soon as the waiter wakes up
+  std::lock_guard<std::mutex> guard(state.lock);
+  state.done = true;
+  state.changed.notify_all();
+}
+
+/**
+ *  \brief Awaits an awaitable, then awaits a task.
+ *  \tparam Awaitable The awaitable type.
+ *  \tparam T The result type of the task.
+ *  \param[in] first The awaitable.
+ *  \param[in] t The task.
+ *  \returns A detached coroutine.
+ */
+template <typename Awaitable, typename T>
+detached spawn_run(Awaitable first, task<T> t) {
+  co_await first;
+  co_await t;
+}
+} // namespace detail
+
+/**
+ *  \brief Runs a task to completion, blocking the calling thread.
+ *
+ *  The task starts on the calling thread; if it moves to another thread (see
+ * fpgen::executor::schedule), the calling thread sleeps until it's finished.
+ * Don't call this from a thread of the pool the task needs to finish.
+ *
+ *  \tparam T The result type.
+ *  \param[in] t The task.
+ *  \returns The result of the task; rethrows the exception from the task if
+ * any.
+ */
+template <typename T> T sync_wait(task<T> t) {
+  detail::sync_state state;
+  detail::sync_run(t.when_ready(), state);
+  {
+    std::unique_lock<std::mutex> guard(state.lock);
+    state.changed.wait(guard, [&state]() { return state.done; });
+  }
+  auto result = t.operator co_await();
+  return result.await_resume();
+}
+
+/**
+ *  \brief Multiplexes coroutines over a thread pool.
+ *
+ *  Coroutines move onto the executor's threads using `co_await
+ * ex.schedule()`. On Linux, coroutines can also wait for a file descriptor to
+ * become readable or writable (`co_await ex.readable(fd)`); a single reactor
+ * thread waits for all of them at once (using `epoll`), and resumes each
+ * coroutine on the pool once its descriptor is ready. This way, many sockets
+ * or pipes can be served by a few threads. Blocking calls (like reading a
+ * regular file) can simply be made after `co_await ex.schedule()`.
+ *
+ *  The executor should outlive all coroutines using it; coroutines still
+ * waiting for a descriptor when it's destroyed are never resumed.
+ */
+class executor {
+public:
+  /**
+   *  \brief Awaiter moving the awaiting coroutine onto the pool.
+   */
+  struct schedule_awaiter {
+    /**
+     *  \brief The pool.
+     */
+    thread_pool &pool;
+
+    /**
+     *  \brief Always suspends.
+     *  \returns False.
+     */
+    bool await_ready() const noexcept { return false; }
+    /**
+     *  \brief Submits a job resuming the coroutine.
+     *  \param[in] h The awaiting coroutine.
+     */
+    void await_suspend(detail::coroutine_handle<> h) {
+      pool.submit([h]() { h.resume(); });
+    }
+    /**
+     *  \brief Does nothing.
+     */
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   *  \brief Starts a new executor.
+   *  \param[in] threads The amount of threads in the pool; `0` means one per
+   * hardware thread.
+   *  \throws std::system_error If the reactor can't be created.
+   */
+  explicit executor(size_t threads = 0) : _pool{threads} {
+#ifdef __linux__
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (epoll_ctl(_epoll.get(), EPOLL_CTL_ADD, _stop.get(), &ev) != 0)
+      throw std::system_error(errno, std::generic_category(),
+                              "fpgen::executor: can't create the reactor");
+    _reactor = std::thread([this]() { react(); });
+#endif
+  }
+
+  executor(const executor &) = delete;
+  executor &operator=(const executor &) = delete;
+
+  /**
+   *  \brief Stops the reactor, finishes all scheduled work and stops the pool.
+   */
+  ~executor() {
+#ifdef __linux__
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t written = write(_stop.get(), &one, sizeof(one));
+    _reactor.join();
+#endif
+  }
+
+  /**
+   *  \brief Gets the pool coroutines are resumed on.
+   *  \returns The pool.
+   */
+  thread_pool &pool() { return _pool; }
+
+  /**
+   *  \brief Moves the awaiting coroutine onto the pool.
+   *  \returns The awaiter.
+   */
+  schedule_awaiter schedule() { return schedule_awaiter{_pool}; }
+
+  /**
+   *  \brief Starts a task on the pool, without waiting for it.
+   *
+   *  The task is destroyed once it's finished. Exceptions escaping the task
+   * terminate the program.
+   *
+   *  \tparam T The result type of the task; the result is discarded.
+   *  \param[in] t The task.
+   */
+  template <typename T> void spawn(task<T> t) {
+    detail::spawn_run(schedule(), std::move(t));
+  }
+
+#ifdef __linux__
+  /**
+   *  \brief Awaiter waiting for a file descriptor to become ready.
+   */
+  struct io_awaiter {
+    /**
+     *  \brief The executor.
+     */
+    executor &ex;
+    /**
+     *  \brief The file descriptor.
+     */
+    int fd;
+    /**
+     *  \brief The `epoll` events to wait for.
+     */
+    uint32_t events;
+    /**
+     *  \brief The address of the waiting coroutine (atomic, as the memory
+     * model doesn't know `epoll` orders the reactor after the waiter).
+     */
+    std::atomic<void *> handle = nullptr;
+    /**
+     *  \brief The error which stopped the reactor, or `0`.
+     */
+    int error = 0;
+
+    /**
+     *  \brief Always suspends.
+     *  \returns False.
+     */
+    bool await_ready() const noexcept { return false; }
+    /**
+     *  \brief Registers the descriptor with the reactor.
+     *
+     *  Descriptors which `epoll` doesn't support (like regular files) are
+     * always ready, so the coroutine isn't suspended.
+     *
+     *  \param[in] h The waiting coroutine.
+     *  \returns False if the coroutine shouldn't be suspended.
+     */
+    bool await_suspend(detail::coroutine_handle<> h) {
+      handle.store(h.address(), std::memory_order_release);
+      return ex.watch(fd, events, this);
+    }
+    /**
+     *  \brief Checks whether the reactor failed while waiting.
+     *  \throws std::system_error If the reactor failed.
+     */
+    void await_resume() const {
+      if (error != 0)
+        throw std::system_error(error, std::generic_category(),
+                                "fpgen::executor: the reactor failed");
+    }
+  };
+
+  /**
+   *  \brief Waits until a file descriptor is readable.
+   *
+   *  The coroutine is resumed on the pool. Only one coroutine should wait for
+   * a descriptor at a time. Awaiting throws `std::system_error` if the
+   * descriptor can't be watched, or if the reactor fails.
+   *
+   *  \param[in] fd The file descriptor.
+   *  \returns The awaiter.
+   */
+  io_awaiter readable(int fd) { return io_awaiter{*this, fd, EPOLLIN}; }
+
+  /**
+   *  \brief Waits until a file descriptor is writable.
+   *
+   *  The coroutine is resumed on the pool. Only one coroutine should wait for
+   * a descriptor at a time. Awaiting throws `std::system_error` if the
+   * descriptor can't be watched, or if the reactor fails.
+   *
+   *  \param[in] fd The file descriptor.
+   *  \returns The awaiter.
+   */
+  io_awaiter writable(int fd) { return io_awaiter{*this, fd, EPOLLOUT}; }
+#endif
+
+private:
+#ifdef __linux__
+  static int reactor_fd(int fd) {
+    if (fd < 0)
+      throw std::system_error(errno, std::generic_category(),
+                              "fpgen::executor: can't create the reactor");
+    return fd;
+  }
+
+  // registers fd once (one-shot); false if epoll doesn't support it
+  bool watch(int fd, uint32_t events, io_awaiter *waiter) {
+    {
+      std::lock_guard<std::mutex> guard(_watch_lock);
+      if (_failure != 0)
+        throw std::system_error(_failure, std::generic_category(),
+                                "fpgen::executor: the reactor failed");
+      _watching.insert(waiter);
+    }
+    epoll_event ev{};
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = waiter;
+    if (epoll_ctl(_epoll.get(), EPOLL_CTL_MOD, fd, &ev) == 0)
+      return true;
+    if (errno == ENOENT && epoll_ctl(_epoll.get(), EPOLL_CTL_ADD, fd, &ev) == 0)
+      return true;
+    int error = errno;
+    // a failing reactor may have resumed the waiter already
+    if (!unwatch(waiter))
+      return true;
+    if (error == EPERM)
+      return false;
+    throw std::system_error(error, std::generic_category(),
+                            "fpgen::executor: can't watch descriptor");
+  }
+
+  bool unwatch(io_awaiter *waiter) {
+    std::lock_guard<std::mutex> guard(_watch_lock);
+    return _watching.erase(waiter) != 0;
+  }
+
+  void resume(io_awaiter *waiter) {
+    auto h = detail::coroutine_handle<>::from_address(
+        waiter->handle.load(std::memory_order_acquire));
+    _pool.submit([h]() { h.resume(); });
+  }
+
+  // resumes all waiters with the error, and rejects new ones
+  void fail(int error) {
+    std::lock_guard<std::mutex> guard(_watch_lock);
+    _failure = error;
+    for (io_awaiter *waiter : _watching) {
+      waiter->error = error;
+      resume(waiter);
+    }
+    _watching.clear();
+  }
+
+  void react() {
+    epoll_event events[64];
+    bool stopping = false;
+    while (!stopping) {
+      int count = epoll_wait(_epoll.get(), events, 64, -1);
+      if (count < 0 && errno != EINTR) {
+        fail(errno);
+        return;
+      }
+      for (int i = 0; i < count; i++) {
+        if (events[i].data.ptr == nullptr) {
+          stopping = true;
+          continue;
+        }
+        auto waiter = static_cast<io_awaiter *>(events[i].data.ptr);
+        if (unwatch(waiter))
+          resume(waiter);
+      }
+    }
+  }
+
+  // closed automatically if constructing the rest of the executor throws
+  detail::unique_fd _epoll{reactor_fd(epoll_create1(EPOLL_CLOEXEC))};
+  detail::unique_fd _stop{reactor_fd(eventfd(0, EFD_CLOEXEC))};
+  std::mutex _watch_lock;
+  std::unordered_set<io_awaiter *> _watching;
+  int _failure = 0;
+  std::thread _reactor;
+#endif
+  // declared last: the reactor is stopped before the pool finishes
+  thread_pool _pool;
+};
+
+/**
+ *  \brief Turns a generator into an asynchronous generator.
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator. Will be in unusable state afterwards.
+ *  \returns An asynchronous generator yielding the same values.
+ */
+template <typename T, typename P>
+async_generator<T> to_async(generator<T, P> gen) {
+  while (gen) {
+    co_yield gen();
+  }
+  co_return;
+}
+
+/**
+ *  \brief Maps a function over an asynchronous generator.
+ *
+ *  See `fpgen::map(gen, func)`.
+ *
+ *  \tparam TIn The type contained in the provided generator.
+ *  \tparam Fun The function signature of the mapping function.
+ *  \tparam TOut The output type. This type is deduced from the `Fun` type
+ * parameter.
+ *  \param[in,out] gen The generator to map over. Will be in unusable state
+ * afterwards.
+ *  \param[in] func The function to map with.
+ *  \returns A new asynchronous generator over the mapped values.
+ */
+template <typename TIn, typename Fun,
+          typename TOut = type::output_type<Fun, TIn>>
+  requires type::function_to<Fun, TOut, TIn>
+async_generator<TOut> map(async_generator<TIn> gen, Fun func) {
+  while (auto value = co_await gen.next()) {
+    co_yield func(std::forward<TIn>(*value));
+  }
+  co_return;
+}
+
+/**
+ *  \brief Filters an asynchronous generator.
+ *
+ *  See `fpgen::filter(gen, p)`.
+ *
+ *  \tparam T The type contained in the generator.
+ *  \tparam Pred The type of the predicate (should be a T -> bool function).
+ *  \param[in,out] gen The generator to filter. Will be in unusable state
+ * afterwards.
+ *  \param[in] p The predicate.
+ *  \returns A new asynchronous generator yielding the values satisfying `p`.
+ */
+template <typename T, typename Pred>
+  requires type::predicate_for<Pred, T>
+async_generator<T> filter(async_generator<T> gen, Pred p) {
+  while (auto value = co_await gen.next()) {
+    if (p(*value))
+      co_yield std::forward<T>(*value);
+  }
+  co_return;
+}
+
+/**
+ *  \brief Takes the first few values of an asynchronous generator.
+ *
+ *  See `fpgen::take(gen, count)`. The source generator is destroyed as soon
+ * as the last value has been taken.
+ *
+ *  \tparam T The type contained in the generator.
+ *  \param[in,out] gen The generator to take values from. Will be in unusable
+ * state afterwards.
+ *  \param[in] count The amount of values to yield.
+ *  \returns A new asynchronous generator yielding only the first n values.
+ */
+template <typename T>
+async_generator<T> take(async_generator<T> gen, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    auto value = co_await gen.next();
+    if (!value)
+      break;
+    co_yield std::forward<T>(*value);
+  }
+  { async_generator<T> done(std::move(gen)); }
+  co_return;
+}
+
+/**
+ *  \brief Calls a function for each value in an asynchronous generator.
+ *
+ *  See `fpgen::foreach(gen, func)`. Run the resulting task with `co_await` or
+ * fpgen::sync_wait.
+ *
+ *  \tparam T The type contained in the generator.
+ *  \tparam Fun The function type.
+ *  \param[in,out] gen The generator to iterate over. Will be in unusable state
+ * afterwards.
+ *  \param[in] func The function to call.
+ *  \returns A task finishing once the generator is done.
+ */
+template <typename T, typename Fun>
+task<void> foreach(async_generator<T> gen, Fun func) {
+  while (auto value = co_await gen.next()) {
+    func(std::forward<T>(*value));
+  }
+  co_return;
+}
+} // namespace fpgen
+
+#endif
@@ -0,0 +1,382 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        batch.hpp
+// Purpose:     batched (span-yielding) generators for fpgen.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_BATCH
+#define _FPGEN_BATCH
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "generator.hpp"
+#include "simd.hpp"
+#include "type_traits.hpp"
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+/**
+ *  \brief A generator yielding batches (blocks) of values.
+ *
+ *  Each batch is a view on a contiguous block of values, which is only valid
+ * until the generator is resumed; the memory behind it is reused for the next
+ * batch. Batches are never empty. See the fpgen::batch namespace for
+ * batch-aware manipulators and aggregators: they resume the generator once per
+ * batch instead of once per value.
+ *
+ *  \tparam T The type of the values in each batch.
+ */
+template <typename T> using batch_generator = generator<std::span<const T>>;
+
+namespace detail {
+/**
+ *  \brief Groups the values in a generator into batches.
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \tparam TVal The type of the values in the batches.
+ *  \param[in,out] gen The generator to group.
+ *  \param[in] size The size of each batch; at least 1.
+ *  \returns A new generator yielding batches.
+ */
+template <typename TVal, typename T, typename P>
+batch_generator<TVal> chunk_impl(generator<T, P> gen, size_t size) {
+  std::vector<TVal> buffer;
+  buffer.reserve(size);
+  while (gen) {
+    buffer.clear();
+    while (buffer.size() < size && gen) {
+      buffer.push_back(gen());
+    }
+    co_yield std::span<const TVal>(buffer);
+  }
+  co_return;
+}
+
+/**
+ *  \brief Splits a span into batches.
+ *  \tparam T The type of the values in the span.
+ *  \param[in] all The span.
+ *  \param[in] size The size of each batch; at least 1.
+ *  \returns A new generator yielding batches.
+ */
+template <typename T>
+batch_generator<T> span_batches(std::span<const T> all, size_t size) {
+  for (size_t start = 0; start < all.size(); start += size) {
+    co_yield all.subspan(start, std::min(size, all.size() - start));
+  }
+  co_return;
+}
+} // namespace detail
+
+/**
+ *  \brief Groups the values in a generator into batches.
+ *
+ *  Values are moved into a buffer which is reused for each batch. All batches
+ * contain `size` values, except for the last one, which may contain fewer.
+ * Using the provided generator after calling fpgen::chunk is undefined
+ * behaviour.
+ *
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \tparam TVal The type of the values in the batches.
+ *  \param[in,out] gen The generator to group. Will be in unusable state
+ * afterwards.
+ *  \param[in] size The size of each batch; at least 1.
+ *  \returns A new generator yielding batches.
+ *  \throws std::invalid_argument If the size is zero.
+ */
+template <typename T, typename P, typename TVal = std::remove_cvref_t<T>>
+batch_generator<TVal> chunk(generator<T, P> gen, size_t size) {
+  if (size == 0)
+    throw std::invalid_argument("fpgen::chunk with a batch size of zero");
+  return detail::chunk_impl<TVal>(std::move(gen), size);
+}
+
+/**
+ *  \brief The namespace containing fpgen's batch-aware functions.
+ *
+ *  These functions work on fpgen::batch_generator, processing each batch in a
+ * tight loop.
+ */
+namespace batch {
+/**
+ *  \brief Creates a batch generator over a contiguous container.
+ *
+ *  The batches refer to the container's own memory; no values are copied. The
+ * container should outlive the generator, and shouldn't be resized while it's
+ * in use.
+ *
+ *  \tparam Container The container type (`std::vector`, `std::array`, ...).
+ *  \tparam T The type of the values in the container.
+ *  \param[in] cont The container.
+ *  \param[in] size The size of each batch; at least 1.
+ *  \returns A new generator yielding batches.
+ *  \throws std::invalid_argument If the size is zero.
+ */
+template <typename Container,
+          typename T = std::remove_cv_t<
+              std::remove_pointer_t<decltype(std::data(
+                  std::declval<const Container &>()))>>>
+batch_generator<T> from(const Container &cont, size_t size) {
+  if (size == 0)
+    throw std::invalid_argument("fpgen::batch::from with a batch size of zero");
+  return detail::span_batches(
+      std::span<const T>(std::data(cont), std::size(cont)), size);
+}
+
+/**
+ *  \brief Maps a function over each value in a batch generator.
+ *
+ *  The mapped values are stored in a buffer which is reused for each batch.
+ * Using the provided generator after calling this function is undefined
+ * behaviour.
+ *
+ *  \tparam TIn The type of the values in the input batches.
+ *  \tparam Fun The function type.
+ *  \tparam TOut The output type. This type is deduced from the `Fun` type
+ * parameter.
+ *  \param[in,out] gen The generator to map over. Will be in unusable state
+ * afterwards.
+ *  \param[in] func The function to map with.
+ *  \returns A new generator yielding batches of mapped values.
+ */
+template <typename TIn, typename Fun,
+          typename TOut = std::remove_cvref_t<
+              type::output_type<Fun, const TIn &>>>
+batch_generator<TOut> map(batch_generator<TIn> gen, Fun func) {
+  std::vector<TOut> buffer;
+  while (gen) {
+    std::span<const TIn> in = gen();
+    buffer.clear();
+    buffer.reserve(in.size());
+    for (const TIn &value : in) {
+      buffer.push_back(func(value));
+    }
+    co_yield std::span<const TOut>(buffer);
+  }
+  co_return;
+}
+
+/**
+ *  \brief Filters the values in a batch generator.
+ *
+ *  The kept values are copied into a buffer which is reused for each batch.
+ * Batches without any kept values are skipped. Using the provided generator
+ * after calling this function is undefined behaviour.
+ *
+ *  \tparam T The type of the values in the batches.
+ *  \tparam Pred The predicate type.
+ *  \param[in,out] gen The generator to filter. Will be in unusable state
+ * afterwards.
+ *  \param[in] p The predicate.
+ *  \returns A new generator yielding batches of the kept values.
+ */
+template <typename T, typename Pred>
+  requires type::predicate_for<Pred, T>
+batch_generator<T> filter(batch_generator<T> gen, Pred p) {
+  std::vector<T> buffer;
+  while (gen) {
+    std::span<const T> in = gen();
+    buffer.clear();
+    for (const T &value : in) {
+      if (p(value))
+        buffer.push_back(value);
+    }
+    if (!buffer.empty())
+      co_yield std::span<const T>(buffer);
+  }
+  co_return;
+}
+
+/**
+ *  \brief Flattens a batch generator back into a generator of values.
+ *  \tparam T The type of the values in the batches.
+ *  \param[in,out] gen The batch generator. Will be in unusable state
+ * afterwards.
+ *  \returns A new generator yielding each value in each batch.
+ */
+template <typename T> generator<T> elements(batch_generator<T> gen) {
+  while (gen) {
+    for (const T &value : gen()) {
+      co_yield value;
+    }
+  }
+  co_return;
+}
+
+/**
+ *  \brief Aggregates all values in a batch generator to a dataset.
+ *
+ *  Each batch is appended at once, using `insert` at the end of the container.
+ *
+ *  \tparam T The type of the values in the batches.
+ *  \tparam Container The container type to output to.
+ *  \param[in,out] gen The generator to extract from.
+ *  \param[out] out The container to output to.
+ *  \returns A reference to the modified container.
+ */
+template <typename T, typename Container>
+Container &aggregate_to(batch_generator<T> gen, Container &out) {
+  for (std::span<const T> in : gen) {
+    out.insert(std::end(out), in.begin(), in.end());
+  }
+  return out;
+}
+
+/**
+ *  \brief Counts the values in a batch generator.
+ *  \tparam T The type of the values in the batches.
+ *  \param[in,out] gen The generator to iterate over.
+ *  \returns The amount of values in all batches.
+ */
+template <typename T> size_t count(batch_generator<T> gen) {
+  size_t cnt = 0;
+  for (std::span<const T> in : gen) {
+    cnt += in.size();
+  }
+  return cnt;
+}
+
+/**
+ *  \brief Accumulates each value in a batch generator using the provided
+ * function.
+ *
+ *  See `fpgen::fold(gen, folder, initial)`.
+ *
+ *  \tparam TOut The output type (accumulator type).
+ *  \tparam TIn The type of the values in the batches.
+ *  \tparam Fun The function type (should have the signature (TOut, TIn) ->
+ * TOut).
+ *  \param[in,out] gen The generator to fold.
+ *  \param[in] folder The folding function.
+ *  \param[in] initial The initial accumulator value.
+ *  \returns The final accumulator value.
+ */
+template <typename TOut, typename TIn, typename Fun>
+  requires type::function_to<Fun, TOut, TOut, TIn>
+TOut fold(batch_generator<TIn> gen, Fun folder, TOut initial) {
+  for (std::span<const TIn> in : gen) {
+    for (const TIn &value : in) {
+      initial = folder(std::move(initial), value);
+    }
+  }
+  return initial;
+}
+
+/**
+ *  \brief Accumulates each value in a batch generator using the provided
+ * function.
+ *
+ *  See `fpgen::fold(gen, folder)`. The accumulator is initialized using
+ * `TOut value = {};`.
+ *
+ *  \tparam TOut The output type (accumulator type).
+ *  \tparam TIn The type of the values in the batches.
+ *  \tparam Fun The function type (should have the signature (TOut, TIn) ->
+ * TOut).
+ *  \param[in,out] gen The generator to fold.
+ *  \param[in] folder The folding function.
+ *  \returns The final accumulator value.
+ */
+template <typename TOut, typename TIn, typename Fun>
+  requires type::function_to<Fun, TOut, TOut, TIn>
+TOut fold(batch_generator<TIn> gen, Fun folder) {
+  return fold<TOut>(std::move(gen), std::move(folder), TOut{});
+}
+
+/**
+ *  \brief Sums each value in a batch generator.
+ *
+ *  See `fpgen::sum(gen)`. Batches of arithmetic values are summed using
+ * fpgen::simd::sum.
+ *
+ *  \tparam T The type of the values in the batches, should support
+ * `operator+`.
+ *  \param[in,out] gen The generator to sum over.
+ *  \returns The sum of all values.
+ */
+template <typename T> T sum(batch_generator<T> gen) {
+  T accum = {};
+  for (std::span<const T> in : gen) {
+    if constexpr (std::is_arithmetic_v<T>) {
+      accum += simd::sum(in);
+    } else {
+      for (const T &value : in) {
+        accum = std::move(accum) + value;
+      }
+    }
+  }
+  return accum;
+}
+
+/**
+ *  \brief Finds the smallest value in a batch generator.
+ *
+ *  Batches of arithmetic values are searched using fpgen::simd::min.
+ *
+ *  \tparam T The type of the values in the batches, should support
+ * `operator<`.
+ *  \param[in,out] gen The generator to search; shouldn't be empty.
+ *  \returns The smallest value.
+ */
+template <typename T> T min(batch_generator<T> gen) {
+  std::optional<T> best;
+  for (std::span<const T> in : gen) {
+    if constexpr (std::is_arithmetic_v<T>) {
+      T local = simd::min(in);
+      if (!best || local < *best)
+        best = local;
+    } else {
+      for (const T &value : in) {
+        if (!best || value < *best)
+          best = value;
+      }
+    }
+  }
+  if (!best)
+    throw std::invalid_argument("fpgen::batch::min on an empty generator");
+  return *std::move(best);
+}
+
+/**
+ *  \brief Finds the largest value in a batch generator.
+ *
+ *  Batches of arithmetic values are searched using fpgen::simd::max.
+ *
+ *  \tparam T The type of the values in the batches, should support
+ * `operator<`.
+ *  \param[in,out] gen The generator to search; shouldn't be empty.
+ *  \returns The largest value.
+ */
+template <typename T> T max(batch_generator<T> gen) {
+  std::optional<T> best;
+  for (std::span<const T> in : gen) {
+    if constexpr (std::is_arithmetic_v<T>) {
+      T local = simd::max(in);
+      if (!best || *best < local)
+        best = local;
+    } else {
+      for (const T &value : in) {
+        if (!best || *best < value)
+          best = value;
+      }
+    }
+  }
+  if (!best)
+    throw std::invalid_argument("fpgen::batch::max on an empty generator");
+  return *std::move(best);
+}
+} // namespace batch
+} // namespace fpgen
+
+#endif
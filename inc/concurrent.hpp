@@ -0,0 +1,631 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        concurrent.hpp
+// Purpose:     manipulators running work on other threads for fpgen.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_CONCURRENT
+#define _FPGEN_CONCURRENT
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "generator.hpp"
+#include "thread_pool.hpp"
+#include "type_traits.hpp"
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+namespace detail {
+/**
+ *  \brief A lock-free, bounded single-producer/single-consumer queue.
+ *
+ *  One thread may push, and one (other) thread may pop. The indices are kept
+ * on separate cache lines, and each side caches the other side's index, so it
+ * only touches the shared line when the queue seems full (or empty).
+ *
+ *  \tparam T The type of the values.
+ */
+template <typename T> class spsc_ring {
+public:
+  /**
+   *  \brief Creates a new queue.
+   *  \param[in] capacity The minimal capacity; rounded up to a power of two.
+   */
+  explicit spsc_ring(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    _mask = size - 1;
+    _slots = std::make_unique<slot[]>(size);
+  }
+
+  spsc_ring(const spsc_ring &) = delete;
+  spsc_ring &operator=(const spsc_ring &) = delete;
+
+  /**
+   *  \brief Destroys all values still in the queue.
+   */
+  ~spsc_ring() {
+    while (front() != nullptr)
+      pop();
+  }
+
+  /**
+   *  \brief Gets the capacity of the queue.
+   *  \returns The capacity.
+   */
+  size_t capacity() const { return _mask + 1; }
+
+  /**
+   *  \brief Tries to push a value (producer only).
+   *  \param[in] value The value.
+   *  \returns False if the queue is full; the value is left untouched.
+   */
+  template <typename U> bool try_push(U &&value) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _head_cache > _mask) {
+      _head_cache = _head.load(std::memory_order_acquire);
+      if (tail - _head_cache > _mask)
+        return false;
+    }
+    ::new (static_cast<void *>(_slots[tail & _mask].bytes))
+        T(std::forward<U>(value));
+    _tail.store(tail + 1, std::memory_order_seq_cst);
+    return true;
+  }
+
+  /**
+   *  \brief Checks whether the queue is full (producer only).
+   *  \returns True if no value can be pushed.
+   */
+  bool full() {
+    _head_cache = _head.load(std::memory_order_seq_cst);
+    return _tail.load(std::memory_order_relaxed) - _head_cache > _mask;
+  }
+
+  /**
+   *  \brief Gets the oldest value in the queue (consumer only).
+   *  \returns A pointer to the value, or `nullptr` if the queue is empty.
+   */
+  T *front() {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail_cache) {
+      _tail_cache = _tail.load(std::memory_order_seq_cst);
+      if (head == _tail_cache)
+        return nullptr;
+    }
+    return std::launder(
+        reinterpret_cast<T *>(_slots[head & _mask].bytes));
+  }
+
+  /**
+   *  \brief Removes the oldest value (consumer only; after a succesful call
+   * to `front()`).
+   */
+  void pop() {
+    size_t head = _head.load(std::memory_order_relaxed);
+    std::launder(reinterpret_cast<T *>(_slots[head & _mask].bytes))->~T();
+    _head.store(head + 1, std::memory_order_seq_cst);
+  }
+
+private:
+  struct slot {
+    alignas(T) unsigned char bytes[sizeof(T)];
+  };
+
+  size_t _mask;
+  std::unique_ptr<slot[]> _slots;
+  alignas(64) std::atomic<size_t> _head{0};
+  size_t _tail_cache = 0; // consumer's copy of _tail
+  alignas(64) std::atomic<size_t> _tail{0};
+  size_t _head_cache = 0; // producer's copy of _head
+};
+
+/**
+ *  \brief The state shared between the consumer and the producer thread of
+ * fpgen::buffered.
+ *
+ *  Both sides only sleep (on `signal`) when the queue stays full or empty for
+ * a few time slices (see `spin_limit`); waking a thread for every value would
+ * make both threads wait on each other all the time. Before
+ * sleeping, a side announces it, then checks the queue once more; after each
+ * push or pop, a side only wakes the other one if it announced it's sleeping
+ * (and clears that announcement, so it's woken only once).
+ *
+ *  \tparam T The type of the values.
+ */
+template <typename T> struct buffer_channel {
+  /**
+   *  \brief The queue.
+   */
+  spsc_ring<T> ring;
+  /**
+   *  \brief Bumped to wake a sleeping side.
+   */
+  std::atomic<uint32_t> signal{0};
+  /**
+   *  \brief Whether the producer is (about to go) sleeping.
+   */
+  std::atomic<bool> producer_sleeping{false};
+  /**
+   *  \brief Whether the consumer is (about to go) sleeping.
+   */
+  std::atomic<bool> consumer_sleeping{false};
+  /**
+   *  \brief Set by the consumer when it's destroyed.
+   */
+  std::atomic<bool> stop{false};
+  /**
+   *  \brief Set by the producer once it's finished.
+   */
+  std::atomic<bool> done{false};
+  /**
+   *  \brief The exception thrown by the upstream generator (if any).
+   */
+  std::exception_ptr error;
+  /**
+   *  \brief How often a side yields its time slice before going to sleep.
+   */
+  static constexpr int spin_limit = 64;
+
+  /**
+   *  \brief Creates a new channel.
+   *  \param[in] capacity The capacity of the queue.
+   */
+  explicit buffer_channel(size_t capacity) : ring{capacity} {}
+
+  /**
+   *  \brief Wakes the other side.
+   */
+  void wake() {
+    signal.fetch_add(1);
+    signal.notify_all();
+  }
+
+  /**
+   *  \brief Pushes a value, sleeping while the queue is full (producer only).
+   *  \param[in] value The value.
+   *  \returns False if the consumer stopped.
+   */
+  template <typename U> bool push(U &&value) {
+    for (int i = 0; i < spin_limit; i++) {
+      if (!ring.full())
+        break;
+      std::this_thread::yield();
+    }
+    while (!ring.try_push(std::forward<U>(value))) {
+      uint32_t seen = signal.load();
+      producer_sleeping.store(true);
+      if (stop.load()) {
+        producer_sleeping.store(false);
+        return false;
+      }
+      if (ring.full())
+        signal.wait(seen);
+      producer_sleeping.store(false);
+    }
+    if (consumer_sleeping.exchange(false))
+      wake();
+    return !stop.load(std::memory_order_relaxed);
+  }
+
+  /**
+   *  \brief Marks the producer as finished (producer only).
+   */
+  void finish() {
+    done.store(true);
+    wake();
+  }
+
+  /**
+   *  \brief Gets the next value, sleeping while the queue is empty (consumer
+   * only).
+   *  \returns A pointer to the value, or `nullptr` once the producer finished.
+   */
+  T *front() {
+    for (int i = 0; i < spin_limit; i++) {
+      if (T *value = ring.front())
+        return value;
+      if (done.load())
+        break;
+      std::this_thread::yield();
+    }
+    while (true) {
+      if (T *value = ring.front())
+        return value;
+      uint32_t seen = signal.load();
+      consumer_sleeping.store(true);
+      if (T *value = ring.front()) {
+        consumer_sleeping.store(false);
+        return value;
+      }
+      if (done.load()) {
+        consumer_sleeping.store(false);
+        return ring.front();
+      }
+      signal.wait(seen);
+      consumer_sleeping.store(false);
+    }
+  }
+
+  /**
+   *  \brief Removes the value returned from `front()` (consumer only).
+   */
+  void pop() {
+    ring.pop();
+    if (producer_sleeping.exchange(false))
+      wake();
+  }
+};
+
+/**
+ *  \brief Runs a generator on a new thread, pushing its values into a
+ * fpgen::detail::buffer_channel.
+ *
+ *  Destroying the worker stops the producer (after its current value) and
+ * joins the thread.
+ *
+ *  \tparam T The type of the values.
+ */
+template <typename T> class buffer_worker {
+public:
+  /**
+   *  \brief Starts the producer thread.
+   *  \tparam P The exception policy of the generator.
+   *  \param[in] channel The channel to push into.
+   *  \param[in] gen The generator to run.
+   */
+  template <typename P>
+  buffer_worker(buffer_channel<T> &channel, generator<T, P> gen)
+      : _channel{channel}, _thread{[&channel, gen = std::move(gen)]() mutable {
+          try {
+            while (gen) {
+              if (!channel.push(gen()))
+                break;
+            }
+          } catch (...) {
+            channel.error = std::current_exception();
+          }
+          // free the generator on this thread, before the consumer can go
+          { generator<T, P> finished(std::move(gen)); }
+          channel.finish();
+        }} {}
+
+  buffer_worker(const buffer_worker &) = delete;
+  buffer_worker &operator=(const buffer_worker &) = delete;
+
+  /**
+   *  \brief Stops the producer and joins its thread.
+   */
+  ~buffer_worker() {
+    _channel.stop.store(true);
+    _channel.wake();
+    _thread.join();
+  }
+
+private:
+  buffer_channel<T> &_channel;
+  std::thread _thread;
+};
+} // namespace detail
+
+/**
+ *  \brief Runs a generator on a background thread, buffering its values.
+ *
+ *  Once the resulting generator is first resumed, a new thread starts pulling
+ * values from the given generator, and pushes them into a lock-free
+ * single-producer/single-consumer queue of (at least) `capacity` values. The
+ * resulting generator pops values from that queue. This way, a slow producer
+ * (like a parser behind fpgen::from_stream) runs in parallel with the work done
+ * on its values. When the queue is full, the producer sleeps; when it's empty,
+ * the consumer sleeps.
+ *
+ *  If the given generator throws, the exception is rethrown from the resulting
+ * generator after all values before it were yielded. If the resulting
+ * generator is destroyed early, the producer stops after its current value,
+ * and the thread is joined (so destruction waits for the value being produced
+ * at that time).
+ *
+ *  The given generator runs on a different thread, so it shouldn't touch
+ * thread-unsafe state shared with the consumer. Reference generators are not
+ * supported (map them to values first).
+ *
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator to buffer. Will be in unusable state
+ * afterwards.
+ *  \param[in] capacity The minimal capacity of the buffer (rounded up to a
+ * power of two).
+ *  \returns A new generator yielding the same values.
+ */
+template <typename T, typename P>
+generator<T> buffered(generator<T, P> gen, size_t capacity = 1024) {
+  static_assert(!std::is_reference_v<T>,
+                "fpgen::buffered doesn't support reference generators");
+  detail::buffer_channel<T> channel(capacity);
+  detail::buffer_worker<T> worker(channel, std::move(gen));
+  while (T *value = channel.front()) {
+    co_yield std::move(*value);
+    channel.pop();
+  }
+  if (channel.error)
+    std::rethrow_exception(channel.error);
+  co_return;
+}
+
+namespace detail {
+/**
+ *  \brief The jobs in flight for fpgen::par_map and fpgen::par_map_unordered.
+ *
+ *  Only the consumer submits jobs and takes their results; the jobs run on a
+ * fpgen::thread_pool. Destroying the window waits for all jobs still running.
+ *
+ *  \tparam T The type of the results.
+ */
+template <typename T> class par_window {
+public:
+  /**
+   *  \brief Creates a new window.
+   *  \param[in] pool The pool to run the jobs on.
+   *  \param[in] size The maximal amount of jobs in flight.
+   *  \param[in] ordered Whether results are taken in submission order.
+   */
+  par_window(thread_pool &pool, size_t size, bool ordered)
+      : _pool{pool}, _size{size}, _ordered{ordered} {
+    if (_ordered)
+      _slots.resize(size);
+  }
+
+  par_window(const par_window &) = delete;
+  par_window &operator=(const par_window &) = delete;
+
+  /**
+   *  \brief Waits for all jobs still running.
+   */
+  ~par_window() {
+    wait([this]() { return _running == 0; });
+  }
+
+  /**
+   *  \brief Checks whether the window is full.
+   *  \returns True if no more jobs should be submitted.
+   */
+  bool full() const { return _submitted - _taken >= _size; }
+
+  /**
+   *  \brief Checks whether there are no jobs in flight.
+   *  \returns True if all results were taken.
+   */
+  bool empty() const { return _submitted == _taken; }
+
+  /**
+   *  \brief Submits a job.
+   *  \tparam Job The job type; `() -> T`.
+   *  \param[in] task The job.
+   */
+  template <typename Job> void submit(Job task) {
+    size_t seq = _submitted++;
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      _running++;
+    }
+    _pool.submit([this, seq, task = std::move(task)]() mutable {
+      entry result;
+      try {
+        result.value.emplace(task());
+      } catch (...) {
+        result.error = std::current_exception();
+      }
+      result.ready = true;
+      // notify while locked: the window may be destroyed right after unlocking
+      std::lock_guard<std::mutex> guard(_lock);
+      if (_ordered)
+        _slots[seq % _size].assign(std::move(result));
+      else
+        _done.push_back(std::move(result));
+      _running--;
+      _changed.notify_all();
+    });
+  }
+
+  /**
+   *  \brief Waits for and takes the next result.
+   *
+   *  For an ordered window, this is the result of the oldest job not taken
+   * yet; otherwise it's the first result to finish. If the job threw, its
+   * exception is rethrown.
+   *
+   *  \returns The result.
+   */
+  T take() {
+    std::optional<T> value;
+    std::exception_ptr error;
+    if (_ordered) {
+      entry &slot = _slots[_taken % _size];
+      wait([&slot]() { return slot.ready; });
+      std::lock_guard<std::mutex> guard(_lock);
+      slot.move_to(value, error);
+      slot.clear();
+    } else {
+      wait([this]() { return !_done.empty(); });
+      std::lock_guard<std::mutex> guard(_lock);
+      _done.front().move_to(value, error);
+      _done.pop_front();
+    }
+    _taken++;
+    if (error)
+      std::rethrow_exception(error);
+    return std::move(*value);
+  }
+
+private:
+  struct entry {
+    std::optional<T> value;
+    std::exception_ptr error;
+    bool ready = false;
+
+    // T only needs to be move constructible
+    void assign(entry &&other) {
+      value.reset();
+      if (other.value)
+        value.emplace(std::move(*other.value));
+      error = std::move(other.error);
+      ready = other.ready;
+    }
+
+    // emplaces into the caller's empty optional, rather than moving a whole
+    // entry around (which GCC reports as maybe-uninitialized)
+    void move_to(std::optional<T> &out, std::exception_ptr &out_error) {
+      if (value)
+        out.emplace(std::move(*value));
+      out_error = std::move(error);
+    }
+
+    void clear() {
+      value.reset();
+      error = nullptr;
+      ready = false;
+    }
+  };
+
+  // waits until cond() holds, running pending jobs in the meantime
+  template <typename Cond> void wait(Cond cond) {
+    std::unique_lock<std::mutex> guard(_lock);
+    while (!cond()) {
+      guard.unlock();
+      bool ran = _pool.try_run_one();
+      guard.lock();
+      if (!ran)
+        _changed.wait(guard, cond);
+    }
+  }
+
+  thread_pool &_pool;
+  size_t _size;
+  bool _ordered;
+  size_t _submitted = 0;
+  size_t _taken = 0;
+  size_t _running = 0;
+  std::mutex _lock;
+  std::condition_variable _changed;
+  std::vector<entry> _slots;
+  std::deque<entry> _done;
+};
+
+/**
+ *  \brief Implements fpgen::par_map and fpgen::par_map_unordered.
+ *  \tparam TOut The output type.
+ *  \tparam TIn The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \tparam Fun The function type.
+ *  \param[in,out] gen The generator to map over.
+ *  \param[in] func The function to map with.
+ *  \param[in] threads The amount of threads, or `0` for the shared pool.
+ *  \param[in] window The maximal amount of values in flight, or `0`.
+ *  \param[in] ordered Whether to keep the original order.
+ *  \returns A new generator over the mapped values.
+ */
+template <typename TOut, typename TIn, typename P, typename Fun>
+generator<TOut> par_map_impl(generator<TIn, P> gen, Fun func, size_t threads,
+                             size_t window, bool ordered) {
+  std::unique_ptr<thread_pool> own;
+  if (threads != 0)
+    own = std::make_unique<thread_pool>(threads);
+  thread_pool &pool = own ? *own : thread_pool::shared();
+  par_window<TOut> work(pool, window != 0 ? window : 4 * pool.size(),
+                        ordered);
+  while (true) {
+    while (!work.full() && gen) {
+      work.submit([&func, in = gen()]() mutable -> TOut {
+        return func(std::move(in));
+      });
+    }
+    if (work.empty())
+      break;
+    TOut result = work.take();
+    co_yield std::move(result);
+  }
+  co_return;
+}
+} // namespace detail
+
+/**
+ *  \brief Maps a function over a generator in parallel, keeping the order.
+ *
+ *  Values are pulled from the given generator (on the consuming thread) and
+ * mapped on a fpgen::thread_pool, with at most `window` values in flight. The
+ * results are yielded in the original order, so a slow value holds back the
+ * results after it (see fpgen::par_map_unordered). The function may be called
+ * on several threads at once. If it throws, the exception is rethrown in place
+ * of the value it was thrown for. Destroying the resulting generator waits for
+ * the values in flight. Using the provided generator after calling
+ * fpgen::par_map is undefined behaviour.
+ *
+ *  \tparam TIn The type contained in the provided generator.
+ *  \tparam P The exception policy of the provided generator.
+ *  \tparam Fun The function signature of the mapping function.
+ *  \tparam TOut The output type. This type is deduced from the `Fun` type
+ * parameter.
+ *  \param[in,out] gen The generator to map over. Will be in unusable state
+ * afterwards.
+ *  \param[in] func The function to map with.
+ *  \param[in] threads The amount of threads in a dedicated pool, or `0` to use
+ * fpgen::thread_pool::shared.
+ *  \param[in] window The maximal amount of values in flight, or `0` for four
+ * per thread.
+ *  \returns A new generator over the mapped values.
+ */
+template <typename TIn, typename P, typename Fun,
+          typename TOut = std::remove_cvref_t<type::output_type<Fun, TIn>>>
+generator<TOut> par_map(generator<TIn, P> gen, Fun func, size_t threads = 0,
+                        size_t window = 0) {
+  return detail::par_map_impl<TOut>(std::move(gen), std::move(func), threads,
+                                    window, true);
+}
+
+/**
+ *  \brief Maps a function over a generator in parallel, yielding the results
+ * as they finish.
+ *
+ *  Like fpgen::par_map, except that a slow value doesn't hold back the others:
+ * the results are yielded in the order they finish.
+ *
+ *  \tparam TIn The type contained in the provided generator.
+ *  \tparam P The exception policy of the provided generator.
+ *  \tparam Fun The function signature of the mapping function.
+ *  \tparam TOut The output type. This type is deduced from the `Fun` type
+ * parameter.
+ *  \param[in,out] gen The generator to map over. Will be in unusable state
+ * afterwards.
+ *  \param[in] func The function to map with.
+ *  \param[in] threads The amount of threads in a dedicated pool, or `0` to use
+ * fpgen::thread_pool::shared.
+ *  \param[in] window The maximal amount of values in flight, or `0` for four
+ * per thread.
+ *  \returns A new generator over the mapped values.
+ */
+template <typename TIn, typename P, typename Fun,
+          typename TOut = std::remove_cvref_t<type::output_type<Fun, TIn>>>
+generator<TOut> par_map_unordered(generator<TIn, P> gen, Fun func,
+                                  size_t threads = 0, size_t window = 0) {
+  return detail::par_map_impl<TOut>(std::move(gen), std::move(func), threads,
+                                    window, false);
+}
+} // namespace fpgen
+
+#endif
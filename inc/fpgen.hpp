@@ -8,9 +8,17 @@
 #ifndef _FPGEN_MAIN
 #define _FPGEN_MAIN
 
+// the core library; subsystems pulling in threads, system I/O or the
+// instrumentation registry are in fpgen_all.hpp (or their own headers), so
+// they don't add to the compile time of every file including this one
 #include "aggregators.hpp"
+#include "allocator.hpp"
+#include "batch.hpp"
 #include "generator.hpp"
 #include "manipulators.hpp"
+#include "pipeline.hpp"
+#include "range.hpp"
+#include "simd.hpp"
 #include "sources.hpp"
 #include "type_traits.hpp"
 
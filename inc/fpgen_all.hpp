@@ -0,0 +1,24 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        fpgen_all.hpp
+// Purpose:     fpgen include file for the core library and all subsystems.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_ALL
+#define _FPGEN_ALL
+
+#include "async.hpp"
+#include "concurrent.hpp"
+#include "fpgen.hpp"
+#include "instrument.hpp"
+#if __has_include(<sys/mman.h>)
+#include "io.hpp"
+#endif
+#include "parallel.hpp"
+#if __has_include(<sys/mman.h>)
+#include "sink.hpp"
+#endif
+#include "thread_pool.hpp"
+
+#endif
@@ -14,14 +14,576 @@
 #include <coroutine>
 #endif
 
+#include <cstddef>
 #include <exception>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <type_traits>
 #include <utility>
+#include "allocator.hpp"
 #include "type_traits.hpp"
 
 /**
  *  \brief The namespace containing all of fpgen's code.
  */
 namespace fpgen {
+/**
+ *  \brief Exception policy: exceptions thrown from the coroutine are rethrown
+ * to the consumer (the default).
+ */
+struct rethrow_policy {};
+/**
+ *  \brief Exception policy: the coroutine doesn't throw; if it does anyway,
+ * `std::terminate` is called.
+ *
+ *  Promises with this policy don't store an exception, so coroutine frames are
+ * smaller, and taking a value involves no exception handling at all.
+ */
+struct nothrow_policy {};
+
+/**
+ *  \brief The kinds of size hints (see fpgen::size_hint).
+ */
+enum class hint_kind {
+  /**
+   *  \brief Nothing is known about the size.
+   */
+  unknown,
+  /**
+   *  \brief The generator yields exactly `size` values.
+   */
+  exact,
+  /**
+   *  \brief The generator yields at most `size` values.
+   */
+  at_most
+};
+
+/**
+ *  \brief The amount of values a generator will yield, if known.
+ *
+ *  Sources over containers (fpgen::from, fpgen::enumerate, ...) know their size
+ * up front, and most manipulators (fpgen::map, fpgen::zip, fpgen::take, ...)
+ * can derive their size from their source. The hint is used by aggregators:
+ * fpgen::aggregate_to reserves space for exactly-sized generators, and
+ * fpgen::count doesn't even have to run them.
+ */
+struct size_hint {
+  /**
+   *  \brief What the size means.
+   */
+  hint_kind kind = hint_kind::unknown;
+  /**
+   *  \brief The (maximal) amount of values; 0 if the size is unknown.
+   */
+  size_t size = 0;
+
+  /**
+   *  \brief Creates a hint for an exactly known size.
+   *  \param[in] n The amount of values.
+   *  \returns The hint.
+   */
+  static constexpr size_hint exact(size_t n) { return {hint_kind::exact, n}; }
+  /**
+   *  \brief Creates a hint for an upper bound on the size.
+   *  \param[in] n The maximal amount of values.
+   *  \returns The hint.
+   */
+  static constexpr size_hint at_most(size_t n) {
+    return {hint_kind::at_most, n};
+  }
+
+  /**
+   *  \brief Checks whether the size is known exactly.
+   *  \returns True if the size is exact.
+   */
+  constexpr bool is_exact() const { return kind == hint_kind::exact; }
+  /**
+   *  \brief Checks whether the size has an upper bound.
+   *  \returns True if the size is exact or bounded.
+   */
+  constexpr bool is_bounded() const { return kind != hint_kind::unknown; }
+
+  /**
+   *  \brief The hint after skipping the first values (see fpgen::drop).
+   *  \param[in] n The amount of values skipped.
+   *  \returns The new hint.
+   */
+  constexpr size_hint skip(size_t n) const {
+    return {kind, size > n ? size - n : 0};
+  }
+  /**
+   *  \brief The hint after keeping only the first values (see fpgen::take).
+   *  \param[in] n The maximal amount of values kept.
+   *  \returns The new hint.
+   */
+  constexpr size_hint limit(size_t n) const {
+    if (kind == hint_kind::unknown)
+      return at_most(n);
+    return {kind, n < size ? n : size};
+  }
+  /**
+   *  \brief The hint for a generator stopping when either of two generators
+   * runs out (see fpgen::zip).
+   *  \param[in] other The hint for the other generator.
+   *  \returns The new hint.
+   */
+  constexpr size_hint shortest(size_hint other) const {
+    if (!other.is_bounded())
+      return is_bounded() ? at_most(size) : *this;
+    if (!is_bounded())
+      return at_most(other.size);
+    if (kind == other.kind)
+      return {kind, size < other.size ? size : other.size};
+    return at_most(size < other.size ? size : other.size);
+  }
+
+  /**
+   *  \brief Compares two hints.
+   *  \returns True if both are equal.
+   */
+  constexpr bool operator==(const size_hint &) const = default;
+};
+
+/**
+ *  \brief The namespace containing fpgen's implementation details.
+ */
+namespace detail {
+#ifdef __clang__
+using suspend_always = std::experimental::suspend_always;
+using suspend_never = std::experimental::suspend_never;
+/**
+ *  \brief Type alias for coroutine handles (`std::coroutine_handle<P>`).
+ *  \tparam P The promise type (or `void` for any coroutine).
+ */
+template <typename P = void>
+using coroutine_handle = std::experimental::coroutine_handle<P>;
+using std::experimental::noop_coroutine;
+#else
+using suspend_always = std::suspend_always;
+using suspend_never = std::suspend_never;
+template <typename P = void> using coroutine_handle = std::coroutine_handle<P>;
+using std::noop_coroutine;
+#endif
+
+/**
+ *  \brief The position of a seekable source (see
+ * fpgen::generator::seekable).
+ *
+ *  Seekable sources yield the elements `position` up to `end` of an indexable
+ * sequence, reading both from their promise on each step. Others can then skip
+ * elements, or stop the source early, by changing them while the source is
+ * suspended; no elements have to be generated for that.
+ */
+struct cursor {
+  /**
+   *  \brief The index of the next element.
+   */
+  size_t position = 0;
+  /**
+   *  \brief The index past the last element.
+   */
+  size_t end = 0;
+  /**
+   *  \brief Whether the source follows this cursor.
+   */
+  bool seekable = false;
+};
+
+/**
+ *  \brief Awaitable giving a seekable source access to its cursor.
+ *
+ *  Used as `detail::cursor &at = co_await detail::get_cursor{};` at the start
+ * of the source; doesn't suspend.
+ */
+struct get_cursor {
+  /**
+   *  \brief The cursor in the coroutine's promise.
+   */
+  cursor *found = nullptr;
+
+  /**
+   *  \brief Never ready; `await_suspend` needs the handle.
+   *  \returns False.
+   */
+  bool await_ready() const noexcept { return false; }
+  /**
+   *  \brief Looks up the cursor and continues the coroutine.
+   *  \tparam P The promise type.
+   *  \param[in] h The coroutine.
+   *  \returns False (the coroutine isn't suspended).
+   */
+  template <typename P> bool await_suspend(coroutine_handle<P> h) noexcept {
+    found = &h.promise().at;
+    return false;
+  }
+  /**
+   *  \brief Gets the cursor.
+   *  \returns A reference to the cursor.
+   */
+  cursor &await_resume() const noexcept { return *found; }
+};
+
+/**
+ *  \brief Exception handling for a promise, depending on its policy.
+ *  \tparam Policy The exception policy (fpgen::rethrow_policy or
+ * fpgen::nothrow_policy).
+ */
+template <typename Policy> struct exception_slot;
+
+/**
+ *  \brief Exception handling for fpgen::rethrow_policy: stores the exception
+ * until the consumer gets to it.
+ */
+template <> struct exception_slot<rethrow_policy> {
+  /**
+   *  \brief Type alias for the exception type (`std::exception_ptr`).
+   */
+  using except_type = std::exception_ptr;
+  /**
+   *  \brief The last exception thrown from the coroutine, or none.
+   */
+  except_type ex;
+
+  /**
+   *  \brief Sets the exception from the coroutine.
+   *
+   *  This method is required by the C++20 spec for coroutines. When an error
+   * is thrown from the coroutine, this will set the `ex` field to the correct
+   * value.
+   */
+  void unhandled_exception() { ex = std::current_exception(); }
+  /**
+   *  \brief Rethrows the exception from the coroutine (once), if any.
+   */
+  void rethrow() {
+    if (ex)
+      std::rethrow_exception(std::exchange(ex, nullptr));
+  }
+};
+
+/**
+ *  \brief Exception handling for fpgen::nothrow_policy: terminates.
+ */
+template <> struct exception_slot<nothrow_policy> {
+  /**
+   *  \brief Terminates; the coroutine shouldn't throw.
+   */
+  [[noreturn]] void unhandled_exception() noexcept { std::terminate(); }
+  /**
+   *  \brief Does nothing; there never is an exception.
+   */
+  void rethrow() noexcept {}
+};
+
+/**
+ *  \brief Picks the exception policy for a generator derived from another.
+ *
+ *  The result is fpgen::nothrow_policy only if the source generator has that
+ * policy and the work added on top of it can't throw either.
+ *
+ *  \tparam Policy The exception policy of the source generator.
+ *  \tparam Nothrow Whether the added work is `noexcept`.
+ */
+template <typename Policy, bool Nothrow>
+using policy_for =
+    std::conditional_t<std::is_same_v<Policy, nothrow_policy> && Nothrow,
+                       nothrow_policy, rethrow_policy>;
+
+/**
+ *  \brief Checks whether taking a value out of a generator can't throw.
+ *
+ *  fpgen::generator::operator() returns references as-is, but moves values
+ * out of the coroutine; a derived generator does so inside its own coroutine.
+ *
+ *  \tparam T The type contained in the generator.
+ */
+template <typename T>
+using is_nothrow_take =
+    std::bool_constant<std::is_reference_v<T> ||
+                       std::is_nothrow_move_constructible_v<T>>;
+
+/**
+ *  \brief Picks the exception policy for a generator passing on the values of
+ * another (see fpgen::detail::policy_for).
+ *  \tparam Policy The exception policy of the source generator.
+ *  \tparam T The type contained in the source generator.
+ */
+template <typename Policy, typename T>
+using forward_policy = policy_for<Policy, is_nothrow_take<T>::value>;
+
+/**
+ *  \brief The result of fpgen::generator::next: an optional value, or a
+ * pointer for reference generators.
+ *  \tparam T The value type for the generator.
+ */
+template <typename T>
+using next_result =
+    std::conditional_t<std::is_reference_v<T>, std::remove_reference_t<T> *,
+                       std::optional<T>>;
+
+/**
+ *  \brief Storage for the last value yielded by a generator.
+ *
+ *  The promise never holds a value of its own; it keeps the address of the
+ * yielded object instead. Yielded rvalues (temporaries, `std::move`d locals,
+ * the result of another generator, ...) live until the coroutine is resumed,
+ * so they are moved out directly when the value is requested. Yielded lvalues
+ * are copy-constructed into the awaiter (which lives in the coroutine frame
+ * while the coroutine is suspended). As a result, the value type doesn't have
+ * to be default-constructible, assignable or copyable.
+ *
+ *  \tparam T The value type for the generator.
+ */
+template <typename T> struct promise_value {
+  /**
+   *  \brief The address of the last value yielded from the coroutine.
+   */
+  T *value = nullptr;
+  /**
+   *  \brief Where to publish yielded values; the `value` field of the
+   * outermost generator (see fpgen::elements_of).
+   */
+  T **target = &value;
+
+  /**
+   *  \brief Awaiter holding a copy of a yielded lvalue.
+   */
+  struct copy_awaiter {
+    /**
+     *  \brief The copy of the yielded value.
+     */
+    T copy;
+    /**
+     *  \brief The promise to publish the copy to.
+     */
+    promise_value &promise;
+
+    /**
+     *  \brief Always suspends.
+     *  \returns False.
+     */
+    bool await_ready() const noexcept { return false; }
+    /**
+     *  \brief Publishes the copy to the promise.
+     */
+    void await_suspend(coroutine_handle<>) noexcept {
+      *promise.target = std::addressof(copy);
+    }
+    /**
+     *  \brief Does nothing.
+     */
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   *  \brief Copies an intermediate value from the coroutine.
+   *  \param[in] v The value to copy.
+   *  \returns An awaiter holding the copy.
+   */
+  copy_awaiter yield_value(const T &v) { return {v, *this}; }
+  /**
+   *  \brief Sets an intermediate value from the coroutine, without copying.
+   *  \param[in] v The value; moved from once requested.
+   *  \returns An intermediate suspend object.
+   */
+  suspend_always yield_value(T &&v) noexcept {
+    *target = std::addressof(v);
+    return {};
+  }
+
+  /**
+   *  \brief Gets the last value yielded from the coroutine.
+   *  \returns A reference to the value.
+   */
+  T &current() { return *value; }
+};
+
+/**
+ *  \brief Storage for the last value yielded by a reference generator.
+ *
+ *  Generators over references (`fpgen::generator<const T &>` or
+ * `fpgen::generator<T &>`) only store the address of the yielded object. The
+ * object lives at least until the coroutine is resumed (this includes
+ * temporaries yielded from a `const T &` generator), so nothing is copied.
+ *
+ *  \tparam T The referenced type for the generator (possibly const).
+ */
+template <typename T> struct promise_value<T &> {
+  /**
+   *  \brief The address of the last object yielded from the coroutine.
+   */
+  T *value = nullptr;
+  /**
+   *  \brief Where to publish yielded objects; the `value` field of the
+   * outermost generator (see fpgen::elements_of).
+   */
+  T **target = &value;
+
+  /**
+   *  \brief Sets an intermediate object from the coroutine.
+   *  \param[in] v The object to refer to.
+   *  \returns An intermediate suspend object.
+   */
+  suspend_always yield_value(T &v) noexcept {
+    *target = std::addressof(v);
+    return {};
+  }
+
+  /**
+   *  \brief Gets the last object yielded from the coroutine.
+   *  \returns A reference to the object.
+   */
+  T &current() { return *value; }
+};
+
+/**
+ *  \brief Promise state shared by all generators yielding `T`.
+ *
+ *  Keeps track of nested generators (see fpgen::elements_of). Nested
+ * generators form a stack; the outermost (root) generator remembers the
+ * innermost (leaf) one, which is resumed directly by the consumer. Once a
+ * nested generator finishes, it transfers control straight back to its
+ * parent. The cost per element is therefore independent of the nesting depth,
+ * and no stack space is used for nesting.
+ *
+ *  \tparam T The value type for the generator.
+ */
+template <typename T> struct promise_base : promise_value<T> {
+  /**
+   *  \brief The outermost generator's promise.
+   */
+  promise_base *root = this;
+  /**
+   *  \brief The generator this one is nested in (or none).
+   */
+  coroutine_handle<> parent;
+  /**
+   *  \brief The innermost active coroutine; only used in the root promise.
+   */
+  coroutine_handle<> leaf;
+  /**
+   *  \brief The amount of values the coroutine will yield, if known.
+   */
+  size_hint hint;
+  /**
+   *  \brief The position of the coroutine, if it's a seekable source.
+   */
+  cursor at;
+
+  /**
+   *  \brief Final awaiter, transferring control to the parent (if any).
+   */
+  struct final_awaiter {
+    /**
+     *  \brief Always suspends.
+     *  \returns False.
+     */
+    bool await_ready() const noexcept { return false; }
+    /**
+     *  \brief Transfers control to the parent generator, or back to the
+     * consumer.
+     *  \tparam P The promise type.
+     *  \param[in] h The finishing coroutine.
+     *  \returns The coroutine to resume next.
+     */
+    template <typename P>
+    coroutine_handle<> await_suspend(coroutine_handle<P> h) noexcept {
+      promise_base &self = h.promise();
+      if (self.parent) {
+        self.root->leaf = self.parent;
+        return self.parent;
+      }
+      // resuming a finished generator does nothing
+      self.leaf = noop_coroutine();
+      return noop_coroutine();
+    }
+    /**
+     *  \brief Does nothing (never called).
+     */
+    void await_resume() const noexcept {}
+  };
+
+  /**
+   *  \brief Awaiter running a nested generator.
+   *  \tparam Gen The nested generator type.
+   */
+  template <typename Gen> struct nested_awaiter {
+    /**
+     *  \brief The nested generator (owned while running).
+     */
+    Gen gen;
+
+    /**
+     *  \brief Skips the nested generator if it already finished.
+     *  \returns True if the nested generator is finished.
+     */
+    bool await_ready() const noexcept {
+      return static_cast<typename Gen::handle_type>(gen).done();
+    }
+    /**
+     *  \brief Links the nested generator in and transfers control to it.
+     *  \tparam P The promise type of the parent.
+     *  \param[in] h The parent coroutine.
+     *  \returns The nested coroutine, to resume next.
+     */
+    template <typename P>
+    coroutine_handle<> await_suspend(coroutine_handle<P> h) noexcept {
+      auto inner = static_cast<typename Gen::handle_type>(gen);
+      promise_base &self = h.promise();
+      promise_base &nested = inner.promise();
+      nested.root = self.root;
+      nested.target = self.target;
+      nested.parent = h;
+      self.root->leaf = inner;
+      return inner;
+    }
+    /**
+     *  \brief Rethrows any exception thrown from the nested generator.
+     */
+    void await_resume() {
+      static_cast<typename Gen::handle_type>(gen).promise().rethrow();
+    }
+  };
+};
+} // namespace detail
+
+/**
+ *  \brief Marks a generator to be yielded element by element.
+ *
+ *  `co_yield fpgen::elements_of(gen);` from a generator yields each element
+ * of `gen` in turn, as if they were yielded by the outer generator itself. The
+ * inner generator is resumed by the consumer directly (see
+ * fpgen::detail::promise_base), so nesting adds no per-element cost, however
+ * deep. Exceptions from the inner generator are rethrown at the `co_yield`.
+ * Both generators should yield the same type.
+ *
+ *  \tparam Gen The generator type.
+ */
+template <typename Gen> struct elements_of {
+  /**
+   *  \brief The generator to yield from.
+   */
+  Gen gen;
+
+  /**
+   *  \brief Wraps a generator.
+   *  \param[in] gen The generator. Should not have been resumed yet.
+   */
+  explicit elements_of(Gen gen) : gen{std::move(gen)} {}
+};
+
+template <typename T, typename Policy = rethrow_policy,
+          typename _ = type::is_generator_type<T>>
+class generator;
+
+namespace detail {
+template <typename T>
+generator<T> rethrowing(generator<T, nothrow_policy> gen);
+} // namespace detail
+
 /**
  *  \brief The main generator type.
  *
@@ -32,29 +594,46 @@ namespace fpgen {
  * use `co_return` to finish the function - otherwise the compiler will
  * complain.
  *
- *  \tparam T The value type for the generator. This should satisfy
- * `std::copyable`, or on (older) CLang versions, `std::is_copy_assignable<T>`.
+ *  Generators are move-only: each generator owns its coroutine frame and
+ * destroys it when it goes out of scope. Functions taking a generator by value
+ * (all manipulators and aggregators) take over that ownership, so pass
+ * generators you still hold with `std::move`.
+ *
+ *  Generators can also yield references (`fpgen::generator<const T &>` or
+ * `fpgen::generator<T &>`). Those pass the yielded object itself to the
+ * consumer, without any copies. The object only lives until the generator is
+ * resumed, so copy it if you need it for longer.
+ *
+ *  Generators with fpgen::nothrow_policy (`fpgen::nothrow_generator<T>`) may
+ * not throw: they terminate instead, in exchange for smaller frames and no
+ * exception handling when taking values. Sources and manipulators return them
+ * automatically where nothing can throw (like fpgen::map over a nothrow
+ * generator with a `noexcept` function). They convert to the default
+ * generators where needed, at the cost of one extra resume per value.
+ *
+ *  \tparam T The value type for the generator. This should be
+ * move-constructible (like `std::unique_ptr`), or a reference type.
+ *  \tparam Policy The exception policy (fpgen::rethrow_policy or
+ * fpgen::nothrow_policy).
  */
-template <typename T, typename _ = type::is_generator_type<T>> class generator {
+template <typename T, typename Policy, typename _> class generator {
 public:
   /**
    *  \brief The promise type for the generator.
    *
    *  This type is required by the C++20 spec for coroutines.
    */
-  struct promise_type {
+  struct promise_type : detail::promise_base<T>,
+                        detail::exception_slot<Policy> {
     /**
      *  \brief Type alias for the value type (`T`) for this promise.
      */
     using value_type = T;
     /**
-     *  \brief Type alias for the exception type (`std::exception_ptr`).
+     *  \brief Type alias for the generator type (`fpgen::generator<T,
+     * Policy>`).
      */
-    using except_type = std::exception_ptr;
-    /**
-     *  \brief Type alias for the generator type (`fpgen::generator<T>`).
-     */
-    using gen_type = generator<T>;
+    using gen_type = generator<T, Policy>;
     /**
      *  \brief Type alias for the suspend type (`std::suspend_always`).
      */
@@ -64,22 +643,16 @@ public:
     using suspend_type = std::suspend_always;
 #endif
 
-    /**
-     *  \brief The last value returned from the coroutine itself.
-     */
-    value_type value;
-    /**
-     *  \brief The last exception thrown from the coroutine, or none.
-     */
-    except_type ex;
-
     /**
      *  \brief Gets the return object.
      *
      *  This method is required by the C++20 spec for coroutines.
      *  \returns A new generator for this promise.
      */
-    gen_type get_return_object() { return gen_type(*this); }
+    gen_type get_return_object() {
+      this->leaf = handle_type::from_promise(*this);
+      return gen_type(*this);
+    }
     /**
      *  \brief Gets the initial suspend object.
      *
@@ -90,10 +663,26 @@ public:
     /**
      *  \brief Gets the final suspend object.
      *
-     *  This method is required by the C++20 spec for coroutines.
+     *  This method is required by the C++20 spec for coroutines. Nested
+     * generators continue their parent from here.
      *  \returns The final suspend object.
      */
-    suspend_type final_suspend() noexcept { return {}; }
+    typename detail::promise_base<T>::final_awaiter final_suspend() noexcept {
+      return {};
+    }
+
+    using detail::promise_base<T>::yield_value;
+    /**
+     *  \brief Yields all elements of a nested generator.
+     *
+     *  This method is called for `co_yield fpgen::elements_of(gen)`.
+     *  \param[in] nested The nested generator.
+     *  \returns An awaiter running the nested generator.
+     */
+    typename detail::promise_base<T>::template nested_awaiter<gen_type>
+    yield_value(elements_of<gen_type> nested) {
+      return {std::move(nested.gen)};
+    }
     /**
      *  \brief Sets the final value from the coroutine.
      *
@@ -106,131 +695,138 @@ public:
     void return_void() {}
 
     /**
-     *  \brief Sets an intermediate value from the coroutine.
+     *  \brief Allocates the coroutine frame.
      *
-     *  This method is required by the C++20 spec for coroutines. When the
-     * coroutine calls `co_yield`, the environment will call this function.
-     *  \param[in] v The value to set.
-     *  \returns An intermediate suspend object.
+     *  Used for coroutines without an allocator argument. The frame is taken
+     * from the current fpgen::alloc::scoped_resource, if any, or from the
+     * thread-local fpgen::alloc::frame_pool.
+     *  \param[in] size The size of the frame.
+     *  \returns A pointer to the frame.
      */
-    suspend_type yield_value(value_type v) {
-      value = v;
-      return {};
+    static void *operator new(size_t size) {
+      return alloc::allocate_frame(size);
     }
-
     /**
-     *  \brief Sets the exception from the coroutine.
+     *  \brief Allocates the coroutine frame using an allocator.
      *
-     *  This method is required by the C++20 spec for coroutines. When an error
-     * is thrown from the coroutine, this will set the `ex` field to the correct
-     * value.
+     *  Used for coroutines whose first two parameters are
+     * `std::allocator_arg_t, const Alloc &`.
+     *  \tparam Alloc The allocator type.
+     *  \tparam Args The types of the other coroutine parameters.
+     *  \param[in] size The size of the frame.
+     *  \param[in] alloc The allocator to use.
+     *  \returns A pointer to the frame.
      */
-    void unhandled_exception() { ex = std::current_exception(); }
+    template <typename Alloc, typename... Args>
+    static void *operator new(size_t size, std::allocator_arg_t,
+                              const Alloc &alloc, const Args &...) {
+      return alloc::allocate_frame(size, alloc);
+    }
+    /**
+     *  \brief Allocates the coroutine frame of a member function using an
+     * allocator.
+     *
+     *  Used for member coroutines whose first two parameters are
+     * `std::allocator_arg_t, const Alloc &`.
+     *  \tparam This The type of the object the member function is called on.
+     *  \tparam Alloc The allocator type.
+     *  \tparam Args The types of the other coroutine parameters.
+     *  \param[in] size The size of the frame.
+     *  \param[in] alloc The allocator to use.
+     *  \returns A pointer to the frame.
+     */
+    template <typename This, typename Alloc, typename... Args>
+    static void *operator new(size_t size, const This &, std::allocator_arg_t,
+                              const Alloc &alloc, const Args &...) {
+      return alloc::allocate_frame(size, alloc);
+    }
+    /**
+     *  \brief Frees the coroutine frame, however it was allocated.
+     *  \param[in] ptr The frame.
+     *  \param[in] size The size of the frame.
+     */
+    static void operator delete(void *ptr, size_t size) noexcept {
+      alloc::deallocate_frame(ptr, size);
+    }
   };
 
   /**
    *  \brief The iterator type for the generator.
    *
    *  This type makes it possible to use for-each (like `for(auto v :
-   * generator)`) over generators.
+   * generator)`) over generators. It's an input iterator, compared against
+   * `std::default_sentinel` (see fpgen::generator::end); each increment resumes
+   * the generator exactly once. Dereferencing gives the current value as
+   * `T &&` (or the referenced object, for reference generators), which lives
+   * until the next increment.
    */
-  struct iterator_type {
+  class iterator_type {
+  public:
     /**
-     *  \brief Type alias for the generator type (`fpgen::generator<T>`).
+     *  \brief The iterator category (`std::input_iterator_tag`).
      */
-    using gen_t = generator<T>;
+    using iterator_concept = std::input_iterator_tag;
     /**
-     *  \brief Type alias for the iterator type
-     * (`fpgen::generator<T>::iterator_type`).
+     *  \brief The iterator category (`std::input_iterator_tag`).
      */
-    using iter_t = iterator_type;
+    using iterator_category = std::input_iterator_tag;
     /**
-     *  \brief Type alias for the value type (`T`) for this iterator.
+     *  \brief The type of the values (`T` without reference or const).
      */
-    using value_t = T;
-
-    /**
-     *  \brief The generator this iterator is associated with.
-     */
-    gen_t &source;
+    using value_type = std::remove_cvref_t<T>;
     /**
-     *  \brief Whether or not this iterator has finished iterating.
-     *
-     *  This value should only be true when the underlying generator is
-     * finished. Iterators are compared based on this value.
+     *  \brief The difference type (`std::ptrdiff_t`).
      */
-    // bool is_finished;
+    using difference_type = std::ptrdiff_t;
     /**
-     *  \brief The last value from the coroutine (and thus, the value currently
-     * held by the generator's promise).
+     *  \brief The type returned when dereferencing (`T &&`, or `T` for
+     * reference generators).
      */
-    // value_t value;
+    using reference = std::conditional_t<std::is_reference_v<T>, T, T &&>;
 
     /**
-     *  \brief Constructs a new iterator from a source generator.
-     *
-     *  The parameter `is_finished` should only be true if we wish to represent
-     * a past-the-end iterator (fpgen::generator<T>::end()). Otherwise,
-     * `is_finised` should be false. This constructor immediately fetches the
-     * next value in the generator.
-     *  \param[in] source The underlying generator. Will be called (and thus
-     * modified).
-     *  \param[in] is_finised Is this an `end` iterator?
-     */
-    iterator_type(gen_t &source, bool is_finised) : source{source} {
-      if (!is_finised)
-        ++(*this);
-    }
+     *  \brief Constructs an iterator not associated with any generator.
+     */
+    iterator_type() = default;
     /**
-     *  \brief Constructs a new iterator from a source generator and a value.
-     *
-     *  Calling this constructor from outside this struct results in undefined
-     * behaviour. The parameter `is_finished` should only be true if we wish to
-     * represent a past-the-end iterator (fpgen::generator<T>::end()).
-     * Otherwise, `is_finised` should be false.
-     *  \param[in] source The underlying generator. Will be called (and thus
-     * modified).
-     *  \param[in] is_finised Is this iterator finished?
-     *  \param[in] value The value this iterator should hold.
+     *  \brief Constructs an iterator over a generator.
+     *  \param[in] source The generator.
+     *  \param[in] more Whether the generator holds a value.
      */
-    explicit iterator_type(gen_t &source) : source{source} {}
+    iterator_type(generator &source, bool more)
+        : _source{&source}, _more{more} {}
 
     /**
-     *  \brief Steps the generator to the next value.
-     *  \returns A new iterator for this generator, with the same state.
+     *  \brief Gets the current value.
+     *  \returns A reference to the current value.
      */
-    iter_t operator++() {
-      source.next();
-      return iter_t(source);
+    reference operator*() const {
+      return static_cast<reference>(_source->_h.promise().current());
     }
-
     /**
-     *  \brief Converts this iterator to a bool.
-     *  \returns True if more values remain, otherwise false.
+     *  \brief Steps the generator to the next value.
+     *  \returns A reference to this iterator.
      */
-    operator bool() { return static_cast<bool>(source); }
+    iterator_type &operator++() {
+      _more = _source->advance();
+      return *this;
+    }
     /**
-     *  \brief Checks two iterators for inequality.
-     *
-     *  This method should only be used to compare against past-the-end
-     * iterators for the same generator - other uses are undefined behaviour.
-     *  \param[in] other The iterator to compare against.
-     *  \returns False if both are equal, otherwise true.
+     *  \brief Steps the generator to the next value.
      */
-    bool operator!=(const iter_t &) { return static_cast<bool>(source); }
+    void operator++(int) { ++*this; }
     /**
-     *  \brief Gets the current value from the iterator.
-     *  \returns The current value.
+     *  \brief Checks whether the generator is finished.
+     *  \param[in] it The iterator.
+     *  \returns True if no values remain.
      */
-    value_t operator*() {
-      source.contains = false;
-      return source._h.promise().value;
+    friend bool operator==(const iterator_type &it, std::default_sentinel_t) {
+      return !it._more;
     }
-    /**
-     *  \brief Converts this iterator to the current value.
-     *  \returns The current value.
-     */
-    operator value_t() { return source._h.promise().value; }
+
+  private:
+    generator *_source = nullptr;
+    bool _more = false;
   };
 
   /**
@@ -257,30 +853,67 @@ public:
       : _h{handle_type::from_promise(p)}, contains{false} {}
 
   /**
-   *  \brief Copy-constructing generators results in undefined behaviour.
+   *  \brief Generators can't be copied; each coroutine frame has one owner.
    */
-  generator(const generator &other) = default;
+  generator(const generator &other) = delete;
   /**
-   *  \brief Moves the data from the other generator into this one.
+   *  \brief Moves the coroutine from the other generator into this one.
+   *
+   *  The other generator no longer owns a coroutine afterwards; the only valid
+   * operations on it are destruction and assignment.
    *  \param[in,out] other The other generator.
    */
-  generator(generator &&other) = default;
+  generator(generator &&other) noexcept
+      : _h{std::exchange(other._h, {})}, contains{other.contains} {}
+  /**
+   *  \brief Wraps a nothrow generator (see fpgen::nothrow_policy).
+   *
+   *  The values are forwarded by a new coroutine, so this adds a coroutine
+   * frame, and one resume per value. The size hint is kept, and so is
+   * seekability: seeking or truncating the wrapper (before it's first
+   * resumed) seeks or truncates the nothrow generator. Sources like
+   * fpgen::from return nothrow generators where possible, so to avoid the
+   * extra resume, store them as `auto` (or as fpgen::nothrow_generator)
+   * rather than as `fpgen::generator<T>`. Only available for generators with
+   * fpgen::rethrow_policy.
+   *  \param[in,out] other The nothrow generator.
+   */
+  template <typename P = Policy,
+            typename = std::enable_if_t<std::is_same_v<P, rethrow_policy>>>
+  generator(generator<T, nothrow_policy> &&other)
+      : generator(detail::rethrowing(std::move(other))) {}
 
   /**
-   *  \brief Copy-assigning generators results in undefined behaviour.
+   *  \brief Generators can't be copied; each coroutine frame has one owner.
    */
-  generator &operator=(const generator &other) = default;
+  generator &operator=(const generator &other) = delete;
   /**
-   *  \brief Moves the data from the other generator into this one.
+   *  \brief Moves the coroutine from the other generator into this one.
+   *
+   *  The coroutine owned by this generator (if any) is destroyed first.
    *  \param[in,out] other The other generator.
    *  \returns A reference to this generator.
    */
-  generator &operator=(generator &&other) = default;
+  generator &operator=(generator &&other) noexcept {
+    if (this != &other) {
+      if (_h)
+        _h.destroy();
+      _h = std::exchange(other._h, {});
+      contains = other.contains;
+    }
+    return *this;
+  }
 
   /**
    *  \brief Cleans up this generator's resources.
+   *
+   *  Destroys the coroutine frame, including any generators it owns (like the
+   * source generator passed to fpgen::map).
    */
-  ~generator() = default;
+  ~generator() {
+    if (_h)
+      _h.destroy();
+  }
 
   /**
    *  \brief Converts this generator its handle.
@@ -289,25 +922,140 @@ public:
   operator handle_type() const { return _h; }
   /**
    *  \brief Converts this generator to a bool.
+   *
+   *  Resumes the generator if the last value was already taken, so the next
+   * value can be taken using `operator()`.
    *  \returns True if more values remain, otherwise false.
+   *  \throws `std::exception` Any exception can be thrown from this function
+   * that can be thrown from the coroutine.
    */
   operator bool() {
+    if (!contains)
+      contains = advance();
+    return contains;
+  }
+
+  /**
+   *  \brief Gets the amount of values this generator will yield, if known.
+   *
+   *  The hint is set by the function creating the generator (see
+   * fpgen::size_hint), and only describes the generator before it is first
+   * resumed. Afterwards, the size is unknown (or exactly 0 once finished).
+   *  \returns The size hint.
+   */
+  size_hint hint() const {
+    if (!_h)
+      return {};
     if (_h.done())
-      return false;
-    next();
-    return !_h.done();
+      return size_hint::exact(0);
+    if (started())
+      return {};
+    return _h.promise().hint;
+  }
+  /**
+   *  \brief Sets the amount of values this generator will yield.
+   *
+   *  Should only be called before the generator is first resumed, by the
+   * function creating it.
+   *  \param[in] hint The size hint.
+   */
+  void set_hint(size_hint hint) { _h.promise().hint = hint; }
+
+  /**
+   *  \brief Checks whether elements can be skipped without generating them.
+   *
+   *  Sources over random-access containers (fpgen::from, fpgen::enumerate,
+   * ...) and integral counters (fpgen::inc) are seekable until they are first
+   * resumed. fpgen::drop and fpgen::take use this to skip or cut off elements
+   * in constant time, instead of resuming the source for each element.
+   *  \returns True if fpgen::generator::seek and fpgen::generator::truncate
+   * can be used.
+   */
+  bool seekable() const {
+    return _h && !_h.done() && !started() && _h.promise().at.seekable;
+  }
+  /**
+   *  \brief Skips elements without generating them.
+   *
+   *  Should only be called if fpgen::generator::seekable returns true.
+   *  \param[in] count The amount of elements to skip.
+   */
+  void seek(size_t count) {
+    detail::cursor &at = _h.promise().at;
+    at.position = count < at.end - at.position ? at.position + count : at.end;
+    _h.promise().hint = _h.promise().hint.skip(count);
+  }
+  /**
+   *  \brief Stops the generator after the given amount of elements.
+   *
+   *  Should only be called if fpgen::generator::seekable returns true.
+   *  \param[in] count The amount of elements to keep.
+   */
+  void truncate(size_t count) {
+    detail::cursor &at = _h.promise().at;
+    if (count < at.end - at.position) {
+      at.end = at.position + count;
+      _h.promise().hint = size_hint::exact(count);
+    }
+  }
+  /**
+   *  \brief Makes this generator seekable.
+   *
+   *  Should only be called before the generator is first resumed, by the
+   * function creating it. The coroutine should yield the elements from its
+   * cursor's `position` up to `end` (see fpgen::detail::get_cursor).
+   *  \param[in] end The amount of elements in the source.
+   */
+  void set_seekable(size_t end) { _h.promise().at = {0, end, true}; }
+  /**
+   *  \brief Gets the amount of elements a seekable generator has left.
+   *
+   *  Should only be called if fpgen::generator::seekable returns true.
+   *  \returns The amount of elements left.
+   */
+  size_t seekable_size() const {
+    const detail::cursor &at = _h.promise().at;
+    return at.end - at.position;
   }
 
   /**
    *  \brief Gets an iterator to the current coroutine state.
+   *
+   *  Resumes the generator, unless it holds a value not taken yet.
    *  \returns An iterator for the current state.
    */
-  iterator_type begin() { return {*this, false}; }
+  iterator_type begin() {
+    bool more = contains || advance();
+    contains = false;
+    return {*this, more};
+  }
   /**
-   *  \brief Gets a past-the-end iterator for the current coroutine state.
-   *  \returns A past-the-end iterator for this generator.
+   *  \brief Gets the sentinel marking the end of the generator.
+   *  \returns `std::default_sentinel`.
    */
-  iterator_type end() { return {*this, true}; }
+  std::default_sentinel_t end() const { return {}; }
+
+  /**
+   *  \brief Takes the next value from the generator.
+   *
+   *  Resumes the generator once (unless `operator bool` already did), and
+   * moves the value out. For reference generators, a pointer to the yielded
+   * object is returned instead. Either way, the result converts to false once
+   * the generator is finished, and is dereferenced with `*`:
+   *        `while (auto v = gen.next()) { use(*v); }`.
+   *  \returns The next value, or nothing if the generator is finished.
+   *  \throws `std::exception` Any exception can be thrown from this function
+   * that can be thrown from the coroutine.
+   */
+  detail::next_result<T> next() {
+    if (!contains && !advance())
+      return {};
+    contains = false;
+    if constexpr (std::is_reference_v<T>)
+      return std::addressof(_h.promise().current());
+    else
+      return std::move(_h.promise().current());
+  }
 
   /**
    *  \brief Steps the generator forward once.
@@ -321,25 +1069,93 @@ public:
    * that can be thrown from the coroutine.
    */
   value_type operator()() {
-    next();
+    if (!contains)
+      advance();
     contains = false;
-    return std::move(_h.promise().value);
+    if constexpr (std::is_reference_v<T>)
+      return _h.promise().current();
+    else
+      return std::move(_h.promise().current());
   }
 
 private:
   handle_type _h;
   bool contains;
 
-  void next() {
-    if (!contains) {
-      _h();
-      if (_h.promise().ex)
-        std::rethrow_exception(_h.promise().ex);
-      contains = true;
-    }
+  // once a value was published, the coroutine has run
+  bool started() const { return _h.promise().value != nullptr; }
+
+  // resumes once; a finished generator's leaf is a no-op coroutine (see
+  // detail::promise_base::final_awaiter), so that's always safe
+  bool advance() {
+    promise_type &promise = _h.promise();
+    promise.leaf.resume();
+    if (!_h.done())
+      return true;
+    promise.rethrow();
+    return false;
   }
 };
 
+/**
+ *  \brief Type alias for generators which don't throw (see
+ * fpgen::nothrow_policy).
+ *  \tparam T The value type for the generator.
+ */
+template <typename T> using nothrow_generator = generator<T, nothrow_policy>;
+
+namespace detail {
+/**
+ *  \brief Forwards all values of a nothrow generator.
+ *  \tparam T The value type for the generator.
+ *  \param[in,out] gen The nothrow generator.
+ *  \returns A generator with fpgen::rethrow_policy and the same values.
+ */
+template <typename T>
+generator<T> rethrowing_impl(generator<T, nothrow_policy> gen) {
+  // forwards seeks on the wrapper, made before it was first resumed
+  cursor &at = co_await get_cursor{};
+  if (at.seekable) {
+    gen.seek(at.position);
+    gen.truncate(at.end - at.position);
+  }
+  for (auto &&value : gen) {
+    co_yield std::forward<decltype(value)>(value);
+  }
+  co_return;
+}
+
+/**
+ *  \brief Forwards all values of a nothrow generator, keeping its size hint
+ * and seekability.
+ *  \tparam T The value type for the generator.
+ *  \param[in,out] gen The nothrow generator.
+ *  \returns A generator with fpgen::rethrow_policy and the same values.
+ */
+template <typename T>
+generator<T> rethrowing(generator<T, nothrow_policy> gen) {
+  size_hint hint = gen.hint();
+  bool seekable = gen.seekable();
+  size_t size = seekable ? gen.seekable_size() : 0;
+  generator<T> forwarded = rethrowing_impl(std::move(gen));
+  forwarded.set_hint(hint);
+  if (seekable)
+    forwarded.set_seekable(size);
+  return forwarded;
+}
+} // namespace detail
 } // namespace fpgen
 
+/**
+ *  \brief Generators are views: move-only ranges owning their coroutine, which
+ * can be composed with the standard views (like `gen |
+ * std::views::transform(f)`) and passed to `std::ranges` algorithms.
+ *  \tparam T The value type for the generator.
+ *  \tparam Policy The exception policy for the generator.
+ *  \tparam U The constraint parameter for the generator.
+ */
+template <typename T, typename Policy, typename U>
+inline constexpr bool
+    std::ranges::enable_view<fpgen::generator<T, Policy, U>> = true;
+
 #endif
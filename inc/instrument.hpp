@@ -0,0 +1,752 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        instrument.hpp
+// Purpose:     per-stage instrumentation of fpgen pipelines.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_INSTRUMENT
+#define _FPGEN_INSTRUMENT
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "generator.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+#define _FPGEN_INSTRUMENT_TSC
+#include <x86intrin.h>
+#endif
+
+/**
+ *  \brief The namespace containing fpgen's pipeline instrumentation.
+ *
+ *  Stages are instrumented by wrapping them in fpgen::instrumented. Each
+ * wrapped stage records its statistics in a fpgen::instrument::registry
+ * (by default the global one), under the name it was given.
+ *
+ *  Defining `FPGEN_NO_INSTRUMENTATION` before including fpgen turns
+ * fpgen::instrumented into a no-op, which returns the generator it was given;
+ * pipelines then run exactly as if they weren't wrapped.
+ */
+namespace fpgen::instrument {
+/**
+ *  \brief The clock timing each resume.
+ *
+ *  On x86, this reads the time-stamp counter, which takes a fraction of the
+ * time a `std::chrono::steady_clock` reading takes. Ticks are converted to
+ * nanoseconds only when statistics are read, using the tick rate measured
+ * against `std::chrono::steady_clock` since the clock was started. Elsewhere,
+ * a tick is a nanosecond of `std::chrono::steady_clock`.
+ */
+class clock {
+public:
+  /**
+   *  \brief Reads the clock.
+   *  \returns The current time, in ticks.
+   */
+  static uint64_t now() {
+#ifdef _FPGEN_INSTRUMENT_TSC
+    return __rdtsc();
+#else
+    return steady_ns();
+#endif
+  }
+
+  /**
+   *  \brief Starts measuring the tick rate, if that hasn't started yet.
+   */
+  static void start() { origin(); }
+
+  /**
+   *  \brief Gets the length of a tick.
+   *
+   *  The first call may wait up to a few milliseconds after the clock was
+   * started, to measure the tick rate precisely enough.
+   *
+   *  \returns The length of a tick, in nanoseconds.
+   */
+  static double ns_per_tick() {
+#ifdef _FPGEN_INSTRUMENT_TSC
+    constexpr uint64_t min_ns = 5000000;
+    const point &from = origin();
+    uint64_t ns = steady_ns() - from.ns;
+    if (ns < min_ns) {
+      std::this_thread::sleep_for(std::chrono::nanoseconds(min_ns - ns));
+      ns = steady_ns() - from.ns;
+    }
+    return static_cast<double>(ns) / static_cast<double>(now() - from.ticks);
+#else
+    return 1;
+#endif
+  }
+
+  /**
+   *  \brief Converts a time to nanoseconds since the clock was started.
+   *  \param[in] ticks The time, in ticks.
+   *  \param[in] tick The length of a tick (see `ns_per_tick`).
+   *  \returns The time since the clock was started, in nanoseconds.
+   */
+  static double since_start_ns(uint64_t ticks, double tick) {
+    return static_cast<double>(ticks - origin().ticks) * tick;
+  }
+
+private:
+  struct point {
+    uint64_t ticks;
+    uint64_t ns;
+  };
+
+  static uint64_t steady_ns() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+
+  static const point &origin() {
+    static const point start{now(), steady_ns()};
+    return start;
+  }
+};
+
+/**
+ *  \brief A histogram of durations, safe to update from multiple threads.
+ *
+ *  Durations are counted in buckets of 1/8th of a power of two (so
+ * percentiles are accurate to about 6%). Durations below 16 are counted
+ * exactly.
+ */
+class histogram {
+public:
+  /**
+   *  \brief The amount of buckets.
+   */
+  static constexpr size_t buckets = 16 + 60 * 8;
+
+  /**
+   *  \brief Counts a duration.
+   *  \param[in] duration The duration.
+   */
+  void record(uint64_t duration) {
+    add(bucket(duration), 1);
+    update_max(duration);
+  }
+
+  /**
+   *  \brief Counts durations falling in a single bucket.
+   *  \param[in] index The bucket (see `bucket`).
+   *  \param[in] count The amount of durations.
+   */
+  void add(size_t index, uint64_t count) {
+    _counts[index].fetch_add(count, std::memory_order_relaxed);
+  }
+
+  /**
+   *  \brief Raises the largest duration counted, if needed.
+   *  \param[in] duration The duration.
+   */
+  void update_max(uint64_t duration) {
+    uint64_t max = _max.load(std::memory_order_relaxed);
+    while (duration > max && !_max.compare_exchange_weak(
+                                 max, duration, std::memory_order_relaxed)) {
+    }
+  }
+
+  /**
+   *  \brief Gets the bucket a duration is counted in.
+   *  \param[in] duration The duration.
+   *  \returns The index of the bucket.
+   */
+  static size_t bucket(uint64_t duration) {
+    if (duration < 16)
+      return static_cast<size_t>(duration);
+    size_t exp = static_cast<size_t>(std::bit_width(duration)) - 1;
+    size_t sub = static_cast<size_t>(duration >> (exp - 3)) & 7;
+    return 16 + (exp - 4) * 8 + sub;
+  }
+
+  /**
+   *  \brief Gets the amount of durations counted.
+   *  \returns The amount of durations.
+   */
+  uint64_t count() const {
+    uint64_t total = 0;
+    for (const auto &c : _counts) {
+      total += c.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  /**
+   *  \brief Gets the largest duration counted.
+   *  \returns The largest duration.
+   */
+  uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+
+  /**
+   *  \brief Estimates a percentile.
+   *  \param[in] p The percentile, between 0 and 1 (`0.99` for p99).
+   *  \returns The estimated duration (the middle of its bucket), or 0 if
+   * nothing was counted.
+   */
+  double percentile(double p) const {
+    uint64_t total = count();
+    if (total == 0)
+      return 0;
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets; i++) {
+      seen += _counts[i].load(std::memory_order_relaxed);
+      if (seen > rank)
+        return middle(i);
+    }
+    return static_cast<double>(max());
+  }
+
+  /**
+   *  \brief Clears the histogram.
+   */
+  void reset() {
+    for (auto &c : _counts) {
+      c.store(0, std::memory_order_relaxed);
+    }
+    _max.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  static double middle(size_t index) {
+    if (index < 16)
+      return static_cast<double>(index);
+    size_t exp = 4 + (index - 16) / 8;
+    size_t sub = (index - 16) % 8;
+    double width = static_cast<double>(uint64_t{1} << (exp - 3));
+    return static_cast<double>(8 + sub) * width + width / 2;
+  }
+
+  std::array<std::atomic<uint64_t>, buckets> _counts{};
+  std::atomic<uint64_t> _max{0};
+};
+
+/**
+ *  \brief The statistics of a single stage, as gathered so far.
+ */
+struct stage_stats {
+  /**
+   *  \brief The name of the stage.
+   */
+  std::string name;
+  /**
+   *  \brief The amount of values the stage took from instrumented stages
+   * upstream of it.
+   */
+  uint64_t elements_in;
+  /**
+   *  \brief The amount of values the stage yielded.
+   */
+  uint64_t elements_out;
+  /**
+   *  \brief The amount of times the stage was resumed (one more than the
+   * amount of values, for stages which ran to completion).
+   */
+  uint64_t resumes;
+  /**
+   *  \brief The time spent inside the stage, including the stages it pulled
+   * values from, in nanoseconds.
+   */
+  uint64_t total_ns;
+  /**
+   *  \brief The time spent inside the stage, excluding the instrumented stages
+   * it pulled values from, in nanoseconds.
+   */
+  uint64_t self_ns;
+  /**
+   *  \brief The median time to produce a value, in nanoseconds.
+   */
+  double p50_ns;
+  /**
+   *  \brief The 99th percentile of the time to produce a value, in
+   * nanoseconds.
+   */
+  double p99_ns;
+  /**
+   *  \brief The longest time to produce a value, in nanoseconds.
+   */
+  uint64_t max_ns;
+};
+
+class registry;
+
+/**
+ *  \brief The live counters of a single stage.
+ *
+ *  Stages are owned by a fpgen::instrument::registry, and updated by
+ * instrumented generators (possibly from multiple threads). Generators still
+ * running publish their counts in batches (see fpgen::instrument::local_stage),
+ * so the statistics of a running stage lag behind slightly.
+ */
+class stage {
+public:
+  /**
+   *  \brief Creates a stage.
+   *  \param[in] owner The registry owning the stage.
+   *  \param[in] name The name of the stage.
+   */
+  stage(registry &owner, std::string name)
+      : _owner{owner}, _name{std::move(name)} {}
+
+  /**
+   *  \brief Gets the name of the stage.
+   *  \returns The name.
+   */
+  const std::string &name() const { return _name; }
+
+  /**
+   *  \brief Gets the statistics gathered so far.
+   *  \returns The statistics.
+   */
+  stage_stats stats() const {
+    double tick = clock::ns_per_tick();
+    auto ns = [tick](uint64_t ticks) {
+      return static_cast<uint64_t>(static_cast<double>(ticks) * tick);
+    };
+    return {_name,
+            _in.load(std::memory_order_relaxed),
+            _out.load(std::memory_order_relaxed),
+            _resumes.load(std::memory_order_relaxed),
+            ns(_total_ticks.load(std::memory_order_relaxed)),
+            ns(_self_ticks.load(std::memory_order_relaxed)),
+            _latency.percentile(0.5) * tick,
+            _latency.percentile(0.99) * tick,
+            ns(_latency.max())};
+  }
+
+  /**
+   *  \brief Clears the statistics.
+   */
+  void reset() {
+    _in.store(0, std::memory_order_relaxed);
+    _out.store(0, std::memory_order_relaxed);
+    _resumes.store(0, std::memory_order_relaxed);
+    _total_ticks.store(0, std::memory_order_relaxed);
+    _self_ticks.store(0, std::memory_order_relaxed);
+    _latency.reset();
+  }
+
+private:
+  friend class local_stage;
+  friend class scope;
+
+  registry &_owner;
+  std::string _name;
+  std::atomic<uint64_t> _in{0};
+  std::atomic<uint64_t> _out{0};
+  std::atomic<uint64_t> _resumes{0};
+  std::atomic<uint64_t> _total_ticks{0};
+  std::atomic<uint64_t> _self_ticks{0};
+  histogram _latency;
+};
+
+/**
+ *  \brief A collection of named stages, with their statistics and (if
+ * enabled) a trace of each resume.
+ */
+class registry {
+public:
+  /**
+   *  \brief Creates an empty registry.
+   */
+  registry() { clock::start(); }
+
+  registry(const registry &) = delete;
+  registry &operator=(const registry &) = delete;
+
+  /**
+   *  \brief Gets the global registry, used by default.
+   *  \returns The global registry.
+   */
+  static registry &global() {
+    static registry instance;
+    return instance;
+  }
+
+  /**
+   *  \brief Gets (or creates) the stage with the given name. Stages sharing a
+   * name share their statistics.
+   *  \param[in] name The name of the stage.
+   *  \returns The stage; valid as long as the registry.
+   */
+  stage &get(const std::string &name) {
+    std::lock_guard<std::mutex> guard(_lock);
+    auto &slot = _stages[name];
+    if (!slot)
+      slot = std::make_unique<stage>(*this, name);
+    return *slot;
+  }
+
+  /**
+   *  \brief Gets the statistics of all stages, ordered by name.
+   *  \returns The statistics.
+   */
+  std::vector<stage_stats> snapshot() const {
+    std::lock_guard<std::mutex> guard(_lock);
+    std::vector<stage_stats> out;
+    for (const auto &[name, s] : _stages) {
+      out.push_back(s->stats());
+    }
+    return out;
+  }
+
+  /**
+   *  \brief Clears the statistics of all stages, and the trace.
+   */
+  void reset() {
+    std::lock_guard<std::mutex> guard(_lock);
+    for (auto &[name, s] : _stages) {
+      s->reset();
+    }
+    _events.clear();
+    _dropped = 0;
+  }
+
+  /**
+   *  \brief Starts or stops recording a trace event for each resume.
+   *
+   *  Tracing takes a lock per resume, so it costs a lot more than the
+   * statistics alone. Once `capacity` events are recorded, further events are
+   * dropped (and counted).
+   *
+   *  \param[in] enabled Whether to record events.
+   *  \param[in] capacity The maximum amount of events kept.
+   */
+  void trace(bool enabled, size_t capacity = 1 << 20) {
+    std::lock_guard<std::mutex> guard(_lock);
+    _capacity = capacity;
+    _tracing.store(enabled, std::memory_order_relaxed);
+  }
+
+  /**
+   *  \brief Writes the statistics of all stages as a JSON object:
+   * `{"stages": [{"name": ..., "elements_in": ..., ...}, ...]}`.
+   *  \param[in,out] out The stream to write to.
+   *  \returns The stream.
+   */
+  std::ostream &to_json(std::ostream &out) const {
+    out << "{\"stages\":[";
+    bool first = true;
+    for (const auto &s : snapshot()) {
+      out << (first ? "" : ",") << "{\"name\":";
+      write_string(out, s.name);
+      out << ",\"elements_in\":" << s.elements_in
+          << ",\"elements_out\":" << s.elements_out
+          << ",\"resumes\":" << s.resumes << ",\"total_ns\":" << s.total_ns
+          << ",\"self_ns\":" << s.self_ns << ",\"p50_ns\":" << s.p50_ns
+          << ",\"p99_ns\":" << s.p99_ns << ",\"max_ns\":" << s.max_ns << "}";
+      first = false;
+    }
+    return out << "]}";
+  }
+
+  /**
+   *  \brief Writes the traced resumes in the Chrome trace event format (one
+   * complete event per resume, on the thread it ran on), viewable in
+   * `chrome://tracing` or Perfetto.
+   *  \param[in,out] out The stream to write to.
+   *  \returns The stream.
+   */
+  std::ostream &to_chrome_trace(std::ostream &out) const {
+    double tick = clock::ns_per_tick();
+    std::lock_guard<std::mutex> guard(_lock);
+    out << "{\"traceEvents\":[";
+    bool first = true;
+    for (const auto &e : _events) {
+      out << (first ? "" : ",") << "{\"name\":";
+      write_string(out, e.source->name());
+      out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+          << ",\"ts\":" << clock::since_start_ns(e.start, tick) / 1000
+          << ",\"dur\":" << static_cast<double>(e.duration) * tick / 1000
+          << "}";
+      first = false;
+    }
+    return out << "],\"otherData\":{\"dropped_events\":" << _dropped << "}}";
+  }
+
+private:
+  friend class scope;
+
+  struct event {
+    const stage *source;
+    uint32_t thread;
+    uint64_t start;
+    uint64_t duration;
+  };
+
+  static void write_string(std::ostream &out, const std::string &text) {
+    out << '"';
+    for (char c : text) {
+      if (c == '"' || c == '\\') {
+        out << '\\' << c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        out << ' ';
+      } else {
+        out << c;
+      }
+    }
+    out << '"';
+  }
+
+  void record(const stage &source, uint64_t start, uint64_t duration) {
+    static std::atomic<uint32_t> next_thread{0};
+    thread_local uint32_t thread = next_thread.fetch_add(1);
+    std::lock_guard<std::mutex> guard(_lock);
+    if (_events.size() < _capacity) {
+      _events.push_back({&source, thread, start, duration});
+    } else {
+      _dropped++;
+    }
+  }
+
+  mutable std::mutex _lock;
+  std::map<std::string, std::unique_ptr<stage>> _stages;
+  std::atomic<bool> _tracing{false};
+  size_t _capacity = 0;
+  std::vector<event> _events;
+  uint64_t _dropped = 0;
+};
+
+/**
+ *  \brief The counters of a single instrumented generator.
+ *
+ *  Counting into the shared fpgen::instrument::stage on every resume would
+ * take several atomic operations per value; instead, each instrumented
+ * generator counts locally (it is only resumed by one thread at a time), and
+ * publishes its counts every `publish_every` resumes, and when destroyed.
+ */
+class local_stage {
+public:
+  /**
+   *  \brief The amount of resumes between two publications.
+   */
+  static constexpr uint64_t publish_every = 1024;
+
+  /**
+   *  \brief Creates empty counters for a stage.
+   *  \param[in,out] s The stage to publish to.
+   */
+  explicit local_stage(stage &s) : _stage{s} {}
+
+  local_stage(const local_stage &) = delete;
+  local_stage &operator=(const local_stage &) = delete;
+
+  /**
+   *  \brief Publishes the remaining counts.
+   */
+  ~local_stage() { publish(); }
+
+  /**
+   *  \brief Adds the counts to the stage, and clears them.
+   */
+  void publish() {
+    _stage._in.fetch_add(_in, std::memory_order_relaxed);
+    _stage._out.fetch_add(_out, std::memory_order_relaxed);
+    _stage._resumes.fetch_add(_resumes, std::memory_order_relaxed);
+    _stage._total_ticks.fetch_add(_total, std::memory_order_relaxed);
+    _stage._self_ticks.fetch_add(_self, std::memory_order_relaxed);
+    for (size_t i = 0; i < histogram::buckets; i++) {
+      if (_counts[i] != 0)
+        _stage._latency.add(i, _counts[i]);
+    }
+    _stage._latency.update_max(_max);
+    _in = _out = _resumes = _total = _self = _max = 0;
+    _counts.fill(0);
+  }
+
+private:
+  friend class scope;
+
+  stage &_stage;
+  uint64_t _in = 0;
+  uint64_t _out = 0;
+  uint64_t _resumes = 0;
+  uint64_t _total = 0;
+  uint64_t _self = 0;
+  uint64_t _max = 0;
+  std::array<uint32_t, histogram::buckets> _counts{};
+};
+
+/**
+ *  \brief Times a single resume of an instrumented stage.
+ *
+ *  Scopes on a thread form a stack: a stage resumed while another one is being
+ * resumed is the other one's upstream. Its time is excluded from the other
+ * stage's self time, and each value it produces counts as an input of the
+ * other stage.
+ */
+class scope {
+public:
+  /**
+   *  \brief Starts timing a resume.
+   *  \param[in,out] counters The counters of the generator being resumed.
+   */
+  explicit scope(local_stage &counters)
+      : _counters{counters}, _parent{current()}, _start{clock::now()} {
+    current() = this;
+  }
+
+  scope(const scope &) = delete;
+  scope &operator=(const scope &) = delete;
+
+  /**
+   *  \brief Stops timing, and records the resume.
+   */
+  ~scope() {
+    uint64_t ticks = clock::now() - _start;
+    current() = _parent;
+    local_stage &c = _counters;
+    c._resumes++;
+    c._total += ticks;
+    c._self += ticks - std::min(ticks, _child);
+    if (_produced) {
+      c._out++;
+      c._counts[histogram::bucket(ticks)]++;
+      c._max = std::max(c._max, ticks);
+      if (_parent != nullptr)
+        _parent->_counters._in++;
+    }
+    if (_parent != nullptr)
+      _parent->_child += ticks;
+    registry &owner = c._stage._owner;
+    if (owner._tracing.load(std::memory_order_relaxed))
+      owner.record(c._stage, _start, ticks);
+    if (c._resumes == local_stage::publish_every)
+      c.publish();
+  }
+
+  /**
+   *  \brief Marks the resume as having produced a value.
+   */
+  void produced() { _produced = true; }
+
+private:
+  static scope *&current() {
+    thread_local scope *top = nullptr;
+    return top;
+  }
+
+  local_stage &_counters;
+  scope *_parent;
+  uint64_t _start;
+  uint64_t _child = 0;
+  bool _produced = false;
+};
+} // namespace fpgen::instrument
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+namespace detail {
+/**
+ *  \brief Forwards all values of a generator, timing each resume.
+ *  \tparam T The type of values in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator to instrument.
+ *  \param[in,out] s The stage to record in.
+ *  \returns A generator with the same values.
+ */
+template <typename T, typename P>
+generator<T, forward_policy<P, T>> instrumented_impl(generator<T, P> gen,
+                                                     instrument::stage &s) {
+  instrument::local_stage counters(s);
+  while (true) {
+    {
+      instrument::scope timed(counters);
+      if (!gen)
+        break;
+      timed.produced();
+    }
+    co_yield gen();
+  }
+  co_return;
+}
+} // namespace detail
+
+#ifdef FPGEN_NO_INSTRUMENTATION
+// a separate inline namespace, so translation units with and without
+// instrumentation can be linked together
+inline namespace instrumentation_off {
+/**
+ *  \brief Instrumentation is disabled (`FPGEN_NO_INSTRUMENTATION`): returns
+ * the generator itself.
+ *  \tparam T The type of values in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator.
+ *  \returns The generator.
+ */
+template <typename T, typename P>
+generator<T, detail::forward_policy<P, T>> instrumented(generator<T, P> gen,
+                                                        std::string_view) {
+  return gen;
+}
+
+/**
+ *  \brief Instrumentation is disabled (`FPGEN_NO_INSTRUMENTATION`): returns
+ * the generator itself.
+ *  \tparam T The type of values in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator.
+ *  \returns The generator.
+ */
+template <typename T, typename P>
+generator<T, detail::forward_policy<P, T>>
+instrumented(generator<T, P> gen, std::string_view, instrument::registry &) {
+  return gen;
+}
+} // namespace instrumentation_off
+#else
+inline namespace instrumentation_on {
+/**
+ *  \brief Instruments a pipeline stage.
+ *
+ *  The resulting generator yields the same values, and records in the registry
+ * (under the given name):
+ *  - the amount of values yielded, and of values taken from instrumented
+ * stages upstream;
+ *  - the amount of resumes, and the time spent in them (in total, and
+ * excluding instrumented stages upstream);
+ *  - a histogram of the time taken to produce each value (p50, p99, max).
+ *
+ *  Wrap each stage of interest, e.g.
+ * `instrumented(map(instrumented(from(v), "source"), f), "map")`. With
+ * `FPGEN_NO_INSTRUMENTATION` defined, this returns the generator unchanged.
+ *
+ *  \tparam T The type of values in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator (stage) to instrument.
+ *  \param[in] name The name of the stage.
+ *  \param[in,out] reg The registry to record in.
+ *  \returns A generator yielding the same values.
+ */
+template <typename T, typename P>
+generator<T, detail::forward_policy<P, T>>
+instrumented(generator<T, P> gen, std::string_view name,
+             instrument::registry &reg = instrument::registry::global()) {
+  return detail::instrumented_impl(std::move(gen), reg.get(std::string(name)));
+}
+} // namespace instrumentation_on
+#endif
+} // namespace fpgen
+
+#endif
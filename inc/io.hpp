@@ -0,0 +1,922 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        io.hpp
+// Purpose:     file, descriptor and stream I/O for fpgen (POSIX).
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_IO
+#define _FPGEN_IO
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <new>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "generator.hpp"
+#include "simd.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+/**
+ *  \brief Hints for the kernel on how a memory-mapped file will be read.
+ */
+struct mmap_options {
+  /**
+   *  \brief Whether the file is read front to back (`MADV_SEQUENTIAL`): the
+   * kernel reads ahead aggressively, and may drop pages soon after they're
+   * read.
+   */
+  bool sequential = true;
+  /**
+   *  \brief Whether to start reading the whole file right away
+   * (`MADV_WILLNEED`).
+   */
+  bool willneed = false;
+  /**
+   *  \brief Whether to read the whole file into memory while mapping it
+   * (`MAP_POPULATE`; Linux only). Avoids page faults, but delays the first
+   * value until all of the file is read.
+   */
+  bool populate = false;
+};
+
+namespace detail {
+/**
+ *  \brief Throws the error in `errno`.
+ *  \param[in] what The message for the exception.
+ */
+[[noreturn]] inline void throw_errno(const char *what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+/**
+ *  \brief A read-only memory-mapped file.
+ *
+ *  The file is mapped on construction and unmapped on destruction. Empty files
+ * aren't mapped at all.
+ */
+class mapped_file {
+public:
+  /**
+   *  \brief Maps a file.
+   *  \param[in] path The path to the file.
+   *  \param[in] options The hints for the kernel.
+   *  \throws std::system_error If the file can't be opened or mapped.
+   */
+  mapped_file(const std::string &path, const mmap_options &options) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      throw_errno("fpgen: can't open file");
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      close(fd);
+      throw_errno("fpgen: can't stat file");
+    }
+    _size = static_cast<size_t>(info.st_size);
+    if (_size == 0) {
+      close(fd);
+      return;
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (options.populate)
+      flags |= MAP_POPULATE;
+#endif
+    void *data = mmap(nullptr, _size, PROT_READ, flags, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (data == MAP_FAILED)
+      throw_errno("fpgen: can't map file");
+    _data = static_cast<const char *>(data);
+
+    // hints only: failing to apply them isn't an error
+    if (options.sequential)
+      madvise(data, _size, MADV_SEQUENTIAL);
+    if (options.willneed)
+      madvise(data, _size, MADV_WILLNEED);
+  }
+
+  mapped_file(const mapped_file &) = delete;
+  mapped_file &operator=(const mapped_file &) = delete;
+
+  /**
+   *  \brief Takes over another mapping.
+   *  \param[in,out] other The mapping to take over.
+   */
+  mapped_file(mapped_file &&other) noexcept
+      : _data{std::exchange(other._data, nullptr)},
+        _size{std::exchange(other._size, 0)} {}
+
+  /**
+   *  \brief Unmaps the file.
+   */
+  ~mapped_file() {
+    if (_data != nullptr)
+      munmap(const_cast<char *>(_data), _size);
+  }
+
+  /**
+   *  \brief Gets the contents of the file.
+   *  \returns A view on the mapped bytes.
+   */
+  std::span<const char> bytes() const { return {_data, _size}; }
+
+private:
+  const char *_data = nullptr;
+  size_t _size = 0;
+};
+
+/**
+ *  \brief Splits a mapped file in lines.
+ *  \param[in] file The mapped file; owned by the generator.
+ *  \returns A generator over views on each line.
+ */
+inline generator<std::string_view> mmap_lines(mapped_file file) {
+  std::span<const char> rest = file.bytes();
+  while (!rest.empty()) {
+    size_t end = simd::find(rest, '\n');
+    co_yield std::string_view(rest.data(), end);
+    rest = rest.subspan(std::min(end + 1, rest.size()));
+  }
+  co_return;
+}
+
+/**
+ *  \brief Reads from a file descriptor.
+ */
+struct fd_reader {
+  /**
+   *  \brief The file descriptor.
+   */
+  int fd;
+
+  /**
+   *  \brief Reads some bytes, retrying when interrupted.
+   *  \param[out] into The buffer to read into.
+   *  \param[in] size The size of the buffer.
+   *  \returns The amount of bytes read; `0` at the end of the input.
+   *  \throws std::system_error If reading fails.
+   */
+  size_t operator()(char *into, size_t size) const {
+    while (true) {
+      ssize_t got = read(fd, into, size);
+      if (got >= 0)
+        return static_cast<size_t>(got);
+      if (errno != EINTR)
+        throw_errno("fpgen: can't read from file descriptor");
+    }
+  }
+};
+
+/**
+ *  \brief Reads from an input stream, directly through its stream buffer.
+ */
+struct stream_reader {
+  /**
+   *  \brief The stream.
+   */
+  std::istream *stream;
+
+  /**
+   *  \brief Reads some bytes; sets `eofbit` on the stream once it's empty.
+   *  \param[out] into The buffer to read into.
+   *  \param[in] size The size of the buffer.
+   *  \returns The amount of bytes read; `0` at the end of the input.
+   */
+  size_t operator()(char *into, size_t size) const {
+    std::streambuf *buffer = stream->rdbuf();
+    std::streamsize got =
+        buffer ? buffer->sgetn(into, static_cast<std::streamsize>(size)) : 0;
+    if (got <= 0) {
+      stream->setstate(std::ios::eofbit);
+      return 0;
+    }
+    return static_cast<size_t>(got);
+  }
+};
+
+/**
+ *  \brief Reads blocks into a reusable buffer, and yields views on them.
+ *  \tparam Reader The reader type; `(char *, size_t) -> size_t`.
+ *  \param[in] reader The reader.
+ *  \param[in] block_size The size of each read.
+ *  \returns A generator over the blocks.
+ */
+template <typename Reader>
+generator<std::string_view> read_blocks(Reader reader, size_t block_size) {
+  std::vector<char> buffer(std::max<size_t>(block_size, 1));
+  while (size_t got = reader(buffer.data(), buffer.size())) {
+    co_yield std::string_view(buffer.data(), got);
+  }
+  co_return;
+}
+
+/**
+ *  \brief Reads blocks into a reusable buffer, and yields views on each
+ * delimited record in them.
+ *
+ *  A record spanning two blocks is moved to the front of the buffer before
+ * the next block is read behind it; the buffer grows if a single record
+ * doesn't fit.
+ *
+ *  \tparam Reader The reader type; `(char *, size_t) -> size_t`.
+ *  \param[in] reader The reader.
+ *  \param[in] block_size The size of each read.
+ *  \param[in] delimiter The character ending each record.
+ *  \returns A generator over the records (without their delimiters).
+ */
+template <typename Reader>
+generator<std::string_view> read_records(Reader reader, size_t block_size,
+                                         char delimiter) {
+  std::vector<char> buffer(std::max<size_t>(block_size, 1));
+  size_t begin = 0;   // start of the current record
+  size_t scanned = 0; // end of the part already searched for a delimiter
+  size_t end = 0;     // end of the data read so far
+  while (true) {
+    std::span<const char> unscanned(buffer.data() + scanned, end - scanned);
+    size_t at = simd::find(unscanned, delimiter);
+    if (at < unscanned.size()) {
+      co_yield std::string_view(buffer.data() + begin, scanned + at - begin);
+      begin = scanned = scanned + at + 1;
+      continue;
+    }
+    scanned = end;
+
+    // make room behind the current record
+    if (begin > 0) {
+      std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+      end -= begin;
+      scanned -= begin;
+      begin = 0;
+    }
+    if (end == buffer.size())
+      buffer.resize(buffer.size() * 2);
+    size_t got = reader(buffer.data() + end, buffer.size() - end);
+    if (got == 0)
+      break;
+    end += got;
+  }
+  if (end > begin)
+    co_yield std::string_view(buffer.data() + begin, end - begin);
+  co_return;
+}
+
+/**
+ *  \brief The alignment of the buffers used for binary I/O; enough for
+ * `O_DIRECT`.
+ */
+constexpr size_t io_alignment = 4096;
+
+/**
+ *  \brief Rounds a size up to a multiple of an alignment.
+ *  \param[in] size The size.
+ *  \param[in] align The alignment.
+ *  \returns The rounded size.
+ */
+constexpr size_t io_round_up(size_t size, size_t align) {
+  return (size + align - 1) / align * align;
+}
+
+/**
+ *  \brief An owned file descriptor, closed on destruction.
+ */
+class unique_fd {
+public:
+  /**
+   *  \brief Takes ownership of a file descriptor.
+   *  \param[in] fd The file descriptor, or `-1` for none.
+   */
+  explicit unique_fd(int fd = -1) : _fd{fd} {}
+
+  unique_fd(const unique_fd &) = delete;
+  unique_fd &operator=(const unique_fd &) = delete;
+
+  /**
+   *  \brief Takes over another file descriptor.
+   *  \param[in,out] other The file descriptor to take over.
+   */
+  unique_fd(unique_fd &&other) noexcept : _fd{std::exchange(other._fd, -1)} {}
+
+  /**
+   *  \brief Closes the file descriptor.
+   */
+  ~unique_fd() {
+    if (_fd >= 0)
+      close(_fd);
+  }
+
+  /**
+   *  \brief Gets the file descriptor.
+   *  \returns The file descriptor.
+   */
+  int get() const { return _fd; }
+
+private:
+  int _fd;
+};
+
+/**
+ *  \brief A buffer aligned to fpgen::detail::io_alignment.
+ */
+class aligned_buffer {
+public:
+  /**
+   *  \brief Allocates a buffer.
+   *  \param[in] size The size of the buffer.
+   */
+  explicit aligned_buffer(size_t size)
+      : _data{static_cast<char *>(
+            ::operator new(size, std::align_val_t{io_alignment}))},
+        _size{size} {}
+
+  aligned_buffer(const aligned_buffer &) = delete;
+  aligned_buffer &operator=(const aligned_buffer &) = delete;
+
+  /**
+   *  \brief Frees the buffer.
+   */
+  ~aligned_buffer() {
+    ::operator delete(_data, std::align_val_t{io_alignment});
+  }
+
+  /**
+   *  \brief Gets the buffer.
+   *  \returns A pointer to the first byte.
+   */
+  char *data() const { return _data; }
+
+  /**
+   *  \brief Gets the size of the buffer.
+   *  \returns The size.
+   */
+  size_t size() const { return _size; }
+
+private:
+  char *_data;
+  size_t _size;
+};
+
+/**
+ *  \brief Opens a file, with `O_DIRECT` if requested and supported.
+ *
+ *  If the file system refuses `O_DIRECT`, the file is opened without it.
+ *
+ *  \param[in] path The path to the file.
+ *  \param[in] flags The flags for `open(2)`.
+ *  \param[in] direct Whether to bypass the page cache.
+ *  \returns The file descriptor.
+ *  \throws std::system_error If the file can't be opened.
+ */
+inline unique_fd open_file(const std::string &path, int flags, bool direct) {
+#ifdef O_DIRECT
+  if (direct) {
+    int fd = open(path.c_str(), flags | O_DIRECT | O_CLOEXEC, 0644);
+    if (fd >= 0)
+      return unique_fd(fd);
+    if (errno != EINVAL)
+      throw_errno("fpgen: can't open file");
+  }
+#endif
+  int fd = open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (fd < 0)
+    throw_errno("fpgen: can't open file");
+  return unique_fd(fd);
+}
+
+/**
+ *  \brief Reads fixed-size records from a file descriptor.
+ *
+ *  Blocks are read into an aligned buffer. The bytes of a record spanning two
+ * blocks are moved to just before the buffer (into a reserved area), so the
+ * next read still goes to an aligned address.
+ *
+ *  \tparam T The record type.
+ *  \param[in] reader The reader.
+ *  \param[in] block_size The size of each read.
+ *  \param[in] owned The file descriptor to close afterwards (if any).
+ *  \returns A generator over the records.
+ */
+template <typename T>
+generator<T> read_binary(fd_reader reader, size_t block_size,
+                         [[maybe_unused]] unique_fd owned) {
+  // owned is never read: as a parameter, it lives in the coroutine frame, so
+  // the descriptor the reader uses is closed when the generator is destroyed
+  size_t carry = io_round_up(sizeof(T), io_alignment);
+  size_t block = io_round_up(std::max(block_size, sizeof(T)), io_alignment);
+  aligned_buffer buffer(carry + block);
+  char *start = buffer.data() + carry;
+  size_t left = 0; // the bytes of a partial record, just before start
+  while (size_t got = reader(start, block)) {
+    const char *at = start - left;
+    const char *end = start + got;
+    while (static_cast<size_t>(end - at) >= sizeof(T)) {
+      T value;
+      std::memcpy(static_cast<void *>(&value), at, sizeof(T));
+      at += sizeof(T);
+      co_yield std::move(value);
+    }
+    left = static_cast<size_t>(end - at);
+    std::memmove(start - left, at, left);
+  }
+  co_return;
+}
+
+/**
+ *  \brief Reads fixed-size records from a mapped file.
+ *  \tparam T The record type.
+ *  \param[in] file The mapped file; owned by the generator.
+ *  \returns A generator over the records.
+ */
+template <typename T> generator<T> mapped_records(mapped_file file) {
+  std::span<const char> bytes = file.bytes();
+  for (size_t at = 0; at + sizeof(T) <= bytes.size(); at += sizeof(T)) {
+    T value;
+    std::memcpy(static_cast<void *>(&value), bytes.data() + at, sizeof(T));
+    co_yield std::move(value);
+  }
+  co_return;
+}
+
+/**
+ *  \brief Writes all bytes to a file descriptor, retrying partial writes.
+ *  \param[in] fd The file descriptor.
+ *  \param[in] data The bytes.
+ *  \param[in] size The amount of bytes.
+ *  \throws std::system_error If writing fails.
+ */
+inline void write_all(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t done = write(fd, data, size);
+    if (done < 0) {
+      if (errno == EINTR)
+        continue;
+      throw_errno("fpgen: can't write to file descriptor");
+    }
+    data += done;
+    size -= static_cast<size_t>(done);
+  }
+}
+
+/**
+ *  \brief Writes two byte ranges to a file descriptor with as few system calls
+ * as possible (`writev(2)`), retrying partial writes.
+ *  \param[in] fd The file descriptor.
+ *  \param[in] first The first range.
+ *  \param[in] second The second range, written right after the first.
+ *  \throws std::system_error If writing fails.
+ */
+inline void write_vectored(int fd, std::string_view first,
+                           std::string_view second) {
+  while (!first.empty()) {
+    iovec parts[2] = {{const_cast<char *>(first.data()), first.size()},
+                      {const_cast<char *>(second.data()), second.size()}};
+    ssize_t done = writev(fd, parts, 2);
+    if (done < 0) {
+      if (errno == EINTR)
+        continue;
+      throw_errno("fpgen: can't write to file descriptor");
+    }
+    size_t in_first = std::min(first.size(), static_cast<size_t>(done));
+    first.remove_prefix(in_first);
+    second.remove_prefix(static_cast<size_t>(done) - in_first);
+  }
+  write_all(fd, second.data(), second.size());
+}
+
+/**
+ *  \brief Writes bytes to a file descriptor in large blocks.
+ *
+ *  The buffer is aligned, and all blocks but the last one are full, so this
+ * works for descriptors opened with `O_DIRECT` too (which is dropped while
+ * writing the last, partial block, and restored afterwards).
+ */
+class block_writer {
+public:
+  /**
+   *  \brief Creates a new writer.
+   *  \param[in] fd The file descriptor.
+   *  \param[in] block_size The size of each write.
+   */
+  block_writer(int fd, size_t block_size)
+      : _fd{fd}, _buffer{io_round_up(std::max<size_t>(block_size, 1),
+                                     io_alignment)} {}
+
+  /**
+   *  \brief Appends bytes, writing out each full block.
+   *  \param[in] data The bytes.
+   *  \param[in] size The amount of bytes.
+   *  \throws std::system_error If writing fails.
+   */
+  void append(const char *data, size_t size) {
+    while (size > 0) {
+      size_t part = std::min(size, _buffer.size() - _used);
+      std::memcpy(_buffer.data() + _used, data, part);
+      _used += part;
+      data += part;
+      size -= part;
+      if (_used == _buffer.size()) {
+        write_all(_fd, _buffer.data(), _used);
+        _used = 0;
+      }
+    }
+  }
+
+  /**
+   *  \brief Writes out the last, partial block.
+   *  \throws std::system_error If writing fails.
+   */
+  void finish() {
+#ifdef O_DIRECT
+    // restores the descriptor's flags afterwards (even if writing fails)
+    struct flag_guard {
+      int fd;
+      int flags = -1;
+      ~flag_guard() {
+        if (flags >= 0)
+          fcntl(fd, F_SETFL, flags);
+      }
+    } guard{_fd};
+    if (_used % io_alignment != 0) {
+      int flags = fcntl(_fd, F_GETFL);
+      if (flags >= 0 && (flags & O_DIRECT) != 0 &&
+          fcntl(_fd, F_SETFL, flags & ~O_DIRECT) == 0)
+        guard.flags = flags;
+    }
+#endif
+    write_all(_fd, _buffer.data(), _used);
+    _used = 0;
+  }
+
+private:
+  int _fd;
+  aligned_buffer _buffer;
+  size_t _used = 0;
+};
+
+/**
+ *  \brief Writes bytes to a file through a sliding memory-mapped window.
+ *
+ *  The file is grown one window at a time, and truncated to the written size
+ * once finished.
+ */
+class mapped_writer {
+public:
+  /**
+   *  \brief Creates a new writer.
+   *  \param[in] fd The file descriptor (opened for reading and writing).
+   *  \param[in] window_size The size of each mapped window.
+   */
+  mapped_writer(int fd, size_t window_size)
+      : _fd{fd}, _window{io_round_up(
+                     std::max<size_t>(window_size, 1),
+                     static_cast<size_t>(sysconf(_SC_PAGESIZE)))} {}
+
+  mapped_writer(const mapped_writer &) = delete;
+  mapped_writer &operator=(const mapped_writer &) = delete;
+
+  /**
+   *  \brief Unmaps the current window.
+   */
+  ~mapped_writer() { unmap(); }
+
+  /**
+   *  \brief Appends bytes, moving the window as it fills up.
+   *  \param[in] data The bytes.
+   *  \param[in] size The amount of bytes.
+   *  \throws std::system_error If the file can't be grown or mapped.
+   */
+  void append(const char *data, size_t size) {
+    while (size > 0) {
+      if (_data == nullptr || _used == _window)
+        next_window();
+      size_t part = std::min(size, _window - _used);
+      std::memcpy(_data + _used, data, part);
+      _used += part;
+      data += part;
+      size -= part;
+    }
+  }
+
+  /**
+   *  \brief Unmaps the last window and truncates the file to its contents.
+   *  \throws std::system_error If the file can't be truncated.
+   */
+  void finish() {
+    size_t total = _offset + _used;
+    unmap();
+    if (ftruncate(_fd, static_cast<off_t>(total)) != 0)
+      throw_errno("fpgen: can't truncate file");
+  }
+
+private:
+  void next_window() {
+    if (_data != nullptr) {
+      unmap();
+      _offset += _window;
+    }
+    _used = 0;
+    if (ftruncate(_fd, static_cast<off_t>(_offset + _window)) != 0)
+      throw_errno("fpgen: can't grow file");
+    void *data = mmap(nullptr, _window, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      _fd, static_cast<off_t>(_offset));
+    if (data == MAP_FAILED)
+      throw_errno("fpgen: can't map file");
+    _data = static_cast<char *>(data);
+  }
+
+  void unmap() {
+    if (_data != nullptr)
+      munmap(_data, _window);
+    _data = nullptr;
+  }
+
+  int _fd;
+  size_t _window;
+  char *_data = nullptr;
+  size_t _offset = 0;
+  size_t _used = 0;
+};
+
+/**
+ *  \brief Writes each value in a generator as raw bytes.
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \tparam Writer The writer type (fpgen::detail::block_writer or
+ * fpgen::detail::mapped_writer).
+ *  \param[in,out] gen The generator.
+ *  \param[in,out] writer The writer.
+ *  \returns The amount of values written.
+ */
+template <typename T, typename P, typename Writer>
+size_t write_records(generator<T, P> &gen, Writer &writer) {
+  using TVal = std::remove_cvref_t<T>;
+  size_t count = 0;
+  for (auto &&value : gen) {
+    writer.append(reinterpret_cast<const char *>(std::addressof(value)),
+                  sizeof(TVal));
+    count++;
+  }
+  writer.finish();
+  return count;
+}
+} // namespace detail
+
+/**
+ *  \brief Creates a generator over the lines in a file, without copying them.
+ *
+ *  The file is mapped into memory (see `mmap(2)`), and each line is yielded
+ * as a view on the mapped bytes; lines are found using fpgen::simd::find. The
+ * views stay valid until the generator is destroyed, and don't include the
+ * `'\n'` (a `'\r'` before it is kept). Unlike fpgen::from_lines, a newline at
+ * the very end of the file doesn't produce an empty last line. The file
+ * shouldn't be truncated while the generator is in use.
+ *
+ *  \param[in] path The path to the file.
+ *  \param[in] options Hints for the kernel on how the file will be read.
+ *  \returns A new generator over the lines in the file.
+ *  \throws std::system_error If the file can't be opened or mapped (right
+ * away, not once the generator is first used).
+ */
+inline generator<std::string_view>
+from_mmap_lines(const std::string &path, mmap_options options = {}) {
+  return detail::mmap_lines(detail::mapped_file(path, options));
+}
+
+/**
+ *  \brief Creates a generator over the lines read from a file descriptor.
+ *
+ *  The descriptor is read in blocks of `block_size` bytes into a buffer which
+ * is reused for the whole input, and each line is yielded as a view on that
+ * buffer; lines are found using fpgen::simd::find. A view is only valid until
+ * the generator is resumed. Lines spanning two blocks are handled (the buffer
+ * grows for lines longer than a block). Like fpgen::from_mmap_lines, lines
+ * don't include the delimiter, and a delimiter at the very end of the input
+ * doesn't produce an empty last line. The descriptor isn't closed.
+ *
+ *  \param[in] fd The file descriptor (a file, pipe, socket, ...; `0` for
+ * standard input).
+ *  \param[in] block_size The size of each read.
+ *  \param[in] delimiter The character ending each line (or record).
+ *  \returns A new generator over the lines.
+ *  \throws std::system_error When resumed, if reading fails.
+ */
+inline generator<std::string_view> from_fd_lines(int fd,
+                                                 size_t block_size = 1 << 16,
+                                                 char delimiter = '\n') {
+  return detail::read_records(detail::fd_reader{fd}, block_size, delimiter);
+}
+
+/**
+ *  \brief Creates a generator over the lines read from an input stream.
+ *
+ *  Like fpgen::from_fd_lines, but reads directly from the stream's buffer
+ * (`std::streambuf::sgetn`), without the per-line checks and allocations of
+ * fpgen::from_lines. Once the stream is empty, its `eofbit` is set. The
+ * stream should outlive the generator.
+ *
+ *  \param[in,out] stream The stream to read from.
+ *  \param[in] block_size The size of each read.
+ *  \param[in] delimiter The character ending each line (or record).
+ *  \returns A new generator over the lines.
+ */
+inline generator<std::string_view>
+from_istream_lines(std::istream &stream, size_t block_size = 1 << 16,
+                   char delimiter = '\n') {
+  return detail::read_records(detail::stream_reader{&stream}, block_size,
+                              delimiter);
+}
+
+/**
+ *  \brief Creates a generator over the raw blocks read from a file descriptor.
+ *
+ *  Each block is a view on a buffer which is reused for the whole input, so
+ * it's only valid until the generator is resumed. Blocks hold at most
+ * `block_size` bytes (fewer if a read returns less, like for pipes). The
+ * descriptor isn't closed.
+ *
+ *  \param[in] fd The file descriptor.
+ *  \param[in] block_size The maximal size of each block.
+ *  \returns A new generator over the blocks.
+ *  \throws std::system_error When resumed, if reading fails.
+ */
+inline generator<std::string_view> from_fd_chunks(int fd,
+                                                  size_t block_size = 1 << 16) {
+  return detail::read_blocks(detail::fd_reader{fd}, block_size);
+}
+
+/**
+ *  \brief Creates a generator over the raw blocks read from an input stream.
+ *
+ *  Like fpgen::from_fd_chunks, reading directly from the stream's buffer. Once
+ * the stream is empty, its `eofbit` is set. The stream should outlive the
+ * generator.
+ *
+ *  \param[in,out] stream The stream to read from.
+ *  \param[in] block_size The maximal size of each block.
+ *  \returns A new generator over the blocks.
+ */
+inline generator<std::string_view>
+from_istream_chunks(std::istream &stream, size_t block_size = 1 << 16) {
+  return detail::read_blocks(detail::stream_reader{&stream}, block_size);
+}
+
+/**
+ *  \brief The ways to access a file for fpgen::from_binary and
+ * fpgen::to_binary.
+ */
+enum class io_mode {
+  /**
+   *  \brief Large reads or writes through the page cache.
+   */
+  buffered,
+  /**
+   *  \brief Memory-mapped access; no system call per block.
+   */
+  mmap,
+  /**
+   *  \brief Large reads or writes bypassing the page cache (`O_DIRECT`), for
+   * spilling streams too large to cache. Falls back to `buffered` where
+   * `O_DIRECT` isn't supported.
+   */
+  direct
+};
+
+/**
+ *  \brief Creates a generator over fixed-size binary records read from a file
+ * descriptor.
+ *
+ *  The descriptor is read in large blocks (into an aligned buffer, so it may
+ * be opened with `O_DIRECT`), and each record is copied out of the block.
+ * Records spanning two blocks are handled; trailing bytes not forming a whole
+ * record are ignored. The descriptor isn't closed.
+ *
+ *  \tparam T The record type; trivially copyable and default-constructible.
+ *  \param[in] fd The file descriptor.
+ *  \param[in] block_size The size of each read (rounded up to a multiple of
+ * 4096).
+ *  \returns A new generator over the records.
+ *  \throws std::system_error When resumed, if reading fails.
+ */
+template <typename T>
+generator<T> from_binary(int fd, size_t block_size = 1 << 20) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "fpgen::from_binary requires trivially copyable records");
+  static_assert(std::is_default_constructible_v<T>,
+                "fpgen::from_binary requires default-constructible records");
+  return detail::read_binary<T>(detail::fd_reader{fd}, block_size,
+                                detail::unique_fd{});
+}
+
+/**
+ *  \brief Creates a generator over fixed-size binary records read from a
+ * file.
+ *
+ *  See `fpgen::from_binary(fd, block_size)`. The file is opened right away,
+ * and closed once the generator is destroyed.
+ *
+ *  \tparam T The record type; trivially copyable and default-constructible.
+ *  \param[in] path The path to the file.
+ *  \param[in] mode How to read the file.
+ *  \param[in] block_size The size of each read (unused for `io_mode::mmap`).
+ *  \returns A new generator over the records.
+ *  \throws std::system_error If the file can't be opened (or mapped).
+ */
+template <typename T>
+generator<T> from_binary(const std::string &path,
+                         io_mode mode = io_mode::buffered,
+                         size_t block_size = 1 << 20) {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "fpgen::from_binary requires trivially copyable records");
+  static_assert(std::is_default_constructible_v<T>,
+                "fpgen::from_binary requires default-constructible records");
+  if (mode == io_mode::mmap)
+    return detail::mapped_records<T>(detail::mapped_file(path, {}));
+  detail::unique_fd fd =
+      detail::open_file(path, O_RDONLY, mode == io_mode::direct);
+  int raw = fd.get();
+  return detail::read_binary<T>(detail::fd_reader{raw}, block_size,
+                                std::move(fd));
+}
+
+/**
+ *  \brief Writes each value in a generator as a fixed-size binary record to a
+ * file descriptor.
+ *
+ *  Values are copied into an aligned buffer, which is written once it's full
+ * (so the descriptor may be opened with `O_DIRECT`; that flag is cleared
+ * while writing the last, partial block, and restored afterwards, which
+ * briefly changes it for every descriptor sharing the open file). The
+ * descriptor isn't closed. Read the records back using fpgen::from_binary.
+ *
+ *  \tparam T The type contained in the generator; its value type should be
+ * trivially copyable.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator to write.
+ *  \param[in] fd The file descriptor.
+ *  \param[in] block_size The size of each write (rounded up to a multiple of
+ * 4096).
+ *  \returns The amount of records written.
+ *  \throws std::system_error If writing fails.
+ */
+template <typename T, typename P>
+size_t to_binary(generator<T, P> gen, int fd, size_t block_size = 1 << 20) {
+  static_assert(std::is_trivially_copyable_v<std::remove_cvref_t<T>>,
+                "fpgen::to_binary requires trivially copyable records");
+  detail::block_writer writer(fd, block_size);
+  return detail::write_records(gen, writer);
+}
+
+/**
+ *  \brief Writes each value in a generator as a fixed-size binary record to a
+ * file.
+ *
+ *  See `fpgen::to_binary(gen, fd, block_size)`. The file is created (or
+ * truncated) first.
+ *
+ *  \tparam T The type contained in the generator; its value type should be
+ * trivially copyable.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator to write.
+ *  \param[in] path The path to the file.
+ *  \param[in] mode How to write the file.
+ *  \param[in] block_size The size of each write (or mapped window).
+ *  \returns The amount of records written.
+ *  \throws std::system_error If the file can't be opened or written.
+ */
+template <typename T, typename P>
+size_t to_binary(generator<T, P> gen, const std::string &path,
+                 io_mode mode = io_mode::buffered,
+                 size_t block_size = 1 << 20) {
+  static_assert(std::is_trivially_copyable_v<std::remove_cvref_t<T>>,
+                "fpgen::to_binary requires trivially copyable records");
+  if (mode == io_mode::mmap) {
+    detail::unique_fd fd =
+        detail::open_file(path, O_RDWR | O_CREAT | O_TRUNC, false);
+    detail::mapped_writer writer(fd.get(), block_size);
+    return detail::write_records(gen, writer);
+  }
+  detail::unique_fd fd = detail::open_file(
+      path, O_WRONLY | O_CREAT | O_TRUNC, mode == io_mode::direct);
+  detail::block_writer writer(fd.get(), block_size);
+  return detail::write_records(gen, writer);
+}
+} // namespace fpgen
+
+#endif
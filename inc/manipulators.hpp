@@ -11,6 +11,7 @@
 #include <array>
 #include <type_traits>
 #include <tuple>
+#include <utility>
 #include "generator.hpp"
 #include "type_traits.hpp"
 
@@ -18,14 +19,126 @@
  *  \brief The namespace containing all of fpgen's code.
  */
 namespace fpgen {
+namespace detail {
+/**
+ *  \brief The exception policy for a generator calling a function on the
+ * values of another.
+ *  \tparam P The exception policy of the source generator.
+ *  \tparam Fun The function type.
+ *  \tparam TIn The argument type for the function.
+ */
+template <typename P, typename Fun, typename TIn>
+using call_policy = policy_for<P, std::is_nothrow_invocable_v<Fun &, TIn> &&
+                                      is_nothrow_take<TIn>::value>;
+
+/**
+ *  \brief The exception policy for a generator passing on the values of another
+ * which satisfy a predicate.
+ *  \tparam P The exception policy of the source generator.
+ *  \tparam Pred The predicate type.
+ *  \tparam T The type contained in the source generator.
+ */
+template <typename P, typename Pred, typename T>
+using test_policy =
+    policy_for<P, std::is_nothrow_invocable_v<Pred &, T &> &&
+                      std::is_nothrow_constructible_v<T, T &&>>;
+
+/**
+ *  \brief Yields the result of a function for each value in a generator.
+ *  \tparam TOut The output type.
+ *  \tparam Policy The exception policy of the result.
+ *  \tparam TIn The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \tparam Fun The mapping function type.
+ *  \param[in,out] gen The generator to map over.
+ *  \param[in] func The function to map with.
+ *  \returns A generator over the mapped values.
+ */
+template <typename TOut, typename Policy, typename TIn, typename P,
+          typename Fun>
+generator<TOut, Policy> map_impl(generator<TIn, P> gen, Fun func) {
+  while (gen) {
+    co_yield func(gen());
+  }
+  co_return;
+}
+
+/**
+ *  \brief Yields pairs of values from two generators.
+ *  \tparam T1 The type contained in the first generator.
+ *  \tparam P1 The exception policy of the first generator.
+ *  \tparam T2 The type contained in the second generator.
+ *  \tparam P2 The exception policy of the second generator.
+ *  \param[in,out] gen1 The first generator.
+ *  \param[in,out] gen2 The second generator.
+ *  \returns A generator over the pairs.
+ */
+template <typename T1, typename P1, typename T2, typename P2>
+generator<std::tuple<T1, T2>,
+          policy_for<P1, std::is_same_v<P2, nothrow_policy> &&
+                             std::is_nothrow_constructible_v<
+                                 std::tuple<T1, T2>, T1 &&, T2 &&>>>
+zip_impl(generator<T1, P1> gen1, generator<T2, P2> gen2) {
+  while (gen1 && gen2) {
+    co_yield {gen1(), gen2()};
+  }
+  co_return;
+}
+
+/**
+ *  \brief Skips the first values of a generator, then yields the rest.
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator.
+ *  \param[in] count The amount of values to skip.
+ *  \returns A generator over the remaining values.
+ */
+template <typename T, typename P>
+generator<T, forward_policy<P, T>> drop_impl(generator<T, P> gen,
+                                             size_t count) {
+  for (size_t i = 0; i < count && gen; i++) {
+    gen();
+  }
+
+  while (gen) {
+    co_yield gen();
+  }
+  co_return;
+}
+
+/**
+ *  \brief Yields the first values of a generator.
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator.
+ *  \param[in] count The amount of values to yield.
+ *  \returns A generator over the first values.
+ */
+template <typename T, typename P>
+generator<T, forward_policy<P, T>> take_impl(generator<T, P> gen,
+                                             size_t count) {
+  for (size_t i = 0; i < count && gen; i++) {
+    co_yield gen();
+  }
+  // free the source now instead of when the resulting generator is destroyed
+  { generator<T, P> done(std::move(gen)); }
+  co_return;
+}
+} // namespace detail
+
 /**
  *  \brief Maps a function over a generator.
  *
  *  Creates a new generator whose values are the transformed values generated by
  * applying the given mapping function on each value in the original generator.
  * Using the provided generator after calling fpgen::map is undefined behaviour.
+ * The new generator has the same size hint (see fpgen::size_hint). It doesn't
+ * throw (see fpgen::nothrow_policy) if the original generator doesn't, the
+ * function is `noexcept`, and the original values can be moved without
+ * throwing.
  *
  *  \tparam TIn The type contained in the provided generator.
+ *  \tparam P The exception policy of the provided generator.
  *  \tparam Fun The function signature of the mapping function.
  *  \tparam TOut The output type. This type is deduced from the `Fun` type
  * parameter.
@@ -35,13 +148,47 @@ namespace fpgen {
  *  \returns A new generator whose contained type is the return type of the
  * mapping function.
  */
-template <typename TIn, typename Fun,
-          typename TOut = type::output_type<Fun, TIn>,
-          typename _ = type::is_function_to<Fun, TOut, TIn>>
-auto map(generator<TIn> gen, Fun func)
-    -> generator<typename std::invoke_result<Fun, TIn>::type> {
+template <typename TIn, typename P, typename Fun,
+          typename TOut = type::output_type<Fun, TIn>>
+  requires type::function_to<Fun, TOut, TIn>
+auto map(generator<TIn, P> gen, Fun func)
+    -> generator<TOut, detail::call_policy<P, Fun, TIn>> {
+  size_hint hint = gen.hint();
+  auto mapped = detail::map_impl<TOut, detail::call_policy<P, Fun, TIn>>(
+      std::move(gen), std::move(func));
+  mapped.set_hint(hint);
+  return mapped;
+}
+
+/**
+ *  \brief Maps a generator-returning function over a generator and flattens
+ * the result.
+ *
+ *  Each value in the original generator is passed to the function, and all
+ * values in the generator it returns are yielded in turn. The inner generators
+ * are run through fpgen::elements_of, so they are resumed directly by the
+ * consumer. Using the provided generator after calling fpgen::flat_map is
+ * undefined behaviour.
+ *
+ *  \tparam TIn The type contained in the provided generator.
+ *  \tparam P The exception policy of the provided generator.
+ *  \tparam Fun The function signature of the mapping function.
+ *  \tparam TGen The generator type returned by the mapping function. This
+ * type is deduced from the `Fun` type parameter.
+ *  \param[in,out] gen The generator to map over. Will be in unusable state
+ * afterwards.
+ *  \param[in] func The function to map with.
+ *  \returns A new generator containing the values of all generated
+ * generators.
+ */
+template <typename TIn, typename P, typename Fun,
+          typename TGen = type::output_type<Fun, TIn>>
+  requires type::function_to<Fun, TGen, TIn>
+auto flat_map(generator<TIn, P> gen, Fun func)
+    -> generator<typename TGen::value_type> {
+  using gen_type = generator<typename TGen::value_type>;
   while (gen) {
-    co_yield func(gen());
+    co_yield elements_of(gen_type(func(gen())));
   }
   co_return;
 }
@@ -51,20 +198,23 @@ auto map(generator<TIn> gen, Fun func)
  *
  *  The result is a tuple of values, one taken from each generator. Once one of
  * the generators runs out of values, the newly generator stops as well. Using
- * either generator after calling this function is undefined behaviour.
+ * either generator after calling this function is undefined behaviour. The
+ * size hint of the new generator is that of the shortest generator.
  *
  *  \tparam T1 The type contained in the first generator.
+ *  \tparam P1 The exception policy of the first generator.
  *  \tparam T2 The type contained in the second generator.
+ *  \tparam P2 The exception policy of the second generator.
  *  \param[in, out] gen1 The first generator to use.
  *  \param[in, out] gen2 The second generator to use.
  *  \returns A new generator containing tuples of values from both generators.
  */
-template <typename T1, typename T2>
-generator<std::tuple<T1, T2>> zip(generator<T1> gen1, generator<T2> gen2) {
-  while (gen1 && gen2) {
-    co_yield {gen1(), gen2()};
-  }
-  co_return;
+template <typename T1, typename P1, typename T2, typename P2>
+auto zip(generator<T1, P1> gen1, generator<T2, P2> gen2) {
+  size_hint hint = gen1.hint().shortest(gen2.hint());
+  auto zipped = detail::zip_impl(std::move(gen1), std::move(gen2));
+  zipped.set_hint(hint);
+  return zipped;
 }
 
 /**
@@ -72,9 +222,12 @@ generator<std::tuple<T1, T2>> zip(generator<T1> gen1, generator<T2> gen2) {
  *
  *  The result is a generator with as much or possibly fewer elements. Each
  * element is an element in the original generator. Elements not matching the
- * predicate are removed.
+ * predicate are removed. Filtering a reference generator yields the original
+ * objects, without copies (the same goes for fpgen::drop, fpgen::take,
+ * fpgen::drop_while and fpgen::take_while).
  *
  *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
  *  \tparam Pred The function type of the predicate function. Should return a
  * bool.
  *  \param[in,out] gen The generator containing the original values.
@@ -82,12 +235,14 @@ generator<std::tuple<T1, T2>> zip(generator<T1> gen1, generator<T2> gen2) {
  *  \returns A new generator which yields all values in the original generator
  * except those not matching the predicate.
  */
-template <typename T, typename Pred, typename _ = type::is_predicate<Pred, T>>
-generator<T> filter(generator<T> gen, Pred p) {
+template <typename T, typename P, typename Pred>
+  requires type::predicate_for<Pred, T>
+generator<T, detail::test_policy<P, Pred, T>> filter(generator<T, P> gen,
+                                                     Pred p) {
   while (gen) {
     T val(gen());
     if (p(val))
-      co_yield val;
+      co_yield std::forward<T>(val);
   }
   co_return;
 }
@@ -98,22 +253,28 @@ generator<T> filter(generator<T> gen, Pred p) {
  *  Extracts the first `count` elements from the generator and throws those
  * away. All subsequent elements in the generator are passed through as normal.
  * If there aren't enough elements in the original generator, an empty generator
- * is returned.
+ * is returned. The size hint of the original generator is reduced by `count`.
+ * Seekable generators (see fpgen::generator::seekable) skip the elements
+ * without generating them, and are returned themselves.
  *
  *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
  *  \param[in,out] gen The generator to drop from.
  *  \param[in] count The amount of elements to ignore.
  *  \returns A new generator yielding all values except the first n.
  */
-template <typename T> generator<T> drop(generator<T> gen, size_t count) {
-  for (size_t i = 0; i < count && gen; i++) {
-    gen();
-  }
-
-  while (gen) {
-    co_yield gen();
+template <typename T, typename P>
+generator<T, detail::forward_policy<P, T>> drop(generator<T, P> gen,
+                                                size_t count) {
+  if (gen.seekable()) {
+    gen.seek(count);
+    return gen;
   }
-  co_return;
+  size_hint hint = gen.hint().skip(count);
+  generator<T, detail::forward_policy<P, T>> dropped =
+      detail::drop_impl(std::move(gen), count);
+  dropped.set_hint(hint);
+  return dropped;
 }
 
 /**
@@ -122,18 +283,51 @@ template <typename T> generator<T> drop(generator<T> gen, size_t count) {
  *  Extracts and yields exactly `count` elements (or less if the generator
  * doesn't contain that much values). The iteration is then stopped and no
  * further elements will be generated. If generation has side effects, the side
- * effects of elements after the first n will not be observable.
+ * effects of elements after the first n will not be observable. The source
+ * generator is destroyed as soon as the last element has been taken. The new
+ * generator's size is at most `count` (exactly, if the original generator's
+ * size is known to be large enough). Seekable generators (see
+ * fpgen::generator::seekable) are cut off and returned themselves.
  *
  *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
  *  \param[in,out] gen The generator to take elements from.
  *  \param[in] count The amount of elements to yield.
  *  \returns A new generator yielding only the first n values.
  */
-template <typename T> generator<T> take(generator<T> gen, size_t count) {
-  for (size_t i = 0; i < count && gen; i++) {
-    co_yield gen();
+template <typename T, typename P>
+generator<T, detail::forward_policy<P, T>> take(generator<T, P> gen,
+                                                size_t count) {
+  if (gen.seekable()) {
+    gen.truncate(count);
+    return gen;
   }
-  co_return;
+  size_hint hint = gen.hint().limit(count);
+  generator<T, detail::forward_policy<P, T>> taken =
+      detail::take_impl(std::move(gen), count);
+  taken.set_hint(hint);
+  return taken;
+}
+
+/**
+ *  \brief Yields a page of elements from a generator.
+ *
+ *  Skips the first `offset` elements, then yields (at most) `limit` elements;
+ * the same as `fpgen::take(fpgen::drop(gen, offset), limit)`. For seekable
+ * generators (see fpgen::generator::seekable), this takes constant time
+ * regardless of the offset, and the original generator is returned.
+ *
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator to take elements from.
+ *  \param[in] offset The amount of elements to skip.
+ *  \param[in] limit The amount of elements to yield.
+ *  \returns A new generator yielding the requested page.
+ */
+template <typename T, typename P>
+generator<T, detail::forward_policy<P, T>>
+slice(generator<T, P> gen, size_t offset, size_t limit) {
+  return take(drop(std::move(gen), offset), limit);
 }
 
 /**
@@ -146,18 +340,21 @@ template <typename T> generator<T> take(generator<T> gen, size_t count) {
  * });`.
  *
  *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
  *  \tparam Pred The type of the predicate (should be a T -> bool function).
  *  \param gen The generator to drop elements from.
  *  \param p The predicate.
  *  \returns A new generator where the first element is guaranteed to not
  * satisfy `p`.
  */
-template <typename T, typename Pred, typename _ = type::is_predicate<Pred, T>>
-generator<T> drop_while(generator<T> gen, Pred p) {
+template <typename T, typename P, typename Pred>
+  requires type::predicate_for<Pred, T>
+generator<T, detail::test_policy<P, Pred, T>> drop_while(generator<T, P> gen,
+                                                         Pred p) {
   while (gen) {
     T temp = gen();
     if (!p(temp)) {
-      co_yield temp;
+      co_yield std::forward<T>(temp);
       break;
     }
   }
@@ -174,10 +371,11 @@ generator<T> drop_while(generator<T> gen, Pred p) {
  *  Iterates over the elements in the generator and yields them until it
  * encounters a value not satisfying the predicate (`!p(value)`). Then it stops
  * generating (any side effects from the subsequent elements won't be
- * observable). To obtain a generator with all elements satisfying `p`, use
- * `fpgen::filter(gen, p);` instead.
+ * observable) and destroys the source generator. To obtain a generator with all
+ * elements satisfying `p`, use `fpgen::filter(gen, p);` instead.
  *
  *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
  *  \tparam Pred The type of the predicate (should be a T -> bool function).
  *  \param gen The generator to take elements from.
  *  \param p The predicate.
@@ -185,15 +383,19 @@ generator<T> drop_while(generator<T> gen, Pred p) {
  * predicate and were generated before any element which didn't satisfy the
  * predicate.
  */
-template <typename T, typename Pred, typename _ = type::is_predicate<Pred, T>>
-generator<T> take_while(generator<T> gen, Pred p) {
+template <typename T, typename P, typename Pred>
+  requires type::predicate_for<Pred, T>
+generator<T, detail::test_policy<P, Pred, T>> take_while(generator<T, P> gen,
+                                                         Pred p) {
   while (gen) {
     T val = gen();
     if (!p(val)) {
       break;
     }
-    co_yield val;
+    co_yield std::forward<T>(val);
   }
+  // free the source now instead of when the resulting generator is destroyed
+  { generator<T, P> done(std::move(gen)); }
   co_return;
 }
 } // namespace fpgen
@@ -0,0 +1,347 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        parallel.hpp
+// Purpose:     splittable sources and parallel aggregators for fpgen.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_PARALLEL
+#define _FPGEN_PARALLEL
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "generator.hpp"
+#include "range.hpp"
+#include "thread_pool.hpp"
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+/**
+ *  \brief A source which can be partitioned into independent generators.
+ *
+ *  A splittable source knows its size, and can create a generator over any
+ * sub-range `[begin, end)` of its values. Different sub-ranges can be
+ * generated on different threads at the same time. Splittable sources are
+ * created using fpgen::split_from, fpgen::split_enumerate and
+ * fpgen::split_range, and consumed using fpgen::parallel_fold and
+ * fpgen::parallel_sum (or as a regular generator, see `all()`).
+ *
+ *  \tparam T The type of the generated values.
+ *  \tparam Part The function type creating the generators; `(size_t, size_t)
+ * -> generator<T>`.
+ */
+template <typename T, typename Part> class splittable {
+public:
+  /**
+   *  \brief The type of the generated values.
+   */
+  using value_type = T;
+
+  /**
+   *  \brief Creates a new splittable source.
+   *  \param[in] size The amount of values.
+   *  \param[in] part The function creating a generator over a sub-range.
+   */
+  splittable(size_t size, Part part) : _size{size}, _part{std::move(part)} {}
+
+  /**
+   *  \brief Gets the amount of values.
+   *  \returns The amount of values.
+   */
+  size_t size() const { return _size; }
+
+  /**
+   *  \brief Creates a generator over a sub-range of the values.
+   *  \param[in] begin The index of the first value.
+   *  \param[in] end The index one past the last value.
+   *  \returns A generator over the values in `[begin, end)`.
+   */
+  generator<T> part(size_t begin, size_t end) const {
+    return _part(begin, std::min(end, _size));
+  }
+
+  /**
+   *  \brief Creates a generator over all values.
+   *  \returns A generator over all values.
+   */
+  generator<T> all() const { return part(0, _size); }
+
+private:
+  size_t _size;
+  Part _part;
+};
+
+namespace detail {
+// The part generators are free functions rather than coroutine lambdas, so
+// they don't refer to the (possibly temporary) splittable source.
+
+/**
+ *  \brief Generates the elements in `[begin, end)` of a container.
+ *  \tparam TRef The reference type of the container's iterators.
+ *  \tparam Container The container type.
+ *  \param[in] cont The container.
+ *  \param[in] begin The index of the first element.
+ *  \param[in] end The index one past the last element.
+ *  \returns A generator over the elements.
+ */
+template <typename TRef, typename Container>
+generator<TRef> split_from_part(const Container &cont, size_t begin,
+                                size_t end) {
+  auto it = std::next(std::begin(cont), begin);
+  for (size_t i = begin; i < end; i++, ++it) {
+    co_yield *it;
+  }
+  co_return;
+}
+
+/**
+ *  \brief Generates the elements in `[begin, end)` of a container, with their
+ * indices.
+ *  \tparam T The value type of the container.
+ *  \tparam Container The container type.
+ *  \param[in] cont The container.
+ *  \param[in] begin The index of the first element.
+ *  \param[in] end The index one past the last element.
+ *  \returns A generator over index-value tuples.
+ */
+template <typename T, typename Container>
+generator<std::tuple<size_t, T>>
+split_enumerate_part(const Container &cont, size_t begin, size_t end) {
+  auto it = std::next(std::begin(cont), begin);
+  for (size_t i = begin; i < end; i++, ++it) {
+    co_yield {i, *it};
+  }
+  co_return;
+}
+
+/**
+ *  \brief Generates `start + i` for each `i` in `[begin, end)`.
+ *  \tparam T The integral type.
+ *  \param[in] start The first value of the whole range.
+ *  \param[in] begin The offset of the first value.
+ *  \param[in] end The offset one past the last value.
+ *  \returns A generator over the values.
+ */
+template <typename T>
+generator<T> split_range_part(T start, size_t begin, size_t end) {
+  // unsigned arithmetic wraps around instead of overflowing
+  using W = std::make_unsigned_t<T>;
+  for (size_t i = begin; i < end; i++) {
+    co_yield static_cast<T>(
+        static_cast<W>(static_cast<W>(start) + static_cast<W>(i)));
+  }
+  co_return;
+}
+
+/**
+ *  \brief Generates the values of (a part of) a numeric range.
+ *  \tparam T The value type.
+ *  \param[in] r The range.
+ *  \returns A generator over the values.
+ */
+template <typename T> generator<T> numeric_part(numeric_range<T> r) {
+  for (size_t i = 0; i < r.size(); i++) {
+    co_yield r[i];
+  }
+  co_return;
+}
+} // namespace detail
+
+/**
+ *  \brief Creates a splittable source over a container, by reference.
+ *
+ *  The container should outlive the source, and should support random access
+ * iterators for the source to split efficiently.
+ *
+ *  \tparam Container The container type.
+ *  \tparam TRef The reference type of the container's iterators.
+ *  \param[in] cont The container.
+ *  \returns A splittable source yielding references to the elements.
+ *  \see fpgen::from, fpgen::from_ref
+ */
+template <typename Container,
+          typename TRef =
+              decltype(*std::begin(std::declval<const Container &>()))>
+auto split_from(const Container &cont) {
+  auto part = [&cont](size_t begin, size_t end) {
+    return detail::split_from_part<TRef>(cont, begin, end);
+  };
+  return splittable<TRef, decltype(part)>(std::size(cont), std::move(part));
+}
+
+/**
+ *  \brief Creates a splittable source over a container, with indexing.
+ *
+ *  The container should outlive the source, and should support random access
+ * iterators for the source to split efficiently.
+ *
+ *  \tparam Container The container type.
+ *  \tparam T The value type of the container.
+ *  \param[in] cont The container.
+ *  \returns A splittable source yielding index-value tuples.
+ *  \see fpgen::enumerate
+ */
+template <typename Container,
+          typename T = std::remove_cvref_t<
+              decltype(*std::begin(std::declval<const Container &>()))>>
+auto split_enumerate(const Container &cont) {
+  auto part = [&cont](size_t begin, size_t end) {
+    return detail::split_enumerate_part<T>(cont, begin, end);
+  };
+  return splittable<std::tuple<size_t, T>, decltype(part)>(std::size(cont),
+                                                          std::move(part));
+}
+
+/**
+ *  \brief Creates a splittable source over a range of integral values.
+ *
+ *  The bounded, splittable counterpart of fpgen::inc: the values are `begin`,
+ * `begin + 1`, ..., up to (but not including) `end`.
+ *
+ *  \tparam T The integral type.
+ *  \param[in] begin The first value.
+ *  \param[in] end The value one past the last one.
+ *  \returns A splittable source yielding the values.
+ */
+template <typename T, typename _ = std::enable_if_t<std::is_integral<T>::value>>
+auto split_range(T begin, T end) {
+  auto part = [begin](size_t from, size_t to) {
+    return detail::split_range_part<T>(begin, from, to);
+  };
+  using W = std::make_unsigned_t<T>;
+  size_t size = end > begin ? static_cast<size_t>(static_cast<W>(
+                                  static_cast<W>(end) - static_cast<W>(begin)))
+                            : 0;
+  return splittable<T, decltype(part)>(size, std::move(part));
+}
+
+/**
+ *  \brief Creates a splittable source over a numeric range.
+ *
+ *  See fpgen::split_range; the range is copied into the source, so it may be
+ * a temporary.
+ *
+ *  \tparam T The value type.
+ *  \param[in] r The range.
+ *  \returns A splittable source yielding the values.
+ */
+template <typename T> auto split_range(numeric_range<T> r) {
+  auto part = [r](size_t from, size_t to) {
+    return detail::numeric_part(r.sub(from, to));
+  };
+  return splittable<T, decltype(part)>(r.size(), std::move(part));
+}
+
+/**
+ *  \brief Accumulates each value in a splittable source in parallel.
+ *
+ *  The source is split into a few parts per thread in the pool (so idle
+ * threads can steal work), each of which is folded separately, starting from
+ * `identity`. The partial results are then combined, in order, starting from
+ * the initial value. For an associative folder whose combiner matches it
+ * (like `*` for both), with `identity` its identity element (like `1`), the
+ * result is the same as that of `fpgen::fold(source.all(), folder, initial)`.
+ *
+ *  \tparam TOut The output type (accumulator type).
+ *  \tparam T The type of the values in the source.
+ *  \tparam Part The part function type of the source.
+ *  \tparam Fun The folding function type; `(TOut, T) -> TOut`.
+ *  \tparam Comb The combining function type; `(TOut, TOut) -> TOut`.
+ *  \param[in] source The source to fold.
+ *  \param[in] folder The folding function.
+ *  \param[in] combiner The function combining partial results.
+ *  \param[in] initial The initial accumulator value.
+ *  \param[in] identity The value each part starts from; should leave any
+ * value unchanged when combined with it.
+ *  \param[in] pool The pool to run on.
+ *  \returns The final accumulator value.
+ */
+template <typename TOut, typename T, typename Part, typename Fun,
+          typename Comb>
+TOut parallel_fold(const splittable<T, Part> &source, Fun folder,
+                   Comb combiner, TOut initial, const TOut &identity,
+                   thread_pool &pool = thread_pool::shared()) {
+  size_t parts = std::min(source.size(), pool.size() * 4);
+  if (parts == 0)
+    return initial;
+  size_t step = (source.size() + parts - 1) / parts;
+  parts = (source.size() + step - 1) / step;
+
+  std::vector<std::optional<TOut>> partial(parts);
+  pool.parallel_for(parts, [&](size_t i) {
+    generator<T> gen = source.part(i * step, (i + 1) * step);
+    TOut value = identity;
+    for (auto &&v : gen) {
+      value = folder(std::move(value), std::forward<decltype(v)>(v));
+    }
+    partial[i] = std::move(value);
+  });
+
+  for (auto &value : partial) {
+    initial = combiner(std::move(initial), std::move(*value));
+  }
+  return initial;
+}
+
+/**
+ *  \brief Accumulates each value in a splittable source in parallel, starting
+ * each part from `TOut{}`.
+ *
+ *  See `fpgen::parallel_fold(source, folder, combiner, initial, identity,
+ * pool)`. This is only correct if `TOut{}` is the combiner's identity element
+ * (like `0` for `+`, or an empty string for concatenation); for other folders
+ * (like `*`, or a maximum over negative values), pass the identity
+ * explicitly.
+ *
+ *  \tparam TOut The output type (accumulator type).
+ *  \tparam T The type of the values in the source.
+ *  \tparam Part The part function type of the source.
+ *  \tparam Fun The folding function type; `(TOut, T) -> TOut`.
+ *  \tparam Comb The combining function type; `(TOut, TOut) -> TOut`.
+ *  \param[in] source The source to fold.
+ *  \param[in] folder The folding function.
+ *  \param[in] combiner The function combining partial results.
+ *  \param[in] initial The initial accumulator value.
+ *  \param[in] pool The pool to run on.
+ *  \returns The final accumulator value.
+ */
+template <typename TOut, typename T, typename Part, typename Fun,
+          typename Comb>
+TOut parallel_fold(const splittable<T, Part> &source, Fun folder,
+                   Comb combiner, TOut initial = {},
+                   thread_pool &pool = thread_pool::shared()) {
+  return parallel_fold<TOut>(source, std::move(folder), std::move(combiner),
+                             std::move(initial), TOut{}, pool);
+}
+
+/**
+ *  \brief Sums each value in a splittable source in parallel.
+ *
+ *  See fpgen::parallel_fold and fpgen::sum.
+ *
+ *  \tparam T The type of the values in the source, should support
+ * `operator+`.
+ *  \tparam Part The part function type of the source.
+ *  \param[in] source The source to sum over.
+ *  \param[in] pool The pool to run on.
+ *  \returns The sum of all values.
+ */
+template <typename T, typename Part, typename TOut = std::remove_cvref_t<T>>
+TOut parallel_sum(const splittable<T, Part> &source,
+                  thread_pool &pool = thread_pool::shared()) {
+  auto add = [](TOut lhs, const TOut &rhs) -> TOut {
+    return std::move(lhs) + rhs;
+  };
+  return parallel_fold<TOut>(source, add, add, TOut{}, TOut{}, pool);
+}
+} // namespace fpgen
+
+#endif
@@ -0,0 +1,1022 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        pipeline.hpp
+// Purpose:     fused pipelines (operator|) for the fpgen generator.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_PIPELINE
+#define _FPGEN_PIPELINE
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "generator.hpp"
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+/**
+ *  \brief Base type for all pipeline stages (see fpgen::pipeline).
+ */
+struct stage {};
+
+namespace detail {
+/**
+ *  \brief Computes the type coming out of a sequence of stages.
+ *  \tparam T The type going into the first stage.
+ *  \tparam Stages The stages.
+ */
+template <typename T, typename... Stages> struct stage_output {
+  /**
+   *  \brief The output type.
+   */
+  using type = T;
+};
+
+/**
+ *  \brief Computes the type coming out of a sequence of stages.
+ *  \tparam T The type going into the first stage.
+ *  \tparam S The first stage.
+ *  \tparam Rest The other stages.
+ */
+template <typename T, typename S, typename... Rest>
+struct stage_output<T, S, Rest...> {
+  /**
+   *  \brief The output type.
+   */
+  using type =
+      typename stage_output<typename S::template output<T>, Rest...>::type;
+};
+
+/**
+ *  \brief Type trait deducing whether a type is a pipeline stage.
+ *  \tparam S The type to check.
+ */
+template <typename S>
+using is_stage =
+    typename std::enable_if<std::is_base_of<stage, S>::value>::type;
+
+/**
+ *  \brief Pipeline source pulling from a generator.
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ */
+template <typename T, typename P> struct gen_source {
+  /**
+   *  \brief The type of the pulled values.
+   */
+  using reference = decltype(std::declval<generator<T, P> &>()());
+
+  /**
+   *  \brief The generator.
+   */
+  generator<T, P> gen;
+
+  /**
+   *  \brief Checks whether there are values left; resumes the generator.
+   *  \returns True if a value can be pulled.
+   */
+  bool has() { return static_cast<bool>(gen); }
+  /**
+   *  \brief Pulls the next value. Only valid after `has()` returned true.
+   *  \returns The next value.
+   */
+  reference pull() { return gen(); }
+};
+
+/**
+ *  \brief Pipeline source iterating over a container, by reference.
+ *  \tparam Container The container type.
+ */
+template <typename Container> struct range_source {
+  /**
+   *  \brief The iterator type.
+   */
+  using iterator = decltype(std::begin(std::declval<Container &>()));
+  /**
+   *  \brief The type of the pulled values.
+   */
+  using reference = decltype(*std::declval<iterator &>());
+
+  /**
+   *  \brief The current position.
+   */
+  iterator it;
+  /**
+   *  \brief The end position.
+   */
+  iterator end;
+
+  /**
+   *  \brief Creates a source over the whole container.
+   *  \param[in] cont The container. Should outlive the source.
+   */
+  explicit range_source(Container &cont)
+      : it{std::begin(cont)}, end{std::end(cont)} {}
+
+  /**
+   *  \brief Checks whether there are values left.
+   *  \returns True if a value can be pulled.
+   */
+  bool has() const { return it != end; }
+  /**
+   *  \brief Pulls the next value. Only valid after `has()` returned true.
+   *  \returns The next value.
+   */
+  reference pull() {
+    reference value = *it;
+    ++it;
+    return static_cast<reference>(value);
+  }
+};
+
+/**
+ *  \brief Final pipeline sink, calling a function for each value.
+ *  \tparam Fun The function type.
+ */
+template <typename Fun> struct call_sink {
+  /**
+   *  \brief The function to call.
+   */
+  Fun func;
+
+  /**
+   *  \brief Checks whether more values are wanted.
+   *  \returns Always true.
+   */
+  bool accepting() const { return true; }
+  /**
+   *  \brief Passes a value to the function.
+   *  \param[in] value The value.
+   */
+  template <typename T> void operator()(T &&value) {
+    func(std::forward<T>(value));
+  }
+};
+
+/**
+ *  \brief Final pipeline sink, storing a value until it's yielded.
+ *
+ *  Every stage passes on at most one value per input value, so a single slot
+ * suffices.
+ *
+ *  \tparam T The type of the values.
+ */
+template <typename T> struct slot_sink {
+  /**
+   *  \brief The stored value (if any).
+   */
+  std::optional<T> *slot;
+
+  /**
+   *  \brief Checks whether more values are wanted.
+   *  \returns Always true.
+   */
+  bool accepting() const { return true; }
+  /**
+   *  \brief Stores a value.
+   *  \param[in] value The value.
+   */
+  template <typename U> void operator()(U &&value) {
+    slot->emplace(std::forward<U>(value));
+  }
+};
+
+/**
+ *  \brief Final pipeline sink, storing a reference until it's yielded.
+ *  \tparam T The type of the values.
+ */
+template <typename T> struct slot_sink<T &> {
+  /**
+   *  \brief The address of the stored reference (or `nullptr`).
+   */
+  T **slot;
+
+  /**
+   *  \brief Checks whether more values are wanted.
+   *  \returns Always true.
+   */
+  bool accepting() const { return true; }
+  /**
+   *  \brief Stores a reference.
+   *  \param[in] value The object to refer to.
+   */
+  void operator()(T &value) { *slot = std::addressof(value); }
+};
+} // namespace detail
+
+/**
+ *  \brief Pipeline stage applying a function to each value.
+ *
+ *  Created using fpgen::map(Fun).
+ *
+ *  \tparam Fun The function type.
+ */
+template <typename Fun> struct map_stage : stage {
+  /**
+   *  \brief The type coming out of the stage.
+   *  \tparam T The type going into the stage.
+   */
+  template <typename T> using output = std::invoke_result_t<Fun &, T>;
+
+  /**
+   *  \brief The mapping function.
+   */
+  Fun func;
+
+  /**
+   *  \brief The sink for this stage.
+   *  \tparam Next The next sink.
+   */
+  template <typename Next> struct sink {
+    /**
+     *  \brief The mapping function.
+     */
+    Fun func;
+    /**
+     *  \brief The next sink.
+     */
+    Next next;
+
+    /**
+     *  \brief Checks whether more values are wanted.
+     *  \returns True if the next sink wants more values.
+     */
+    bool accepting() const { return next.accepting(); }
+    /**
+     *  \brief Maps a value and passes it on.
+     *  \param[in] value The value.
+     */
+    template <typename T> void operator()(T &&value) {
+      next(func(std::forward<T>(value)));
+    }
+  };
+
+  /**
+   *  \brief Binds this stage to the next sink.
+   *  \param[in] next The next sink.
+   *  \returns The sink for this stage.
+   */
+  template <typename Next> sink<Next> bind(Next next) && {
+    return {std::move(func), std::move(next)};
+  }
+};
+
+/**
+ *  \brief Pipeline stage keeping only values matching a predicate.
+ *
+ *  Created using fpgen::filter(Pred).
+ *
+ *  \tparam Pred The predicate type.
+ */
+template <typename Pred> struct filter_stage : stage {
+  /**
+   *  \brief The type coming out of the stage.
+   *  \tparam T The type going into the stage.
+   */
+  template <typename T> using output = T;
+
+  /**
+   *  \brief The predicate.
+   */
+  Pred pred;
+
+  /**
+   *  \brief The sink for this stage.
+   *  \tparam Next The next sink.
+   */
+  template <typename Next> struct sink {
+    /**
+     *  \brief The predicate.
+     */
+    Pred pred;
+    /**
+     *  \brief The next sink.
+     */
+    Next next;
+
+    /**
+     *  \brief Checks whether more values are wanted.
+     *  \returns True if the next sink wants more values.
+     */
+    bool accepting() const { return next.accepting(); }
+    /**
+     *  \brief Passes a value on if it matches the predicate.
+     *  \param[in] value The value.
+     */
+    template <typename T> void operator()(T &&value) {
+      if (pred(value))
+        next(std::forward<T>(value));
+    }
+  };
+
+  /**
+   *  \brief Binds this stage to the next sink.
+   *  \param[in] next The next sink.
+   *  \returns The sink for this stage.
+   */
+  template <typename Next> sink<Next> bind(Next next) && {
+    return {std::move(pred), std::move(next)};
+  }
+};
+
+/**
+ *  \brief Pipeline stage skipping the first few values.
+ *
+ *  Created using fpgen::drop(size_t).
+ */
+struct drop_stage : stage {
+  /**
+   *  \brief The type coming out of the stage.
+   *  \tparam T The type going into the stage.
+   */
+  template <typename T> using output = T;
+
+  /**
+   *  \brief The amount of values to skip.
+   */
+  size_t count;
+
+  /**
+   *  \brief The sink for this stage.
+   *  \tparam Next The next sink.
+   */
+  template <typename Next> struct sink {
+    /**
+     *  \brief The amount of values still to skip.
+     */
+    size_t remaining;
+    /**
+     *  \brief The next sink.
+     */
+    Next next;
+
+    /**
+     *  \brief Checks whether more values are wanted.
+     *  \returns True if the next sink wants more values.
+     */
+    bool accepting() const { return next.accepting(); }
+    /**
+     *  \brief Skips the value, or passes it on.
+     *  \param[in] value The value.
+     */
+    template <typename T> void operator()(T &&value) {
+      if (remaining > 0)
+        remaining--;
+      else
+        next(std::forward<T>(value));
+    }
+  };
+
+  /**
+   *  \brief Binds this stage to the next sink.
+   *  \param[in] next The next sink.
+   *  \returns The sink for this stage.
+   */
+  template <typename Next> sink<Next> bind(Next next) && {
+    return {count, std::move(next)};
+  }
+};
+
+/**
+ *  \brief Pipeline stage keeping only the first few values.
+ *
+ *  Created using fpgen::take(size_t). Once enough values passed, the source
+ * is not pulled from anymore.
+ */
+struct take_stage : stage {
+  /**
+   *  \brief The type coming out of the stage.
+   *  \tparam T The type going into the stage.
+   */
+  template <typename T> using output = T;
+
+  /**
+   *  \brief The amount of values to keep.
+   */
+  size_t count;
+
+  /**
+   *  \brief The sink for this stage.
+   *  \tparam Next The next sink.
+   */
+  template <typename Next> struct sink {
+    /**
+     *  \brief The amount of values still to keep.
+     */
+    size_t remaining;
+    /**
+     *  \brief The next sink.
+     */
+    Next next;
+
+    /**
+     *  \brief Checks whether more values are wanted.
+     *  \returns True if not all values were taken yet, and the next sink wants
+     * more values.
+     */
+    bool accepting() const { return remaining > 0 && next.accepting(); }
+    /**
+     *  \brief Passes the value on.
+     *  \param[in] value The value.
+     */
+    template <typename T> void operator()(T &&value) {
+      remaining--;
+      next(std::forward<T>(value));
+    }
+  };
+
+  /**
+   *  \brief Binds this stage to the next sink.
+   *  \param[in] next The next sink.
+   *  \returns The sink for this stage.
+   */
+  template <typename Next> sink<Next> bind(Next next) && {
+    return {count, std::move(next)};
+  }
+};
+
+/**
+ *  \brief Pipeline stage skipping values while they match a predicate.
+ *
+ *  Created using fpgen::drop_while(Pred).
+ *
+ *  \tparam Pred The predicate type.
+ */
+template <typename Pred> struct drop_while_stage : stage {
+  /**
+   *  \brief The type coming out of the stage.
+   *  \tparam T The type going into the stage.
+   */
+  template <typename T> using output = T;
+
+  /**
+   *  \brief The predicate.
+   */
+  Pred pred;
+
+  /**
+   *  \brief The sink for this stage.
+   *  \tparam Next The next sink.
+   */
+  template <typename Next> struct sink {
+    /**
+     *  \brief The predicate.
+     */
+    Pred pred;
+    /**
+     *  \brief The next sink.
+     */
+    Next next;
+    /**
+     *  \brief Whether values are still being skipped.
+     */
+    bool dropping = true;
+
+    /**
+     *  \brief Checks whether more values are wanted.
+     *  \returns True if the next sink wants more values.
+     */
+    bool accepting() const { return next.accepting(); }
+    /**
+     *  \brief Skips the value, or passes it on.
+     *  \param[in] value The value.
+     */
+    template <typename T> void operator()(T &&value) {
+      if (dropping && pred(value))
+        return;
+      dropping = false;
+      next(std::forward<T>(value));
+    }
+  };
+
+  /**
+   *  \brief Binds this stage to the next sink.
+   *  \param[in] next The next sink.
+   *  \returns The sink for this stage.
+   */
+  template <typename Next> sink<Next> bind(Next next) && {
+    return {std::move(pred), std::move(next)};
+  }
+};
+
+/**
+ *  \brief Pipeline stage keeping values while they match a predicate.
+ *
+ *  Created using fpgen::take_while(Pred). Once a value doesn't match, the
+ * source is not pulled from anymore.
+ *
+ *  \tparam Pred The predicate type.
+ */
+template <typename Pred> struct take_while_stage : stage {
+  /**
+   *  \brief The type coming out of the stage.
+   *  \tparam T The type going into the stage.
+   */
+  template <typename T> using output = T;
+
+  /**
+   *  \brief The predicate.
+   */
+  Pred pred;
+
+  /**
+   *  \brief The sink for this stage.
+   *  \tparam Next The next sink.
+   */
+  template <typename Next> struct sink {
+    /**
+     *  \brief The predicate.
+     */
+    Pred pred;
+    /**
+     *  \brief The next sink.
+     */
+    Next next;
+    /**
+     *  \brief Whether values are still being kept.
+     */
+    bool taking = true;
+
+    /**
+     *  \brief Checks whether more values are wanted.
+     *  \returns True if no value failed the predicate yet, and the next sink
+     * wants more values.
+     */
+    bool accepting() const { return taking && next.accepting(); }
+    /**
+     *  \brief Passes the value on, or stops the pipeline.
+     *  \param[in] value The value.
+     */
+    template <typename T> void operator()(T &&value) {
+      if (pred(value))
+        next(std::forward<T>(value));
+      else
+        taking = false;
+    }
+  };
+
+  /**
+   *  \brief Binds this stage to the next sink.
+   *  \param[in] next The next sink.
+   *  \returns The sink for this stage.
+   */
+  template <typename Next> sink<Next> bind(Next next) && {
+    return {std::move(pred), std::move(next)};
+  }
+};
+
+/**
+ *  \brief A lazy, fused chain of stages over a source.
+ *
+ *  Pipelines are built using `operator|`, like so:
+ *        `fpgen::from(v) | fpgen::map(f) | fpgen::filter(p) | fpgen::take(n)`,
+ * where the source can be a generator or a container (iterated by reference).
+ * Nothing happens until the pipeline is consumed. All stages are then fused
+ * into a single loop which pushes each value from the source through the
+ * stages: aggregating a pipeline (fpgen::sum, fpgen::fold, ...) needs no
+ * coroutine at all, while converting it to a generator creates just one (next
+ * to the source generator, if any). This is much cheaper than chaining the
+ * manipulator functions, where each stage is a separate coroutine, resumed
+ * once for each value.
+ *
+ *  \tparam Source The source type (see fpgen::detail::gen_source and
+ * fpgen::detail::range_source).
+ *  \tparam Stages The stages, in order.
+ */
+template <typename Source, typename... Stages> class pipeline {
+public:
+  /**
+   *  \brief The type of the values coming out of the pipeline.
+   */
+  using value_type =
+      typename detail::stage_output<typename Source::reference,
+                                    Stages...>::type;
+
+  /**
+   *  \brief Creates a new pipeline.
+   *  \param[in] source The source.
+   *  \param[in] stages The stages.
+   */
+  pipeline(Source source, std::tuple<Stages...> stages)
+      : _source{std::move(source)}, _stages{std::move(stages)} {}
+
+  /**
+   *  \brief Appends a stage to the pipeline.
+   *  \tparam Stage The stage type.
+   *  \param[in] next The stage.
+   *  \returns A new pipeline, ending with the given stage.
+   */
+  template <typename Stage>
+  pipeline<Source, Stages..., Stage> then(Stage next) && {
+    return {std::move(_source),
+            std::tuple_cat(std::move(_stages),
+                           std::tuple<Stage>(std::move(next)))};
+  }
+
+  /**
+   *  \brief Runs the pipeline, calling a function on each resulting value.
+   *
+   *  This is a plain loop; no coroutines are involved (except for the source,
+   * if it's a generator).
+   *
+   *  \tparam Fun The function type.
+   *  \param[in] func The function.
+   */
+  template <typename Fun> void run(Fun func) && {
+    // local copies keep the loop state in registers
+    Source source = std::move(_source);
+    auto sink = bind(detail::call_sink<Fun>{std::move(func)});
+    while (sink.accepting() && source.has()) {
+      sink(source.pull());
+    }
+  }
+
+  /**
+   *  \brief Converts the pipeline into a generator.
+   *
+   *  The stages run inside a single coroutine.
+   *
+   *  \returns A generator over the resulting values.
+   */
+  operator generator<value_type>() && { return drive(std::move(*this)); }
+
+private:
+  /**
+   *  \brief Binds all stages from the `I`-th onwards to the final sink.
+   *  \tparam I The first stage to bind.
+   *  \tparam Sink The final sink type.
+   *  \param[in] sink The final sink.
+   *  \returns The sink for the `I`-th stage.
+   */
+  template <size_t I = 0, typename Sink> auto bind(Sink sink) {
+    if constexpr (I == sizeof...(Stages)) {
+      return sink;
+    } else {
+      return std::move(std::get<I>(_stages)).bind(bind<I + 1>(std::move(sink)));
+    }
+  }
+
+  /**
+   *  \brief The coroutine running the pipeline.
+   *  \param[in] self The pipeline.
+   *  \returns A generator over the resulting values.
+   */
+  static generator<value_type> drive(pipeline self) {
+    if constexpr (std::is_reference_v<value_type>) {
+      std::remove_reference_t<value_type> *slot = nullptr;
+      auto sink = self.bind(detail::slot_sink<value_type>{&slot});
+      while (true) {
+        while (slot == nullptr && sink.accepting() && self._source.has()) {
+          sink(self._source.pull());
+        }
+        if (slot == nullptr)
+          break;
+        co_yield *std::exchange(slot, nullptr);
+      }
+    } else {
+      std::optional<value_type> slot;
+      auto sink = self.bind(detail::slot_sink<value_type>{&slot});
+      while (true) {
+        while (!slot && sink.accepting() && self._source.has()) {
+          sink(self._source.pull());
+        }
+        if (!slot)
+          break;
+        co_yield std::move(*slot);
+        slot.reset();
+      }
+    }
+    co_return;
+  }
+
+  Source _source;
+  std::tuple<Stages...> _stages;
+};
+
+/**
+ *  \brief Creates a pipeline stage applying a function to each value.
+ *
+ *  The pipeline counterpart of `fpgen::map(gen, func)`.
+ *
+ *  \tparam Fun The function type.
+ *  \param[in] func The mapping function.
+ *  \returns The stage, to be used with `operator|`.
+ */
+template <typename Fun> map_stage<Fun> map(Fun func) {
+  return {{}, std::move(func)};
+}
+
+/**
+ *  \brief Creates a pipeline stage keeping only values matching a predicate.
+ *
+ *  The pipeline counterpart of `fpgen::filter(gen, p)`.
+ *
+ *  \tparam Pred The predicate type.
+ *  \param[in] p The predicate.
+ *  \returns The stage, to be used with `operator|`.
+ */
+template <typename Pred> filter_stage<Pred> filter(Pred p) {
+  return {{}, std::move(p)};
+}
+
+/**
+ *  \brief Creates a pipeline stage skipping the first few values.
+ *
+ *  The pipeline counterpart of `fpgen::drop(gen, count)`.
+ *
+ *  \param[in] count The amount of values to skip.
+ *  \returns The stage, to be used with `operator|`.
+ */
+inline drop_stage drop(size_t count) { return {{}, count}; }
+
+/**
+ *  \brief Creates a pipeline stage keeping only the first few values.
+ *
+ *  The pipeline counterpart of `fpgen::take(gen, count)`.
+ *
+ *  \param[in] count The amount of values to keep.
+ *  \returns The stage, to be used with `operator|`.
+ */
+inline take_stage take(size_t count) { return {{}, count}; }
+
+/**
+ *  \brief Creates a pipeline stage skipping values while they match a
+ * predicate.
+ *
+ *  The pipeline counterpart of `fpgen::drop_while(gen, p)`.
+ *
+ *  \tparam Pred The predicate type.
+ *  \param[in] p The predicate.
+ *  \returns The stage, to be used with `operator|`.
+ */
+template <typename Pred> drop_while_stage<Pred> drop_while(Pred p) {
+  return {{}, std::move(p)};
+}
+
+/**
+ *  \brief Creates a pipeline stage keeping values while they match a
+ * predicate.
+ *
+ *  The pipeline counterpart of `fpgen::take_while(gen, p)`.
+ *
+ *  \tparam Pred The predicate type.
+ *  \param[in] p The predicate.
+ *  \returns The stage, to be used with `operator|`.
+ */
+template <typename Pred> take_while_stage<Pred> take_while(Pred p) {
+  return {{}, std::move(p)};
+}
+
+/**
+ *  \brief Starts a pipeline from a generator.
+ *  \tparam T The type contained in the generator.
+ *  \tparam P The exception policy of the generator.
+ *  \tparam Stage The stage type.
+ *  \param[in,out] gen The generator. Will be in unusable state afterwards.
+ *  \param[in] next The first stage.
+ *  \returns A new pipeline.
+ */
+template <typename T, typename P, typename Stage,
+          typename _ = detail::is_stage<Stage>>
+pipeline<detail::gen_source<T, P>, Stage> operator|(generator<T, P> gen,
+                                                    Stage next) {
+  return {detail::gen_source<T, P>{std::move(gen)},
+          std::tuple<Stage>(std::move(next))};
+}
+
+/**
+ *  \brief Starts a pipeline from a container.
+ *
+ *  The container is iterated by reference, without copying its elements, and
+ * should outlive the pipeline.
+ *
+ *  \tparam Container The container type.
+ *  \tparam Stage The stage type.
+ *  \param[in] cont The container.
+ *  \param[in] next The first stage.
+ *  \returns A new pipeline.
+ */
+template <typename Container, typename Stage,
+          typename _ = detail::is_stage<Stage>,
+          typename = decltype(std::begin(std::declval<Container &>()))>
+pipeline<detail::range_source<Container>, Stage> operator|(Container &cont,
+                                                           Stage next) {
+  return {detail::range_source<Container>(cont),
+          std::tuple<Stage>(std::move(next))};
+}
+
+/**
+ *  \brief Appends a stage to a pipeline.
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \tparam Stage The stage type.
+ *  \param[in] pipe The pipeline.
+ *  \param[in] next The stage to append.
+ *  \returns A new pipeline, ending with the given stage.
+ */
+template <typename Source, typename... Stages, typename Stage,
+          typename _ = detail::is_stage<Stage>>
+pipeline<Source, Stages..., Stage> operator|(pipeline<Source, Stages...> pipe,
+                                             Stage next) {
+  return std::move(pipe).then(std::move(next));
+}
+
+/**
+ *  \brief Appends a stage applying a function to each value to a pipeline.
+ *
+ *  The manipulator-style counterpart of `pipe | fpgen::map(func)`, so
+ * `fpgen::map(fpgen::map(pipe, f), g)` stays a single fused loop.
+ *
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \tparam Fun The function type.
+ *  \param[in] pipe The pipeline.
+ *  \param[in] func The mapping function.
+ *  \returns A new pipeline, ending with the new stage.
+ */
+template <typename Source, typename... Stages, typename Fun>
+pipeline<Source, Stages..., map_stage<Fun>>
+map(pipeline<Source, Stages...> pipe, Fun func) {
+  return std::move(pipe).then(map(std::move(func)));
+}
+
+/**
+ *  \brief Appends a stage keeping only values matching a predicate to a
+ * pipeline.
+ *
+ *  The manipulator-style counterpart of `pipe | fpgen::filter(p)`.
+ *
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \tparam Pred The predicate type.
+ *  \param[in] pipe The pipeline.
+ *  \param[in] p The predicate.
+ *  \returns A new pipeline, ending with the new stage.
+ */
+template <typename Source, typename... Stages, typename Pred>
+pipeline<Source, Stages..., filter_stage<Pred>>
+filter(pipeline<Source, Stages...> pipe, Pred p) {
+  return std::move(pipe).then(filter(std::move(p)));
+}
+
+/**
+ *  \brief Appends a stage skipping the first few values to a pipeline.
+ *
+ *  The manipulator-style counterpart of `pipe | fpgen::drop(count)`.
+ *
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \param[in] pipe The pipeline.
+ *  \param[in] count The amount of values to skip.
+ *  \returns A new pipeline, ending with the new stage.
+ */
+template <typename Source, typename... Stages>
+pipeline<Source, Stages..., drop_stage> drop(pipeline<Source, Stages...> pipe,
+                                             size_t count) {
+  return std::move(pipe).then(drop(count));
+}
+
+/**
+ *  \brief Appends a stage keeping only the first few values to a pipeline.
+ *
+ *  The manipulator-style counterpart of `pipe | fpgen::take(count)`.
+ *
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \param[in] pipe The pipeline.
+ *  \param[in] count The amount of values to keep.
+ *  \returns A new pipeline, ending with the new stage.
+ */
+template <typename Source, typename... Stages>
+pipeline<Source, Stages..., take_stage> take(pipeline<Source, Stages...> pipe,
+                                             size_t count) {
+  return std::move(pipe).then(take(count));
+}
+
+/**
+ *  \brief Aggregates all values in a pipeline to a dataset.
+ *
+ *  See `fpgen::aggregate_to(gen, out)`.
+ *
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \tparam Container The container type to output to.
+ *  \param[in] pipe The pipeline to run.
+ *  \param[out] out The container to output to.
+ *  \returns A reference to the modified container.
+ */
+template <typename Source, typename... Stages, typename Container>
+Container &aggregate_to(pipeline<Source, Stages...> pipe, Container &out) {
+  std::move(pipe).run([&out](auto &&value) {
+    out.push_back(std::forward<decltype(value)>(value));
+  });
+  return out;
+}
+
+/**
+ *  \brief Counts the values coming out of a pipeline.
+ *
+ *  See `fpgen::count(gen)`.
+ *
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \param[in] pipe The pipeline to run.
+ *  \returns The amount of values.
+ */
+template <typename Source, typename... Stages>
+size_t count(pipeline<Source, Stages...> pipe) {
+  size_t cnt = 0;
+  std::move(pipe).run([&cnt](auto &&) { cnt++; });
+  return cnt;
+}
+
+/**
+ *  \brief Accumulates each value in a pipeline using the provided function.
+ *
+ *  See `fpgen::fold(gen, folder)`.
+ *
+ *  \tparam TOut The output type (accumulator type).
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \tparam Fun The function type.
+ *  \param[in] pipe The pipeline to run.
+ *  \param[in] folder The folding function.
+ *  \returns The final accumulator value.
+ */
+template <typename TOut, typename Source, typename... Stages, typename Fun>
+TOut fold(pipeline<Source, Stages...> pipe, Fun folder) {
+  TOut value = {};
+  std::move(pipe).run([&value, &folder](auto &&in) {
+    value = folder(std::move(value), std::forward<decltype(in)>(in));
+  });
+  return value;
+}
+
+/**
+ *  \brief Accumulates each value in a pipeline using the provided function.
+ *
+ *  See `fpgen::fold(gen, folder, initial)`.
+ *
+ *  \tparam TOut The output type (accumulator type).
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \tparam Fun The function type.
+ *  \param[in] pipe The pipeline to run.
+ *  \param[in] folder The folding function.
+ *  \param[in] initial The initial accumulator value.
+ *  \returns The final accumulator value.
+ */
+template <typename TOut, typename Source, typename... Stages, typename Fun>
+TOut fold(pipeline<Source, Stages...> pipe, Fun folder, TOut initial) {
+  std::move(pipe).run([&initial, &folder](auto &&in) {
+    initial = folder(std::move(initial), std::forward<decltype(in)>(in));
+  });
+  return initial;
+}
+
+/**
+ *  \brief Sums each value in a pipeline.
+ *
+ *  See `fpgen::sum(gen)`.
+ *
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \param[in] pipe The pipeline to run.
+ *  \returns The sum of all values.
+ */
+template <typename Source, typename... Stages>
+auto sum(pipeline<Source, Stages...> pipe)
+    -> std::remove_cvref_t<typename pipeline<Source, Stages...>::value_type> {
+  std::remove_cvref_t<typename pipeline<Source, Stages...>::value_type>
+      accum = {};
+  std::move(pipe).run([&accum](auto &&value) {
+    accum = std::move(accum) + std::forward<decltype(value)>(value);
+  });
+  return accum;
+}
+
+/**
+ *  \brief Loops over a pipeline, calling a function on each value.
+ *
+ *  See `fpgen::foreach(gen, func)`.
+ *
+ *  \tparam Source The source type of the pipeline.
+ *  \tparam Stages The stages in the pipeline.
+ *  \tparam Fun The function type of the callback.
+ *  \param[in] pipe The pipeline to run.
+ *  \param[in] func The function to use.
+ */
+template <typename Source, typename... Stages, typename Fun>
+void foreach (pipeline<Source, Stages...> pipe, Fun func) {
+  std::move(pipe).run(std::move(func));
+}
+} // namespace fpgen
+
+#endif
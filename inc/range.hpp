@@ -0,0 +1,677 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        range.hpp
+// Purpose:     bounded numeric ranges (with a step) for fpgen.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_RANGE
+#define _FPGEN_RANGE
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "generator.hpp"
+#include "pipeline.hpp"
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+namespace detail {
+/**
+ *  \brief Type trait checking whether a type can be used in a numeric range
+ * (integral types except `bool`, and floating-point types).
+ *  \tparam T The type to check.
+ */
+template <typename T>
+using is_numeric = std::bool_constant<
+    (std::is_integral_v<T> && !std::is_same_v<T, bool>) ||
+    std::is_floating_point_v<T>>;
+
+/**
+ *  \brief The unsigned type integral range values are computed in (at least
+ * `unsigned int`, so small types don't overflow after promotion).
+ *  \tparam T The integral value type.
+ */
+template <typename T>
+using numeric_word =
+    std::make_unsigned_t<std::common_type_t<T, unsigned int>>;
+
+/**
+ *  \brief Computes the `index`-th value of a numeric range.
+ *
+ *  The value is computed directly as `first + index * step` rather than by
+ * repeated addition, so values can be computed in any order (which is what
+ * makes seeking, splitting and vectorizing possible), and floating-point
+ * errors don't accumulate. Integral values wrap around in unsigned arithmetic,
+ * so intermediate results never overflow.
+ *
+ *  \tparam T The value type.
+ *  \param[in] first The first value.
+ *  \param[in] step The difference between two values.
+ *  \param[in] index The index of the value.
+ *  \returns The value.
+ */
+template <typename T>
+constexpr T numeric_value(T first, T step, size_t index) noexcept {
+  if constexpr (std::is_integral_v<T>) {
+    using W = numeric_word<T>;
+    return static_cast<T>(static_cast<W>(first) +
+                          static_cast<W>(index) * static_cast<W>(step));
+  } else {
+    return first + static_cast<T>(index) * step;
+  }
+}
+
+/**
+ *  \brief Computes the amount of values in `[begin, end)` with a given step.
+ *  \tparam T The value type.
+ *  \param[in] begin The first value.
+ *  \param[in] end The bound (excluded).
+ *  \param[in] step The step; not zero.
+ *  \returns The amount of values.
+ *  \throws std::invalid_argument If the step is zero, or the amount of values
+ * isn't finite or doesn't fit in a `size_t`.
+ */
+template <typename T> size_t numeric_count(T begin, T end, T step) {
+  if (!(step != T{}))
+    throw std::invalid_argument("fpgen::range with a step of zero");
+  if constexpr (std::is_integral_v<T>) {
+    using W = numeric_word<T>;
+    if (step > T{} ? end <= begin : begin <= end)
+      return 0;
+    // the distance and step as positive (unsigned) numbers
+    W dist = step > T{} ? static_cast<W>(static_cast<W>(end) -
+                                         static_cast<W>(begin))
+                        : static_cast<W>(static_cast<W>(begin) -
+                                         static_cast<W>(end));
+    W size = step > T{} ? static_cast<W>(step)
+                        : static_cast<W>(W{} - static_cast<W>(step));
+    return static_cast<size_t>(dist / size + (dist % size != 0 ? 1 : 0));
+  } else {
+    T count = std::ceil((end - begin) / step);
+    if (!std::isfinite(count))
+      throw std::invalid_argument("fpgen::range with an infinite size");
+    if (!(count > T{}))
+      return 0;
+    // 2^64 (or 2^32) is exact in every floating-point type, SIZE_MAX isn't
+    if (count >= std::ldexp(T{1}, std::numeric_limits<size_t>::digits))
+      throw std::invalid_argument("fpgen::range with too many values");
+    return static_cast<size_t>(count);
+  }
+}
+} // namespace detail
+
+/**
+ *  \brief A bounded range of numbers: `first`, `first + step`, ...
+ *
+ *  Numeric ranges are created using fpgen::range and fpgen::iota_n. They
+ * don't involve any coroutine: each value is computed from its index, so a
+ * numeric range is a sized random-access view (like `std::views::iota`, but
+ * with a step and floating-point support). This means that:
+ *  - `fpgen::from(r)` is a seekable generator with an exact size hint (see
+ * fpgen::generator::seekable and fpgen::size_hint), which doesn't throw (see
+ * fpgen::nothrow_policy);
+ *  - fpgen::take, fpgen::drop and fpgen::slice return a smaller numeric range;
+ *  - fpgen::map and fpgen::filter (and `operator|` with any pipeline stage)
+ * return a fused fpgen::pipeline, while fpgen::sum, fpgen::fold,
+ * fpgen::count, fpgen::foreach and fpgen::aggregate_to run a plain counted
+ * loop, which the compiler can unroll and vectorize;
+ *  - fpgen::split_range (in parallel.hpp) splits it for fpgen::parallel_fold
+ * and fpgen::parallel_sum.
+ *
+ *  \tparam T The value type (integral or floating-point).
+ */
+template <typename T>
+class numeric_range : public std::ranges::view_interface<numeric_range<T>> {
+public:
+  static_assert(detail::is_numeric<T>::value,
+                "fpgen::numeric_range requires an integral (non-bool) or "
+                "floating-point type");
+
+  /**
+   *  \brief The random-access iterator over a numeric range.
+   *
+   *  Dereferencing computes the value, so it yields values, not references.
+   */
+  class iterator {
+  public:
+    /**
+     *  \brief The iterator concept (random-access).
+     */
+    using iterator_concept = std::random_access_iterator_tag;
+    /**
+     *  \brief The iterator category (random-access, so `std::next` and
+     * friends take constant time).
+     */
+    using iterator_category = std::random_access_iterator_tag;
+    /**
+     *  \brief The value type.
+     */
+    using value_type = T;
+    /**
+     *  \brief The difference type.
+     */
+    using difference_type = std::ptrdiff_t;
+    /**
+     *  \brief The pointer type (none).
+     */
+    using pointer = void;
+    /**
+     *  \brief The reference type (values are computed).
+     */
+    using reference = T;
+
+    /**
+     *  \brief Creates an iterator at the start of an empty range.
+     */
+    iterator() = default;
+    /**
+     *  \brief Creates an iterator.
+     *  \param[in] first The first value of the range.
+     *  \param[in] step The step of the range.
+     *  \param[in] index The index the iterator is at.
+     */
+    iterator(T first, T step, size_t index) noexcept
+        : _first{first}, _step{step}, _index{index} {}
+
+    /**
+     *  \brief Computes the current value.
+     *  \returns The value.
+     */
+    T operator*() const noexcept {
+      return detail::numeric_value(_first, _step, _index);
+    }
+    /**
+     *  \brief Computes the value a few positions further.
+     *  \param[in] n The amount of positions.
+     *  \returns The value.
+     */
+    T operator[](difference_type n) const noexcept {
+      return detail::numeric_value(_first, _step,
+                                   _index + static_cast<size_t>(n));
+    }
+
+    /**
+     *  \brief Moves to the next value.
+     *  \returns This iterator.
+     */
+    iterator &operator++() noexcept {
+      _index++;
+      return *this;
+    }
+    /**
+     *  \brief Moves to the next value.
+     *  \returns A copy of this iterator before moving.
+     */
+    iterator operator++(int) noexcept {
+      iterator old = *this;
+      _index++;
+      return old;
+    }
+    /**
+     *  \brief Moves to the previous value.
+     *  \returns This iterator.
+     */
+    iterator &operator--() noexcept {
+      _index--;
+      return *this;
+    }
+    /**
+     *  \brief Moves to the previous value.
+     *  \returns A copy of this iterator before moving.
+     */
+    iterator operator--(int) noexcept {
+      iterator old = *this;
+      _index--;
+      return old;
+    }
+    /**
+     *  \brief Moves a few positions.
+     *  \param[in] n The amount of positions (may be negative).
+     *  \returns This iterator.
+     */
+    iterator &operator+=(difference_type n) noexcept {
+      _index += static_cast<size_t>(n);
+      return *this;
+    }
+    /**
+     *  \brief Moves a few positions back.
+     *  \param[in] n The amount of positions (may be negative).
+     *  \returns This iterator.
+     */
+    iterator &operator-=(difference_type n) noexcept {
+      _index -= static_cast<size_t>(n);
+      return *this;
+    }
+
+    /**
+     *  \brief Creates an iterator a few positions further.
+     *  \param[in] it The iterator.
+     *  \param[in] n The amount of positions.
+     *  \returns The new iterator.
+     */
+    friend iterator operator+(iterator it, difference_type n) noexcept {
+      return it += n;
+    }
+    /**
+     *  \brief Creates an iterator a few positions further.
+     *  \param[in] n The amount of positions.
+     *  \param[in] it The iterator.
+     *  \returns The new iterator.
+     */
+    friend iterator operator+(difference_type n, iterator it) noexcept {
+      return it += n;
+    }
+    /**
+     *  \brief Creates an iterator a few positions back.
+     *  \param[in] it The iterator.
+     *  \param[in] n The amount of positions.
+     *  \returns The new iterator.
+     */
+    friend iterator operator-(iterator it, difference_type n) noexcept {
+      return it -= n;
+    }
+    /**
+     *  \brief Computes the distance between two iterators in the same range.
+     *  \param[in] lhs The first iterator.
+     *  \param[in] rhs The second iterator.
+     *  \returns The distance.
+     */
+    friend difference_type operator-(const iterator &lhs,
+                                     const iterator &rhs) noexcept {
+      return static_cast<difference_type>(lhs._index - rhs._index);
+    }
+    /**
+     *  \brief Checks whether two iterators in the same range are at the same
+     * position.
+     *  \param[in] lhs The first iterator.
+     *  \param[in] rhs The second iterator.
+     *  \returns True if both are at the same position.
+     */
+    friend bool operator==(const iterator &lhs, const iterator &rhs) noexcept {
+      return lhs._index == rhs._index;
+    }
+    /**
+     *  \brief Compares the positions of two iterators in the same range.
+     *  \param[in] lhs The first iterator.
+     *  \param[in] rhs The second iterator.
+     *  \returns The ordering of the positions.
+     */
+    friend auto operator<=>(const iterator &lhs, const iterator &rhs) noexcept {
+      return lhs._index <=> rhs._index;
+    }
+
+  private:
+    T _first{};
+    T _step{};
+    size_t _index = 0;
+  };
+
+  /**
+   *  \brief Creates an empty range.
+   */
+  numeric_range() = default;
+  /**
+   *  \brief Creates a range from its first value, step and size.
+   *  \param[in] first The first value.
+   *  \param[in] step The difference between two values.
+   *  \param[in] count The amount of values.
+   */
+  numeric_range(T first, T step, size_t count) noexcept
+      : _first{first}, _step{step}, _count{count} {}
+
+  /**
+   *  \brief Gets the first value (if the range isn't empty).
+   *  \returns The first value.
+   */
+  T first() const noexcept { return _first; }
+  /**
+   *  \brief Gets the difference between two values.
+   *  \returns The step.
+   */
+  T step() const noexcept { return _step; }
+  /**
+   *  \brief Gets the amount of values.
+   *  \returns The amount of values.
+   */
+  size_t size() const noexcept { return _count; }
+
+  /**
+   *  \brief Gets an iterator to the first value.
+   *  \returns The iterator.
+   */
+  iterator begin() const noexcept { return {_first, _step, 0}; }
+  /**
+   *  \brief Gets an iterator past the last value.
+   *  \returns The iterator.
+   */
+  iterator end() const noexcept { return {_first, _step, _count}; }
+
+  /**
+   *  \brief Computes a value.
+   *  \param[in] index The index of the value; less than `size()`.
+   *  \returns The value.
+   */
+  T operator[](size_t index) const noexcept {
+    return detail::numeric_value(_first, _step, index);
+  }
+
+  /**
+   *  \brief Gets the sub-range with the values at indices `[begin, end)`.
+   *  \param[in] begin The index of the first value (clamped to the size).
+   *  \param[in] end The index one past the last value (clamped to the size).
+   *  \returns The sub-range.
+   */
+  numeric_range sub(size_t begin, size_t end) const noexcept {
+    end = std::min(end, _count);
+    begin = std::min(begin, end);
+    return {(*this)[begin], _step, end - begin};
+  }
+
+private:
+  T _first{};
+  T _step{};
+  size_t _count = 0;
+};
+
+/**
+ *  \brief Creates a range of numbers: `begin`, `begin + step`, ..., up to (but
+ * not including) `end`.
+ *
+ *  The bounded counterpart of fpgen::inc, for integral and floating-point
+ * types; the step may be negative (then the values decrease, down to but not
+ * including `end`). See fpgen::numeric_range for what ranges can do. Values
+ * are computed as `begin + i * step`, so floating-point errors don't
+ * accumulate.
+ *
+ *  \tparam T The value type.
+ *  \param[in] begin The first value.
+ *  \param[in] end The bound (excluded).
+ *  \param[in] step The difference between two values; not zero.
+ *  \returns A new numeric range.
+ *  \throws std::invalid_argument If the step is zero, or the range is
+ * infinite or has more values than fit in a `size_t`.
+ */
+template <typename T>
+  requires detail::is_numeric<T>::value
+numeric_range<T> range(T begin, T end, T step = T{1}) {
+  return {begin, step, detail::numeric_count(begin, end, step)};
+}
+
+/**
+ *  \brief Creates a range of `count` consecutive numbers, starting from
+ * `start`.
+ *
+ *  The same as `fpgen::take(fpgen::inc(start), count)`, but without any
+ * coroutine (see fpgen::numeric_range).
+ *
+ *  \tparam T The value type.
+ *  \param[in] start The first value.
+ *  \param[in] count The amount of values.
+ *  \returns A new numeric range.
+ */
+template <typename T>
+  requires detail::is_numeric<T>::value
+numeric_range<T> iota_n(T start, size_t count) {
+  return {start, T{1}, count};
+}
+
+namespace detail {
+/**
+ *  \brief Pipeline source computing the values of a numeric range.
+ *  \tparam T The value type.
+ */
+template <typename T> struct numeric_source {
+  /**
+   *  \brief The type of the pulled values.
+   */
+  using reference = T;
+
+  /**
+   *  \brief The first value.
+   */
+  T first;
+  /**
+   *  \brief The step.
+   */
+  T step;
+  /**
+   *  \brief The index of the next value.
+   */
+  size_t index;
+  /**
+   *  \brief The amount of values.
+   */
+  size_t count;
+
+  /**
+   *  \brief Checks whether there are values left.
+   *  \returns True if a value can be pulled.
+   */
+  bool has() const noexcept { return index < count; }
+  /**
+   *  \brief Pulls the next value. Only valid after `has()` returned true.
+   *  \returns The next value.
+   */
+  T pull() noexcept { return numeric_value(first, step, index++); }
+};
+
+/**
+ *  \brief Starts a pipeline (without any stages) over a numeric range.
+ *  \tparam T The value type.
+ *  \param[in] r The range.
+ *  \returns A new pipeline.
+ */
+template <typename T>
+pipeline<numeric_source<T>> numeric_pipeline(const numeric_range<T> &r) {
+  return {numeric_source<T>{r.first(), r.step(), 0, r.size()}, {}};
+}
+} // namespace detail
+
+/**
+ *  \brief Starts a pipeline from a numeric range.
+ *
+ *  The values are computed in the pipeline's loop, without any coroutine.
+ *
+ *  \tparam T The value type.
+ *  \tparam Stage The stage type.
+ *  \param[in] r The range.
+ *  \param[in] next The first stage.
+ *  \returns A new pipeline.
+ */
+template <typename T, typename Stage, typename _ = detail::is_stage<Stage>>
+pipeline<detail::numeric_source<T>, Stage> operator|(numeric_range<T> r,
+                                                     Stage next) {
+  return detail::numeric_pipeline(r).then(std::move(next));
+}
+
+/**
+ *  \brief Maps a function over a numeric range.
+ *
+ *  See `fpgen::map(gen, func)`. The result is a fused pipeline (see
+ * fpgen::pipeline), so aggregating it runs a single counted loop.
+ *
+ *  \tparam T The value type.
+ *  \tparam Fun The function type.
+ *  \param[in] r The range.
+ *  \param[in] func The mapping function.
+ *  \returns A new pipeline.
+ */
+template <typename T, typename Fun>
+  requires type::function_to<Fun, std::invoke_result_t<Fun &, T>, T>
+pipeline<detail::numeric_source<T>, map_stage<Fun>> map(numeric_range<T> r,
+                                                        Fun func) {
+  return detail::numeric_pipeline(r).then(map(std::move(func)));
+}
+
+/**
+ *  \brief Filters a numeric range, keeping only values matching a predicate.
+ *
+ *  See `fpgen::filter(gen, p)`. The result is a fused pipeline (see
+ * fpgen::pipeline).
+ *
+ *  \tparam T The value type.
+ *  \tparam Pred The predicate type.
+ *  \param[in] r The range.
+ *  \param[in] p The predicate.
+ *  \returns A new pipeline.
+ */
+template <typename T, typename Pred>
+  requires type::predicate_for<Pred, T>
+pipeline<detail::numeric_source<T>, filter_stage<Pred>>
+filter(numeric_range<T> r, Pred p) {
+  return detail::numeric_pipeline(r).then(filter(std::move(p)));
+}
+
+/**
+ *  \brief Skips the first values of a numeric range.
+ *  \tparam T The value type.
+ *  \param[in] r The range.
+ *  \param[in] count The amount of values to skip.
+ *  \returns The range without its first `count` values.
+ */
+template <typename T>
+numeric_range<T> drop(numeric_range<T> r, size_t count) noexcept {
+  return r.sub(count, r.size());
+}
+
+/**
+ *  \brief Keeps the first values of a numeric range.
+ *  \tparam T The value type.
+ *  \param[in] r The range.
+ *  \param[in] count The amount of values to keep.
+ *  \returns The range with only its first `count` values.
+ */
+template <typename T>
+numeric_range<T> take(numeric_range<T> r, size_t count) noexcept {
+  return r.sub(0, count);
+}
+
+/**
+ *  \brief Keeps a page of values of a numeric range.
+ *  \tparam T The value type.
+ *  \param[in] r The range.
+ *  \param[in] offset The amount of values to skip.
+ *  \param[in] limit The amount of values to keep.
+ *  \returns The sub-range.
+ */
+template <typename T>
+numeric_range<T> slice(numeric_range<T> r, size_t offset,
+                       size_t limit) noexcept {
+  return take(drop(r, offset), limit);
+}
+
+/**
+ *  \brief Counts the values in a numeric range; its size.
+ *  \tparam T The value type.
+ *  \param[in] r The range.
+ *  \returns The amount of values.
+ */
+template <typename T> size_t count(const numeric_range<T> &r) noexcept {
+  return r.size();
+}
+
+/**
+ *  \brief Sums the values in a numeric range, in a plain counted loop.
+ *
+ *  For floating-point types, the compiler only vectorizes the loop if it may
+ * reorder the additions (like with `-ffast-math`).
+ *
+ *  \tparam T The value type.
+ *  \param[in] r The range.
+ *  \returns The sum of all values.
+ */
+template <typename T> T sum(const numeric_range<T> &r) {
+  return sum(detail::numeric_pipeline(r));
+}
+
+/**
+ *  \brief Accumulates each value in a numeric range, in a plain counted loop.
+ *
+ *  See `fpgen::fold(gen, folder)`.
+ *
+ *  \tparam TOut The output type (accumulator type).
+ *  \tparam T The value type.
+ *  \tparam Fun The function type.
+ *  \param[in] r The range.
+ *  \param[in] folder The folding function.
+ *  \returns The final accumulator value.
+ */
+template <typename TOut, typename T, typename Fun>
+  requires type::function_to<Fun, TOut, TOut, T>
+TOut fold(const numeric_range<T> &r, Fun folder) {
+  return fold<TOut>(detail::numeric_pipeline(r), std::move(folder));
+}
+
+/**
+ *  \brief Accumulates each value in a numeric range, in a plain counted loop.
+ *
+ *  See `fpgen::fold(gen, folder, initial)`.
+ *
+ *  \tparam TOut The output type (accumulator type).
+ *  \tparam T The value type.
+ *  \tparam Fun The function type.
+ *  \param[in] r The range.
+ *  \param[in] folder The folding function.
+ *  \param[in] initial The initial value for the accumulator.
+ *  \returns The final accumulator value.
+ */
+template <typename TOut, typename T, typename Fun>
+  requires type::function_to<Fun, TOut, TOut, T>
+TOut fold(const numeric_range<T> &r, Fun folder, TOut initial) {
+  return fold(detail::numeric_pipeline(r), std::move(folder),
+              std::move(initial));
+}
+
+/**
+ *  \brief Loops over a numeric range, calling a function on each value.
+ *  \tparam T The value type.
+ *  \tparam Fun The function type of the callback.
+ *  \param[in] r The range.
+ *  \param[in] func The function to use.
+ */
+template <typename T, typename Fun>
+  requires type::function_to<Fun, void, T>
+void foreach (const numeric_range<T> &r, Fun func) {
+  detail::numeric_pipeline(r).run(std::move(func));
+}
+
+/**
+ *  \brief Appends all values in a numeric range to a container.
+ *
+ *  See `fpgen::aggregate_to(gen, out)`. Space for all values is reserved up
+ * front, if the container supports `reserve`.
+ *
+ *  \tparam T The value type.
+ *  \tparam Container The container type to output to.
+ *  \param[in] r The range.
+ *  \param[out] out The container to output to.
+ *  \returns A reference to the modified container.
+ */
+template <typename T, typename Container>
+Container &aggregate_to(const numeric_range<T> &r, Container &out) {
+  if constexpr (requires { out.reserve(out.size()); })
+    out.reserve(out.size() + r.size());
+  return aggregate_to(detail::numeric_pipeline(r), out);
+}
+} // namespace fpgen
+
+/**
+ *  \brief Numeric ranges don't refer to any data, so their iterators may
+ * outlive them.
+ *  \tparam T The value type.
+ */
+template <typename T>
+inline constexpr bool
+    std::ranges::enable_borrowed_range<fpgen::numeric_range<T>> = true;
+
+#endif
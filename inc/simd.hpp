@@ -0,0 +1,452 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        simd.hpp
+// Purpose:     vectorized reductions over contiguous data for fpgen.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_SIMD
+#define _FPGEN_SIMD
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                               \
+    (defined(__x86_64__) || defined(__i386__))
+#define _FPGEN_SIMD_X86 1
+#define _FPGEN_SIMD_INLINE __attribute__((always_inline)) inline
+#elif defined(__GNUC__) || defined(__clang__)
+#define _FPGEN_SIMD_INLINE __attribute__((always_inline)) inline
+#else
+#define _FPGEN_SIMD_INLINE inline
+#endif
+
+/**
+ *  \brief The namespace containing fpgen's vectorized reductions and searches.
+ *
+ *  The functions work on any contiguous data (`std::vector`, `std::array`,
+ * `std::span`, the batches from fpgen::batch_generator, ...) of an arithmetic
+ * type. They use AVX2 or SSE4.2 when the CPU supports it (detected at
+ * runtime), with a scalar fallback. Floating-point reductions reorder the
+ * operations, so their results may differ in the last bits from a sequential
+ * loop like fpgen::sum.
+ */
+namespace fpgen::simd {
+/**
+ *  \brief The instruction set levels the kernels are compiled for.
+ */
+enum class level { scalar = 0, sse4 = 1, avx2 = 2 };
+
+/**
+ *  \brief Detects the best level supported by the CPU.
+ *
+ *  The result is computed once.
+ *
+ *  \returns The best supported level.
+ */
+inline level supported() noexcept {
+#ifdef _FPGEN_SIMD_X86
+  static const level best = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return level::avx2;
+    if (__builtin_cpu_supports("sse4.2"))
+      return level::sse4;
+    return level::scalar;
+  }();
+  return best;
+#else
+  return level::scalar;
+#endif
+}
+
+namespace detail {
+/**
+ *  \brief The highest level the kernels may use (see fpgen::simd::limit).
+ */
+inline std::atomic<level> ceiling{level::avx2};
+
+/**
+ *  \brief The element type of a contiguous container.
+ *  \tparam Container The container type.
+ */
+template <typename Container>
+using element_t = std::remove_cv_t<std::remove_pointer_t<decltype(std::data(
+    std::declval<const Container &>()))>>;
+
+/**
+ *  \brief Type trait restricting the reductions to arithmetic element types.
+ *  \tparam Container The container type.
+ */
+template <typename Container>
+using is_arithmetic_data = typename std::enable_if<
+    std::is_arithmetic<element_t<Container>>::value>::type;
+
+/**
+ *  \brief Kernel folding contiguous data with an associative operation.
+ *  \tparam T The element type.
+ *  \tparam Op The operation type.
+ */
+template <typename T, typename Op> struct fold_kernel {
+  /**
+   *  \brief The data.
+   */
+  const T *data;
+  /**
+   *  \brief The amount of elements.
+   */
+  size_t size;
+  /**
+   *  \brief The identity of the operation.
+   */
+  T identity;
+  /**
+   *  \brief The operation.
+   */
+  Op op;
+
+  /**
+   *  \brief Runs the kernel using `Bytes` bytes worth of independent
+   * accumulators, which the compiler maps onto vector registers.
+   *  \tparam Bytes The width of the accumulators, in bytes.
+   *  \returns The folded value.
+   */
+  template <size_t Bytes> _FPGEN_SIMD_INLINE T run() {
+    constexpr size_t lanes = Bytes / sizeof(T) > 0 ? Bytes / sizeof(T) : 1;
+    T acc[lanes];
+    for (size_t l = 0; l < lanes; l++)
+      acc[l] = identity;
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      for (size_t l = 0; l < lanes; l++)
+        acc[l] = op(acc[l], data[i + l]);
+    }
+    T result = identity;
+    for (size_t l = 0; l < lanes; l++)
+      result = op(result, acc[l]);
+    for (; i < size; i++)
+      result = op(result, data[i]);
+    return result;
+  }
+};
+
+/**
+ *  \brief Kernel computing the dot product of contiguous data.
+ *  \tparam T The element type.
+ */
+template <typename T> struct dot_kernel {
+  /**
+   *  \brief The first operand.
+   */
+  const T *lhs;
+  /**
+   *  \brief The second operand.
+   */
+  const T *rhs;
+  /**
+   *  \brief The amount of elements.
+   */
+  size_t size;
+
+  /**
+   *  \brief Runs the kernel (see fpgen::simd::detail::fold_kernel::run).
+   *  \tparam Bytes The width of the accumulators, in bytes.
+   *  \returns The dot product.
+   */
+  template <size_t Bytes> _FPGEN_SIMD_INLINE T run() {
+    constexpr size_t lanes = Bytes / sizeof(T) > 0 ? Bytes / sizeof(T) : 1;
+    T acc[lanes] = {};
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      for (size_t l = 0; l < lanes; l++)
+        acc[l] += lhs[i + l] * rhs[i + l];
+    }
+    T result = {};
+    for (size_t l = 0; l < lanes; l++)
+      result += acc[l];
+    for (; i < size; i++)
+      result += lhs[i] * rhs[i];
+    return result;
+  }
+};
+
+/**
+ *  \brief Kernel counting the occurrences of a value in contiguous data.
+ *  \tparam T The element type.
+ */
+template <typename T> struct count_kernel {
+  /**
+   *  \brief The data.
+   */
+  const T *data;
+  /**
+   *  \brief The amount of elements.
+   */
+  size_t size;
+  /**
+   *  \brief The value to count.
+   */
+  T value;
+
+  /**
+   *  \brief Runs the kernel (see fpgen::simd::detail::fold_kernel::run).
+   *  \tparam Bytes The width of the accumulators, in bytes.
+   *  \returns The amount of elements equal to the value.
+   */
+  template <size_t Bytes> _FPGEN_SIMD_INLINE size_t run() {
+    constexpr size_t lanes = Bytes / sizeof(T) > 0 ? Bytes / sizeof(T) : 1;
+    size_t acc[lanes] = {};
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      for (size_t l = 0; l < lanes; l++)
+        acc[l] += data[i + l] == value;
+    }
+    size_t result = 0;
+    for (size_t l = 0; l < lanes; l++)
+      result += acc[l];
+    for (; i < size; i++)
+      result += data[i] == value;
+    return result;
+  }
+};
+
+/**
+ *  \brief Kernel finding the first element equal to a value.
+ *  \tparam T The element type.
+ */
+template <typename T> struct find_kernel {
+  /**
+   *  \brief The data.
+   */
+  const T *data;
+  /**
+   *  \brief The amount of elements.
+   */
+  size_t size;
+  /**
+   *  \brief The value to find.
+   */
+  T value;
+
+  /**
+   *  \brief Runs the kernel: checks whole blocks of `Bytes` bytes for a match
+   * at once, and only searches a block element by element once it matched.
+   *  \tparam Bytes The width of the blocks, in bytes.
+   *  \returns The index of the first match, or the size if there's none.
+   */
+  template <size_t Bytes> _FPGEN_SIMD_INLINE size_t run() {
+    constexpr size_t lanes = Bytes / sizeof(T) > 0 ? Bytes / sizeof(T) : 1;
+    size_t i = 0;
+    for (; i + lanes <= size; i += lanes) {
+      unsigned char hit = 0;
+      for (size_t l = 0; l < lanes; l++)
+        hit |= data[i + l] == value;
+      if (hit)
+        break;
+    }
+    for (; i < size; i++) {
+      if (data[i] == value)
+        return i;
+    }
+    return size;
+  }
+};
+
+#ifdef _FPGEN_SIMD_X86
+/**
+ *  \brief Runs a kernel compiled for AVX2 (two 256-bit accumulators).
+ *  \param[in] kernel The kernel.
+ *  \returns The kernel's result.
+ */
+template <typename Kernel>
+__attribute__((target("avx2"))) auto run_avx2(Kernel kernel) {
+  return kernel.template run<64>();
+}
+
+/**
+ *  \brief Runs a kernel compiled for SSE4.2 (two 128-bit accumulators).
+ *  \param[in] kernel The kernel.
+ *  \returns The kernel's result.
+ */
+template <typename Kernel>
+__attribute__((target("sse4.2"))) auto run_sse4(Kernel kernel) {
+  return kernel.template run<32>();
+}
+#endif
+
+/**
+ *  \brief Runs a kernel at the best allowed level.
+ *  \param[in] kernel The kernel.
+ *  \returns The kernel's result.
+ */
+template <typename Kernel> auto dispatch(Kernel kernel) {
+  level use = std::min(supported(), ceiling.load(std::memory_order_relaxed));
+#ifdef _FPGEN_SIMD_X86
+  if (use == level::avx2)
+    return run_avx2(kernel);
+  if (use == level::sse4)
+    return run_sse4(kernel);
+#endif
+  // a single accumulator: a plain loop
+  return kernel.template run<1>();
+}
+} // namespace detail
+
+/**
+ *  \brief Limits the instruction set used by the kernels.
+ *
+ *  By default, the best level supported by the CPU is used. Limiting the level
+ * is mostly useful for testing and benchmarking.
+ *
+ *  \param[in] max The highest level to use.
+ */
+inline void limit(level max) noexcept {
+  detail::ceiling.store(max, std::memory_order_relaxed);
+}
+
+/**
+ *  \brief Gets the level the kernels currently use.
+ *  \returns The active level.
+ */
+inline level active() noexcept {
+  return std::min(supported(),
+                  detail::ceiling.load(std::memory_order_relaxed));
+}
+
+/**
+ *  \brief Folds contiguous data with an associative and commutative
+ * operation.
+ *
+ *  The operation is applied in an unspecified order, to several independent
+ * accumulators (each starting from `identity`) which are combined at the end.
+ * It should therefore be associative and commutative, and `identity` should be
+ * its identity element (`0` for `+`, `1` for `*`, ...). Simple operations (like
+ * the ones in `<functional>`, or lambdas using arithmetic operators) are
+ * vectorized.
+ *
+ *  \tparam Container The container type.
+ *  \tparam Op The operation type, `(T, T) -> T`.
+ *  \tparam T The element type.
+ *  \param[in] data The data to fold.
+ *  \param[in] identity The identity element of the operation.
+ *  \param[in] op The operation.
+ *  \returns The folded value.
+ */
+template <typename Container, typename Op,
+          typename T = detail::element_t<Container>,
+          typename _ = detail::is_arithmetic_data<Container>>
+T fold(const Container &data, T identity, Op op) {
+  return detail::dispatch(detail::fold_kernel<T, Op>{
+      std::data(data), std::size(data), identity, std::move(op)});
+}
+
+/**
+ *  \brief Sums contiguous data.
+ *  \tparam Container The container type.
+ *  \tparam T The element type.
+ *  \param[in] data The data to sum.
+ *  \returns The sum of all elements (`0` if there are none).
+ */
+template <typename Container, typename T = detail::element_t<Container>,
+          typename _ = detail::is_arithmetic_data<Container>>
+T sum(const Container &data) {
+  return fold(data, T{}, [](T lhs, T rhs) -> T { return lhs + rhs; });
+}
+
+/**
+ *  \brief Finds the smallest element in contiguous data.
+ *  \tparam Container The container type.
+ *  \tparam T The element type.
+ *  \param[in] data The data to search; shouldn't be empty.
+ *  \returns The smallest element.
+ */
+template <typename Container, typename T = detail::element_t<Container>,
+          typename _ = detail::is_arithmetic_data<Container>>
+T min(const Container &data) {
+  if (std::size(data) == 0)
+    throw std::invalid_argument("fpgen::simd::min on empty data");
+  return fold(data, *std::data(data),
+              [](T lhs, T rhs) { return rhs < lhs ? rhs : lhs; });
+}
+
+/**
+ *  \brief Finds the largest element in contiguous data.
+ *  \tparam Container The container type.
+ *  \tparam T The element type.
+ *  \param[in] data The data to search; shouldn't be empty.
+ *  \returns The largest element.
+ */
+template <typename Container, typename T = detail::element_t<Container>,
+          typename _ = detail::is_arithmetic_data<Container>>
+T max(const Container &data) {
+  if (std::size(data) == 0)
+    throw std::invalid_argument("fpgen::simd::max on empty data");
+  return fold(data, *std::data(data),
+              [](T lhs, T rhs) { return lhs < rhs ? rhs : lhs; });
+}
+
+/**
+ *  \brief Counts the elements equal to a value in contiguous data.
+ *  \tparam Container The container type.
+ *  \tparam T The element type.
+ *  \param[in] data The data to search.
+ *  \param[in] value The value to count.
+ *  \returns The amount of elements equal to the value.
+ */
+template <typename Container, typename T = detail::element_t<Container>,
+          typename _ = detail::is_arithmetic_data<Container>>
+size_t count(const Container &data, T value) {
+  return detail::dispatch(
+      detail::count_kernel<T>{std::data(data), std::size(data), value});
+}
+
+/**
+ *  \brief Finds the first element equal to a value in contiguous data.
+ *  \tparam Container The container type.
+ *  \tparam T The element type.
+ *  \param[in] data The data to search.
+ *  \param[in] value The value to find.
+ *  \returns The index of the first element equal to the value, or the size of
+ * the data if there's none.
+ */
+template <typename Container, typename T = detail::element_t<Container>,
+          typename _ = detail::is_arithmetic_data<Container>>
+size_t find(const Container &data, T value) {
+  return detail::dispatch(
+      detail::find_kernel<T>{std::data(data), std::size(data), value});
+}
+
+/**
+ *  \brief Computes the dot product of two contiguous datasets.
+ *
+ *  Only the first `n` elements of both are used, where `n` is the size of the
+ * smallest one.
+ *
+ *  \tparam Container1 The first container type.
+ *  \tparam Container2 The second container type.
+ *  \tparam T The element type (the same for both).
+ *  \param[in] lhs The first dataset.
+ *  \param[in] rhs The second dataset.
+ *  \returns The sum of the pairwise products.
+ */
+template <typename Container1, typename Container2,
+          typename T = detail::element_t<Container1>,
+          typename _ = detail::is_arithmetic_data<Container1>,
+          typename = std::enable_if_t<
+              std::is_same<T, detail::element_t<Container2>>::value>>
+T dot(const Container1 &lhs, const Container2 &rhs) {
+  return detail::dispatch(detail::dot_kernel<T>{
+      std::data(lhs), std::data(rhs),
+      std::min<size_t>(std::size(lhs), std::size(rhs))});
+}
+} // namespace fpgen::simd
+
+#undef _FPGEN_SIMD_INLINE
+
+#endif
@@ -0,0 +1,433 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        sink.hpp
+// Purpose:     buffered output sinks for fpgen (POSIX).
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_SINK
+#define _FPGEN_SINK
+
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "generator.hpp"
+#include "io.hpp"
+
+#include <fcntl.h>
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+/**
+ *  \brief When an fpgen::fd_sink writes its buffer out.
+ */
+enum class flush_policy {
+  /**
+   *  \brief Only when the buffer is full, or on an explicit flush.
+   */
+  full,
+  /**
+   *  \brief As with `full`, and after each write containing a newline.
+   */
+  line,
+  /**
+   *  \brief After each write (slow; for interactive output).
+   */
+  always
+};
+
+/**
+ *  \brief The options for an fpgen::fd_sink.
+ */
+struct sink_options {
+  /**
+   *  \brief The size of the buffer (in bytes). Each system call writes (up to)
+   * this many bytes.
+   */
+  size_t capacity = 1 << 16;
+  /**
+   *  \brief When to write the buffer out.
+   */
+  flush_policy policy = flush_policy::full;
+  /**
+   *  \brief Whether to write on a background thread. A second buffer is
+   * filled while the previous one is being written.
+   */
+  bool background = false;
+};
+
+namespace detail {
+/**
+ *  \brief Writes buffers to a file descriptor on its own thread.
+ *
+ *  One buffer can be pending at a time; handing over another one waits until
+ * the previous one is written. A failed write is reported on the next
+ * hand-over (or wait), and drops all data handed over until then.
+ */
+class background_writer {
+public:
+  /**
+   *  \brief Starts the writer thread.
+   *  \param[in] fd The file descriptor.
+   *  \param[in] capacity The size of the spare buffer.
+   */
+  background_writer(int fd, size_t capacity)
+      : _fd{fd}, _pending(capacity), _thread{[this]() { run(); }} {}
+
+  background_writer(const background_writer &) = delete;
+  background_writer &operator=(const background_writer &) = delete;
+
+  /**
+   *  \brief Writes whatever is pending, then joins the thread.
+   */
+  ~background_writer() {
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      _stop = true;
+    }
+    _changed.notify_all();
+    _thread.join();
+  }
+
+  /**
+   *  \brief Hands a buffer over to the writer, and replaces it by the spare
+   * buffer (of the same size).
+   *  \param[in,out] buffer The buffer to write.
+   *  \param[in] size The amount of bytes to write from the buffer.
+   *  \throws std::system_error If a previous write failed.
+   */
+  void submit(std::vector<char> &buffer, size_t size) {
+    std::unique_lock<std::mutex> guard(_lock);
+    _changed.wait(guard, [this]() { return !_busy; });
+    rethrow();
+    std::swap(buffer, _pending);
+    _size = size;
+    _busy = true;
+    guard.unlock();
+    _changed.notify_all();
+  }
+
+  /**
+   *  \brief Waits until all handed over buffers are written.
+   *  \throws std::system_error If a write failed.
+   */
+  void wait() {
+    std::unique_lock<std::mutex> guard(_lock);
+    _changed.wait(guard, [this]() { return !_busy; });
+    rethrow();
+  }
+
+private:
+  // called with the lock held
+  void rethrow() {
+    if (_error)
+      std::rethrow_exception(std::exchange(_error, nullptr));
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> guard(_lock);
+    while (true) {
+      _changed.wait(guard, [this]() { return _busy || _stop; });
+      if (!_busy)
+        return;
+      // the consumer doesn't touch the pending buffer while busy
+      guard.unlock();
+      std::exception_ptr error;
+      try {
+        write_all(_fd, _pending.data(), _size);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      guard.lock();
+      if (error && !_error)
+        _error = error;
+      _busy = false;
+      _changed.notify_all();
+    }
+  }
+
+  int _fd;
+  std::mutex _lock;
+  std::condition_variable _changed;
+  std::vector<char> _pending;
+  size_t _size = 0;
+  bool _busy = false;
+  bool _stop = false;
+  std::exception_ptr _error;
+  std::thread _thread;
+};
+} // namespace detail
+
+/**
+ *  \brief A buffered output sink, writing to a file descriptor.
+ *
+ *  Unlike `std::ostream`, values are formatted straight into a large buffer
+ * (numbers using `std::to_chars`), and the buffer is written out with a single
+ * `write(2)` once full (or according to the fpgen::flush_policy). Writes larger
+ * than the buffer go out with a single `writev(2)`, together with what's
+ * buffered.
+ *
+ *  The sink is flushed on destruction; errors are ignored there, so call
+ * `flush` first to see them.
+ */
+class fd_sink {
+public:
+  /**
+   *  \brief Creates a sink writing to a file descriptor (which is not closed
+   * by the sink).
+   *  \param[in] fd The file descriptor.
+   *  \param[in] options The buffer size and flush policy.
+   */
+  explicit fd_sink(int fd, sink_options options = {})
+      : fd_sink(fd, detail::unique_fd(), options) {}
+
+  /**
+   *  \brief Creates (or truncates) a file, and creates a sink writing to it.
+   *  \param[in] path The path to the file.
+   *  \param[in] options The buffer size and flush policy.
+   *  \throws std::system_error If the file can't be opened.
+   */
+  explicit fd_sink(const std::string &path, sink_options options = {})
+      : fd_sink(detail::open_file(path, O_WRONLY | O_CREAT | O_TRUNC, false),
+                options) {}
+
+  fd_sink(const fd_sink &) = delete;
+  fd_sink &operator=(const fd_sink &) = delete;
+
+  /**
+   *  \brief Flushes the sink, ignoring errors.
+   */
+  ~fd_sink() {
+    try {
+      flush();
+    } catch (...) {
+    }
+  }
+
+  /**
+   *  \brief Appends bytes to the sink.
+   *  \param[in] bytes The bytes to write.
+   *  \returns The sink itself.
+   *  \throws std::system_error If writing fails.
+   */
+  fd_sink &write(std::string_view bytes) {
+    append(bytes);
+    apply_policy(bytes.find('\n') != std::string_view::npos);
+    return *this;
+  }
+
+  /**
+   *  \brief Formats a value, and appends it to the sink.
+   *
+   *  Booleans are written as `0` or `1`, and characters as themselves (like
+   * `std::ostream` does). Other arithmetic types are formatted by
+   * `std::to_chars` (for floating-point values, this is the shortest
+   * representation that reads back to the same value). Anything convertible to
+   * `std::string_view` is written as-is; all other types go through their
+   * `operator<<`.
+   *
+   *  \tparam T The type of the value.
+   *  \param[in] value The value to write.
+   *  \returns The sink itself.
+   *  \throws std::system_error If writing fails.
+   */
+  template <typename T> fd_sink &put(const T &value) {
+    using type = std::remove_cvref_t<T>;
+    if constexpr (std::is_same_v<type, bool>) {
+      append_char(value ? '1' : '0');
+      apply_policy(false);
+    } else if constexpr (std::is_same_v<type, char> ||
+                         std::is_same_v<type, signed char> ||
+                         std::is_same_v<type, unsigned char>) {
+      append_char(static_cast<char>(value));
+      apply_policy(value == '\n');
+    } else if constexpr (std::is_arithmetic_v<type>) {
+      if (_buffer.size() - _used < max_number)
+        drain();
+      auto result = std::to_chars(_buffer.data() + _used,
+                                  _buffer.data() + _buffer.size(), value);
+      _used = static_cast<size_t>(result.ptr - _buffer.data());
+      apply_policy(false);
+    } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+      write(std::string_view(value));
+    } else {
+      std::ostringstream formatted;
+      formatted << value;
+      write(formatted.view());
+    }
+    return *this;
+  }
+
+  /**
+   *  \brief Writes everything buffered to the file descriptor.
+   *  \returns The sink itself.
+   *  \throws std::system_error If writing fails.
+   */
+  fd_sink &flush() {
+    drain();
+    if (_writer)
+      _writer->wait();
+    return *this;
+  }
+
+  /**
+   *  \brief Gets the file descriptor the sink writes to.
+   *  \returns The file descriptor.
+   */
+  int fd() const { return _fd; }
+
+private:
+  fd_sink(detail::unique_fd owned, sink_options options)
+      : fd_sink(owned.get(), std::move(owned), options) {}
+
+  fd_sink(int fd, detail::unique_fd &&owned, sink_options options)
+      : _fd{fd}, _owned{std::move(owned)},
+        _buffer(std::max<size_t>(options.capacity, min_capacity)),
+        _policy{options.policy} {
+    if (options.background)
+      _writer =
+          std::make_unique<detail::background_writer>(fd, _buffer.size());
+  }
+
+  // room for any number std::to_chars can produce
+  static constexpr size_t max_number = 64;
+  static constexpr size_t min_capacity = max_number;
+
+  void append_char(char c) {
+    if (_used == _buffer.size())
+      drain();
+    _buffer[_used++] = c;
+  }
+
+  void append(std::string_view bytes) {
+    if (bytes.size() <= _buffer.size() - _used) {
+      std::memcpy(_buffer.data() + _used, bytes.data(), bytes.size());
+      _used += bytes.size();
+      return;
+    }
+    if (!_writer && bytes.size() >= _buffer.size()) {
+      // one system call for the buffer and the bytes, without copying
+      detail::write_vectored(_fd, {_buffer.data(), _used}, bytes);
+      _used = 0;
+      return;
+    }
+    while (!bytes.empty()) {
+      if (_used == _buffer.size())
+        drain();
+      size_t part = std::min(bytes.size(), _buffer.size() - _used);
+      std::memcpy(_buffer.data() + _used, bytes.data(), part);
+      _used += part;
+      bytes.remove_prefix(part);
+    }
+  }
+
+  void apply_policy(bool newline) {
+    if (_policy == flush_policy::always ||
+        (newline && _policy == flush_policy::line))
+      flush();
+  }
+
+  void drain() {
+    if (_used == 0)
+      return;
+    if (_writer) {
+      _writer->submit(_buffer, _used);
+    } else {
+      detail::write_all(_fd, _buffer.data(), _used);
+    }
+    _used = 0;
+  }
+
+  int _fd;
+  detail::unique_fd _owned;
+  std::vector<char> _buffer;
+  size_t _used = 0;
+  flush_policy _policy;
+  std::unique_ptr<detail::background_writer> _writer;
+};
+
+/**
+ *  \brief Writes each value to the sink.
+ *
+ *  Calls `sink.put(value)` for each value in the generator. The sink is not
+ * flushed (besides what its fpgen::flush_policy requires).
+ *
+ *  \tparam T The type of values in the stream.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator supplying the values.
+ *  \param[in,out] sink The sink to output to.
+ *  \returns The sink.
+ *  \throws std::system_error If writing fails.
+ */
+template <typename T, typename P>
+fd_sink &to_sink(generator<T, P> gen, fd_sink &sink) {
+  for (auto &&v : gen) {
+    sink.put(v);
+  }
+  return sink;
+}
+
+/**
+ *  \brief Writes each value to the sink. Values are separated by the given
+ * separator.
+ *
+ *  \tparam T The type of values in the stream.
+ *  \tparam P The exception policy of the generator.
+ *  \tparam T2 The type of the separator.
+ *  \param[in,out] gen The generator supplying the values.
+ *  \param[in,out] sink The sink to output to.
+ *  \param[in] separator The separator to use.
+ *  \returns The sink.
+ *  \throws std::system_error If writing fails.
+ */
+template <typename T, typename P, typename T2>
+fd_sink &to_sink(generator<T, P> gen, fd_sink &sink, const T2 &separator) {
+  bool first = true;
+  for (auto &&v : gen) {
+    if (!first)
+      sink.put(separator);
+    sink.put(v);
+    first = false;
+  }
+  return sink;
+}
+
+/**
+ *  \brief Writes each value to the sink on a separate line (with a trailing
+ * newline).
+ *
+ *  The sink-based counterpart of fpgen::to_lines.
+ *
+ *  \tparam T The type of values in the stream.
+ *  \tparam P The exception policy of the generator.
+ *  \param[in,out] gen The generator supplying the values.
+ *  \param[in,out] sink The sink to output to.
+ *  \returns The sink.
+ *  \throws std::system_error If writing fails.
+ */
+template <typename T, typename P>
+fd_sink &to_sink_lines(generator<T, P> gen, fd_sink &sink) {
+  for (auto &&v : gen) {
+    sink.put(v);
+    sink.put('\n');
+  }
+  return sink;
+}
+} // namespace fpgen
+
+#endif
@@ -10,9 +10,12 @@
 
 #include <istream>
 #include <iterator>
+#include <limits>
+#include <ranges>
 #include <type_traits>
 #include <string>
 #include <tuple>
+#include <utility>
 #include "generator.hpp"
 #include "type_traits.hpp"
 
@@ -20,27 +23,325 @@
  *  \brief The namespace containing all of fpgen's code.
  */
 namespace fpgen {
+namespace detail {
+/**
+ *  \brief Type trait checking whether a container knows its size (using
+ * `std::size`).
+ *  \tparam Container The container type.
+ */
+template <typename Container, typename = void>
+struct is_sized : std::false_type {};
+/**
+ *  \brief Type trait checking whether a container knows its size (using
+ * `std::size`).
+ *  \tparam Container The container type.
+ */
+template <typename Container>
+struct is_sized<Container, std::void_t<decltype(std::size(
+                               std::declval<const Container &>()))>>
+    : std::true_type {};
+
+/**
+ *  \brief Type trait checking whether a container has random-access
+ * iterators (like `std::vector`, `std::deque` or arrays).
+ *  \tparam Container The container type.
+ */
+template <typename Container>
+using is_random_access = std::is_base_of<
+    std::random_access_iterator_tag,
+    typename std::iterator_traits<decltype(std::begin(
+        std::declval<Container &>()))>::iterator_category>;
+
+/**
+ *  \brief Type alias for the iterator type of a container.
+ *  \tparam Container The container type.
+ */
+template <typename Container>
+using iterator_type = decltype(std::begin(std::declval<Container &>()));
+
+/**
+ *  \brief Type trait checking whether indexing a container's iterators (if
+ * they are random-access) can't throw.
+ *  \tparam Container The container type.
+ */
+template <typename Container, bool = is_random_access<Container>::value>
+struct is_nothrow_indexable : std::true_type {};
+/**
+ *  \brief Type trait checking whether indexing a container's iterators (if
+ * they are random-access) can't throw.
+ *  \tparam Container The container type.
+ */
+template <typename Container>
+struct is_nothrow_indexable<Container, true>
+    : std::bool_constant<noexcept(
+          std::declval<iterator_type<Container> &>()[size_t{}])> {};
+
+/**
+ *  \brief Type trait checking whether iterating over a container can't throw
+ * (`*it`, `++it`, `it != end` and, for random-access iterators, `it[n]` are
+ * all `noexcept`).
+ *  \tparam Container The container type.
+ */
+template <typename Container>
+struct is_nothrow_iterable
+    : std::bool_constant<
+          noexcept(*std::declval<iterator_type<Container> &>()) &&
+          noexcept(++std::declval<iterator_type<Container> &>()) &&
+          noexcept(std::declval<iterator_type<Container> &>() !=
+                   std::declval<iterator_type<Container> &>()) &&
+          is_nothrow_indexable<Container>::value> {};
+
+/**
+ *  \brief The exception policy for a generator over a container: it doesn't
+ * throw (see fpgen::nothrow_policy) if iterating doesn't, and neither does
+ * constructing the yielded values from the elements.
+ *  \tparam Container The container type.
+ *  \tparam T The type of the values yielded.
+ */
+template <typename Container, typename T>
+using source_policy = policy_for<
+    nothrow_policy,
+    is_nothrow_iterable<Container>::value &&
+        std::is_nothrow_constructible_v<
+            T, decltype(*std::declval<iterator_type<Container> &>())>>;
+
+/**
+ *  \brief Type trait checking whether copying and incrementing
+ * (`operator++()`) a value can't throw.
+ *  \tparam T The value type.
+ */
+template <typename T>
+struct is_nothrow_incrementable
+    : std::bool_constant<std::is_nothrow_copy_constructible_v<T> &&
+                         noexcept(++std::declval<T &>())> {};
+
+/**
+ *  \brief The exception policy for fpgen::inc.
+ *  \tparam T The value type.
+ */
+template <typename T>
+using inc_policy =
+    policy_for<nothrow_policy, is_nothrow_incrementable<T>::value>;
+
+/**
+ *  \brief Sets the size hint for a generator over a container, and makes it
+ * seekable if the container has random-access iterators.
+ *  \tparam Gen The generator type.
+ *  \tparam Container The container type.
+ *  \param[in,out] gen The generator.
+ *  \param[in] cont The container.
+ */
+template <typename Gen, typename Container>
+void describe_source(Gen &gen, Container &cont) {
+  if constexpr (is_sized<Container>::value)
+    gen.set_hint(size_hint::exact(std::size(cont)));
+  if constexpr (is_random_access<Container>::value)
+    gen.set_seekable(std::size(cont));
+}
+
+/**
+ *  \brief Yields a copy of each element in a container.
+ *  \tparam T The type contained in the container.
+ *  \tparam Policy The exception policy.
+ *  \tparam Container The container type.
+ *  \param[in] cont The container.
+ *  \returns A generator over the container.
+ */
+template <typename T, typename Policy, typename Container>
+generator<T, Policy> from_impl(const Container &cont) {
+  if constexpr (is_random_access<const Container>::value) {
+    cursor &at = co_await get_cursor{};
+    auto first = std::begin(cont);
+    for (; at.position < at.end; at.position++) {
+      co_yield first[at.position];
+    }
+  } else {
+    for (auto it = std::begin(cont); it != std::end(cont); ++it) {
+      co_yield *it;
+    }
+  }
+  co_return;
+}
+
+/**
+ *  \brief Yields a reference to each element in a container.
+ *  \tparam TRef The reference type yielded.
+ *  \tparam Policy The exception policy.
+ *  \tparam Container The container type.
+ *  \param[in] cont The container.
+ *  \returns A generator over the container.
+ */
+template <typename TRef, typename Policy, typename Container>
+generator<TRef, Policy> from_ref_impl(Container &cont) {
+  if constexpr (is_random_access<Container>::value) {
+    cursor &at = co_await get_cursor{};
+    auto first = std::begin(cont);
+    for (; at.position < at.end; at.position++) {
+      co_yield first[at.position];
+    }
+  } else {
+    for (auto it = std::begin(cont); it != std::end(cont); ++it) {
+      co_yield *it;
+    }
+  }
+  co_return;
+}
+
+/**
+ *  \brief Yields each element in a container, with its index.
+ *  \tparam T The type contained in the container.
+ *  \tparam Policy The exception policy.
+ *  \tparam Container The container type.
+ *  \param[in] cont The container.
+ *  \returns A generator over the container.
+ */
+template <typename T, typename Policy, typename Container>
+generator<std::tuple<size_t, T>, Policy>
+enumerate_impl(const Container &cont) {
+  if constexpr (is_random_access<const Container>::value) {
+    cursor &at = co_await get_cursor{};
+    auto first = std::begin(cont);
+    for (; at.position < at.end; at.position++) {
+      co_yield {at.position, first[at.position]};
+    }
+  } else {
+    size_t i = 0;
+    for (auto it = std::begin(cont); it != std::end(cont); ++it) {
+      co_yield {i, *it};
+      i++;
+    }
+  }
+  co_return;
+}
+
+/**
+ *  \brief Yields increasing values, starting from a given one.
+ *  \tparam T The (integral) value type.
+ *  \param[in] start The first value.
+ *  \returns A seekable generator over the values.
+ */
+template <typename T> generator<T, inc_policy<T>> inc_impl(T start) {
+  cursor &at = co_await get_cursor{};
+  for (; at.position < at.end; at.position++) {
+    co_yield static_cast<T>(start + static_cast<T>(at.position));
+  }
+  co_return;
+}
+
+/**
+ *  \brief Yields increasing values, starting from a given one.
+ *  \tparam T The value type (supporting `operator++()`).
+ *  \param[in] start The first value.
+ *  \returns An infinite generator over the values.
+ */
+template <typename T> generator<T, inc_policy<T>> inc_generic(T start) {
+  T value = start;
+  while (true) {
+    co_yield value;
+    ++value;
+  }
+}
+
+/**
+ *  \brief Yields each key-value pair in an associative container.
+ *  \tparam TKey The key type.
+ *  \tparam TVal The value type.
+ *  \tparam Policy The exception policy.
+ *  \tparam Container The container type.
+ *  \param[in] cont The container.
+ *  \returns A generator over the container.
+ */
+template <typename TKey, typename TVal, typename Policy, typename Container>
+generator<std::tuple<TKey, TVal>, Policy>
+from_tup_impl(const Container &cont) {
+  for (auto it = cont.begin(); it != cont.end(); ++it) {
+    co_yield *it;
+  }
+  co_return;
+}
+/**
+ *  \brief Yields each element in a range.
+ *  \tparam T The type of the values yielded.
+ *  \tparam View The view type (see `std::views::all`).
+ *  \param[in] view The view over the range; owned by the coroutine.
+ *  \returns A generator over the range.
+ */
+template <typename T, typename View> generator<T> from_range_impl(View view) {
+  if constexpr (std::ranges::random_access_range<View> &&
+                std::ranges::sized_range<View>) {
+    cursor &at = co_await get_cursor{};
+    auto first = std::ranges::begin(view);
+    for (; at.position < at.end; at.position++) {
+      co_yield first[static_cast<std::ranges::range_difference_t<View>>(
+          at.position)];
+    }
+  } else {
+    auto last = std::ranges::end(view);
+    for (auto it = std::ranges::begin(view); it != last; ++it) {
+      co_yield *it;
+    }
+  }
+  co_return;
+}
+} // namespace detail
+
 /**
  *  \brief Creates a generator over a data source.
  *
  *  The data source should have an iterator (using `std::begin` and `std::end`).
  * For most builtin containers (`std::vector`, ...) this is already satisfied.
- * For `std::map`, see fpgen::from_tup.
+ * For `std::map`, see fpgen::from_tup. Each element is copied once; to iterate
+ * without copies, see fpgen::from_ref. The generator's size hint is the size of
+ * the container (see fpgen::size_hint). Generators over random-access
+ * containers are seekable (see fpgen::generator::seekable); the same goes for
+ * fpgen::from_ref and fpgen::enumerate. If neither iterating over the container
+ * nor copying its elements can throw, the result is a nothrow generator (see
+ * fpgen::nothrow_policy); the same goes for fpgen::from_ref, fpgen::enumerate
+ * and fpgen::from_tup.
  *
  *  \tparam T The type contained in the container.
  *  \tparam TArgs Any other template parameters passed to the container.
  *  \tparam Container The container type.
  *  \param[in] cont The container to iterate over.
  *  \returns A new generator which will iterate over the container.
- *  \see fpgen::from_tup, fpgen::enumerate
+ *  \see fpgen::from_tup, fpgen::from_ref, fpgen::enumerate
  */
 template <typename T, typename... TArgs,
           template <typename...> typename Container>
-generator<T> from(const Container<T, TArgs...> &cont) {
-  for (auto it = std::begin(cont); it != std::end(cont); ++it) {
-    co_yield *it;
-  }
-  co_return;
+generator<T, detail::source_policy<const Container<T, TArgs...>, T>>
+from(const Container<T, TArgs...> &cont) {
+  auto gen = detail::from_impl<
+      T, detail::source_policy<const Container<T, TArgs...>, T>>(cont);
+  detail::describe_source(gen, cont);
+  return gen;
+}
+
+/**
+ *  \brief Creates a generator yielding references to the elements in a data
+ * source.
+ *
+ *  Unlike fpgen::from, the elements aren't copied: the generator yields
+ * references to the elements in the container (`const T &` for a const
+ * container, `T &` otherwise). This works for any iterable container; for
+ * associative containers like `std::map`, the elements are the stored key-value
+ * pairs. The container should outlive the generator and shouldn't be modified
+ * while iterating.
+ *
+ *  \tparam Container The container type.
+ *  \tparam TRef The reference type yielded. This type is deduced from the
+ * container's iterators.
+ *  \param[in] cont The container to iterate over.
+ *  \returns A new generator which will yield each element in the container.
+ *  \see fpgen::from
+ */
+template <typename Container,
+          typename TRef = decltype(*std::begin(std::declval<Container &>()))>
+generator<TRef, detail::source_policy<Container, TRef>>
+from_ref(Container &cont) {
+  auto gen =
+      detail::from_ref_impl<TRef, detail::source_policy<Container, TRef>>(cont);
+  detail::describe_source(gen, cont);
+  return gen;
 }
 
 /**
@@ -60,13 +361,13 @@ generator<T> from(const Container<T, TArgs...> &cont) {
  */
 template <typename T, typename... TArgs,
           template <typename...> typename Container>
-generator<std::tuple<size_t, T>> enumerate(const Container<T, TArgs...> &cont) {
-  size_t i = 0;
-  for (auto it = std::begin(cont); it != std::end(cont); ++it) {
-    co_yield {i, *it};
-    i++;
-  }
-  co_return;
+generator<std::tuple<size_t, T>,
+          detail::source_policy<const Container<T, TArgs...>, T>>
+enumerate(const Container<T, TArgs...> &cont) {
+  auto gen = detail::enumerate_impl<
+      T, detail::source_policy<const Container<T, TArgs...>, T>>(cont);
+  detail::describe_source(gen, cont);
+  return gen;
 }
 
 /**
@@ -87,12 +388,51 @@ generator<std::tuple<size_t, T>> enumerate(const Container<T, TArgs...> &cont) {
  */
 template <typename TKey, typename TVal, typename... TArgs,
           template <typename...> typename Container>
-generator<std::tuple<TKey, TVal>>
+generator<std::tuple<TKey, TVal>,
+          detail::source_policy<const Container<TKey, TVal, TArgs...>,
+                                std::tuple<TKey, TVal>>>
 from_tup(const Container<TKey, TVal, TArgs...> &cont) {
-  for (auto it = cont.begin(); it != cont.end(); ++it) {
-    co_yield *it;
-  }
-  co_return;
+  auto gen = detail::from_tup_impl<
+      TKey, TVal,
+      detail::source_policy<const Container<TKey, TVal, TArgs...>,
+                            std::tuple<TKey, TVal>>>(cont);
+  detail::describe_source(gen, cont);
+  return gen;
+}
+
+/**
+ *  \brief Creates a generator over any range.
+ *
+ *  Reads the elements straight from the range (a container, a standard view
+ * like `std::views::iota(0, n) | std::views::transform(f)`, ...), without an
+ * intermediate container. The range is wrapped using `std::views::all`:
+ * containers passed as lvalues should outlive the generator, while rvalues are
+ * moved into it. Sized ranges give an exact size hint (see fpgen::size_hint),
+ * and sized random-access ranges are seekable (see
+ * fpgen::generator::seekable).
+ *
+ *  \tparam Range The range type.
+ *  \tparam T The type of the values yielded; the range's value type.
+ *  \param[in] range The range to iterate over.
+ *  \returns A new generator which yields each element in the range.
+ *  \see fpgen::from, fpgen::from_ref
+ */
+template <typename Range, typename T = std::ranges::range_value_t<Range>>
+  requires std::ranges::input_range<Range> &&
+           std::ranges::viewable_range<Range>
+generator<T> from_range(Range &&range) {
+  auto view = std::views::all(std::forward<Range>(range));
+  using View = decltype(view);
+  size_t size = 0;
+  if constexpr (std::ranges::sized_range<View>)
+    size = static_cast<size_t>(std::ranges::size(view));
+  generator<T> gen = detail::from_range_impl<T>(std::move(view));
+  if constexpr (std::ranges::sized_range<View>)
+    gen.set_hint(size_hint::exact(size));
+  if constexpr (std::ranges::random_access_range<View> &&
+                std::ranges::sized_range<View>)
+    gen.set_seekable(size);
+  return gen;
 }
 
 /**
@@ -101,17 +441,23 @@ from_tup(const Container<TKey, TVal, TArgs...> &cont) {
  *  The generator is contstructed by continuously incrementing (a copy of) the
  * given value. While mainly meant for integral types, any type supporting
  * operator++() (the prefix increment operator) can be used. The first value
- * returned is the start value itself.
+ * returned is the start value itself. For integral types, the generator is
+ * seekable (see fpgen::generator::seekable). If neither copying nor
+ * incrementing the value can throw, the result is a nothrow generator (see
+ * fpgen::nothrow_policy).
  *
  *  \tparam T The type to increment.
  *  \param[in] start The initial value.
  *  \returns An infinite generator which increments a value.
  */
-template <typename T> generator<T> inc(T start) {
-  T value = start;
-  while (true) {
-    co_yield value;
-    ++value;
+template <typename T> generator<T, detail::inc_policy<T>> inc(T start) {
+  if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+    // seekable, so dropping values from it is cheap
+    auto gen = detail::inc_impl(start);
+    gen.set_seekable(std::numeric_limits<size_t>::max());
+    return gen;
+  } else {
+    return detail::inc_generic(std::move(start));
   }
 }
 
@@ -123,7 +469,8 @@ template <typename T> generator<T> inc(T start) {
  * in the generator. Once the stream fails (`!stream.good()`) or the stream
  * reaches EOF, the generator stops. Trailing whitespace may result in
  * unpredictable behaviour. Since the stream isn't copied, using the generator
- * after the stream goes out of scope is undefined behaviour.
+ * after the stream goes out of scope is undefined behaviour. If the function is
+ * `noexcept`, the result is a nothrow generator (see fpgen::nothrow_policy).
  *
  *  \tparam Fun The type of the function. Should have the signature
  * (std::istream &) -> T.
@@ -134,9 +481,12 @@ template <typename T> generator<T> inc(T start) {
  *  \returns A new generator which will iterate over the given stream, each time
  * applying the given function to retrieve the next value.
  */
-template <typename Fun, typename TOut = type::output_type<Fun, std::istream &>,
-          typename _ = type::is_function_to<Fun, TOut, std::istream &>>
-generator<TOut> from_stream(std::istream &stream, Fun func) {
+template <typename Fun, typename TOut = type::output_type<Fun, std::istream &>>
+  requires type::function_to<Fun, TOut, std::istream &>
+generator<TOut, detail::policy_for<nothrow_policy,
+                                   std::is_nothrow_invocable_v<
+                                       Fun &, std::istream &>>>
+from_stream(std::istream &stream, Fun func) {
   while (stream.good() && !stream.eof()) {
     co_yield func(stream);
   }
@@ -0,0 +1,295 @@
+/////////////////////////////////////////////////////////////////////////////
+// Name:        thread_pool.hpp
+// Purpose:     a work-stealing thread pool for fpgen's parallel algorithms.
+// Author:      jay-tux
+// Copyright:   (c) 2022 jay-tux
+// Licence:     MPL
+/////////////////////////////////////////////////////////////////////////////
+#ifndef _FPGEN_THREAD_POOL
+#define _FPGEN_THREAD_POOL
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ *  \brief The namespace containing all of fpgen's code.
+ */
+namespace fpgen {
+/**
+ *  \brief A move-only, type-erased job (a callable without arguments).
+ *
+ *  Unlike `std::function`, jobs can hold move-only callables.
+ */
+class job {
+public:
+  /**
+   *  \brief Creates an empty job.
+   */
+  job() = default;
+
+  /**
+   *  \brief Wraps a callable.
+   *  \tparam Fun The callable type; `void()`.
+   *  \param[in] func The callable.
+   */
+  template <typename Fun, typename _ = std::enable_if_t<
+                              !std::is_same<std::decay_t<Fun>, job>::value>>
+  job(Fun &&func)
+      : _impl{std::make_unique<impl<std::decay_t<Fun>>>(
+            std::forward<Fun>(func))} {}
+
+  /**
+   *  \brief Runs the job.
+   */
+  void operator()() { _impl->run(); }
+
+  /**
+   *  \brief Checks whether the job holds a callable.
+   *  \returns True if the job isn't empty.
+   */
+  explicit operator bool() const { return static_cast<bool>(_impl); }
+
+private:
+  struct base {
+    virtual ~base() = default;
+    virtual void run() = 0;
+  };
+
+  template <typename Fun> struct impl : base {
+    Fun func;
+    template <typename F> explicit impl(F &&f) : func{std::forward<F>(f)} {}
+    void run() override { func(); }
+  };
+
+  std::unique_ptr<base> _impl;
+};
+
+/**
+ *  \brief A work-stealing thread pool.
+ *
+ *  Each worker thread has its own queue of jobs. Jobs submitted from a worker
+ * go to that worker's queue, which it processes last-in-first-out (keeping
+ * recently touched data hot in its cache); jobs submitted from other threads
+ * are spread over the queues. Idle workers steal the oldest job from another
+ * worker's queue. Threads waiting for jobs in the pool (see
+ * fpgen::thread_pool::parallel_for) run pending jobs while they wait, so
+ * parallel algorithms can be nested without deadlocking.
+ */
+class thread_pool {
+public:
+  /**
+   *  \brief Starts a new pool.
+   *  \param[in] threads The amount of worker threads; `0` means one per
+   * hardware thread.
+   */
+  explicit thread_pool(size_t threads = 0) {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < threads; i++) {
+      _queues.push_back(std::make_unique<queue>());
+    }
+    for (size_t i = 0; i < threads; i++) {
+      _threads.emplace_back([this, i]() { work(i); });
+    }
+  }
+
+  thread_pool(const thread_pool &) = delete;
+  thread_pool &operator=(const thread_pool &) = delete;
+
+  /**
+   *  \brief Finishes all submitted jobs and stops the worker threads.
+   */
+  ~thread_pool() {
+    {
+      std::lock_guard<std::mutex> guard(_sleep_lock);
+      _stopping = true;
+    }
+    _wake.notify_all();
+    for (auto &thread : _threads) {
+      thread.join();
+    }
+  }
+
+  /**
+   *  \brief Gets the pool shared by fpgen's parallel algorithms.
+   *
+   *  The pool is started on first use, with one worker per hardware thread.
+   *
+   *  \returns The shared pool.
+   */
+  static thread_pool &shared() {
+    static thread_pool pool;
+    return pool;
+  }
+
+  /**
+   *  \brief Gets the amount of worker threads.
+   *  \returns The amount of worker threads.
+   */
+  size_t size() const { return _threads.size(); }
+
+  /**
+   *  \brief Submits a job to the pool.
+   *
+   *  Exceptions escaping the job terminate the program.
+   *
+   *  \param[in] task The job to run.
+   */
+  void submit(job task) {
+    size_t index = (_current == this)
+                       ? _current_index
+                       : _next.fetch_add(1, std::memory_order_relaxed) %
+                             _queues.size();
+    {
+      // counted under the queue's lock, like in take()
+      std::lock_guard<std::mutex> guard(_queues[index]->lock);
+      _queues[index]->jobs.push_back(std::move(task));
+      _pending.fetch_add(1);
+    }
+    // a worker registers as sleeping before checking _pending (both
+    // sequentially consistent), so either it sees the new job, or we see it
+    if (_sleeping.load() > 0) {
+      // wait until it's actually inside wait(), so the wake-up isn't lost
+      { std::lock_guard<std::mutex> guard(_sleep_lock); }
+      _wake.notify_one();
+    }
+  }
+
+  /**
+   *  \brief Runs a single pending job on the calling thread, if there is one.
+   *  \returns True if a job was run.
+   */
+  bool try_run_one() {
+    job task = take(_current == this ? _current_index : 0);
+    if (!task)
+      return false;
+    task();
+    return true;
+  }
+
+  /**
+   *  \brief Runs `func(i)` for each `i` in `[0, count)` on the pool, and
+   * waits until all calls finished.
+   *
+   *  The calling thread runs pending jobs while it waits. If any call throws,
+   * the first exception is rethrown once all calls finished.
+   *
+   *  \tparam Fun The function type; `void(size_t)`.
+   *  \param[in] count The amount of calls.
+   *  \param[in] func The function to call.
+   */
+  template <typename Fun> void parallel_for(size_t count, Fun func) {
+    struct state {
+      std::mutex lock;
+      std::condition_variable done;
+      size_t remaining;
+      std::exception_ptr error;
+    } shared;
+    shared.remaining = count;
+
+    for (size_t i = 0; i < count; i++) {
+      submit([&shared, &func, i]() {
+        std::exception_ptr error;
+        try {
+          func(i);
+        } catch (...) {
+          error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> guard(shared.lock);
+        if (error && !shared.error)
+          shared.error = error;
+        if (--shared.remaining == 0)
+          shared.done.notify_all();
+      });
+    }
+
+    while (true) {
+      {
+        std::unique_lock<std::mutex> guard(shared.lock);
+        if (shared.remaining == 0)
+          break;
+      }
+      if (!try_run_one()) {
+        // everything left is running on other threads
+        std::unique_lock<std::mutex> guard(shared.lock);
+        shared.done.wait(guard, [&shared]() { return shared.remaining == 0; });
+        break;
+      }
+    }
+    if (shared.error)
+      std::rethrow_exception(shared.error);
+  }
+
+private:
+  struct queue {
+    std::mutex lock;
+    std::deque<job> jobs;
+  };
+
+  // pops from the own queue (newest first), or steals from another queue
+  // (oldest first)
+  job take(size_t own) {
+    for (size_t i = 0; i < _queues.size(); i++) {
+      size_t index = (own + i) % _queues.size();
+      queue &q = *_queues[index];
+      std::lock_guard<std::mutex> guard(q.lock);
+      if (q.jobs.empty())
+        continue;
+      job task;
+      if (i == 0) {
+        task = std::move(q.jobs.back());
+        q.jobs.pop_back();
+      } else {
+        task = std::move(q.jobs.front());
+        q.jobs.pop_front();
+      }
+      _pending.fetch_sub(1, std::memory_order_relaxed);
+      return task;
+    }
+    return {};
+  }
+
+  void work(size_t index) {
+    _current = this;
+    _current_index = index;
+    while (true) {
+      job task = take(index);
+      if (task) {
+        task();
+        continue;
+      }
+      std::unique_lock<std::mutex> guard(_sleep_lock);
+      _sleeping.fetch_add(1);
+      _wake.wait(guard, [this]() { return _stopping || _pending.load() > 0; });
+      _sleeping.fetch_sub(1);
+      if (_stopping && _pending.load() == 0)
+        return;
+    }
+  }
+
+  std::vector<std::unique_ptr<queue>> _queues;
+  std::vector<std::thread> _threads;
+  std::mutex _sleep_lock;
+  std::condition_variable _wake;
+  // jobs in the queues; only the sleep/wake path takes _sleep_lock
+  std::atomic<size_t> _pending{0};
+  std::atomic<size_t> _sleeping{0};
+  bool _stopping = false;
+  std::atomic<size_t> _next{0};
+
+  inline static thread_local thread_pool *_current = nullptr;
+  inline static thread_local size_t _current_index = 0;
+};
+} // namespace fpgen
+
+#endif
@@ -8,7 +8,7 @@
 #ifndef _FPGEN_TYPE_TRAITS
 #define _FPGEN_TYPE_TRAITS
 
-#include <functional>
+#include <concepts>
 #include <type_traits>
 
 /**
@@ -17,42 +17,69 @@
 namespace fpgen::type {
 
 /**
- *  \brief Type trait deducing whether a type is a function from the input types
+ *  \brief Concept checking whether a type is a function from the input types
  * to the output type.
  *
  *  In short, the function type `TFun` should have the signature `(TIns...) ->
  * TOut`. This can include any "free" function (plain C function pointer), any
  * lambda function, or any struct/class type supporting `TOut
- * operator()(TIns...)`. This is implemented using the type traits
- * `std::enable_if` and `std::is_convertible`. Usage: use as an extra template
- * type, like so:
- *        `typename _ = fpgen::type::is_function_to<TFun, TOut, TIns...>`.
+ * operator()(TIns...)`. If `TOut` is `void`, any result is accepted. This is
+ * implemented using `std::invocable` and `std::convertible_to`, so checking it
+ * is cheap to compile. Usage: use as a constraint, like so:
+ *        `requires fpgen::type::function_to<TFun, TOut, TIns...>`.
  *
  *  \tparam TFun The function type.
  *  \tparam TOut The output type for the function.
  *  \tparam TIns The input type(s) for the function.
  */
 template <typename TFun, typename TOut, typename... TIns>
-using is_function_to = typename std::enable_if<
-    std::is_convertible<TFun, std::function<TOut(TIns...)>>::value>::type;
+concept function_to =
+    std::invocable<TFun &, TIns...> &&
+    (std::is_void_v<TOut> ||
+     std::convertible_to<std::invoke_result_t<TFun &, TIns...>, TOut>);
 
 /**
- *  \brief Type trait deducing whether a type is a predicate.
+ *  \brief Concept checking whether a type is a predicate.
  *
  *  In short, the function type `TFun` should have the signature `(TIns...) ->
- * bool`. This can include any "free" function (plain C function pointer), any
- * lambda function, or any struct/class type supporting `bool
- * operator()(TIns...)`. This is implemented using fpgen::type::is_function_to.
+ * bool` (see `std::predicate`). Usage: use as a constraint, like so:
+ *        `requires fpgen::type::predicate_for<TFun, TIns...>`.
+ *
+ *  \tparam TFun The predicate function type.
+ *  \tparam TIns The input type(s) for the function.
+ */
+template <typename TFun, typename... TIns>
+concept predicate_for = std::predicate<TFun &, TIns...>;
+
+/**
+ *  \brief Type trait deducing whether a type is a function from the input types
+ * to the output type.
+ *
+ *  The SFINAE counterpart of fpgen::type::function_to, kept for existing code.
  * Usage: use as an extra template type, like so:
- *        `typename _ = fpgen::type::is_predicate<TFun, TIns...>`;
- * this is synonymous to using
- *        `typename _ = fpgen::type::is_function_to<TFun, bool, TIns...>`.
+ *        `typename _ = fpgen::type::is_function_to<TFun, TOut, TIns...>`.
+ *
+ *  \tparam TFun The function type.
+ *  \tparam TOut The output type for the function.
+ *  \tparam TIns The input type(s) for the function.
+ */
+template <typename TFun, typename TOut, typename... TIns>
+using is_function_to =
+    typename std::enable_if<function_to<TFun, TOut, TIns...>>::type;
+
+/**
+ *  \brief Type trait deducing whether a type is a predicate.
+ *
+ *  The SFINAE counterpart of fpgen::type::predicate_for, kept for existing
+ * code. Usage: use as an extra template type, like so:
+ *        `typename _ = fpgen::type::is_predicate<TFun, TIns...>`.
  *
  *  \tparam TFun The predicate function type.
  *  \tparam TIns The input type(s) for the function.
  */
 template <typename TFun, typename... TIns>
-using is_predicate = is_function_to<TFun, bool, TIns...>;
+using is_predicate =
+    typename std::enable_if<predicate_for<TFun, TIns...>>::type;
 
 /**
  *  \brief Type trait deducing the output type of a functional type.
@@ -71,13 +98,15 @@ using output_type = typename std::invoke_result<TFun, TIns...>::type;
  *  \brief Type trait deducing whether a type is fit as data type for a
  * generator.
  *
- *  The type `T` will pass the test if it's copy-assignable.
+ *  The type `T` will pass the test if it's move-constructible (it doesn't have
+ * to be copyable or default-constructible), or if it's a reference type (for
+ * generators yielding references).
  *
  *  \tparam T The type to check.
  */
 template <typename T>
-using is_generator_type =
-    typename std::enable_if<std::is_copy_assignable<T>::value>::type;
+using is_generator_type = typename std::enable_if<
+    std::is_reference<T>::value || std::is_move_constructible<T>::value>::type;
 
 } // namespace fpgen::type
 
@@ -5,7 +5,10 @@
 #include "sources.hpp"
 
 #include <map>
+#include <memory>
 #include <sstream>
+#include <string>
+#include <utility>
 #include <vector>
 
 fpgen::generator<size_t> a_empty() { co_return; }
@@ -48,13 +51,13 @@ size_t sum_ref(size_t &old, size_t in) {
 TEST_CASE("Aggregate empty generator") {
   auto gen = a_empty();
   std::vector<size_t> res;
-  CHECK(0 == fpgen::aggregate_to(gen, res).size());
+  CHECK(0 == fpgen::aggregate_to(std::move(gen), res).size());
 }
 
 TEST_CASE("Aggregate to std::vector") {
   auto gen = values();
   std::vector<size_t> res;
-  fpgen::aggregate_to(gen, res);
+  fpgen::aggregate_to(std::move(gen), res);
 
   CHECK(0 == res[0]);
   CHECK(1 == res[1]);
@@ -73,15 +76,22 @@ TEST_CASE("Aggregate: std::vector to generator to std::vector") {
   std::vector<size_t> in = {0, 1, 2, 3, 4, 5, 6};
   std::vector<size_t> out = {};
   auto gen = fpgen::from(in);
-  out = fpgen::aggregate_to(gen, out);
+  out = fpgen::aggregate_to(std::move(gen), out);
+  CHECK(in == out);
+}
+
+TEST_CASE("Aggregate: reference generator to std::vector") {
+  std::vector<size_t> in = {0, 1, 2, 3, 4, 5, 6};
+  std::vector<size_t> out = {};
+  fpgen::aggregate_to(fpgen::from_ref(std::as_const(in)), out);
   CHECK(in == out);
 }
 
 TEST_CASE("Aggregate to std::map") {
   fpgen::generator<size_t> sources[2] = {values(), values()};
-  auto gen = fpgen::zip(sources[0], sources[1]);
+  auto gen = fpgen::zip(std::move(sources[0]), std::move(sources[1]));
   std::map<size_t, size_t> res;
-  fpgen::tup_aggregate_to(gen, res);
+  fpgen::tup_aggregate_to(std::move(gen), res);
 
   CHECK(0 == res[0]);
   CHECK(1 == res[1]);
@@ -97,63 +107,94 @@ TEST_CASE("Aggregate to std::map") {
 
 TEST_CASE("Count empty generator") {
   auto gen = a_empty();
-  CHECK(0 == fpgen::count(gen));
+  CHECK(0 == fpgen::count(std::move(gen)));
 }
 
 TEST_CASE("Count generator") {
   auto gen = values();
-  CHECK(10 == fpgen::count(gen));
+  CHECK(10 == fpgen::count(std::move(gen)));
+}
+
+TEST_CASE("Count generator of known size") {
+  std::vector<int> vec(100, 1);
+  size_t calls = 0;
+  auto gen = fpgen::map(fpgen::from(vec), [&calls](int v) {
+    calls++;
+    return v;
+  });
+  CHECK(100 == fpgen::count(std::move(gen)));
+  // the size is known up front; nothing is generated
+  CHECK(calls == 0);
+  CHECK(10 == fpgen::count(fpgen::take(fpgen::from(vec), 10)));
+  CHECK(7 == fpgen::count(fpgen::take(values(), 7)));
+}
+
+TEST_CASE("Aggregate reserves for generators of known size") {
+  std::vector<int> vec(1000, 3);
+  std::vector<int> res = {1, 2};
+  fpgen::aggregate_to(fpgen::from(vec), res);
+  CHECK(res.size() == 1002);
+  CHECK(res.capacity() == 1002);
+
+  std::vector<size_t> unknown;
+  fpgen::aggregate_to(values(), unknown);
+  CHECK(unknown.size() == 10);
 }
 
 TEST_CASE("Fold [using no-input, empty generator]") {
   auto gen = a_empty();
-  CHECK(0 == fpgen::fold<size_t>(gen, sum));
+  CHECK(0 == fpgen::fold<size_t>(std::move(gen), sum));
 }
 
 TEST_CASE("Fold [using no-input, non-empty generator]") {
   auto gen = values();
-  CHECK(calc_sum() == fpgen::fold<size_t>(gen, sum));
+  CHECK(calc_sum() == fpgen::fold<size_t>(std::move(gen), sum));
 }
 
 TEST_CASE("Fold [using input, empty generator]") {
   auto gen = a_empty();
-  CHECK(7 == fpgen::fold<size_t>(gen, sum, 7));
+  CHECK(7 == fpgen::fold<size_t>(std::move(gen), sum, 7));
 }
 
 TEST_CASE("Fold [using input, non-empty generator]") {
   auto gen = values();
-  CHECK(calc_sum() + 7 == fpgen::fold<size_t>(gen, sum, 7));
+  CHECK(calc_sum() + 7 == fpgen::fold<size_t>(std::move(gen), sum, 7));
 }
 
 TEST_CASE("Fold [using ref input, empty generator]") {
   auto gen = a_empty();
   size_t res = 7;
-  CHECK(7 == fpgen::fold_ref<size_t>(gen, sum, res));
+  CHECK(7 == fpgen::fold_ref<size_t>(std::move(gen), sum, res));
   CHECK(7 == res);
 }
 
 TEST_CASE("Fold [using ref input, non-epty generator]") {
   auto gen = values();
   size_t res = 7;
-  CHECK(calc_sum() + 7 == fpgen::fold_ref<size_t>(gen, sum, res));
+  CHECK(calc_sum() + 7 == fpgen::fold_ref<size_t>(std::move(gen), sum, res));
   CHECK(calc_sum() + 7 == res);
 }
 
 TEST_CASE("Sum empty generator") {
   auto gen = a_empty();
-  CHECK(0 == fpgen::sum(gen));
+  CHECK(0 == fpgen::sum(std::move(gen)));
 }
 
 TEST_CASE("Sum over generator") {
   auto gen = values();
-  CHECK(calc_sum() == fpgen::sum(gen));
+  CHECK(calc_sum() == fpgen::sum(std::move(gen)));
+}
+
+TEST_CASE("Sum over reference generator") {
+  std::vector<size_t> in = {1, 2, 3, 4};
+  CHECK(10 == fpgen::sum(fpgen::from_ref(std::as_const(in))));
 }
 
 TEST_CASE("Foreach over empty generator") {
   auto gen = a_empty();
   // gen();
   size_t res = 0;
-  fpgen::foreach (gen, [&res](size_t val) { res += val; });
+  fpgen::foreach (std::move(gen), [&res](size_t val) { res += val; });
   CHECK(res == 0);
 }
 
@@ -161,15 +202,15 @@ TEST_CASE("Foreach over non-empty generator") {
   auto gen = values();
   auto gen2 = values();
   size_t res = 0;
-  fpgen::foreach (gen, [&res](size_t val) { res += val; });
-  CHECK(res == fpgen::sum(gen2));
+  fpgen::foreach (std::move(gen), [&res](size_t val) { res += val; });
+  CHECK(res == fpgen::sum(std::move(gen2)));
 }
 
 TEST_CASE("Output to stream, no separator") {
   std::vector<int> vals = {1, 2, 3, 4, 5, 6};
   auto gen = fpgen::from(vals);
   std::stringstream strm;
-  fpgen::to_stream(gen, strm);
+  fpgen::to_stream(std::move(gen), strm);
   CHECK(strm.str() == "123456");
 }
 
@@ -177,7 +218,7 @@ TEST_CASE("Output to stream, with separator") {
   std::vector<int> vals = {1, 2, 3, 4, 5, 6, 7};
   auto gen = fpgen::from(vals);
   std::stringstream strm;
-  fpgen::to_stream(gen, strm, " ");
+  fpgen::to_stream(std::move(gen), strm, " ");
   CHECK(strm.str() == "1 2 3 4 5 6 7");
 }
 
@@ -188,7 +229,7 @@ TEST_CASE("Output to stream (by lines), with trailing line") {
   std::stringstream expect;
   for (auto v : vals)
     expect << v << std::endl;
-  fpgen::to_lines(gen, strm);
+  fpgen::to_lines(std::move(gen), strm);
   CHECK(strm.str() == expect.str());
 }
 
@@ -198,6 +239,42 @@ TEST_CASE("Output to stream (by lines), without trailing line") {
   std::stringstream strm;
   std::stringstream expect;
   expect << 1 << std::endl << 2 << std::endl << 3 << std::endl << 4;
-  fpgen::to_lines_no_trail(gen, strm);
+  fpgen::to_lines_no_trail(std::move(gen), strm);
   CHECK(strm.str() == expect.str());
 }
+
+fpgen::generator<std::unique_ptr<size_t>> a_boxed(size_t max) {
+  for (size_t i = 0; i < max; i++) {
+    co_yield std::make_unique<size_t>(i);
+  }
+  co_return;
+}
+
+TEST_CASE("Aggregate move-only values to std::vector") {
+  std::vector<std::unique_ptr<size_t>> res;
+  fpgen::aggregate_to(a_boxed(5), res);
+  CHECK(res.size() == 5);
+  for (size_t i = 0; i < res.size(); i++) {
+    CHECK(*res[i] == i);
+  }
+}
+
+TEST_CASE("Aggregate move-only values to std::map") {
+  std::map<size_t, std::unique_ptr<size_t>> res;
+  fpgen::tup_aggregate_to(fpgen::zip(fpgen::inc((size_t)0), a_boxed(4)), res);
+  CHECK(res.size() == 4);
+  CHECK(*res[3] == 3);
+}
+
+TEST_CASE("Fold move-only values") {
+  using box = std::unique_ptr<size_t>;
+  auto res = fpgen::fold<box>(a_boxed(5), [](box acc, box in) {
+    return (acc == nullptr || *in > *acc) ? std::move(in) : std::move(acc);
+  });
+  CHECK(*res == 4);
+}
+
+TEST_CASE("Sum without copies") {
+  std::vector<std::string> in = {"a", "b", "c"};
+  CHECK(fpgen::sum(fpgen::from(in)) == "abc");
+}
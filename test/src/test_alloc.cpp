@@ -0,0 +1,123 @@
+#include "aggregators.hpp"
+#include "allocator.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace {
+size_t alloc_calls = 0;
+size_t dealloc_calls = 0;
+
+template <typename T> struct counting_allocator {
+  using value_type = T;
+
+  counting_allocator() = default;
+  template <typename U> counting_allocator(const counting_allocator<U> &) {}
+
+  T *allocate(size_t n) {
+    alloc_calls++;
+    return std::allocator<T>{}.allocate(n);
+  }
+  void deallocate(T *ptr, size_t n) {
+    dealloc_calls++;
+    std::allocator<T>{}.deallocate(ptr, n);
+  }
+
+  template <typename U> bool operator==(const counting_allocator<U> &) const {
+    return true;
+  }
+};
+} // namespace
+
+fpgen::generator<size_t> with_alloc(std::allocator_arg_t,
+                                    counting_allocator<char>, size_t max) {
+  for (size_t i = 0; i < max; i++) {
+    co_yield i;
+  }
+  co_return;
+}
+
+struct alloc_member {
+  size_t base;
+
+  fpgen::generator<size_t> values(std::allocator_arg_t,
+                                  counting_allocator<int>, size_t max) {
+    for (size_t i = 0; i < max; i++) {
+      co_yield base + i;
+    }
+    co_return;
+  }
+};
+
+TEST_CASE("Coroutine frame from an allocator argument") {
+  alloc_calls = dealloc_calls = 0;
+  {
+    auto gen = with_alloc(std::allocator_arg, {}, 5);
+    CHECK(alloc_calls == 1);
+    CHECK(fpgen::sum(std::move(gen)) == 10);
+  }
+  CHECK(dealloc_calls == 1);
+}
+
+TEST_CASE("Member coroutine frame from an allocator argument") {
+  alloc_calls = dealloc_calls = 0;
+  alloc_member obj{10};
+  CHECK(fpgen::sum(obj.values(std::allocator_arg, {}, 3)) == 33);
+  CHECK(alloc_calls == 1);
+  CHECK(dealloc_calls == 1);
+}
+
+TEST_CASE("Pipeline frames from an arena") {
+  std::vector<size_t> in = {1, 2, 3, 4};
+  fpgen::alloc::arena arena;
+  size_t cached = fpgen::alloc::frame_pool::cached();
+  {
+    fpgen::alloc::scoped_resource scope(arena);
+    auto gen = fpgen::map(fpgen::from(in), [](size_t v) { return v * 2; });
+    CHECK(fpgen::sum(std::move(gen)) == 20);
+  }
+  // frames were neither taken from nor returned to the pool
+  CHECK(fpgen::alloc::frame_pool::cached() == cached);
+}
+
+TEST_CASE("Frames outlive the scope of their resource") {
+  fpgen::alloc::arena arena;
+  fpgen::generator<size_t> gen = [&arena]() {
+    fpgen::alloc::scoped_resource scope(arena);
+    return fpgen::take(fpgen::inc((size_t)1), 3);
+  }();
+  CHECK(fpgen::alloc::current_resource() == nullptr);
+  CHECK(fpgen::sum(std::move(gen)) == 6);
+}
+
+TEST_CASE("Frame pool recycles blocks") {
+  fpgen::alloc::frame_pool::trim();
+  void *first = fpgen::alloc::frame_pool::allocate(200);
+  fpgen::alloc::frame_pool::deallocate(first, 200);
+  CHECK(fpgen::alloc::frame_pool::cached() == 1);
+
+  // same size class
+  void *second = fpgen::alloc::frame_pool::allocate(220);
+  CHECK(first == second);
+  CHECK(fpgen::alloc::frame_pool::cached() == 0);
+  fpgen::alloc::frame_pool::deallocate(second, 220);
+
+  fpgen::alloc::frame_pool::trim();
+  CHECK(fpgen::alloc::frame_pool::cached() == 0);
+}
+
+TEST_CASE("Frame pool reuses frames of destroyed pipelines") {
+  std::vector<size_t> in = {1, 2, 3};
+  fpgen::alloc::frame_pool::trim();
+  CHECK(fpgen::sum(fpgen::map(fpgen::from(in), [](size_t v) { return v; })) ==
+        6);
+  size_t cached = fpgen::alloc::frame_pool::cached();
+  CHECK(cached == 2);
+  CHECK(fpgen::sum(fpgen::map(fpgen::from(in), [](size_t v) { return v; })) ==
+        6);
+  CHECK(fpgen::alloc::frame_pool::cached() == cached);
+}
@@ -0,0 +1,252 @@
+#include "async.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <latch>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <system_error>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+fpgen::task<int> as_answer() { co_return 42; }
+
+fpgen::task<int> as_twice() {
+  int first = co_await as_answer();
+  int second = co_await as_answer();
+  co_return first + second;
+}
+
+fpgen::task<int> as_throws() {
+  throw std::runtime_error("task failed");
+  co_return 0;
+}
+
+fpgen::async_generator<int> as_values(int max) {
+  for (int i = 0; i < max; i++) {
+    co_yield i;
+  }
+  co_return;
+}
+
+fpgen::async_generator<int> as_awaiting(int max) {
+  for (int i = 0; i < max; i++) {
+    co_yield co_await as_answer() + i;
+  }
+  co_return;
+}
+
+fpgen::async_generator<int> as_throws_after(int count) {
+  for (int i = 0; i < count; i++) {
+    co_yield i;
+  }
+  throw std::runtime_error("generator failed");
+}
+
+fpgen::async_generator<std::string> as_lvalues() {
+  std::string value = "kept";
+  co_yield value;
+  co_yield value;
+  co_return;
+}
+
+fpgen::async_generator<int &> as_refs(std::vector<int> &values) {
+  for (int &v : values) {
+    co_yield v;
+  }
+  co_return;
+}
+
+fpgen::task<std::vector<int>> as_collect(fpgen::async_generator<int> gen) {
+  std::vector<int> out;
+  while (int *value = co_await gen.next()) {
+    out.push_back(*value);
+  }
+  co_return out;
+}
+
+fpgen::task<std::thread::id> as_on_pool(fpgen::executor &ex) {
+  co_await ex.schedule();
+  co_return std::this_thread::get_id();
+}
+
+TEST_CASE("Tasks return values") {
+  CHECK(fpgen::sync_wait(as_answer()) == 42);
+  CHECK(fpgen::sync_wait(as_twice()) == 84);
+}
+
+TEST_CASE("Tasks forward exceptions") {
+  CHECK_THROWS_AS(fpgen::sync_wait(as_throws()), std::runtime_error);
+}
+
+TEST_CASE("Async generator yields all values") {
+  std::vector<int> out = fpgen::sync_wait(as_collect(as_values(5)));
+  CHECK(out == std::vector<int>{0, 1, 2, 3, 4});
+}
+
+TEST_CASE("Async generator awaits in between values") {
+  std::vector<int> out = fpgen::sync_wait(as_collect(as_awaiting(3)));
+  CHECK(out == std::vector<int>{42, 43, 44});
+}
+
+TEST_CASE("Async generator over an empty sequence") {
+  CHECK(fpgen::sync_wait(as_collect(as_values(0))).empty());
+}
+
+TEST_CASE("Async generator forwards exceptions") {
+  std::vector<int> seen;
+  auto consume = [&seen]() -> fpgen::task<void> {
+    auto gen = as_throws_after(3);
+    while (int *value = co_await gen.next()) {
+      seen.push_back(*value);
+    }
+  };
+  CHECK_THROWS_AS(fpgen::sync_wait(consume()), std::runtime_error);
+  CHECK(seen == std::vector<int>{0, 1, 2});
+}
+
+TEST_CASE("Async generator copies yielded lvalues") {
+  std::vector<std::string> out;
+  fpgen::sync_wait(fpgen::foreach(
+      as_lvalues(), [&out](std::string v) { out.push_back(std::move(v)); }));
+  CHECK(out == std::vector<std::string>{"kept", "kept"});
+}
+
+TEST_CASE("Async generator over references") {
+  std::vector<int> values = {1, 2, 3};
+  fpgen::sync_wait(fpgen::foreach(as_refs(values), [](int &v) { v *= 10; }));
+  CHECK(values == std::vector<int>{10, 20, 30});
+}
+
+TEST_CASE("Async map, filter and take") {
+  auto gen = fpgen::take(
+      fpgen::filter(fpgen::map(as_values(100), [](int v) { return v * 3; }),
+                    [](int v) { return v % 2 == 0; }),
+      4);
+  std::vector<int> out = fpgen::sync_wait(as_collect(std::move(gen)));
+  CHECK(out == std::vector<int>{0, 6, 12, 18});
+}
+
+TEST_CASE("Async generator from a generator") {
+  auto gen = fpgen::to_async(fpgen::take(fpgen::inc(0), 3));
+  CHECK(fpgen::sync_wait(as_collect(std::move(gen))) ==
+        std::vector<int>{0, 1, 2});
+}
+
+TEST_CASE("Async chains over many values") {
+  long total = 0;
+  fpgen::sync_wait(fpgen::foreach(
+      fpgen::map(as_values(10000), [](int v) { return v % 3; }),
+      [&total](int v) { total += v; }));
+  CHECK(total == 9999);
+}
+
+TEST_CASE("Executor resumes coroutines on its threads") {
+  fpgen::executor ex(2);
+  CHECK(fpgen::sync_wait(as_on_pool(ex)) != std::this_thread::get_id());
+}
+
+TEST_CASE("Executor runs spawned tasks") {
+  std::atomic<int> total{0};
+  std::latch done(10);
+  fpgen::executor ex(2);
+  for (int i = 0; i < 10; i++) {
+    ex.spawn([](std::atomic<int> &total, std::latch &done,
+                int i) -> fpgen::task<void> {
+      total += i;
+      done.count_down();
+      co_return;
+    }(total, done, i));
+  }
+  done.wait();
+  CHECK(total.load() == 45);
+}
+
+#ifdef __linux__
+fpgen::async_generator<std::string> as_read_pipe(fpgen::executor &ex,
+                                                 int fd) {
+  char buffer[64];
+  while (true) {
+    co_await ex.readable(fd);
+    ssize_t got = read(fd, buffer, sizeof(buffer));
+    if (got <= 0)
+      break;
+    co_yield std::string(buffer, static_cast<size_t>(got));
+  }
+  co_return;
+}
+
+TEST_CASE("Executor multiplexes pipes on one thread") {
+  int first[2], second[2];
+  REQUIRE(pipe(first) == 0);
+  REQUIRE(pipe(second) == 0);
+
+  std::string got[2];
+  std::latch done(2);
+  fpgen::executor ex(1);
+  auto drain = [](fpgen::executor &ex, int fd, std::string &out,
+                  std::latch &done) -> fpgen::task<void> {
+    auto gen = as_read_pipe(ex, fd);
+    while (std::string *chunk = co_await gen.next()) {
+      out += *chunk;
+    }
+    done.count_down();
+  };
+  ex.spawn(drain(ex, first[0], got[0], done));
+  ex.spawn(drain(ex, second[0], got[1], done));
+
+  // interleave writes: both readers wait at the same time
+  for (int i = 0; i < 3; i++) {
+    CHECK(write(second[1], "b", 1) == 1);
+    CHECK(write(first[1], "a", 1) == 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  close(first[1]);
+  close(second[1]);
+  done.wait();
+  close(first[0]);
+  close(second[0]);
+  CHECK(got[0] == "aaa");
+  CHECK(got[1] == "bbb");
+}
+
+TEST_CASE("Executor closes its descriptors if it can't start") {
+  int lowest = dup(0);
+  REQUIRE(lowest >= 0);
+  close(lowest);
+
+  // sanitizers need a descriptor to check a type for the first time
+  CHECK(std::system_error(EMFILE, std::generic_category()).code().value() ==
+        EMFILE);
+
+  // the epoll descriptor fits, the stop eventfd doesn't
+  rlimit old;
+  REQUIRE(getrlimit(RLIMIT_NOFILE, &old) == 0);
+  rlimit low = old;
+  low.rlim_cur = static_cast<rlim_t>(lowest) + 1;
+  REQUIRE(setrlimit(RLIMIT_NOFILE, &low) == 0);
+  bool threw = false;
+  try {
+    fpgen::executor ex(1);
+  } catch (const std::system_error &) {
+    threw = true;
+  }
+  REQUIRE(setrlimit(RLIMIT_NOFILE, &old) == 0);
+  CHECK(threw);
+
+  int reused = dup(0);
+  CHECK(reused == lowest);
+  close(reused);
+}
+#endif
@@ -0,0 +1,102 @@
+#include "aggregators.hpp"
+#include "batch.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+TEST_CASE("Chunk a generator") {
+  auto gen = fpgen::chunk(fpgen::take(fpgen::inc(0), 7), 3);
+  std::vector<size_t> sizes;
+  int expect = 0;
+  for (auto span : gen) {
+    sizes.push_back(span.size());
+    for (int v : span) {
+      CHECK(v == expect);
+      expect++;
+    }
+  }
+  CHECK(sizes == std::vector<size_t>{3, 3, 1});
+  CHECK(expect == 7);
+}
+
+TEST_CASE("Chunk an empty generator") {
+  CHECK(fpgen::batch::count(fpgen::chunk(fpgen::take(fpgen::inc(0), 0), 4)) ==
+        0);
+}
+
+TEST_CASE("Batches of size zero are rejected") {
+  std::vector<int> in = {1, 2, 3};
+  CHECK_THROWS_AS(fpgen::chunk(fpgen::from(in), 0), std::invalid_argument);
+  CHECK_THROWS_AS(fpgen::batch::from(in, 0), std::invalid_argument);
+}
+
+TEST_CASE("Batches over a container without copies") {
+  std::vector<int> in = {1, 2, 3, 4, 5};
+  auto gen = fpgen::batch::from(in, 2);
+  auto first = gen();
+  CHECK(first.data() == in.data());
+  CHECK(first.size() == 2);
+  CHECK(gen().data() == in.data() + 2);
+  auto last = gen();
+  CHECK(last.data() == in.data() + 4);
+  CHECK(last.size() == 1);
+  CHECK(!static_cast<bool>(gen));
+}
+
+TEST_CASE("Batch manipulators and aggregators") {
+  std::vector<int> in;
+  for (int i = 0; i < 100; i++) {
+    in.push_back(i);
+  }
+  auto odd = [](int v) { return v % 2 == 1; };
+  auto square = [](int v) { return (long)v * v; };
+
+  CHECK(fpgen::batch::sum(fpgen::batch::from(in, 16)) == 4950);
+  CHECK(fpgen::batch::count(
+            fpgen::batch::filter(fpgen::batch::from(in, 16), odd)) == 50);
+
+  long expect = 0;
+  for (int v : in) {
+    if (v % 2 == 1)
+      expect += square(v);
+  }
+  CHECK(fpgen::batch::sum(fpgen::batch::map(
+            fpgen::batch::filter(fpgen::batch::from(in, 7), odd), square)) ==
+        expect);
+
+  CHECK(fpgen::batch::fold<int>(fpgen::batch::from(in, 10),
+                                [](int acc, int v) { return acc ^ v; }) ==
+        fpgen::fold<int>(fpgen::from(in),
+                         [](int acc, int v) { return acc ^ v; }));
+
+  std::vector<int> out;
+  fpgen::batch::aggregate_to(fpgen::batch::from(in, 33), out);
+  CHECK(out == in);
+}
+
+TEST_CASE("Batch filter skips empty batches") {
+  std::vector<int> in = {1, 1, 1, 2, 1, 1, 1, 1, 3};
+  auto gen = fpgen::batch::filter(fpgen::batch::from(in, 3),
+                                  [](int v) { return v > 1; });
+  size_t batches = 0;
+  for (auto span : gen) {
+    CHECK(span.size() == 1);
+    batches++;
+  }
+  CHECK(batches == 2);
+}
+
+TEST_CASE("Flatten batches") {
+  std::vector<std::string> in = {"a", "b", "c"};
+  auto gen = fpgen::batch::elements(fpgen::batch::from(in, 2));
+  std::string joined;
+  while (gen) {
+    joined += gen();
+  }
+  CHECK(joined == "abc");
+}
@@ -25,7 +25,7 @@ TEST_CASE("Simple chain check") {
                     [](size_t in) { return (char)('a' + (in % 26)); });
 
   size_t value = 5;
-  for (auto v : zip(gen, second)) {
+  for (auto v : zip(std::move(gen), std::move(second))) {
     CHECK(value * value == std::get<0>(v));
     CHECK('a' + 2 + value == std::get<1>(v));
     CHECK(value <= 13);
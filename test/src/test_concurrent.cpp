@@ -0,0 +1,217 @@
+#include "aggregators.hpp"
+#include "concurrent.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+fpgen::generator<size_t> cc_values(size_t max) {
+  for (size_t i = 0; i < max; i++) {
+    co_yield i;
+  }
+  co_return;
+}
+
+fpgen::generator<int> cc_throws_after(int count) {
+  for (int i = 0; i < count; i++) {
+    co_yield i;
+  }
+  throw std::runtime_error("producer failed");
+}
+
+fpgen::generator<size_t> cc_counted(std::atomic<size_t> &produced) {
+  size_t i = 0;
+  while (true) {
+    produced++;
+    co_yield i++;
+  }
+}
+
+TEST_CASE("Buffered generator keeps all values in order") {
+  auto gen = fpgen::buffered(cc_values(100000), 16);
+  size_t expect = 0;
+  for (auto v : gen) {
+    REQUIRE(v == expect);
+    expect++;
+  }
+  CHECK(expect == 100000);
+}
+
+TEST_CASE("Buffered generator runs on another thread") {
+  auto here = std::this_thread::get_id();
+  auto ids = fpgen::map(cc_values(5), [](size_t) {
+    return std::this_thread::get_id();
+  });
+  for (auto id : fpgen::buffered(std::move(ids), 2)) {
+    CHECK(id != here);
+  }
+}
+
+TEST_CASE("Buffered generator over move-only values") {
+  auto boxes = fpgen::map(cc_values(50), [](size_t v) {
+    return std::make_unique<size_t>(v);
+  });
+  auto gen = fpgen::buffered(std::move(boxes), 4);
+  size_t total = 0;
+  while (gen) {
+    std::unique_ptr<size_t> box = gen();
+    total += *box;
+  }
+  CHECK(total == 49 * 50 / 2);
+}
+
+TEST_CASE("Buffered generator forwards exceptions") {
+  auto gen = fpgen::buffered(cc_throws_after(10), 64);
+  for (int i = 0; i < 10; i++) {
+    REQUIRE(static_cast<bool>(gen));
+    CHECK(gen() == i);
+  }
+  CHECK_THROWS(gen());
+}
+
+TEST_CASE("Destroying a buffered generator stops the producer") {
+  std::atomic<size_t> produced{0};
+  {
+    auto gen = fpgen::buffered(cc_counted(produced), 8);
+    CHECK(gen() == 0);
+    CHECK(gen() == 1);
+  } // infinite producer: must stop here
+  size_t after = produced.load();
+  CHECK(after >= 2);
+  CHECK(after <= 2 + 8 + 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  CHECK(produced.load() == after);
+}
+
+TEST_CASE("Unused buffered generator starts no thread") {
+  std::atomic<size_t> produced{0};
+  { auto gen = fpgen::buffered(cc_counted(produced), 8); }
+  CHECK(produced.load() == 0);
+}
+
+TEST_CASE("Buffered empty generator") {
+  CHECK(fpgen::count(fpgen::buffered(cc_values(0), 4)) == 0);
+  CHECK(fpgen::sum(fpgen::buffered(cc_values(3), 1)) == 3);
+}
+
+TEST_CASE("Parallel map keeps the order") {
+  auto gen = fpgen::par_map(
+      cc_values(1000), [](size_t v) { return v * 2; }, 3, 8);
+  size_t expect = 0;
+  for (auto v : gen) {
+    REQUIRE(v == expect * 2);
+    expect++;
+  }
+  CHECK(expect == 1000);
+}
+
+TEST_CASE("Parallel map on the shared pool") {
+  auto gen = fpgen::par_map(cc_values(100),
+                            [](size_t v) { return std::to_string(v); });
+  size_t expect = 0;
+  for (auto v : gen) {
+    CHECK(v == std::to_string(expect));
+    expect++;
+  }
+  CHECK(expect == 100);
+}
+
+TEST_CASE("Parallel map unordered yields each value once") {
+  auto gen = fpgen::par_map_unordered(
+      cc_values(500),
+      [](size_t v) {
+        if (v % 7 == 0)
+          std::this_thread::yield();
+        return v + 1;
+      },
+      4, 16);
+  std::vector<size_t> out;
+  fpgen::aggregate_to(std::move(gen), out);
+  std::sort(out.begin(), out.end());
+  REQUIRE(out.size() == 500);
+  for (size_t i = 0; i < out.size(); i++) {
+    CHECK(out[i] == i + 1);
+  }
+}
+
+TEST_CASE("Parallel map bounds the values in flight") {
+  std::atomic<size_t> produced{0};
+  std::atomic<size_t> mapped{0};
+  auto gen = fpgen::par_map(
+      cc_counted(produced),
+      [&mapped](size_t v) {
+        mapped++;
+        return v;
+      },
+      2, 4);
+  for (size_t i = 0; i < 20; i++) {
+    REQUIRE(gen() == i);
+    CHECK(produced.load() <= i + 1 + 4);
+  }
+}
+
+TEST_CASE("Parallel map forwards exceptions in place") {
+  auto gen = fpgen::par_map(
+      cc_values(10),
+      [](size_t v) {
+        if (v == 5)
+          throw std::runtime_error("map failed");
+        return v;
+      },
+      2, 4);
+  for (size_t i = 0; i < 5; i++) {
+    CHECK(gen() == i);
+  }
+  CHECK_THROWS(gen());
+}
+
+TEST_CASE("Parallel map forwards producer exceptions") {
+  auto gen = fpgen::par_map(
+      cc_throws_after(3), [](int v) { return v; }, 2, 8);
+  CHECK_THROWS(fpgen::count(std::move(gen)));
+}
+
+TEST_CASE("Destroying a parallel map waits for its jobs") {
+  std::atomic<size_t> produced{0};
+  auto alive = std::make_shared<int>(0);
+  {
+    auto gen = fpgen::par_map(
+        cc_counted(produced),
+        [alive](size_t v) {
+          std::this_thread::sleep_for(std::chrono::microseconds(100));
+          return v;
+        },
+        2, 8);
+    CHECK(gen() == 0);
+  }
+  CHECK(alive.use_count() == 1);
+  CHECK(produced.load() <= 1 + 8);
+}
+
+TEST_CASE("Parallel map over move-only values") {
+  auto boxes = fpgen::map(cc_values(50), [](size_t v) {
+    return std::make_unique<size_t>(v);
+  });
+  auto gen = fpgen::par_map(
+      std::move(boxes),
+      [](std::unique_ptr<size_t> box) {
+        *box *= 2;
+        return box;
+      },
+      2, 4);
+  size_t total = 0;
+  while (gen) {
+    std::unique_ptr<size_t> box = gen();
+    total += *box;
+  }
+  CHECK(total == 49 * 50);
+}
@@ -1,6 +1,12 @@
 #include "doctest/doctest.h"
 #include "generator.hpp"
+#include <algorithm>
 #include <iostream>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <stdexcept>
+#include <string>
 
 fpgen::generator<float> empty() { co_return; }
 
@@ -59,3 +65,312 @@ TEST_CASE("Iterate over a generator") {
     expect++;
   }
 }
+
+fpgen::generator<const std::string &> words() {
+  std::string word = "first";
+  co_yield word;
+  co_yield std::string("second"); // temporary lives until resumed
+  word = "third";
+  co_yield word;
+  co_return;
+}
+
+fpgen::generator<int &> counters(int &a, int &b) {
+  co_yield a;
+  co_yield b;
+  co_return;
+}
+
+TEST_CASE("Generator over const references") {
+  auto gen = words();
+  CHECK(gen() == "first");
+  CHECK(gen() == "second");
+  CHECK(gen() == "third");
+  CHECK(!static_cast<bool>(gen));
+}
+
+TEST_CASE("Generator over references") {
+  int a = 1;
+  int b = 2;
+  for (int &v : counters(a, b)) {
+    v *= 10;
+  }
+  CHECK(a == 10);
+  CHECK(b == 20);
+}
+
+struct no_default {
+  explicit no_default(int v) : v{v} {}
+  int v;
+};
+
+fpgen::generator<std::unique_ptr<int>> owned(int max) {
+  for (int i = 0; i < max; i++) {
+    co_yield std::make_unique<int>(i);
+  }
+  auto last = std::make_unique<int>(max);
+  co_yield std::move(last);
+  co_return;
+}
+
+fpgen::generator<no_default> not_defaulted() {
+  no_default value(1);
+  co_yield value; // copied
+  co_yield no_default(2);
+  co_return;
+}
+
+TEST_CASE("Generator over move-only values") {
+  auto gen = owned(3);
+  for (int i = 0; i <= 3; i++) {
+    CHECK(static_cast<bool>(gen));
+    std::unique_ptr<int> ptr = gen();
+    CHECK(*ptr == i);
+  }
+  CHECK(!static_cast<bool>(gen));
+}
+
+TEST_CASE("Iterate over move-only values") {
+  int expect = 0;
+  for (auto ptr : owned(4)) {
+    CHECK(*ptr == expect);
+    expect++;
+  }
+  CHECK(expect == 5);
+}
+
+TEST_CASE("Generator over non-default-constructible values") {
+  auto gen = not_defaulted();
+  CHECK(gen().v == 1);
+  CHECK(gen().v == 2);
+  CHECK(!static_cast<bool>(gen));
+}
+
+fpgen::generator<int> nested_range(int from, int to) {
+  for (int i = from; i < to; i++) {
+    co_yield i;
+  }
+  co_return;
+}
+
+fpgen::generator<int> nested_outer() {
+  co_yield 0;
+  co_yield fpgen::elements_of(nested_range(1, 4));
+  co_yield fpgen::elements_of(nested_range(4, 4)); // empty
+  co_yield 4;
+  co_yield fpgen::elements_of(nested_range(5, 7));
+  co_return;
+}
+
+fpgen::generator<int> nested_deep(int depth) {
+  if (depth > 0) {
+    co_yield fpgen::elements_of(nested_deep(depth - 1));
+  }
+  co_yield depth;
+  co_return;
+}
+
+fpgen::generator<int> nested_throws() {
+  co_yield 1;
+  throw std::runtime_error("nested");
+  co_return;
+}
+
+fpgen::generator<int> nested_catches() {
+  bool caught = false;
+  try {
+    co_yield fpgen::elements_of(nested_throws());
+  } catch (const std::runtime_error &) {
+    caught = true;
+  }
+  if (caught) {
+    co_yield -1;
+  }
+  co_yield fpgen::elements_of(nested_throws());
+  co_return;
+}
+
+fpgen::generator<const std::string &> nested_refs(const std::string &first,
+                                                  const std::string &second) {
+  co_yield first;
+  co_yield second;
+  co_return;
+}
+
+fpgen::generator<const std::string &>
+nested_ref_outer(const std::string &first, const std::string &second) {
+  co_yield fpgen::elements_of(nested_refs(first, second));
+  co_yield fpgen::elements_of(nested_refs(second, first));
+  co_return;
+}
+
+TEST_CASE("Yield elements of nested generators") {
+  int expect = 0;
+  for (auto v : nested_outer()) {
+    CHECK(v == expect);
+    expect++;
+  }
+  CHECK(expect == 7);
+}
+
+TEST_CASE("Deeply nested generators") {
+  const int depth = 10000;
+  auto gen = nested_deep(depth);
+  for (int i = 0; i <= depth; i++) {
+    REQUIRE(static_cast<bool>(gen));
+    CHECK(gen() == i);
+  }
+  CHECK(!static_cast<bool>(gen));
+}
+
+TEST_CASE("Exceptions from nested generators") {
+  auto gen = nested_catches();
+  CHECK(gen() == 1);
+  CHECK(gen() == -1);
+  CHECK(gen() == 1);
+  CHECK_THROWS(gen());
+}
+
+TEST_CASE("Destroy a generator while nested") {
+  auto gen = nested_deep(50);
+  CHECK(gen() == 0);
+  CHECK(gen() == 1);
+}
+
+TEST_CASE("Nested reference generators") {
+  std::string first = "first", second = "second";
+  auto gen = nested_ref_outer(first, second);
+  CHECK(&gen() == &first);
+  CHECK(&gen() == &second);
+  CHECK(&gen() == &second);
+  CHECK(&gen() == &first);
+  CHECK(!static_cast<bool>(gen));
+}
+
+fpgen::generator<int> throws_after_one() {
+  co_yield 1;
+  throw std::runtime_error("failed");
+}
+
+TEST_CASE("Pull values with next") {
+  auto gen = finite_squares(1, 3);
+  auto first = gen.next();
+  REQUIRE(first.has_value());
+  CHECK(*first == 1);
+  CHECK(static_cast<bool>(gen)); // holds 4, taken by next
+  CHECK(*gen.next() == 4);
+  CHECK(*gen.next() == 9);
+  CHECK_FALSE(gen.next().has_value());
+  CHECK_FALSE(gen.next().has_value());
+  CHECK(!static_cast<bool>(gen));
+
+  std::string word = "word";
+  auto refs = nested_refs(word, word);
+  const std::string *ptr = refs.next();
+  CHECK(ptr == &word);
+  CHECK(refs.next() == &word);
+  CHECK(refs.next() == nullptr);
+
+  int total = 0;
+  auto owning = owned(3);
+  while (auto v = owning.next()) {
+    total += **v;
+  }
+  CHECK(total == 6);
+}
+
+TEST_CASE("Generator iterators are input iterators") {
+  using gen_t = fpgen::generator<int>;
+  static_assert(std::input_iterator<gen_t::iterator_type>);
+  static_assert(std::sentinel_for<std::default_sentinel_t,
+                                  gen_t::iterator_type>);
+  static_assert(
+      std::is_same_v<std::iter_reference_t<gen_t::iterator_type>, int &&>);
+  static_assert(std::is_same_v<std::iter_reference_t<
+                                   fpgen::generator<int &>::iterator_type>,
+                               int &>);
+
+  auto gen = finite_squares(1, 4);
+  auto it = gen.begin();
+  CHECK(*it == 1);
+  CHECK(*it == 1); // dereferencing doesn't advance
+  ++it;
+  CHECK(*it == 4);
+  it++;
+  CHECK(it != gen.end());
+  // leaving the loop early: the generator continues after the last value seen
+  CHECK(gen() == 16);
+  CHECK(!static_cast<bool>(gen));
+}
+
+TEST_CASE("Finished generators stay finished after an exception") {
+  auto gen = throws_after_one();
+  CHECK(gen.next().value() == 1);
+  CHECK_THROWS_AS(gen.next(), std::runtime_error);
+  CHECK_FALSE(gen.next().has_value());
+  CHECK(!static_cast<bool>(gen));
+  for (int v : gen) {
+    CHECK(v < 0); // never reached
+  }
+}
+
+TEST_CASE("Generators are standard views") {
+  static_assert(std::ranges::input_range<fpgen::generator<int>>);
+  static_assert(std::ranges::view<fpgen::generator<int>>);
+  static_assert(std::ranges::view<fpgen::generator<const std::string &>>);
+
+  long total = 0;
+  for (long v : finite_squares(1, 6) |
+                    std::views::filter([](long v) { return v % 2 == 0; }) |
+                    std::views::transform([](long v) { return v / 2; })) {
+    total += v;
+  }
+  CHECK(total == 2 + 8 + 18);
+  CHECK(std::ranges::count_if(finite_squares(1, 10),
+                              [](long v) { return v > 50; }) == 3);
+  CHECK(std::ranges::distance(finite_squares(0, 4)) == 5);
+}
+
+fpgen::nothrow_generator<int> nothrow_counter(int max) {
+  for (int i = 0; i < max; i++) {
+    co_yield i;
+  }
+  co_return;
+}
+
+fpgen::nothrow_generator<int> nothrow_nested(int max) {
+  co_yield -1;
+  co_yield fpgen::elements_of(nothrow_counter(max));
+  co_return;
+}
+
+TEST_CASE("Nothrow generators") {
+  static_assert(std::ranges::view<fpgen::nothrow_generator<int>>);
+  // no exception slot in the promise
+  static_assert(sizeof(fpgen::nothrow_generator<int>::promise_type) <
+                sizeof(fpgen::generator<int>::promise_type));
+
+  auto gen = nothrow_nested(3);
+  CHECK(gen.next().value() == -1);
+  int expect = 0;
+  for (int v : gen) {
+    CHECK(v == expect);
+    expect++;
+  }
+  CHECK(expect == 3);
+  CHECK_FALSE(gen.next().has_value());
+}
+
+TEST_CASE("Nothrow generators convert to default generators") {
+  auto source = nothrow_counter(4);
+  source.set_hint(fpgen::size_hint::exact(4));
+  fpgen::generator<int> gen = std::move(source);
+  CHECK(gen.hint().is_exact());
+  CHECK(gen.hint().size == 4);
+  int expect = 0;
+  for (int v : gen) {
+    CHECK(v == expect);
+    expect++;
+  }
+  CHECK(expect == 4);
+}
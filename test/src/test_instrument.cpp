@@ -0,0 +1,136 @@
+#include "aggregators.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "instrument.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+size_t in_occurrences(const std::string &text, const std::string &part) {
+  size_t count = 0;
+  for (size_t at = text.find(part); at != std::string::npos;
+       at = text.find(part, at + 1)) {
+    count++;
+  }
+  return count;
+}
+
+fpgen::generator<int> in_throws_after(int count) {
+  for (int i = 0; i < count; i++) {
+    co_yield i;
+  }
+  throw std::runtime_error("stage failed");
+}
+} // namespace
+
+TEST_CASE("Instrumented stages count elements and resumes") {
+  fpgen::instrument::registry reg;
+  std::vector<int> values = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  auto source = fpgen::instrumented(fpgen::from(values), "source", reg);
+  auto mapped = fpgen::instrumented(
+      fpgen::map(std::move(source), [](int v) { return v * 3; }), "map", reg);
+  auto filtered = fpgen::instrumented(
+      fpgen::filter(std::move(mapped), [](int v) { return v % 2 == 0; }),
+      "filter", reg);
+  CHECK(fpgen::sum(std::move(filtered)) == 90);
+
+  auto s = reg.get("source").stats();
+  CHECK(s.elements_in == 0);
+  CHECK(s.elements_out == 10);
+  CHECK(s.resumes == 11);
+  auto m = reg.get("map").stats();
+  CHECK(m.elements_in == 10);
+  CHECK(m.elements_out == 10);
+  auto f = reg.get("filter").stats();
+  CHECK(f.elements_in == 10);
+  CHECK(f.elements_out == 5);
+  CHECK(f.resumes == 6);
+  for (const auto &stats : reg.snapshot()) {
+    CHECK(stats.self_ns <= stats.total_ns);
+    CHECK(stats.p50_ns <= stats.p99_ns);
+  }
+  // the filter's time includes the map's, which includes the source's
+  CHECK(f.total_ns >= m.total_ns);
+  CHECK(m.total_ns >= s.total_ns);
+}
+
+TEST_CASE("Instrumented stages sharing a name") {
+  fpgen::instrument::registry reg;
+  std::vector<int> values = {1, 2, 3};
+  CHECK(fpgen::count(fpgen::instrumented(fpgen::from(values), "s", reg)) == 3);
+  CHECK(fpgen::count(fpgen::instrumented(fpgen::from(values), "s", reg)) == 3);
+  CHECK(reg.snapshot().size() == 1);
+  CHECK(reg.get("s").stats().elements_out == 6);
+
+  reg.reset();
+  CHECK(reg.get("s").stats().elements_out == 0);
+  CHECK(reg.get("s").stats().p50_ns == 0);
+}
+
+TEST_CASE("Instrumented stages forward exceptions") {
+  fpgen::instrument::registry reg;
+  auto gen = fpgen::instrumented(in_throws_after(2), "throws", reg);
+  CHECK_THROWS_AS(fpgen::count(std::move(gen)), std::runtime_error);
+  auto s = reg.get("throws").stats();
+  CHECK(s.elements_out == 2);
+  CHECK(s.resumes == 3);
+}
+
+TEST_CASE("Instrumented reference generators") {
+  fpgen::instrument::registry reg;
+  std::vector<int> values = {1, 2, 3};
+  for (int &v : fpgen::instrumented(fpgen::from_ref(values), "refs", reg)) {
+    v *= 2;
+  }
+  CHECK(values == std::vector<int>{2, 4, 6});
+}
+
+TEST_CASE("Latency histogram percentiles") {
+  fpgen::instrument::histogram hist;
+  CHECK(hist.percentile(0.5) == 0);
+  for (uint64_t ns = 1; ns <= 10000; ns++) {
+    hist.record(ns);
+  }
+  CHECK(hist.count() == 10000);
+  CHECK(hist.max() == 10000);
+  // within the precision of a bucket
+  CHECK(hist.percentile(0.5) >= 5000 * 0.93);
+  CHECK(hist.percentile(0.5) <= 5000 * 1.07);
+  CHECK(hist.percentile(0.99) >= 9900 * 0.93);
+  CHECK(hist.percentile(0.99) <= 9900 * 1.07);
+
+  fpgen::instrument::histogram small;
+  small.record(3);
+  CHECK(small.percentile(0.5) == 3);
+}
+
+TEST_CASE("Instrumentation as JSON and trace events") {
+  fpgen::instrument::registry reg;
+  reg.trace(true);
+  std::vector<int> values = {1, 2, 3, 4};
+  fpgen::count(fpgen::instrumented(fpgen::from(values), "a \"quoted\"", reg));
+
+  std::ostringstream json;
+  reg.to_json(json);
+  CHECK(json.str().find("{\"stages\":[{\"name\":\"a \\\"quoted\\\"\"") == 0);
+  CHECK(json.str().find("\"elements_out\":4") != std::string::npos);
+
+  std::ostringstream trace;
+  reg.to_chrome_trace(trace);
+  CHECK(trace.str().find("{\"traceEvents\":[") == 0);
+  CHECK(in_occurrences(trace.str(), "\"ph\":\"X\"") == 5);
+  CHECK(trace.str().find("\"dropped_events\":0") != std::string::npos);
+
+  reg.reset();
+  reg.trace(true, 2);
+  fpgen::count(fpgen::instrumented(fpgen::from(values), "b", reg));
+  std::ostringstream limited;
+  reg.to_chrome_trace(limited);
+  CHECK(in_occurrences(limited.str(), "\"ph\":\"X\"") == 2);
+  CHECK(limited.str().find("\"dropped_events\":3") != std::string::npos);
+}
@@ -0,0 +1,241 @@
+#include "aggregators.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "io.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+// a file in the temporary directory, removed once the test is done
+struct temp_file {
+  std::string path;
+
+  temp_file(const std::string &name, const std::string &contents)
+      : path{(std::filesystem::temp_directory_path() / name).string()} {
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+  }
+
+  ~temp_file() { std::filesystem::remove(path); }
+};
+
+std::vector<std::string> io_collect(fpgen::generator<std::string_view> gen) {
+  std::vector<std::string> out;
+  for (auto line : gen) {
+    out.emplace_back(line);
+  }
+  return out;
+}
+} // namespace
+
+TEST_CASE("Memory-mapped lines") {
+  temp_file file("fpgen_io_lines.txt", "first\nsecond\n\nfourth\n");
+  CHECK(io_collect(fpgen::from_mmap_lines(file.path)) ==
+        std::vector<std::string>{"first", "second", "", "fourth"});
+}
+
+TEST_CASE("Memory-mapped lines without a trailing newline") {
+  temp_file file("fpgen_io_last.txt", "a\r\nb");
+  CHECK(io_collect(fpgen::from_mmap_lines(file.path)) ==
+        std::vector<std::string>{"a\r", "b"});
+}
+
+TEST_CASE("Memory-mapped lines over an empty file") {
+  temp_file file("fpgen_io_empty.txt", "");
+  CHECK(fpgen::count(fpgen::from_mmap_lines(file.path)) == 0);
+}
+
+TEST_CASE("Memory-mapped lines with all hints") {
+  std::string contents;
+  for (int i = 0; i < 10000; i++) {
+    contents += std::string(i % 150, 'x') + "\n";
+  }
+  temp_file file("fpgen_io_long.txt", contents);
+  fpgen::mmap_options options;
+  options.willneed = true;
+  options.populate = true;
+  size_t lines = 0;
+  bool lengths_match = true;
+  for (auto line : fpgen::from_mmap_lines(file.path, options)) {
+    lengths_match = lengths_match && line.size() == lines % 150;
+    lines++;
+  }
+  CHECK(lines == 10000);
+  CHECK(lengths_match);
+}
+
+TEST_CASE("Memory-mapped lines from a missing file") {
+  CHECK_THROWS_AS(fpgen::from_mmap_lines("/nonexistent/fpgen/file"),
+                  std::system_error);
+}
+
+TEST_CASE("Descriptor lines spanning blocks") {
+  int ends[2];
+  REQUIRE(pipe(ends) == 0);
+  std::string contents = "short\n" + std::string(50, 'y') + "\n\nab\ncd";
+  std::thread writer([&]() {
+    // small writes, so reads return partial lines
+    for (size_t i = 0; i < contents.size(); i += 3) {
+      size_t size = std::min<size_t>(3, contents.size() - i);
+      CHECK(write(ends[1], contents.data() + i, size) == (ssize_t)size);
+    }
+    close(ends[1]);
+  });
+  auto lines = io_collect(fpgen::from_fd_lines(ends[0], 8));
+  writer.join();
+  close(ends[0]);
+  CHECK(lines == std::vector<std::string>{"short", std::string(50, 'y'), "",
+                                          "ab", "cd"});
+}
+
+TEST_CASE("Descriptor lines with a custom delimiter") {
+  temp_file file("fpgen_io_records.txt", "a,bb,,ccc,");
+  int fd = open(file.path.c_str(), O_RDONLY);
+  REQUIRE(fd >= 0);
+  CHECK(io_collect(fpgen::from_fd_lines(fd, 4, ',')) ==
+        std::vector<std::string>{"a", "bb", "", "ccc"});
+  close(fd);
+}
+
+TEST_CASE("Descriptor lines from a bad descriptor") {
+  auto gen = fpgen::from_fd_lines(-1);
+  CHECK_THROWS_AS(gen(), std::system_error);
+}
+
+TEST_CASE("Stream lines match getline") {
+  std::string contents;
+  for (int i = 0; i < 1000; i++) {
+    contents += std::to_string(i * 7919) + (i % 5 == 0 ? "\n\n" : "\n");
+  }
+  std::istringstream expected_in(contents);
+  std::vector<std::string> expected;
+  std::string line;
+  while (std::getline(expected_in, line)) {
+    expected.push_back(line);
+  }
+
+  std::istringstream in(contents);
+  CHECK(io_collect(fpgen::from_istream_lines(in, 5)) == expected);
+  CHECK(in.eof());
+}
+
+TEST_CASE("Stream and descriptor chunks") {
+  std::string contents(1000, 'q');
+  contents[999] = 'z';
+  std::istringstream in(contents);
+  std::string joined;
+  size_t chunks = 0;
+  for (auto chunk : fpgen::from_istream_chunks(in, 64)) {
+    CHECK(chunk.size() <= 64);
+    joined += chunk;
+    chunks++;
+  }
+  CHECK(joined == contents);
+  CHECK(chunks == 16);
+
+  temp_file file("fpgen_io_chunks.txt", contents);
+  int fd = open(file.path.c_str(), O_RDONLY);
+  REQUIRE(fd >= 0);
+  joined.clear();
+  for (auto chunk : fpgen::from_fd_chunks(fd, 100)) {
+    joined += chunk;
+  }
+  close(fd);
+  CHECK(joined == contents);
+}
+
+namespace {
+struct io_record {
+  int32_t id;
+  double weight;
+  char tag;
+};
+
+fpgen::generator<io_record> io_records(int count) {
+  for (int i = 0; i < count; i++) {
+    co_yield io_record{i, i * 0.5, static_cast<char>('a' + i % 26)};
+  }
+  co_return;
+}
+
+bool io_check_records(fpgen::generator<io_record> gen, int count) {
+  int i = 0;
+  for (auto rec : gen) {
+    if (rec.id != i || rec.weight != i * 0.5 || rec.tag != 'a' + i % 26)
+      return false;
+    i++;
+  }
+  return i == count;
+}
+} // namespace
+
+TEST_CASE("Binary records round trip in every mode") {
+  temp_file file("fpgen_io_binary.bin", "");
+  const fpgen::io_mode modes[] = {fpgen::io_mode::buffered,
+                                  fpgen::io_mode::mmap,
+                                  fpgen::io_mode::direct};
+  for (auto write_mode : modes) {
+    // small blocks, so records span blocks and windows
+    CHECK(fpgen::to_binary(io_records(5000), file.path, write_mode, 4096) ==
+          5000);
+    CHECK(std::filesystem::file_size(file.path) == 5000 * sizeof(io_record));
+    for (auto read_mode : modes) {
+      CHECK(io_check_records(
+          fpgen::from_binary<io_record>(file.path, read_mode, 4096), 5000));
+    }
+  }
+}
+
+TEST_CASE("Binary records over an empty file") {
+  temp_file file("fpgen_io_binary_empty.bin", "");
+  CHECK(fpgen::to_binary(io_records(0), file.path) == 0);
+  CHECK(fpgen::count(fpgen::from_binary<io_record>(file.path)) == 0);
+  CHECK(fpgen::count(
+            fpgen::from_binary<io_record>(file.path, fpgen::io_mode::mmap)) ==
+        0);
+}
+
+TEST_CASE("Binary records through a pipe") {
+  int ends[2];
+  REQUIRE(pipe(ends) == 0);
+  std::thread writer([&]() {
+    CHECK(fpgen::to_binary(io_records(300), ends[1], 100) == 300);
+    close(ends[1]);
+  });
+  CHECK(io_check_records(fpgen::from_binary<io_record>(ends[0], 64), 300));
+  writer.join();
+  close(ends[0]);
+}
+
+#ifdef O_DIRECT
+TEST_CASE("Binary records keep the flags of a caller's descriptor") {
+  temp_file file("fpgen_io_binary_flags.bin", "");
+  int fd = open(file.path.c_str(), O_WRONLY | O_DIRECT);
+  if (fd < 0)
+    return; // the file system doesn't support O_DIRECT
+  // 100 records don't fill a block, so the last write isn't aligned
+  CHECK(fpgen::to_binary(io_records(100), fd, 4096) == 100);
+  CHECK((fcntl(fd, F_GETFL) & O_DIRECT) != 0);
+  close(fd);
+  CHECK(io_check_records(fpgen::from_binary<io_record>(file.path), 100));
+}
+#endif
+
+TEST_CASE("Binary records ignore a trailing partial record") {
+  temp_file file("fpgen_io_binary_partial.bin", std::string(10, '\0'));
+  CHECK(fpgen::count(fpgen::from_binary<int32_t>(file.path)) == 2);
+  CHECK(fpgen::count(
+            fpgen::from_binary<int32_t>(file.path, fpgen::io_mode::mmap)) ==
+        2);
+}
@@ -0,0 +1,151 @@
+#include "aggregators.hpp"
+#include "allocator.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "manipulators.hpp"
+#include "sources.hpp"
+
+#include <vector>
+
+// Every coroutine frame is allocated from the installed frame resource, so
+// counting the calls to a resource while a pipeline is built and torn down
+// counts the frames.
+namespace {
+size_t allocs = 0;
+size_t frees = 0;
+
+struct counting_resource : fpgen::alloc::heap_resource {
+  void *allocate(size_t size) override {
+    allocs++;
+    return heap_resource::allocate(size);
+  }
+  void deallocate(void *ptr, size_t size) noexcept override {
+    frees++;
+    heap_resource::deallocate(ptr, size);
+  }
+};
+
+struct frame_counter {
+  counting_resource res;
+  fpgen::alloc::scoped_resource scope{res};
+
+  frame_counter() {
+    allocs = 0;
+    frees = 0;
+  }
+};
+} // namespace
+
+fpgen::generator<size_t> lt_values(size_t max) {
+  for (size_t i = 0; i < max; i++) {
+    co_yield i;
+  }
+  co_return;
+}
+
+TEST_CASE("Destroying a generator frees its frame") {
+  size_t made, freed;
+  {
+    frame_counter cnt;
+    {
+      auto gen = lt_values(10);
+      gen();
+    }
+    made = allocs;
+    freed = frees;
+  }
+  CHECK(made == 1);
+  CHECK(freed == 1);
+}
+
+TEST_CASE("Moving a generator keeps a single frame") {
+  size_t made, freed_early, freed;
+  {
+    frame_counter cnt;
+    {
+      auto gen = lt_values(10);
+      auto moved(std::move(gen));
+      auto assigned = lt_values(5);
+      assigned = std::move(moved);
+      freed_early = frees;
+      assigned();
+    }
+    made = allocs;
+    freed = frees;
+  }
+  CHECK(made == 2);
+  CHECK(freed_early == 1); // the generator assigned over
+  CHECK(freed == 2);
+}
+
+TEST_CASE("Destroying a pipeline frees every stage") {
+  std::vector<size_t> in = {1, 2, 3, 4, 5, 6};
+  size_t made, freed;
+  {
+    frame_counter cnt;
+    {
+      auto gen = fpgen::map(
+          fpgen::filter(fpgen::from(in), [](size_t v) { return v % 2 == 0; }),
+          [](size_t v) { return v * v; });
+      gen();
+    }
+    made = allocs;
+    freed = frees;
+  }
+  CHECK(made == 3);
+  CHECK(freed == 3);
+}
+
+TEST_CASE("Aggregating a pipeline frees every stage") {
+  size_t made, freed, total;
+  {
+    frame_counter cnt;
+    total =
+        fpgen::count(fpgen::zip(lt_values(4), fpgen::drop(lt_values(10), 2)));
+    made = allocs;
+    freed = frees;
+  }
+  CHECK(total == 4);
+  CHECK(made == 4);
+  CHECK(freed == 4);
+}
+
+TEST_CASE("Take frees its source once finished") {
+  size_t made, freed_early, freed;
+  {
+    frame_counter cnt;
+    {
+      auto gen = fpgen::take(
+          fpgen::map(fpgen::inc((size_t)0), [](size_t v) { return v + 1; }), 3);
+      while (gen) {
+        gen();
+      }
+      freed_early = frees;
+    }
+    made = allocs;
+    freed = frees;
+  }
+  CHECK(made == 3);
+  CHECK(freed_early == 2);
+  CHECK(freed == 3);
+}
+
+TEST_CASE("Takewhile frees its source once finished") {
+  size_t made, freed_early, freed;
+  {
+    frame_counter cnt;
+    {
+      auto gen = fpgen::take_while(fpgen::inc((size_t)0),
+                                   [](size_t v) { return v < 4; });
+      while (gen) {
+        gen();
+      }
+      freed_early = frees;
+    }
+    made = allocs;
+    freed = frees;
+  }
+  CHECK(made == 2);
+  CHECK(freed_early == 1);
+  CHECK(freed == 2);
+}
@@ -1,11 +1,19 @@
+#include "aggregators.hpp"
 #include "doctest/doctest.h"
 #include "generator.hpp"
 #include "manipulators.hpp"
 #include "sources.hpp"
 
+#include <deque>
+#include <list>
 #include <map>
+#include <memory>
 #include <set>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 fpgen::generator<size_t> manip_empty() { co_return; }
@@ -33,7 +41,7 @@ bool over_100(size_t v) { return (v > 100); }
 TEST_CASE("Map over empty generator") {
   auto gen = manip_empty();
 
-  for (auto v : fpgen::map(gen, mapper)) {
+  for (auto v : fpgen::map(std::move(gen), mapper)) {
     CHECK(false); // should fail
   }
 }
@@ -41,7 +49,7 @@ TEST_CASE("Map over empty generator") {
 TEST_CASE("Map over a non-empty generator") {
   auto gen = manip();
   size_t i = 1;
-  for (auto v : fpgen::map(gen, mapper)) {
+  for (auto v : fpgen::map(std::move(gen), mapper)) {
     CHECK(i * i == v);
     CHECK(i <= 1024);
     i *= 2;
@@ -52,7 +60,7 @@ TEST_CASE("Zip over two empty generator") {
   auto gen = manip_empty();
   auto gen2 = manip_empty();
 
-  for (auto v : fpgen::zip(gen, gen2)) {
+  for (auto v : fpgen::zip(std::move(gen), std::move(gen2))) {
     CHECK(false); // should fail
   }
 }
@@ -61,7 +69,7 @@ TEST_CASE("Zip, first generator is empty") {
   auto gen = manip_empty();
   auto gen2 = fpgen::inc((size_t)0);
 
-  for (auto v : fpgen::zip(gen, gen2)) {
+  for (auto v : fpgen::zip(std::move(gen), std::move(gen2))) {
     CHECK(false); // should fail
   }
 }
@@ -70,7 +78,7 @@ TEST_CASE("Zip, second generator is empty") {
   auto gen = fpgen::inc((size_t)0);
   auto gen2 = manip_empty();
 
-  for (auto v : fpgen::zip(gen, gen2)) {
+  for (auto v : fpgen::zip(std::move(gen), std::move(gen2))) {
     CHECK(false); // should fail
   }
 }
@@ -82,7 +90,7 @@ TEST_CASE("Zip, both generators are non-empty") {
   size_t i = 0;
   size_t j = 1;
 
-  for (auto v : fpgen::zip(gen, gen2)) {
+  for (auto v : fpgen::zip(std::move(gen), std::move(gen2))) {
     CHECK(std::get<0>(v) == i);
     CHECK(std::get<1>(v) == j);
     CHECK(j <= 1024);
@@ -98,7 +106,7 @@ TEST_CASE("Filter an empty generator") {
 
   size_t i = 0;
 
-  for (auto v : fpgen::filter(gen, is_even)) {
+  for (auto v : fpgen::filter(std::move(gen), is_even)) {
     CHECK(false); // should fail
   }
 }
@@ -106,7 +114,7 @@ TEST_CASE("Filter an empty generator") {
 TEST_CASE("Filter to an empty generator") {
   auto gen = until12();
 
-  for (auto v : fpgen::filter(gen, over_100)) {
+  for (auto v : fpgen::filter(std::move(gen), over_100)) {
     CHECK(false); // should fail
   }
 }
@@ -114,7 +122,7 @@ TEST_CASE("Filter to an empty generator") {
 TEST_CASE("Filter a generator") {
   auto gen = until12();
   size_t i = 0;
-  for (auto v : fpgen::filter(gen, is_even)) {
+  for (auto v : fpgen::filter(std::move(gen), is_even)) {
     CHECK(v == i);
     CHECK(i <= 12);
     i += 2;
@@ -204,3 +212,274 @@ TEST_CASE("Takewhile over a generator") {
   }
   CHECK(exp == 8);
 }
+
+TEST_CASE("Pass-through manipulators keep references") {
+  std::vector<std::string> words = {"a", "bb", "ccc", "dddd", "eeeee", "f"};
+  auto longer =
+      fpgen::filter(fpgen::from_ref(std::as_const(words)),
+                    [](const std::string &w) { return w.size() > 1; });
+  auto gen =
+      fpgen::take_while(fpgen::take(fpgen::drop(std::move(longer), 1), 3),
+                        [](const std::string &w) { return w.size() < 5; });
+  size_t idx = 2;
+  for (const std::string &w : gen) {
+    CHECK(&w == &words[idx]);
+    idx++;
+  }
+  CHECK(idx == 4);
+}
+
+TEST_CASE("Map over a reference generator") {
+  std::vector<std::string> words = {"a", "bb", "ccc"};
+  size_t len = 1;
+  for (auto v : fpgen::map(fpgen::from_ref(std::as_const(words)),
+                           [](const std::string &w) { return w.size(); })) {
+    CHECK(v == len);
+    len++;
+  }
+  CHECK(len == 4);
+}
+
+fpgen::generator<std::unique_ptr<size_t>> boxed(size_t max) {
+  for (size_t i = 0; i < max; i++) {
+    co_yield std::make_unique<size_t>(i);
+  }
+  co_return;
+}
+
+TEST_CASE("Manipulators over move-only values") {
+  using box = std::unique_ptr<size_t>;
+  auto evens =
+      fpgen::filter(boxed(20), [](const box &b) { return *b % 2 == 0; });
+  auto gen = fpgen::take_while(
+      fpgen::drop_while(fpgen::take(fpgen::drop(std::move(evens), 1), 6),
+                        [](const box &b) { return *b < 4; }),
+      [](const box &b) { return *b < 10; });
+  auto squares = fpgen::map(std::move(gen), [](box b) {
+    *b *= *b;
+    return b;
+  });
+
+  size_t expect = 4;
+  for (auto v : fpgen::zip(std::move(squares), boxed(10))) {
+    CHECK(*std::get<0>(v) == expect * expect);
+    expect += 2;
+  }
+  CHECK(expect == 10);
+}
+
+TEST_CASE("Flat map over a generator") {
+  std::vector<size_t> in = {1, 2, 3};
+  auto gen = fpgen::flat_map(fpgen::from(in), [](size_t v) {
+    return fpgen::take(fpgen::inc(v * 10), v);
+  });
+  std::vector<size_t> expect = {10, 20, 21, 30, 31, 32};
+  size_t idx = 0;
+  for (auto v : gen) {
+    REQUIRE(idx < expect.size());
+    CHECK(v == expect[idx]);
+    idx++;
+  }
+  CHECK(idx == expect.size());
+}
+
+TEST_CASE("Flat map with empty inner generators") {
+  auto gen = fpgen::flat_map(fpgen::take(fpgen::inc((size_t)0), 5),
+                             [](size_t v) {
+                               return fpgen::take(fpgen::inc((size_t)0),
+                                                  v % 2 == 0 ? 0 : v);
+                             });
+  size_t total = 0;
+  for (auto v : gen) {
+    total += v;
+  }
+  CHECK(total == 3); // 0 + (0 + 1 + 2)
+}
+
+TEST_CASE("Manipulators propagate size hints") {
+  std::vector<size_t> vec = {1, 2, 3, 4, 5, 6};
+  using hint = fpgen::size_hint;
+  CHECK(fpgen::map(fpgen::from(vec), mapper).hint() == hint::exact(6));
+  CHECK(fpgen::drop(fpgen::from(vec), 2).hint() == hint::exact(4));
+  CHECK(fpgen::drop(fpgen::from(vec), 10).hint() == hint::exact(0));
+  CHECK(fpgen::take(fpgen::from(vec), 2).hint() == hint::exact(2));
+  CHECK(fpgen::take(fpgen::from(vec), 10).hint() == hint::exact(6));
+  CHECK(fpgen::take(manip(), 3).hint() == hint::at_most(3));
+  CHECK_FALSE(fpgen::drop(manip(), 3).hint().is_bounded());
+  CHECK_FALSE(fpgen::filter(fpgen::from(vec), is_even).hint().is_bounded());
+
+  std::vector<size_t> shorter = {1, 2};
+  CHECK(fpgen::zip(fpgen::from(vec), fpgen::from(shorter)).hint() ==
+        hint::exact(2));
+  CHECK(fpgen::zip(fpgen::from(vec), manip()).hint() == hint::at_most(6));
+  CHECK(fpgen::zip(fpgen::take(manip(), 3), fpgen::from(vec)).hint() ==
+        hint::at_most(3));
+  CHECK_FALSE(fpgen::zip(manip(), until12()).hint().is_bounded());
+
+  // the hints are correct
+  auto taken = fpgen::take(fpgen::drop(fpgen::from(vec), 1), 3);
+  CHECK(taken.hint() == hint::exact(3));
+  size_t count = 0;
+  for (size_t v : taken) {
+    CHECK(v == count + 2);
+    count++;
+  }
+  CHECK(count == 3);
+}
+
+TEST_CASE("Drop and take seek in random-access sources") {
+  std::vector<size_t> vec = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  CHECK(fpgen::from(vec).seekable());
+  CHECK(fpgen::inc(size_t{0}).seekable());
+  CHECK_FALSE(manip().seekable());
+  CHECK_FALSE(fpgen::from(std::set<size_t>{1, 2}).seekable());
+
+  auto dropped = fpgen::drop(fpgen::from(vec), 7);
+  CHECK(dropped.seekable());
+  CHECK(dropped.hint() == fpgen::size_hint::exact(3));
+  CHECK(dropped() == 7);
+  CHECK(dropped() == 8);
+  CHECK(dropped() == 9);
+  CHECK_FALSE(dropped);
+  CHECK_FALSE(dropped.seekable());
+
+  CHECK(fpgen::count(fpgen::drop(fpgen::from(vec), 20)) == 0);
+  CHECK(fpgen::sum(fpgen::take(fpgen::from(vec), 3)) == 3);
+  CHECK(fpgen::sum(fpgen::take(fpgen::drop(fpgen::from(vec), 8), 5)) == 17);
+
+  // a million skipped values cost nothing
+  auto far = fpgen::drop(fpgen::inc(size_t{5}), 1000000000);
+  CHECK(far() == 1000000005);
+  CHECK(far() == 1000000006);
+  CHECK(fpgen::take(fpgen::inc(0), 4).hint() == fpgen::size_hint::exact(4));
+  CHECK(fpgen::sum(fpgen::take(fpgen::inc(0), 4)) == 6);
+}
+
+TEST_CASE("Seeking keeps indices and references") {
+  std::deque<std::string> words = {"a", "b", "c", "d"};
+  std::vector<std::tuple<size_t, std::string>> pairs;
+  fpgen::aggregate_to(fpgen::drop(fpgen::enumerate(words), 2), pairs);
+  CHECK(pairs.size() == 2);
+  CHECK(std::get<0>(pairs[0]) == 2);
+  CHECK(std::get<1>(pairs[0]) == "c");
+  CHECK(std::get<0>(pairs[1]) == 3);
+
+  std::vector<int> values = {1, 2, 3, 4};
+  for (int &v : fpgen::slice(fpgen::from_ref(values), 1, 2)) {
+    v = 0;
+  }
+  CHECK(values == std::vector<int>{1, 0, 0, 4});
+}
+
+TEST_CASE("Slices of sequential and started generators") {
+  std::list<size_t> list = {0, 1, 2, 3, 4, 5};
+  auto page = fpgen::slice(fpgen::from(list), 2, 3);
+  CHECK(page() == 2);
+  CHECK(page() == 3);
+  CHECK(page() == 4);
+  CHECK_FALSE(page);
+
+  std::vector<size_t> vec = {0, 1, 2, 3, 4, 5};
+  auto started = fpgen::from(vec);
+  CHECK(started() == 0);
+  CHECK_FALSE(started.seekable());
+  auto rest = fpgen::slice(std::move(started), 1, 2);
+  CHECK(rest() == 2);
+  CHECK(rest() == 3);
+  CHECK_FALSE(rest);
+
+  CHECK(fpgen::count(fpgen::slice(manip(), 9, 100)) == 2);
+}
+
+TEST_CASE("Manipulators keep the nothrow policy for noexcept functions") {
+  std::vector<int> values = {1, 2, 3, 4};
+  auto twice = [](int v) noexcept { return 2 * v; };
+  auto even = [](int v) noexcept { return v % 2 == 0; };
+  auto throwing = [](int v) { return 2 * v; };
+
+  static_assert(std::is_same_v<decltype(fpgen::map(fpgen::from(values), twice)),
+                               fpgen::nothrow_generator<int>>);
+  static_assert(
+      std::is_same_v<decltype(fpgen::map(fpgen::from(values), throwing)),
+                     fpgen::generator<int>>);
+  static_assert(
+      std::is_same_v<decltype(fpgen::filter(fpgen::from(values), even)),
+                     fpgen::nothrow_generator<int>>);
+  static_assert(
+      std::is_same_v<decltype(fpgen::zip(fpgen::from(values),
+                                         fpgen::from(values))),
+                     fpgen::nothrow_generator<std::tuple<int, int>>>);
+  static_assert(std::is_same_v<decltype(fpgen::take(fpgen::inc(0), 3)),
+                               fpgen::nothrow_generator<int>>);
+  // a default generator anywhere upstream means the result may throw
+  static_assert(
+      std::is_same_v<decltype(fpgen::map(manip(), [](size_t v) noexcept {
+                       return v;
+                     })),
+                     fpgen::generator<size_t>>);
+
+  auto gen = fpgen::filter(fpgen::map(fpgen::from(values), twice),
+                           [](int v) noexcept { return v > 2; });
+  CHECK(fpgen::sum(std::move(gen)) == 4 + 6 + 8);
+  CHECK(fpgen::count(fpgen::map(fpgen::from(values), twice)) == 4);
+}
+
+namespace {
+// moving the value 2 throws
+struct throwing_move {
+  int value;
+  explicit throwing_move(int v) : value{v} {}
+  throwing_move(throwing_move &&other) : value{other.value} {
+    if (value == 2)
+      throw std::runtime_error("moved 2");
+  }
+};
+
+fpgen::nothrow_generator<throwing_move> throwing_moves() {
+  for (int i = 0; i < 5; i++) {
+    co_yield throwing_move(i);
+  }
+  co_return;
+}
+} // namespace
+
+TEST_CASE("Manipulators moving values which may throw can throw") {
+  auto get = [](const throwing_move &m) noexcept { return m.value; };
+  static_assert(std::is_same_v<decltype(fpgen::map(throwing_moves(), get)),
+                               fpgen::generator<int>>);
+  static_assert(std::is_same_v<decltype(fpgen::take(throwing_moves(), 3)),
+                               fpgen::generator<throwing_move>>);
+  static_assert(std::is_same_v<decltype(fpgen::drop(throwing_moves(), 1)),
+                               fpgen::generator<throwing_move>>);
+  static_assert(std::is_same_v<decltype(fpgen::slice(throwing_moves(), 1, 2)),
+                               fpgen::generator<throwing_move>>);
+
+  auto mapped = fpgen::map(throwing_moves(), get);
+  CHECK(mapped() == 0);
+  CHECK(mapped() == 1);
+  CHECK_THROWS_AS(mapped(), std::runtime_error);
+
+  auto taken = fpgen::take(throwing_moves(), 3);
+  CHECK(taken().value == 0);
+  CHECK(taken().value == 1);
+  CHECK_THROWS_AS(taken(), std::runtime_error);
+
+  auto dropped = fpgen::drop(throwing_moves(), 2);
+  CHECK_THROWS_AS(dropped(), std::runtime_error);
+}
+
+TEST_CASE("Manipulators accept any callable satisfying the constraints") {
+  auto twice = [](int v) { return 2 * v; };
+  static_assert(fpgen::type::function_to<decltype(twice), long, int>);
+  static_assert(!fpgen::type::function_to<decltype(twice), std::string, int>);
+  static_assert(fpgen::type::function_to<decltype(twice), void, int>);
+  static_assert(fpgen::type::predicate_for<decltype(twice), int>);
+  static_assert(!fpgen::type::predicate_for<decltype(twice), std::string>);
+
+  // move-only callables work as well
+  auto offset = std::make_unique<int>(10);
+  std::vector<int> values = {1, 2, 3};
+  auto gen = fpgen::map(fpgen::from(values),
+                        [o = std::move(offset)](int v) { return v + *o; });
+  CHECK(fpgen::sum(std::move(gen)) == 36);
+}
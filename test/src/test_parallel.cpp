@@ -0,0 +1,147 @@
+#include "aggregators.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "parallel.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+TEST_CASE("Thread pool runs every job") {
+  fpgen::thread_pool pool(4);
+  std::vector<std::atomic<int>> hits(1000);
+  pool.parallel_for(hits.size(), [&hits](size_t i) { hits[i]++; });
+  for (auto &hit : hits) {
+    CHECK(hit.load() == 1);
+  }
+}
+
+TEST_CASE("Thread pool jobs can be move-only") {
+  std::atomic<int> total{0};
+  {
+    fpgen::thread_pool pool(2);
+    for (int i = 1; i <= 10; i++) {
+      auto value = std::make_unique<int>(i);
+      pool.submit([&total, value = std::move(value)]() { total += *value; });
+    }
+  } // the destructor finishes all jobs
+  CHECK(total.load() == 55);
+}
+
+TEST_CASE("Nested parallel loops") {
+  fpgen::thread_pool pool(2);
+  std::atomic<size_t> total{0};
+  pool.parallel_for(8, [&](size_t) {
+    pool.parallel_for(100, [&](size_t j) { total += j; });
+  });
+  CHECK(total.load() == 8 * 4950);
+}
+
+TEST_CASE("Parallel loop rethrows exceptions") {
+  fpgen::thread_pool pool(3);
+  std::atomic<int> ran{0};
+  CHECK_THROWS(pool.parallel_for(20, [&ran](size_t i) {
+    ran++;
+    if (i == 7)
+      throw std::runtime_error("seven");
+  }));
+  CHECK(ran.load() == 20);
+}
+
+TEST_CASE("Splittable sources") {
+  std::vector<std::string> in = {"a", "b", "c", "d", "e"};
+  auto src = fpgen::split_from(in);
+  CHECK(src.size() == 5);
+  auto gen = src.part(1, 3);
+  CHECK(&gen() == &in[1]);
+  CHECK(&gen() == &in[2]);
+  CHECK(!static_cast<bool>(gen));
+  CHECK(fpgen::count(src.part(3, 100)) == 2);
+
+  auto idx = fpgen::split_enumerate(in).part(2, 4);
+  CHECK(idx() == std::tuple<size_t, std::string>{2, "c"});
+  CHECK(idx() == std::tuple<size_t, std::string>{3, "d"});
+
+  CHECK(fpgen::sum(fpgen::split_range(-3, 5).all()) == 4);
+  CHECK(fpgen::split_range(5, 2).size() == 0);
+}
+
+TEST_CASE("Splittable range over the full width of a type") {
+  using lim = std::numeric_limits<int>;
+  auto wide = fpgen::split_range(lim::min(), lim::max());
+  CHECK(wide.size() == size_t{lim::max()} * 2 + 1);
+  auto last = wide.part(wide.size() - 2, wide.size());
+  CHECK(last() == lim::max() - 2);
+  CHECK(last() == lim::max() - 1);
+  CHECK(!static_cast<bool>(last));
+
+  auto bytes = fpgen::split_range<int8_t>(-128, 127);
+  CHECK(bytes.size() == 255);
+  CHECK(fpgen::count(bytes.part(250, 300)) == 5);
+  auto widen = [](int acc, int8_t v) { return acc + v; };
+  CHECK(fpgen::fold<int>(bytes.part(250, 255), widen) ==
+        122 + 123 + 124 + 125 + 126);
+}
+
+TEST_CASE("Parallel sum matches the sequential sum") {
+  fpgen::thread_pool pool(4);
+  std::vector<long> in;
+  for (long i = 0; i < 100000; i++) {
+    in.push_back(i * 7 % 1013);
+  }
+  long expect = fpgen::sum(fpgen::split_from(in).all());
+  CHECK(fpgen::parallel_sum(fpgen::split_from(in), pool) == expect);
+  CHECK(fpgen::parallel_sum(fpgen::split_range(0L, 100000L)) ==
+        99999L * 100000 / 2);
+  CHECK(fpgen::parallel_sum(fpgen::split_from(std::vector<int>{})) == 0);
+}
+
+TEST_CASE("Parallel fold keeps the order of a non-commutative fold") {
+  std::vector<char> in;
+  for (int i = 0; i < 2000; i++) {
+    in.push_back((char)('a' + i % 26));
+  }
+  auto append = [](std::string acc, char c) { return acc + c; };
+  auto concat = [](std::string lhs, std::string rhs) { return lhs + rhs; };
+  std::string expect(in.begin(), in.end());
+  CHECK(fpgen::parallel_fold<std::string>(fpgen::split_from(in), append,
+                                          concat, std::string(">")) ==
+        ">" + expect);
+}
+
+TEST_CASE("Parallel fold seeds each part with the identity") {
+  fpgen::thread_pool pool(4);
+  auto mul = [](long acc, long v) { return acc * v; };
+  CHECK(fpgen::parallel_fold<long>(fpgen::split_range(1L, 11L), mul, mul, 1L,
+                                   1L, pool) == 3628800);
+  CHECK(fpgen::parallel_fold<long>(fpgen::split_range(1L, 11L), mul, mul, 2L,
+                                   1L, pool) == 2 * 3628800L);
+
+  std::vector<int> in;
+  for (int i = 0; i < 1000; i++) {
+    in.push_back(-1000 + i * 37 % 991);
+  }
+  auto max = [](int lhs, int rhs) { return std::max(lhs, rhs); };
+  CHECK(fpgen::parallel_fold<int>(fpgen::split_from(in), max, max,
+                                  std::numeric_limits<int>::min(),
+                                  std::numeric_limits<int>::min(),
+                                  pool) == *std::max_element(in.begin(),
+                                                             in.end()));
+}
+
+TEST_CASE("Parallel fold over an enumeration") {
+  std::vector<int> in = {5, 6, 7, 8};
+  auto weigh = [](long acc, std::tuple<size_t, int> v) {
+    return acc + (long)std::get<0>(v) * std::get<1>(v);
+  };
+  auto add = [](long lhs, long rhs) { return lhs + rhs; };
+  CHECK(fpgen::parallel_fold<long>(fpgen::split_enumerate(in), weigh, add) ==
+        0 * 5 + 1 * 6 + 2 * 7 + 3 * 8);
+}
@@ -0,0 +1,124 @@
+#include "aggregators.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "manipulators.hpp"
+#include "pipeline.hpp"
+#include "sources.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+TEST_CASE("Pipeline over a generator") {
+  std::vector<int> in = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  fpgen::generator<int> gen = fpgen::from(in) |
+                              fpgen::map([](int v) { return v * 3; }) |
+                              fpgen::filter([](int v) { return v % 2 == 0; }) |
+                              fpgen::take(3);
+  CHECK(gen() == 6);
+  CHECK(gen() == 12);
+  CHECK(gen() == 18);
+  CHECK(!static_cast<bool>(gen));
+}
+
+TEST_CASE("Pipeline matches the manipulator functions") {
+  auto p = [](size_t v) { return v % 3 != 0; };
+  auto f = [](size_t v) { return v * v; };
+  auto lt = [](size_t v) { return v < 1000; };
+  auto small = [](size_t v) { return v < 20; };
+
+  std::vector<size_t> chained, fused;
+  fpgen::aggregate_to(
+      fpgen::take_while(
+          fpgen::map(fpgen::drop_while(
+                         fpgen::filter(fpgen::drop(fpgen::inc((size_t)0), 2),
+                                       p),
+                         small),
+                     f),
+          lt),
+      chained);
+  fpgen::aggregate_to(fpgen::inc((size_t)0) | fpgen::drop(2) |
+                          fpgen::filter(p) | fpgen::drop_while(small) |
+                          fpgen::map(f) | fpgen::take_while(lt),
+                      fused);
+  CHECK(chained.size() > 0);
+  CHECK(chained == fused);
+}
+
+TEST_CASE("Pipeline over a container keeps references") {
+  std::vector<std::string> in = {"a", "bb", "ccc", "dddd"};
+  fpgen::generator<std::string &> gen =
+      in | fpgen::filter([](const std::string &s) { return s.size() % 2; });
+  CHECK(&gen() == &in[0]);
+  CHECK(&gen() == &in[2]);
+  CHECK(!static_cast<bool>(gen));
+
+  std::string joined;
+  fpgen::foreach (in | fpgen::drop(1) | fpgen::take(2),
+                  [&joined](const std::string &s) { joined += s; });
+  CHECK(joined == "bbccc");
+}
+
+TEST_CASE("Pipeline aggregators") {
+  std::vector<int> in = {1, 2, 3, 4, 5};
+  auto odd = [](int v) { return v % 2 == 1; };
+  CHECK(fpgen::sum(in | fpgen::filter(odd)) == 9);
+  CHECK(fpgen::count(in | fpgen::filter(odd)) == 3);
+  CHECK(fpgen::fold<int>(in | fpgen::take(3),
+                         [](int acc, int v) { return acc * 10 + v; }) ==
+        123);
+  CHECK(fpgen::fold(
+            in | fpgen::map([](int v) { return std::to_string(v); }),
+            [](std::string acc, std::string v) { return acc + v; },
+            std::string("0")) == "012345");
+}
+
+TEST_CASE("Pipeline take stops pulling from the source") {
+  size_t pulled = 0;
+  auto gen = fpgen::map(fpgen::inc((size_t)0), [&pulled](size_t v) {
+    pulled++;
+    return v;
+  });
+  CHECK(fpgen::sum(std::move(gen) | fpgen::take(4)) == 6);
+  CHECK(pulled == 4);
+
+  std::vector<int> in = {1, 2, 3};
+  size_t mapped = 0;
+  auto counted = [&mapped](int v) {
+    mapped++;
+    return v;
+  };
+  CHECK(fpgen::count(in | fpgen::map(counted) | fpgen::take(0)) == 0);
+  CHECK(mapped == 0);
+}
+
+TEST_CASE("Pipeline over move-only values") {
+  std::vector<int> in = {1, 2, 3, 4};
+  fpgen::generator<std::unique_ptr<int>> gen =
+      in | fpgen::map([](int v) { return std::make_unique<int>(v); }) |
+      fpgen::filter([](const std::unique_ptr<int> &p) { return *p > 1; });
+  std::vector<std::unique_ptr<int>> out;
+  fpgen::aggregate_to(std::move(gen), out);
+  REQUIRE(out.size() == 3);
+  CHECK(*out[0] == 2);
+  CHECK(*out[2] == 4);
+}
+
+TEST_CASE("Manipulators over a converted pipeline") {
+  std::vector<int> in = {1, 2, 3};
+  fpgen::generator<int> gen = in | fpgen::map([](int v) { return v + 1; });
+  CHECK(fpgen::sum(fpgen::map(std::move(gen), [](int v) { return v * 2; })) ==
+        18);
+}
+
+TEST_CASE("Manipulators over a pipeline extend it") {
+  std::vector<int> in = {1, 2, 3, 4, 5, 6};
+  auto pipe = fpgen::filter(
+      fpgen::map(in | fpgen::drop(1), [](int v) { return v * 2; }),
+      [](int v) { return v % 3 != 0; });
+  static_assert(std::is_same_v<decltype(pipe)::value_type, int>);
+  std::vector<int> out;
+  fpgen::aggregate_to(fpgen::take(std::move(pipe), 3), out);
+  CHECK(out == std::vector<int>{4, 8, 10});
+  CHECK(fpgen::sum(fpgen::drop(in | fpgen::take(4), 2)) == 7);
+}
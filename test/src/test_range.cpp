@@ -0,0 +1,154 @@
+#include "aggregators.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "manipulators.hpp"
+#include "parallel.hpp"
+#include "pipeline.hpp"
+#include "range.hpp"
+#include "sources.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+template <typename T> std::vector<T> values(fpgen::numeric_range<T> r) {
+  std::vector<T> out;
+  for (T v : r) {
+    out.push_back(v);
+  }
+  return out;
+}
+
+TEST_CASE("Range values and size") {
+  CHECK(values(fpgen::range(0, 5)) == std::vector<int>{0, 1, 2, 3, 4});
+  CHECK(values(fpgen::range(1, 10, 3)) == std::vector<int>{1, 4, 7});
+  CHECK(values(fpgen::range(10, 0, -4)) == std::vector<int>{10, 6, 2});
+  CHECK(values(fpgen::iota_n(-2, 4)) == std::vector<int>{-2, -1, 0, 1});
+  CHECK(fpgen::range(0, 5).size() == 5);
+  CHECK(fpgen::range(1, 10, 3).size() == 3);
+  CHECK(fpgen::range(0, 9, 3).size() == 3);
+  CHECK(fpgen::range(0, 0).empty());
+  CHECK(fpgen::range(5, 0).empty());
+  CHECK(fpgen::range(0, 5, -1).empty());
+  CHECK(fpgen::range(1, 10, 3)[2] == 7);
+}
+
+TEST_CASE("Range over the full width of a type") {
+  using lim = std::numeric_limits<int8_t>;
+  auto all = fpgen::range<int8_t>(lim::min(), lim::max());
+  CHECK(all.size() == 255);
+  CHECK(all.front() == lim::min());
+  CHECK(all.back() == lim::max() - 1);
+  CHECK(fpgen::range<int8_t>(lim::max(), lim::min(), -100).size() == 3);
+  CHECK(fpgen::range<uint64_t>(0, UINT64_MAX, UINT64_MAX / 2).size() == 3);
+}
+
+TEST_CASE("Floating-point range") {
+  CHECK(values(fpgen::range(0.0, 1.0, 0.25)) ==
+        std::vector<double>{0.0, 0.25, 0.5, 0.75});
+  CHECK(values(fpgen::range(1.0, 0.0, -0.5)) ==
+        std::vector<double>{1.0, 0.5});
+  CHECK(fpgen::range(0.0, 1.1, 0.5).size() == 3);
+  CHECK(fpgen::iota_n(0.5f, 3).back() == 2.5f);
+  // values don't accumulate rounding errors
+  CHECK(fpgen::range(0.0, 1.0, 0.1)[7] == 7 * 0.1);
+}
+
+TEST_CASE("Range rejects invalid steps") {
+  CHECK_THROWS_AS(fpgen::range(0, 10, 0), std::invalid_argument);
+  CHECK_THROWS_AS(fpgen::range(0.0, 1.0, 0.0), std::invalid_argument);
+  CHECK_THROWS_AS(
+      fpgen::range(0.0, std::numeric_limits<double>::infinity(), 1.0),
+      std::invalid_argument);
+  CHECK_THROWS_AS(
+      fpgen::range(0.0, 1.0, std::numeric_limits<double>::quiet_NaN()),
+      std::invalid_argument);
+  CHECK_THROWS_AS(fpgen::range(0.0, 1e30, 1.0), std::invalid_argument);
+  CHECK_THROWS_AS(fpgen::range(0.0f, 1e20f, 1.0f), std::invalid_argument);
+  CHECK(fpgen::range(0.0, 1e30, 1e20).size() == 10000000000);
+}
+
+TEST_CASE("Range is a standard view") {
+  using range_t = fpgen::numeric_range<long>;
+  static_assert(std::ranges::random_access_range<range_t>);
+  static_assert(std::ranges::sized_range<range_t>);
+  static_assert(std::ranges::view<range_t>);
+  static_assert(std::ranges::borrowed_range<range_t>);
+
+  auto r = fpgen::range(0L, 10L, 2L);
+  CHECK(std::ranges::distance(r) == 5);
+  CHECK(std::ranges::find(r, 6L) - r.begin() == 3);
+  std::vector<long> rev;
+  for (long v : r | std::views::reverse) {
+    rev.push_back(v);
+  }
+  CHECK(rev == std::vector<long>{8, 6, 4, 2, 0});
+}
+
+TEST_CASE("Generator over a range is seekable and exact") {
+  auto gen = fpgen::from(fpgen::range(0, 100, 5));
+  static_assert(std::is_same_v<decltype(gen), fpgen::nothrow_generator<int>>);
+  CHECK(gen.hint() == fpgen::size_hint::exact(20));
+  CHECK(gen.seekable());
+  CHECK(fpgen::sum(fpgen::slice(fpgen::from(fpgen::range(0, 100, 5)), 2, 3)) ==
+        10 + 15 + 20);
+}
+
+TEST_CASE("Take, drop and slice keep a range") {
+  auto r = fpgen::range(0, 20, 2);
+  static_assert(
+      std::is_same_v<decltype(fpgen::take(r, 3)), fpgen::numeric_range<int>>);
+  CHECK(values(fpgen::take(r, 3)) == std::vector<int>{0, 2, 4});
+  CHECK(values(fpgen::drop(r, 7)) == std::vector<int>{14, 16, 18});
+  CHECK(values(fpgen::slice(r, 1, 2)) == std::vector<int>{2, 4});
+  CHECK(fpgen::take(r, 100).size() == 10);
+  CHECK(fpgen::drop(r, 100).empty());
+}
+
+TEST_CASE("Range aggregators match the generator versions") {
+  auto odd = [](int v) { return v % 2 != 0; };
+  auto sq = [](int v) { return v * v; };
+  auto r = fpgen::range(-7, 50, 3);
+  auto gen = [] {
+    return fpgen::filter(fpgen::take(fpgen::inc(-7), 57),
+                         [](int v) { return (v + 7) % 3 == 0; });
+  };
+
+  CHECK(fpgen::sum(r) == fpgen::sum(gen()));
+  CHECK(fpgen::count(r) == fpgen::count(gen()));
+  CHECK(fpgen::sum(fpgen::map(r, sq)) == fpgen::sum(fpgen::map(gen(), sq)));
+  CHECK(fpgen::count(fpgen::filter(r, odd)) ==
+        fpgen::count(fpgen::filter(gen(), odd)));
+  CHECK(fpgen::fold<int>(r, [](int acc, int v) { return acc - v; }) ==
+        fpgen::fold<int>(gen(), [](int acc, int v) { return acc - v; }));
+  CHECK(fpgen::fold(
+            r, [](long acc, int v) { return acc * 3 + v; }, 1L) ==
+        fpgen::fold(
+            gen(), [](long acc, int v) { return acc * 3 + v; }, 1L));
+  CHECK(fpgen::sum(r | fpgen::filter(odd) | fpgen::map(sq) | fpgen::take(3)) ==
+        49 + 1 + 25);
+
+  std::vector<int> out = {100};
+  fpgen::aggregate_to(r, out);
+  CHECK(out.size() == r.size() + 1);
+  CHECK(std::equal(r.begin(), r.end(), out.begin() + 1));
+
+  int total = 0;
+  fpgen::foreach (fpgen::iota_n(1, 4), [&total](int v) { total += v; });
+  CHECK(total == 10);
+}
+
+TEST_CASE("Range splits for parallel aggregators") {
+  auto r = fpgen::range<int64_t>(3, 100003, 7);
+  auto src = fpgen::split_range(r);
+  CHECK(src.size() == r.size());
+  CHECK(fpgen::parallel_sum(src) == fpgen::sum(r));
+  CHECK(fpgen::parallel_sum(fpgen::split_range(fpgen::range(0, 0))) == 0);
+
+  std::vector<int64_t> part;
+  fpgen::aggregate_to(src.part(2, 5), part);
+  CHECK(part == std::vector<int64_t>{17, 24, 31});
+}
@@ -0,0 +1,121 @@
+#include "batch.hpp"
+#include "doctest/doctest.h"
+#include "simd.hpp"
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace {
+const fpgen::simd::level levels[] = {fpgen::simd::level::scalar,
+                                     fpgen::simd::level::sse4,
+                                     fpgen::simd::level::avx2};
+
+// runs the checks at every level the CPU supports
+template <typename Fun> void at_each_level(Fun checks) {
+  for (auto lvl : levels) {
+    if (lvl > fpgen::simd::supported())
+      continue;
+    fpgen::simd::limit(lvl);
+    CHECK(fpgen::simd::active() == lvl);
+    checks();
+  }
+  fpgen::simd::limit(fpgen::simd::level::avx2);
+}
+} // namespace
+
+TEST_CASE("SIMD sum") {
+  std::vector<int> ints;
+  std::vector<double> doubles;
+  for (int i = 0; i < 1001; i++) {
+    ints.push_back(i - 300);
+    doubles.push_back(0.5 * i);
+  }
+  at_each_level([&]() {
+    CHECK(fpgen::simd::sum(ints) == 1001 * 200);
+    CHECK(fpgen::simd::sum(doubles) == 0.5 * 1000 * 1001 / 2);
+    CHECK(fpgen::simd::sum(std::span<const int>(ints).first(5)) ==
+          -300 - 299 - 298 - 297 - 296);
+    CHECK(fpgen::simd::sum(std::vector<float>{}) == 0.0f);
+  });
+}
+
+TEST_CASE("SIMD sum wraps like a sequential sum") {
+  std::vector<uint8_t> bytes(1000, 200);
+  uint8_t expect = 0;
+  for (uint8_t b : bytes)
+    expect = (uint8_t)(expect + b);
+  at_each_level([&]() { CHECK(fpgen::simd::sum(bytes) == expect); });
+}
+
+TEST_CASE("SIMD min and max") {
+  std::vector<float> values;
+  for (int i = 0; i < 257; i++) {
+    values.push_back((float)((i * 37) % 101) - 50.0f);
+  }
+  values[200] = -1000.0f;
+  values[13] = 1000.0f;
+  at_each_level([&]() {
+    CHECK(fpgen::simd::min(values) == -1000.0f);
+    CHECK(fpgen::simd::max(values) == 1000.0f);
+    CHECK(fpgen::simd::min(std::array<long, 1>{7}) == 7);
+  });
+  CHECK_THROWS(fpgen::simd::min(std::vector<int>{}));
+  CHECK_THROWS(fpgen::simd::max(std::vector<int>{}));
+}
+
+TEST_CASE("SIMD count and dot product") {
+  std::vector<short> values;
+  for (int i = 0; i < 999; i++) {
+    values.push_back((short)(i % 9));
+  }
+  std::vector<int> lhs = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  std::vector<int> rhs = {2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 100};
+  at_each_level([&]() {
+    CHECK(fpgen::simd::count(values, (short)4) == 111);
+    CHECK(fpgen::simd::count(values, (short)42) == 0);
+    CHECK(fpgen::simd::dot(lhs, rhs) == 132);
+  });
+}
+
+TEST_CASE("SIMD find") {
+  std::vector<char> text(1000, 'x');
+  text[77] = '\n';
+  text[500] = '\n';
+  at_each_level([&]() {
+    CHECK(fpgen::simd::find(text, '\n') == 77);
+    CHECK(fpgen::simd::find(std::span<const char>(text).subspan(78), '\n') ==
+          500 - 78);
+    CHECK(fpgen::simd::find(std::span<const char>(text).first(77), '\n') ==
+          77);
+    CHECK(fpgen::simd::find(text, 'y') == 1000);
+    CHECK(fpgen::simd::find(std::vector<int>{}, 1) == 0);
+  });
+}
+
+TEST_CASE("SIMD associative fold") {
+  std::vector<unsigned> values;
+  for (unsigned i = 0; i < 100; i++) {
+    values.push_back(i * 2654435761u);
+  }
+  unsigned expect = 0;
+  for (unsigned v : values)
+    expect ^= v;
+  at_each_level([&]() {
+    CHECK(fpgen::simd::fold(values, 0u,
+                            [](unsigned a, unsigned b) { return a ^ b; }) ==
+          expect);
+  });
+}
+
+TEST_CASE("Batch aggregators use the SIMD kernels") {
+  std::vector<int> values;
+  for (int i = 0; i < 100; i++) {
+    values.push_back((i * 13) % 50);
+  }
+  CHECK(fpgen::batch::sum(fpgen::batch::from(values, 16)) == 49 * 50);
+  CHECK(fpgen::batch::min(fpgen::batch::from(values, 16)) == 0);
+  CHECK(fpgen::batch::max(fpgen::batch::from(values, 16)) == 49);
+  CHECK_THROWS(fpgen::batch::max(fpgen::batch::from(std::vector<int>{}, 4)));
+}
@@ -0,0 +1,163 @@
+#include "aggregators.hpp"
+#include "doctest/doctest.h"
+#include "generator.hpp"
+#include "sink.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+// a file in the temporary directory, removed once the test is done
+struct sink_file {
+  std::string path;
+
+  explicit sink_file(const std::string &name)
+      : path{(std::filesystem::temp_directory_path() / name).string()} {}
+
+  ~sink_file() { std::filesystem::remove(path); }
+
+  std::string contents() const {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in),
+            std::istreambuf_iterator<char>()};
+  }
+};
+
+struct sink_point {
+  int x, y;
+};
+
+std::ostream &operator<<(std::ostream &out, const sink_point &p) {
+  return out << "(" << p.x << "," << p.y << ")";
+}
+
+fpgen::generator<int> sink_values(int max) {
+  for (int i = 0; i < max; i++) {
+    co_yield i;
+  }
+  co_return;
+}
+} // namespace
+
+TEST_CASE("Sink formats values") {
+  sink_file file("fpgen_sink_values.txt");
+  {
+    fpgen::fd_sink sink(file.path);
+    sink.put(-42).put(' ').put(0.1).put(' ').put(1e20).put(' ').put(true);
+    sink.put(' ').put("text").put(' ').put(std::string("string"));
+    sink.put(' ').put(sink_point{1, 2}).put(' ').put(18446744073709551615ull);
+  }
+  CHECK(file.contents() ==
+        "-42 0.1 1e+20 1 text string (1,2) 18446744073709551615");
+}
+
+TEST_CASE("Sink output matches to_lines") {
+  std::ostringstream expected;
+  fpgen::to_lines(sink_values(1000), expected);
+
+  sink_file file("fpgen_sink_lines.txt");
+  {
+    fpgen::sink_options options;
+    options.capacity = 100;
+    fpgen::fd_sink sink(file.path, options);
+    fpgen::to_sink_lines(sink_values(1000), sink).flush();
+  }
+  CHECK(file.contents() == expected.str());
+}
+
+TEST_CASE("Sink with and without separator") {
+  sink_file file("fpgen_sink_separator.txt");
+  {
+    fpgen::fd_sink sink(file.path);
+    fpgen::to_sink(sink_values(4), sink, ", ");
+    fpgen::to_sink(sink_values(4), sink);
+  }
+  CHECK(file.contents() == "0, 1, 2, 30123");
+}
+
+TEST_CASE("Sink writes larger than its buffer") {
+  std::string big(1000, 'b');
+  sink_file file("fpgen_sink_big.txt");
+  {
+    fpgen::sink_options options;
+    options.capacity = 64;
+    fpgen::fd_sink sink(file.path, options);
+    sink.write("start ").write(big).write(" end");
+  }
+  CHECK(file.contents() == "start " + big + " end");
+}
+
+TEST_CASE("Sink flush policies") {
+  int ends[2];
+  REQUIRE(pipe(ends) == 0);
+  REQUIRE(fcntl(ends[0], F_SETFL, O_NONBLOCK) == 0);
+  auto available = [&ends]() {
+    char buffer[256];
+    ssize_t got = read(ends[0], buffer, sizeof(buffer));
+    return got < 0 ? std::string() : std::string(buffer, got);
+  };
+
+  {
+    fpgen::fd_sink sink(ends[1]);
+    sink.put(1).put('\n');
+    CHECK(available() == "");
+    sink.flush();
+    CHECK(available() == "1\n");
+  }
+  {
+    fpgen::sink_options options;
+    options.policy = fpgen::flush_policy::line;
+    fpgen::fd_sink sink(ends[1], options);
+    sink.put(2);
+    CHECK(available() == "");
+    sink.put('\n');
+    CHECK(available() == "2\n");
+  }
+  {
+    fpgen::sink_options options;
+    options.policy = fpgen::flush_policy::always;
+    fpgen::fd_sink sink(ends[1], options);
+    sink.put(3);
+    CHECK(available() == "3");
+  }
+  close(ends[0]);
+  close(ends[1]);
+}
+
+TEST_CASE("Sink on a background thread") {
+  std::ostringstream expected;
+  fpgen::to_stream(sink_values(20000), expected, ' ');
+
+  sink_file file("fpgen_sink_background.txt");
+  {
+    fpgen::sink_options options;
+    options.capacity = 256;
+    options.background = true;
+    fpgen::fd_sink sink(file.path, options);
+    fpgen::to_sink(sink_values(20000), sink, ' ');
+    sink.write(std::string(1000, '!')).flush();
+  }
+  CHECK(file.contents() == expected.str() + std::string(1000, '!'));
+}
+
+TEST_CASE("Sink errors surface on flush") {
+  fpgen::fd_sink sink(-1);
+  sink.put(5);
+  CHECK_THROWS_AS(sink.flush(), std::system_error);
+
+  fpgen::sink_options options;
+  options.background = true;
+  fpgen::fd_sink background(-1, options);
+  background.put(5);
+  CHECK_THROWS_AS(background.flush(), std::system_error);
+  CHECK_THROWS_AS(fpgen::fd_sink("/nonexistent/fpgen/sink"),
+                  std::system_error);
+}
@@ -1,12 +1,18 @@
+#include "aggregators.hpp"
 #include "doctest/doctest.h"
 #include "generator.hpp"
+#include "manipulators.hpp"
 #include "sources.hpp"
 
 #include <iostream>
 #include <map>
+#include <ranges>
 #include <set>
 #include <sstream>
 #include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 TEST_CASE("Generator from std::vector") {
@@ -29,6 +35,68 @@ TEST_CASE("Generator from std::set") {
   CHECK(todo.empty());
 }
 
+namespace {
+struct copy_counter {
+  static inline size_t copies = 0;
+  int value;
+
+  copy_counter() : value{0} {}
+  copy_counter(int value) : value{value} {}
+  copy_counter(const copy_counter &other) : value{other.value} { copies++; }
+  copy_counter(copy_counter &&other) = default;
+  copy_counter &operator=(const copy_counter &other) {
+    value = other.value;
+    copies++;
+    return *this;
+  }
+  copy_counter &operator=(copy_counter &&other) = default;
+};
+} // namespace
+
+TEST_CASE("Generator from std::vector copies each element once") {
+  std::vector<copy_counter> values = {1, 2, 3};
+  copy_counter::copies = 0;
+  int expect = 1;
+  auto gen = fpgen::from(values);
+  while (gen) {
+    copy_counter v = gen();
+    CHECK(v.value == expect);
+    expect++;
+  }
+  CHECK(copy_counter::copies == 3);
+}
+
+TEST_CASE("Reference generator from std::vector") {
+  std::vector<copy_counter> values = {1, 2, 3};
+  copy_counter::copies = 0;
+  size_t idx = 0;
+  for (const copy_counter &v : fpgen::from_ref(std::as_const(values))) {
+    CHECK(&v == &values[idx]);
+    idx++;
+  }
+  CHECK(idx == 3);
+  CHECK(copy_counter::copies == 0);
+}
+
+TEST_CASE("Mutable reference generator from std::vector") {
+  std::vector<int> values = {1, 2, 3};
+  for (int &v : fpgen::from_ref(values)) {
+    v *= 2;
+  }
+  CHECK(values == std::vector<int>{2, 4, 6});
+}
+
+TEST_CASE("Reference generator from std::map") {
+  std::map<std::string, std::string> map = {{"key 1", "value 1"},
+                                            {"key 2", "value 2"}};
+  auto it = map.begin();
+  for (const auto &v : fpgen::from_ref(std::as_const(map))) {
+    CHECK(&v == &*it);
+    ++it;
+  }
+  CHECK(it == map.end());
+}
+
 TEST_CASE("Generator from enumerate over std::vector") {
   std::vector<char> values = {'a', 'c', 'e', 'k', 'j', 't'};
   size_t prev = 0;
@@ -151,3 +219,115 @@ Etiam vel porta augue. Maecenas volutpat odio in lacus sagittis fermentum.
   bool gens = gen;
   CHECK(!gens);
 }
+
+TEST_CASE("Size hints of container sources") {
+  std::vector<int> vec = {1, 2, 3, 4};
+  std::map<int, char> map = {{1, 'a'}, {2, 'b'}};
+  CHECK(fpgen::from(vec).hint() == fpgen::size_hint::exact(4));
+  CHECK(fpgen::from_ref(vec).hint() == fpgen::size_hint::exact(4));
+  CHECK(fpgen::enumerate(vec).hint() == fpgen::size_hint::exact(4));
+  CHECK(fpgen::from_tup(map).hint() == fpgen::size_hint::exact(2));
+  CHECK_FALSE(fpgen::inc(0).hint().is_bounded());
+
+  auto gen = fpgen::from(vec);
+  CHECK(gen);
+  gen();
+  // the hint only describes the generator before it runs
+  CHECK_FALSE(gen.hint().is_bounded());
+  while (gen) {
+    gen();
+  }
+  CHECK(gen.hint() == fpgen::size_hint::exact(0));
+}
+
+TEST_CASE("Generator from a range") {
+  std::vector<int> vec = {1, 2, 3, 4};
+  auto doubled = fpgen::from_range(
+      vec | std::views::transform([](int v) { return v * 2; }));
+  CHECK(doubled.hint() == fpgen::size_hint::exact(4));
+  CHECK(doubled.seekable());
+  std::vector<int> out;
+  for (int v : doubled) {
+    out.push_back(v);
+  }
+  CHECK(out == std::vector<int>{2, 4, 6, 8});
+
+  auto odd = fpgen::from_range(std::views::iota(0, 10) |
+                               std::views::filter([](int v) { return v % 2; }));
+  CHECK_FALSE(odd.hint().is_bounded());
+  CHECK_FALSE(odd.seekable());
+  int expect = 1;
+  for (int v : odd) {
+    CHECK(v == expect);
+    expect += 2;
+  }
+  CHECK(expect == 11);
+
+  // rvalue containers are owned by the generator
+  auto owned = fpgen::from_range(std::vector<std::string>{"a", "b"});
+  CHECK(owned() == "a");
+  CHECK(owned() == "b");
+  CHECK_FALSE(owned);
+
+  auto infinite = fpgen::from_range(std::views::iota(5));
+  CHECK(infinite() == 5);
+  CHECK(infinite() == 6);
+}
+
+TEST_CASE("Sources pick the nothrow policy where nothing can throw") {
+  std::vector<int> ints = {1, 2, 3};
+  std::vector<std::string> strings = {"a", "b"};
+  std::map<int, int> map = {{1, 2}};
+  static_assert(std::is_same_v<decltype(fpgen::from(ints)),
+                               fpgen::nothrow_generator<int>>);
+  static_assert(std::is_same_v<decltype(fpgen::from_ref(strings)),
+                               fpgen::nothrow_generator<std::string &>>);
+  static_assert(
+      std::is_same_v<decltype(fpgen::enumerate(ints)),
+                     fpgen::nothrow_generator<std::tuple<size_t, int>>>);
+  static_assert(std::is_same_v<decltype(fpgen::from_tup(map)),
+                               fpgen::nothrow_generator<std::tuple<int, int>>>);
+  static_assert(std::is_same_v<decltype(fpgen::inc(0)),
+                               fpgen::nothrow_generator<int>>);
+  // copying strings may throw
+  static_assert(std::is_same_v<decltype(fpgen::from(strings)),
+                               fpgen::generator<std::string>>);
+
+  std::stringstream stream("1 2 3");
+  auto read = [](std::istream &s) noexcept {
+    int v = 0;
+    s >> v;
+    return v;
+  };
+  static_assert(std::is_same_v<decltype(fpgen::from_stream(stream, read)),
+                               fpgen::nothrow_generator<int>>);
+  static_assert(std::is_same_v<decltype(fpgen::from_lines(stream)),
+                               fpgen::generator<std::string>>);
+
+  auto gen = fpgen::from(ints);
+  CHECK(gen.seekable());
+  CHECK(gen.hint().size == 3);
+  CHECK(gen() == 1);
+}
+
+TEST_CASE("Converted nothrow generators stay seekable") {
+  std::vector<int> in = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  fpgen::generator<int> gen = fpgen::from(in);
+  CHECK(gen.seekable());
+  CHECK(gen.hint() == fpgen::size_hint::exact(10));
+  gen.seek(3);
+  gen.truncate(4);
+  CHECK(gen.hint() == fpgen::size_hint::exact(4));
+  std::vector<int> out;
+  for (int v : gen) {
+    out.push_back(v);
+  }
+  CHECK(out == std::vector<int>{3, 4, 5, 6});
+
+  // drop and take seek through the wrapper, without resuming for skipped
+  // values
+  fpgen::generator<int> counter = fpgen::inc(0);
+  CHECK(counter.seekable());
+  CHECK(fpgen::sum(fpgen::take(fpgen::drop(std::move(counter), 1000000), 3)) ==
+        3000003);
+}